@@ -0,0 +1,74 @@
+#!/bin/bash
+
+# Mesure le débit des programmes de test/bench : durée, octets écrits et lus, appels système.
+# Les options sont passées au compilateur, par exemple : ./bench.sh -O1
+# Un programme lit la sortie du script de même nom en .sh s'il existe.
+# Les cycles par ligne, lue ou écrite, sont estimés avec la fréquence de /proc/cpuinfo.
+
+if [ ! -f "./bin/tpcc" ]; then
+  echo "Le compilateur 'tpcc' n'est pas présent dans le répertoire courant."
+  exit 1
+fi
+
+if [ ! -f "./bin/libtpc.a" ]; then
+  echo "Le runtime 'libtpc.a' n'est pas construit, utilisez : make runtime"
+  exit 1
+fi
+
+bench_directory="test/bench"
+
+mkdir -p obj bin
+
+# Compteurs d'entrées-sorties du shell, qui comptent aussi ceux des processus fils terminés.
+read_io() {
+  while read -r key value; do
+    case $key in
+      rchar:) read_bytes=$value ;;
+      wchar:) write_bytes=$value ;;
+      syscr:) read_calls=$value ;;
+      syscw:) write_calls=$value ;;
+    esac
+  done < /proc/$BASHPID/io
+}
+
+mhz=$(awk -F': ' '/^cpu MHz/ { print $2; exit }' /proc/cpuinfo)
+
+# Appels faits par read_io lui-même, retirés des mesures.
+read_io; start_read_bytes=$read_bytes start_read_calls=$read_calls start_write_calls=$write_calls
+read_io; own_read_bytes=$((read_bytes - start_read_bytes))
+own_read_calls=$((read_calls - start_read_calls)) own_write_calls=$((write_calls - start_write_calls))
+
+printf "%-24s %8s %12s %12s %10s %10s %10s %14s %13s\n" "programme" "durée" "écritures" "lectures" "Mo écrits" "Mo lus" "Mo/s" "appels/s" "cycles/ligne"
+for file in "$bench_directory"/*.tpc; do
+  name=$(basename "$file" .tpc)
+  input=/dev/null
+  if [ -f "$bench_directory/$name.sh" ]; then
+    input="obj/$name.in"
+    bash "$bench_directory/$name.sh" > "$input"
+  fi
+
+  ./bin/tpcc "$@" < "$file" > /dev/null || { echo "$name : erreur de compilation"; continue; }
+  nasm -f elf64 -o obj/bench.o _anonymous.asm && gcc -o bin/bench obj/bench.o -nostartfiles -no-pie -Lbin -ltpc || continue
+
+  read_io
+  start_write_bytes=$write_bytes start_read_bytes=$read_bytes start_read_calls=$read_calls start_write_calls=$write_calls
+  start=$EPOCHREALTIME
+  ./bin/bench < "$input" > /dev/null
+  end=$EPOCHREALTIME
+  read_io
+  lines=$(( $(./bin/bench < "$input" | wc -l) + $(wc -l < "$input") ))
+
+  awk -v name="$name" -v start="${start/,/.}" -v end="${end/,/.}" \
+      -v writes=$((write_calls - start_write_calls - own_write_calls)) \
+      -v reads=$((read_calls - start_read_calls - own_read_calls)) \
+      -v lines=$lines -v mhz="$mhz" -v written=$((write_bytes - start_write_bytes)) -v read=$((read_bytes - start_read_bytes - own_read_bytes)) 'BEGIN {
+    time = end - start
+    printf "%-24s %7.3fs %12d %12d %10.2f %10.2f %10.1f %14.0f", name, time, writes, reads,
+      written / 1e6, read / 1e6, (written + read) / 1e6 / time, (writes + reads) / time
+    if (mhz > 0 && lines > 0)
+      printf " %13.1f\n", time * mhz * 1e6 / lines
+    else
+      printf " %13s\n", "-"
+  }'
+done
+rm -f _anonymous.asm
@@ -0,0 +1,80 @@
+#!/bin/bash
+
+# Compare la machine virtuelle (--vm) au code natif (nasm puis gcc avec libtpc) sur les programmes
+# de test/good et de test/bench, puis sur des programmes générés, plus grands.
+# Les options sont passées au compilateur, par exemple : ./bench_vm.sh -O1
+# Un programme de test/bench lit la sortie du script de même nom en .sh s'il existe.
+# Le chemin natif est compté en deux temps, la compilation (tpcc, nasm et gcc) puis l'exécution,
+# tandis que --vm compile et exécute d'un coup : le premier rapport est celui de --vm à l'exécution
+# native seule, le second à tout le chemin natif. Les sorties et les codes de retour des deux chemins
+# doivent être identiques.
+
+if [ ! -f "./bin/tpcc" ]; then
+  echo "Le compilateur 'tpcc' n'est pas présent dans le répertoire courant."
+  exit 1
+fi
+
+if [ ! -f "./bin/libtpc.a" ]; then
+  echo "Le runtime 'libtpc.a' n'est pas construit, utilisez : make runtime"
+  exit 1
+fi
+
+mkdir -p obj bin
+
+# Écrit un programme de $1 fonctions, chacune bouclant sur un calcul, que main appelle toutes
+# avec le nombre de tours lu par getint, pour que rien ne soit calculé à la compilation.
+generate() {
+  local i
+  for ((i = 0; i < $1; i++)); do
+    printf 'int f%d(int n){\n    int s, k;\n    s = %d;\n    k = 0;\n' $i $i
+    printf '    while(k < n){\n        s = (s * %d + k) %% %d;\n        k = k + 1;\n    }\n    return s;\n}\n\n' \
+      $((i % 13 + 2)) $((i % 1000 + 7))
+  done
+  printf 'int main(void){\n    int total, n;\n    total = 0;\n    n = getint();\n'
+  for ((i = 0; i < $1; i++)); do
+    printf '    total = total + f%d(n);\n' $i
+  done
+  printf "    putint(total);\n    putchar('\\\\n');\n    return 0;\n}\n"
+}
+
+programs=(test/good/*.tpc test/bench/*.tpc)
+for size in 100 300; do
+  generate $size > "obj/generated_$size.tpc"
+  echo $((4000000 / size)) > "obj/generated_$size.in"
+  programs+=("obj/generated_$size.tpc")
+done
+
+printf "%-24s %12s %12s %12s %12s %12s %10s\n" "programme" "compilation" "exécution" "--vm" "/exécution" "/total" "identique"
+for file in "${programs[@]}"; do
+  name=$(basename "$file" .tpc)
+  directory=$(dirname "$file")
+  input=/dev/null
+  if [ -f "$directory/$name.sh" ]; then
+    input="obj/$name.in"
+    bash "$directory/$name.sh" > "$input"
+  elif [ -f "$directory/$name.in" ]; then
+    input="$directory/$name.in"
+  fi
+
+  start=$EPOCHREALTIME
+  ./bin/tpcc "$@" < "$file" > /dev/null 2>&1 || { echo "$name : erreur de compilation"; continue; }
+  nasm -f elf64 -o obj/bench_vm.o _anonymous.asm && gcc -o bin/bench_vm obj/bench_vm.o -nostartfiles -no-pie -Lbin -ltpc || continue
+  compiled=$EPOCHREALTIME
+  { ./bin/bench_vm < "$input" > obj/bench_native.out; } 2> /dev/null
+  native_status=$?
+  ran=$EPOCHREALTIME
+  { ./bin/tpcc --vm --input "$input" "$@" < "$file" > obj/bench_vm.out; } 2> /dev/null
+  vm_status=$?
+  end=$EPOCHREALTIME
+
+  same=oui
+  if [ $native_status != $vm_status ] || ! cmp -s obj/bench_native.out obj/bench_vm.out; then
+    same=NON
+  fi
+  awk -v name="$name" -v start="${start/,/.}" -v compiled="${compiled/,/.}" -v ran="${ran/,/.}" \
+      -v end="${end/,/.}" -v same=$same 'BEGIN {
+    printf "%-24s %11.3fs %11.3fs %11.3fs %12.2f %12.2f %10s\n", name, compiled - start, ran - compiled,
+      end - ran, (end - ran) / (ran - compiled), (end - ran) / (ran - start), same
+  }'
+done
+rm -f _anonymous.asm obj/bench_vm.o obj/bench_native.out obj/bench_vm.out
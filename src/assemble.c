@@ -0,0 +1,1060 @@
+#include "assemble.h"
+
+#define OP_NONE 0
+#define OP_REG 1
+#define OP_XMM 2
+#define OP_MEM 3
+#define OP_IMM 4
+
+#define MAX_OPERANDS 3
+
+/**
+ * @brief An operand of an instruction.
+ */
+typedef struct{
+    int kind;    ///< Kind of the operand, one of the OP_ constants.
+    int reg;     ///< Number of the register, or base register of the address, -1 if none.
+    int size;    ///< Size in bytes of the register or of the memory access, 0 if not given.
+    int index;   ///< Index register of the address, -1 if none.
+    int scale;   ///< Scale of the index register.
+    long value;  ///< Displacement of the address, or value of the immediate.
+    int symbol;  ///< Symbol added to the value, -1 if none.
+}Operand;
+
+typedef void (*Encoder)(Assembly *as, Operand *ops, int nb_ops, int code);
+
+/**
+ * @brief An instruction and the function writing its encodings.
+ */
+typedef struct{
+    char *name;
+    Encoder encode;
+    int code;     ///< Parameter of the function: opcode, extension of the opcode or condition.
+}Instruction;
+
+static const char *regs64[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+static const char *regs32[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+static const char *regs16[] = {"ax", "cx", "dx", "bx", "sp", "bp", "si", "di",
+    "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w"};
+static const char *regs8[] = {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+
+static const char *conditions[] = {"o", "no", "b", "ae", "e", "ne", "be", "a",
+    "s", "ns", "p", "np", "l", "ge", "le", "g"};
+
+static void asm_error(Assembly *as, char *message, char *text){
+    fprintf(stderr, "Assembler error line %d: %s%s%s\n", as->lineno, message, text ? ": " : "", text ? text : "");
+    exit(EXIT_ERROR);
+}
+
+static void reserve(Assembly *as, long size){
+    AsmSection *section = &as->sections[as->section];
+    if(as->section == ASM_BSS){
+        section->size += size;
+        return;
+    }
+    if(section->size + size > section->capacity){
+        section->capacity = (section->size + size) * 2 + 64;
+        section->bytes = (unsigned char*) try(realloc(section->bytes, section->capacity), NULL);
+    }
+    memset(section->bytes + section->size, 0, size);
+    section->size += size;
+}
+
+static void emit(Assembly *as, int byte){
+    if(as->section == ASM_BSS)
+        asm_error(as, "data in .bss", NULL);
+    reserve(as, 1);
+    as->sections[as->section].bytes[as->sections[as->section].size - 1] = byte;
+}
+
+static void emit_value(Assembly *as, long value, int size){
+    for(int i = 0; i < size; ++i)
+        emit(as, (value >> (8 * i)) & 0xff);
+}
+
+static unsigned hash_name(char *name){
+    unsigned hash = 5381;
+    for(; *name; ++name)
+        hash = hash * 33 + (unsigned char) *name;
+    return hash;
+}
+
+/**
+ * @brief Rebuilds the hash table of the symbols with twice as many slots.
+ */
+static void grow_hash(Assembly *as){
+    as->hash_size = as->hash_size ? as->hash_size * 2 : 256;
+    free(as->hash);
+    as->hash = (int*) try(malloc(sizeof(int) * as->hash_size), NULL);
+    memset(as->hash, -1, sizeof(int) * as->hash_size);
+    for(int i = 0; i < as->nb_symbols; ++i){
+        unsigned slot = hash_name(as->symbols[i].name) & (as->hash_size - 1);
+        while(as->hash[slot] >= 0)
+            slot = (slot + 1) & (as->hash_size - 1);
+        as->hash[slot] = i;
+    }
+}
+
+/**
+ * @brief Gives the number of a symbol, added undefined if it's new.
+ */
+static int find_symbol(Assembly *as, char *name){
+    unsigned slot;
+    if(2 * (as->nb_symbols + 1) > as->hash_size)
+        grow_hash(as);
+    for(slot = hash_name(name) & (as->hash_size - 1); as->hash[slot] >= 0; slot = (slot + 1) & (as->hash_size - 1))
+        if(!strcmp(as->symbols[as->hash[slot]].name, name))
+            return as->hash[slot];
+    as->hash[slot] = as->nb_symbols;
+    as->symbols = (AsmSymbol*) try(realloc(as->symbols, sizeof(AsmSymbol) * (as->nb_symbols + 1)), NULL);
+    as->symbols[as->nb_symbols].name = strdup(name);
+    as->symbols[as->nb_symbols].section = -1;
+    as->symbols[as->nb_symbols].offset = 0;
+    return as->nb_symbols++;
+}
+
+static void define_symbol(Assembly *as, char *name){
+    int index = find_symbol(as, name);
+    AsmSymbol *symbol = &as->symbols[index];
+    if(symbol->section >= 0)
+        asm_error(as, "label defined twice", name);
+    symbol->section = as->section;
+    symbol->offset = as->sections[as->section].size;
+}
+
+/**
+ * @brief Writes the value of an operand, recording a fixup when it holds a symbol.
+ */
+static void emit_field(Assembly *as, Operand *op, int size, int kind){
+    if(op->symbol >= 0){
+        as->fixups = (AsmFixup*) try(realloc(as->fixups, sizeof(AsmFixup) * (as->nb_fixups + 1)), NULL);
+        as->fixups[as->nb_fixups++] = (AsmFixup){as->section, as->sections[as->section].size, op->symbol, op->value, kind, -1};
+        emit_value(as, 0, size);
+    }else
+        emit_value(as, op->value, size);
+}
+
+static int fits8(long value){
+    return value >= -128 && value <= 127;
+}
+
+static int fits32(long value){
+    return value >= -2147483648L && value <= 2147483647L;
+}
+
+static int find_register(const char **names, char *text){
+    for(int i = 0; i < 16; ++i)
+        if(!strcmp(names[i], text))
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Reads a register name.
+ * @param size Set to the size of the register, 16 for xmm.
+ * @return The number of the register, or -1.
+ */
+static int parse_register(char *text, int *size){
+    int reg;
+    if((reg = find_register(regs64, text)) >= 0)
+        *size = 8;
+    else if((reg = find_register(regs32, text)) >= 0)
+        *size = 4;
+    else if((reg = find_register(regs16, text)) >= 0)
+        *size = 2;
+    else if((reg = find_register(regs8, text)) >= 0)
+        *size = 1;
+    else if(!strncmp(text, "xmm", 3) && text[3] >= '0' && text[3] <= '9'){
+        reg = atoi(text + 3);
+        *size = 16;
+        if(reg > 15)
+            return -1;
+    }
+    return reg;
+}
+
+static char *trim(char *text){
+    char *end;
+    while(*text == ' ' || *text == '\t')
+        text++;
+    end = text + strlen(text);
+    while(end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        *--end = '\0';
+    return text;
+}
+
+/**
+ * @brief Reads a number: decimal, hexadecimal with 0x, or a character between quotes.
+ * @return 1 if the text is a number, 0 otherwise.
+ */
+static int parse_number(char *text, long *value){
+    char *end;
+    if((text[0] == '\'' || text[0] == '"') && text[1] && text[2] == text[0] && !text[3]){
+        *value = (unsigned char) text[1];
+        return 1;
+    }
+    if(!((*text >= '0' && *text <= '9') || (*text == '-' && text[1] >= '0' && text[1] <= '9')))
+        return 0;
+    *value = (long) strtoull(text, &end, 0);
+    if(*text == '-')
+        *value = -(long) strtoull(text + 1, &end, 0);
+    return !*end;
+}
+
+/**
+ * @brief Tells if a sign ends a term, rather than starting a negative number.
+ */
+static int ends_term(char *term, char *sign){
+    while(sign > term && (sign[-1] == ' ' || sign[-1] == '\t'))
+        sign--;
+    return sign > term && sign[-1] != '*' && sign[-1] != '+' && sign[-1] != '-';
+}
+
+/**
+ * @brief Reads a sum of terms, each a register, a number, a symbol or a product of them, the
+ * terms of an address or of an immediate.
+ */
+static void parse_sum(Assembly *as, char *text, Operand *op){
+    char *term = text;
+    int sign = 1;
+    op->value = 0;
+    op->symbol = -1;
+    while(term){
+        char *next = term, *factor, *save;
+        long product = 1;
+        int reg = -1, size, nb_numbers = 0, has_symbol = 0;
+        while(*next && ((*next != '+' && *next != '-') || !ends_term(term, next)))
+            next++;
+        int next_sign = *next == '-' ? -1 : 1;
+        if(*next)
+            *next++ = '\0';
+        else
+            next = NULL;
+        for(factor = strtok_r(term, "*", &save); factor; factor = strtok_r(NULL, "*", &save)){
+            long value;
+            int factor_reg;
+            factor = trim(factor);
+            if(parse_number(factor, &value)){
+                product *= value;
+                nb_numbers++;
+            }
+            else if((factor_reg = parse_register(factor, &size)) >= 0 && size == 8)
+                reg = factor_reg;
+            else if(*factor){
+                if(op->symbol >= 0 || sign < 0)
+                    asm_error(as, "unsupported expression", factor);
+                op->symbol = find_symbol(as, factor);
+                has_symbol = 1;
+            }else
+                asm_error(as, "empty term", NULL);
+        }
+        if(reg >= 0){
+            if(op->kind != OP_MEM || sign < 0)
+                asm_error(as, "register in an expression", NULL);
+            if(product == 1 && op->reg < 0)
+                op->reg = reg;
+            else if(op->index < 0 && (product == 1 || product == 2 || product == 4 || product == 8) && reg != 4){
+                op->index = reg;
+                op->scale = product;
+            }else
+                asm_error(as, "invalid address", NULL);
+        }else if(has_symbol && nb_numbers)
+            asm_error(as, "unsupported expression", NULL);
+        else if(nb_numbers)
+            op->value += sign * product;
+        sign = next_sign;
+        term = next;
+    }
+}
+
+/**
+ * @brief Replaces the characters between quotes by their codes, so that a '-' or a '*' isn't
+ * read as an operator.
+ */
+static void replace_characters(char *text){
+    for(char *c = text; *c; ++c)
+        if((c[0] == '\'' || c[0] == '"') && c[1] && c[2] == c[0]){
+            char code[4];
+            snprintf(code, sizeof(code), "%3d", (unsigned char) c[1]);
+            memcpy(c, code, 3);
+            c += 2;
+        }
+}
+
+static void parse_operand(Assembly *as, char *text, Operand *op){
+    static const char *sizes[] = {"byte", "word", "dword", "qword", "oword"};
+    static const int size_values[] = {1, 2, 4, 8, 16};
+    char *open;
+    int size;
+    memset(op, 0, sizeof(Operand));
+    op->reg = op->index = op->symbol = -1;
+    text = trim(text);
+    replace_characters(text);
+    if((open = strchr(text, '['))){
+        char *close = strrchr(text, ']');
+        if(!close)
+            asm_error(as, "missing ]", text);
+        *open = *close = '\0';
+        op->kind = OP_MEM;
+        text = trim(text);
+        for(int i = 0; i < 5; ++i)
+            if(!strcmp(text, sizes[i]))
+                op->size = size_values[i];
+        if(*text && !op->size)
+            asm_error(as, "unknown size", text);
+        parse_sum(as, open + 1, op);
+        return;
+    }
+    if((op->reg = parse_register(text, &size)) >= 0){
+        op->kind = size == 16 ? OP_XMM : OP_REG;
+        op->size = size;
+        return;
+    }
+    op->kind = OP_IMM;
+    parse_sum(as, text, op);
+}
+
+static void emit_rex(Assembly *as, int w, int r, int x, int b, int force){
+    if(w || r > 7 || x > 7 || b > 7 || force)
+        emit(as, 0x40 | (w ? 8 : 0) | (r > 7 ? 4 : 0) | (x > 7 ? 2 : 0) | (b > 7 ? 1 : 0));
+}
+
+/**
+ * @brief Tells if a byte register needs a REX prefix to be told apart from ah, ch, dh and bh.
+ */
+static int needs_rex(Operand *op){
+    return op && op->kind == OP_REG && op->size == 1 && op->reg >= 4 && op->reg <= 7;
+}
+
+/**
+ * @brief Writes an instruction with a ModRM byte: its prefix, REX prefix, opcode, ModRM, SIB and
+ * displacement, the immediate being written by the caller.
+ * @param prefix Mandatory or size prefix, 0 if none.
+ * @param w Flag of the 64 bit operand size.
+ * @param opcode Bytes of the opcode, 0x0F included, any of them possibly 0.
+ * @param nb_bytes Number of bytes of the opcode.
+ * @param reg Register of the reg field, or extension of the opcode.
+ * @param other Register operand of the reg field, checked for a REX prefix, or NULL.
+ * @param rm Register or memory operand of the rm field.
+ */
+static void encode_modrm(Assembly *as, int prefix, int w, const char *opcode, int nb_bytes, int reg, Operand *other, Operand *rm){
+    int base = rm->reg, index = rm->index, mod;
+    if(prefix)
+        emit(as, prefix);
+    if(rm->kind != OP_MEM){
+        emit_rex(as, w, reg, 0, rm->reg, needs_rex(other) || needs_rex(rm));
+        for(int i = 0; i < nb_bytes; ++i)
+            emit(as, (unsigned char) opcode[i]);
+        emit(as, 0xC0 | ((reg & 7) << 3) | (rm->reg & 7));
+        return;
+    }
+    emit_rex(as, w, reg, index < 0 ? 0 : index, base < 0 ? 0 : base, needs_rex(other));
+    for(int i = 0; i < nb_bytes; ++i)
+        emit(as, (unsigned char) opcode[i]);
+    if(base < 0){
+        emit(as, ((reg & 7) << 3) | 4);
+        emit(as, (index < 0 ? 0x20 : (__builtin_ctz(rm->scale) << 6) | ((index & 7) << 3)) | 5);
+        emit_field(as, rm, 4, FIX_ABS32);
+        return;
+    }
+    if(rm->symbol >= 0 || !fits8(rm->value))
+        mod = 2;
+    else if(rm->value || (base & 7) == 5)
+        mod = 1;
+    else
+        mod = 0;
+    if(index < 0 && (base & 7) != 4)
+        emit(as, (mod << 6) | ((reg & 7) << 3) | (base & 7));
+    else{
+        emit(as, (mod << 6) | ((reg & 7) << 3) | 4);
+        emit(as, (index < 0 ? 0x20 : (__builtin_ctz(rm->scale) << 6) | ((index & 7) << 3)) | (base & 7));
+    }
+    if(mod == 1)
+        emit(as, rm->value & 0xff);
+    else if(mod == 2)
+        emit_field(as, rm, 4, FIX_ABS32);
+}
+
+/**
+ * @brief Gives the size of the operation of an instruction from its operands.
+ */
+static int operation_size(Assembly *as, Operand *ops, int nb_ops){
+    int size = 0;
+    for(int i = 0; i < nb_ops; ++i)
+        if(ops[i].kind != OP_IMM && ops[i].size){
+            if(size && ops[i].size != size)
+                asm_error(as, "operands of different sizes", NULL);
+            size = ops[i].size;
+        }
+    if(!size)
+        asm_error(as, "size of the operation not given", NULL);
+    return size;
+}
+
+/**
+ * @brief Writes an instruction whose opcode depends on the size: the byte opcode is one less.
+ */
+static void encode_sized(Assembly *as, int size, int opcode, int reg, Operand *other, Operand *rm){
+    char byte = size == 1 ? opcode - 1 : opcode;
+    encode_modrm(as, size == 2 ? 0x66 : 0, size == 8, &byte, 1, reg, other, rm);
+}
+
+static void expect(Assembly *as, int nb_ops, int expected){
+    if(nb_ops != expected)
+        asm_error(as, "wrong number of operands", NULL);
+}
+
+static int is_rm(Operand *op){
+    return op->kind == OP_REG || op->kind == OP_MEM;
+}
+
+static void emit_immediate(Assembly *as, Operand *op, int size){
+    if(op->symbol >= 0 ? size < 4 : size == 8 ? !fits32(op->value)
+        : op->value < -(1L << (8 * size - 1)) || op->value >= (1L << (8 * size)))
+        asm_error(as, "immediate out of range", NULL);
+    emit_field(as, op, size > 4 ? 4 : size, FIX_ABS32);
+}
+
+/**
+ * @brief add, or, adc, sbb, and, sub, xor and cmp, the code being the extension of the opcode.
+ */
+static void encode_alu(Assembly *as, Operand *ops, int nb_ops, int code){
+    int size;
+    expect(as, nb_ops, 2);
+    size = operation_size(as, ops, 2);
+    if(is_rm(&ops[0]) && ops[1].kind == OP_REG)
+        encode_sized(as, size, code * 8 + 1, ops[1].reg, &ops[1], &ops[0]);
+    else if(ops[0].kind == OP_REG && ops[1].kind == OP_MEM)
+        encode_sized(as, size, code * 8 + 3, ops[0].reg, &ops[0], &ops[1]);
+    else if(is_rm(&ops[0]) && ops[1].kind == OP_IMM){
+        if(size != 1 && ops[1].symbol < 0 && fits8(ops[1].value)){
+            encode_modrm(as, size == 2 ? 0x66 : 0, size == 8, "\x83", 1, code, NULL, &ops[0]);
+            emit(as, ops[1].value & 0xff);
+        }else{
+            encode_sized(as, size, 0x81, code, NULL, &ops[0]);
+            emit_immediate(as, &ops[1], size);
+        }
+    }else
+        asm_error(as, "invalid operands", NULL);
+}
+
+static void encode_mov(Assembly *as, Operand *ops, int nb_ops, int code){
+    int size;
+    expect(as, nb_ops, 2);
+    size = operation_size(as, ops, 2);
+    if(is_rm(&ops[0]) && ops[1].kind == OP_REG)
+        encode_sized(as, size, 0x89, ops[1].reg, &ops[1], &ops[0]);
+    else if(ops[0].kind == OP_REG && ops[1].kind == OP_MEM)
+        encode_sized(as, size, 0x8B, ops[0].reg, &ops[0], &ops[1]);
+    else if(ops[0].kind == OP_REG && ops[1].kind == OP_IMM && size == 8 && ops[1].symbol < 0 && !fits32(ops[1].value)){
+        emit_rex(as, 1, 0, 0, ops[0].reg, 0);
+        emit(as, 0xB8 + (ops[0].reg & 7));
+        emit_value(as, ops[1].value, 8);
+    }else if(ops[0].kind == OP_REG && ops[1].kind == OP_IMM && size == 8 && ops[1].symbol < 0 && ops[1].value >= 0){
+        emit_rex(as, 0, 0, 0, ops[0].reg, 0);
+        emit(as, 0xB8 + (ops[0].reg & 7));
+        emit_value(as, ops[1].value, 4);
+    }else if(is_rm(&ops[0]) && ops[1].kind == OP_IMM){
+        encode_sized(as, size, 0xC7, 0, NULL, &ops[0]);
+        emit_immediate(as, &ops[1], size);
+    }else
+        asm_error(as, "invalid operands", NULL);
+}
+
+static void encode_lea(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 2);
+    if(ops[0].kind != OP_REG || ops[0].size != 8 || ops[1].kind != OP_MEM)
+        asm_error(as, "invalid operands", NULL);
+    encode_modrm(as, 0, 1, "\x8D", 1, ops[0].reg, NULL, &ops[1]);
+}
+
+/**
+ * @brief movsx, movsxd and movzx, the code being 0 for a sign extension and 1 for a zero extension.
+ */
+static void encode_extend(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 2);
+    if(ops[0].kind != OP_REG || !is_rm(&ops[1]) || !ops[1].size || ops[1].size >= ops[0].size)
+        asm_error(as, "invalid operands", NULL);
+    if(ops[1].size == 4){
+        if(code)
+            asm_error(as, "invalid operands", NULL);
+        encode_modrm(as, 0, 1, "\x63", 1, ops[0].reg, NULL, &ops[1]);
+        return;
+    }
+    encode_modrm(as, ops[0].size == 2 ? 0x66 : 0, ops[0].size == 8,
+        code ? (ops[1].size == 1 ? "\x0F\xB6" : "\x0F\xB7") : (ops[1].size == 1 ? "\x0F\xBE" : "\x0F\xBF"), 2,
+        ops[0].reg, NULL, &ops[1]);
+}
+
+/**
+ * @brief push and pop of a 64 bit register, the code being the opcode of rax.
+ */
+static void encode_stack(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 1);
+    if(ops[0].kind != OP_REG || ops[0].size != 8)
+        asm_error(as, "invalid operands", NULL);
+    emit_rex(as, 0, 0, 0, ops[0].reg, 0);
+    emit(as, code + (ops[0].reg & 7));
+}
+
+/**
+ * @brief not, neg, mul, div and idiv, the code being the extension of the opcode.
+ */
+static void encode_unary(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 1);
+    if(!is_rm(&ops[0]))
+        asm_error(as, "invalid operands", NULL);
+    encode_sized(as, operation_size(as, ops, 1), 0xF7, code, NULL, &ops[0]);
+}
+
+/**
+ * @brief inc and dec, the code being the extension of the opcode.
+ */
+static void encode_incdec(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 1);
+    if(!is_rm(&ops[0]))
+        asm_error(as, "invalid operands", NULL);
+    encode_sized(as, operation_size(as, ops, 1), 0xFF, code, NULL, &ops[0]);
+}
+
+static void encode_imul(Assembly *as, Operand *ops, int nb_ops, int code){
+    Operand *source = nb_ops == 1 ? NULL : &ops[nb_ops == 2 && ops[1].kind == OP_IMM ? 0 : 1], *imm = ops[nb_ops - 1].kind == OP_IMM ? &ops[nb_ops - 1] : NULL;
+    int size;
+    if(nb_ops == 1){
+        encode_unary(as, ops, nb_ops, 5);
+        return;
+    }
+    if(ops[0].kind != OP_REG || !is_rm(source) || ops[0].size == 1)
+        asm_error(as, "invalid operands", NULL);
+    size = ops[0].size;
+    if(!imm)
+        encode_modrm(as, size == 2 ? 0x66 : 0, size == 8, "\x0F\xAF", 2, ops[0].reg, NULL, source);
+    else if(imm->symbol < 0 && fits8(imm->value)){
+        encode_modrm(as, size == 2 ? 0x66 : 0, size == 8, "\x6B", 1, ops[0].reg, NULL, source);
+        emit(as, imm->value & 0xff);
+    }else{
+        encode_modrm(as, size == 2 ? 0x66 : 0, size == 8, "\x69", 1, ops[0].reg, NULL, source);
+        emit_immediate(as, imm, size);
+    }
+}
+
+/**
+ * @brief shl, sal, shr and sar by a constant or by cl, the code being the extension of the opcode.
+ */
+static void encode_shift(Assembly *as, Operand *ops, int nb_ops, int code){
+    int size;
+    expect(as, nb_ops, 2);
+    size = operation_size(as, ops, 1);
+    if(!is_rm(&ops[0]))
+        asm_error(as, "invalid operands", NULL);
+    if(ops[1].kind == OP_REG && ops[1].size == 1 && ops[1].reg == 1)
+        encode_sized(as, size, 0xD3, code, NULL, &ops[0]);
+    else if(ops[1].kind == OP_IMM && ops[1].symbol < 0 && ops[1].value == 1)
+        encode_sized(as, size, 0xD1, code, NULL, &ops[0]);
+    else if(ops[1].kind == OP_IMM && ops[1].symbol < 0){
+        encode_sized(as, size, 0xC1, code, NULL, &ops[0]);
+        emit(as, ops[1].value & 0xff);
+    }else
+        asm_error(as, "invalid operands", NULL);
+}
+
+static void encode_test(Assembly *as, Operand *ops, int nb_ops, int code){
+    int size;
+    expect(as, nb_ops, 2);
+    size = operation_size(as, ops, 2);
+    if(is_rm(&ops[0]) && ops[1].kind == OP_REG)
+        encode_sized(as, size, 0x85, ops[1].reg, &ops[1], &ops[0]);
+    else if(is_rm(&ops[0]) && ops[1].kind == OP_IMM){
+        encode_sized(as, size, 0xF7, 0, NULL, &ops[0]);
+        emit_immediate(as, &ops[1], size);
+    }else
+        asm_error(as, "invalid operands", NULL);
+}
+
+static void encode_xchg(Assembly *as, Operand *ops, int nb_ops, int code){
+    int size;
+    expect(as, nb_ops, 2);
+    size = operation_size(as, ops, 2);
+    if(is_rm(&ops[0]) && ops[1].kind == OP_REG)
+        encode_sized(as, size, 0x87, ops[1].reg, &ops[1], &ops[0]);
+    else if(ops[0].kind == OP_REG && ops[1].kind == OP_MEM)
+        encode_sized(as, size, 0x87, ops[0].reg, &ops[0], &ops[1]);
+    else
+        asm_error(as, "invalid operands", NULL);
+}
+
+/**
+ * @brief Instructions without operands, the code indexing their bytes.
+ */
+static void encode_fixed(Assembly *as, Operand *ops, int nb_ops, int code){
+    static const char *bytes[] = {"\x48\x99", "\xC3", "\x0F\x05", "\x90", "\x99", "\xF3\xA4", "\xF3\xA5",
+        "\xF3\x48\xA5", "\xF3\xAA", "\xF3\xAB", "\xF3\x48\xAB"};
+    static const int nb_bytes[] = {2, 1, 2, 1, 1, 2, 2, 3, 2, 2, 3};
+    expect(as, nb_ops, 0);
+    for(int i = 0; i < nb_bytes[code]; ++i)
+        emit(as, (unsigned char) bytes[code][i]);
+}
+
+/**
+ * @brief Writes the displacement of a jump to a label, recording its fixup.
+ */
+static void emit_jump_target(Assembly *as, Operand *op, int size, int jump){
+    if(op->kind != OP_IMM || op->symbol < 0 || op->value)
+        asm_error(as, "jump to something else than a label", NULL);
+    as->fixups = (AsmFixup*) try(realloc(as->fixups, sizeof(AsmFixup) * (as->nb_fixups + 1)), NULL);
+    as->fixups[as->nb_fixups++] = (AsmFixup){as->section, as->sections[as->section].size, op->symbol,
+        -size, size == 1 ? FIX_REL8 : FIX_REL32, jump};
+    emit_value(as, 0, size);
+}
+
+/**
+ * @brief jmp and the conditional jumps, the code being the condition, or -1 for jmp.
+ *
+ * A jump is written on 2 bytes, unless a previous pass found its target too far.
+ */
+static void encode_jump(Assembly *as, Operand *ops, int nb_ops, int code){
+    int jump = as->nb_jumps++, is_long = as->long_jumps && as->long_jumps[jump];
+    expect(as, nb_ops, 1);
+    if(is_long && code < 0)
+        emit(as, 0xE9);
+    else if(is_long){
+        emit(as, 0x0F);
+        emit(as, 0x80 + code);
+    }else
+        emit(as, code < 0 ? 0xEB : 0x70 + code);
+    emit_jump_target(as, &ops[0], is_long ? 4 : 1, jump);
+}
+
+static void encode_call(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 1);
+    emit(as, 0xE8);
+    emit_jump_target(as, &ops[0], 4, -1);
+}
+
+/**
+ * @brief setcc, the code being the condition.
+ */
+static void encode_set(Assembly *as, Operand *ops, int nb_ops, int code){
+    char opcode[2] = {0x0F, 0x90 + code};
+    expect(as, nb_ops, 1);
+    if(!is_rm(&ops[0]) || (ops[0].size && ops[0].size != 1))
+        asm_error(as, "invalid operands", NULL);
+    encode_modrm(as, 0, 0, opcode, 2, 0, NULL, &ops[0]);
+}
+
+/**
+ * @brief SSE2 instructions on xmm registers, the code being the opcode after 0x66 0x0F, with the
+ * extension of the opcode in its second byte for a shift by a constant.
+ */
+static void encode_sse(Assembly *as, Operand *ops, int nb_ops, int code){
+    char opcode[2] = {0x0F, code & 0xff};
+    if(nb_ops < 2 || ops[0].kind != OP_XMM)
+        asm_error(as, "invalid operands", NULL);
+    if(code >> 8){
+        expect(as, nb_ops, 2);
+        if(ops[1].kind != OP_IMM)
+            asm_error(as, "invalid operands", NULL);
+        encode_modrm(as, 0x66, 0, opcode, 2, (code >> 8) & 7, NULL, &ops[0]);
+        emit(as, ops[1].value & 0xff);
+        return;
+    }
+    if(ops[1].kind != OP_XMM && ops[1].kind != OP_MEM)
+        asm_error(as, "invalid operands", NULL);
+    encode_modrm(as, 0x66, 0, opcode, 2, ops[0].reg, NULL, &ops[1]);
+    if(code == 0x70){
+        expect(as, nb_ops, 3);
+        emit(as, ops[2].value & 0xff);
+    }else
+        expect(as, nb_ops, 2);
+}
+
+/**
+ * @brief movdqa and movdqu, the code being their mandatory prefix.
+ */
+static void encode_movdq(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 2);
+    if(ops[0].kind == OP_XMM && (ops[1].kind == OP_XMM || ops[1].kind == OP_MEM))
+        encode_modrm(as, code, 0, "\x0F\x6F", 2, ops[0].reg, NULL, &ops[1]);
+    else if(ops[0].kind == OP_MEM && ops[1].kind == OP_XMM)
+        encode_modrm(as, code, 0, "\x0F\x7F", 2, ops[1].reg, NULL, &ops[0]);
+    else
+        asm_error(as, "invalid operands", NULL);
+}
+
+/**
+ * @brief movd and movq between a general register or memory and an xmm register.
+ */
+static void encode_movx(Assembly *as, Operand *ops, int nb_ops, int code){
+    expect(as, nb_ops, 2);
+    if(ops[0].kind == OP_XMM && is_rm(&ops[1]))
+        encode_modrm(as, 0x66, code == 8, "\x0F\x6E", 2, ops[0].reg, NULL, &ops[1]);
+    else if(is_rm(&ops[0]) && ops[1].kind == OP_XMM)
+        encode_modrm(as, 0x66, code == 8, "\x0F\x7E", 2, ops[1].reg, NULL, &ops[0]);
+    else
+        asm_error(as, "invalid operands", NULL);
+}
+
+static const Instruction instructions[] = {
+    {"add", encode_alu, 0}, {"or", encode_alu, 1}, {"adc", encode_alu, 2}, {"sbb", encode_alu, 3},
+    {"and", encode_alu, 4}, {"sub", encode_alu, 5}, {"xor", encode_alu, 6}, {"cmp", encode_alu, 7},
+    {"mov", encode_mov, 0}, {"lea", encode_lea, 0},
+    {"movsx", encode_extend, 0}, {"movsxd", encode_extend, 0}, {"movzx", encode_extend, 1},
+    {"push", encode_stack, 0x50}, {"pop", encode_stack, 0x58},
+    {"not", encode_unary, 2}, {"neg", encode_unary, 3}, {"mul", encode_unary, 4},
+    {"div", encode_unary, 6}, {"idiv", encode_unary, 7}, {"imul", encode_imul, 0},
+    {"inc", encode_incdec, 0}, {"dec", encode_incdec, 1},
+    {"shl", encode_shift, 4}, {"sal", encode_shift, 4}, {"shr", encode_shift, 5}, {"sar", encode_shift, 7},
+    {"test", encode_test, 0}, {"xchg", encode_xchg, 0},
+    {"cqo", encode_fixed, 0}, {"ret", encode_fixed, 1}, {"syscall", encode_fixed, 2}, {"nop", encode_fixed, 3},
+    {"cdq", encode_fixed, 4}, {"rep movsb", encode_fixed, 5}, {"rep movsd", encode_fixed, 6},
+    {"rep movsq", encode_fixed, 7}, {"rep stosb", encode_fixed, 8}, {"rep stosd", encode_fixed, 9},
+    {"rep stosq", encode_fixed, 10},
+    {"jmp", encode_jump, -1}, {"call", encode_call, 0},
+    {"movdqa", encode_movdq, 0x66}, {"movdqu", encode_movdq, 0xF3},
+    {"movd", encode_movx, 4}, {"movq", encode_movx, 8},
+    {"paddb", encode_sse, 0xFC}, {"paddw", encode_sse, 0xFD}, {"paddd", encode_sse, 0xFE}, {"paddq", encode_sse, 0xD4},
+    {"psubb", encode_sse, 0xF8}, {"psubw", encode_sse, 0xF9}, {"psubd", encode_sse, 0xFA}, {"psubq", encode_sse, 0xFB},
+    {"pand", encode_sse, 0xDB}, {"pandn", encode_sse, 0xDF}, {"por", encode_sse, 0xEB}, {"pxor", encode_sse, 0xEF},
+    {"pcmpgtb", encode_sse, 0x64}, {"pcmpgtw", encode_sse, 0x65}, {"pcmpgtd", encode_sse, 0x66},
+    {"pmuludq", encode_sse, 0xF4}, {"pmullw", encode_sse, 0xD5},
+    {"punpcklbw", encode_sse, 0x60}, {"punpcklwd", encode_sse, 0x61}, {"punpckldq", encode_sse, 0x62},
+    {"punpckhdq", encode_sse, 0x6A}, {"punpcklqdq", encode_sse, 0x6C}, {"punpckhqdq", encode_sse, 0x6D},
+    {"pshufd", encode_sse, 0x70},
+    {"psrlq", encode_sse, 0x273}, {"psllq", encode_sse, 0x673}, {"psrld", encode_sse, 0x272},
+    {"pslld", encode_sse, 0x672}, {"psrad", encode_sse, 0x472},
+};
+
+/**
+ * @brief Pads the code with nops, or the data with zeros, up to a multiple of an alignment.
+ */
+static void align_section(Assembly *as, long alignment){
+    static const char *nops[] = {"", "\x90", "\x66\x90", "\x0F\x1F\x00", "\x0F\x1F\x40\x00",
+        "\x0F\x1F\x44\x00\x00", "\x66\x0F\x1F\x44\x00\x00", "\x0F\x1F\x80\x00\x00\x00\x00",
+        "\x0F\x1F\x84\x00\x00\x00\x00\x00"};
+    long padding = (alignment - as->sections[as->section].size % alignment) % alignment;
+    if(as->section != ASM_TEXT){
+        reserve(as, padding);
+        return;
+    }
+    while(padding > 0){
+        int size = padding > 8 ? 8 : padding;
+        for(int i = 0; i < size; ++i)
+            emit(as, (unsigned char) nops[size][i]);
+        padding -= size;
+    }
+}
+
+/**
+ * @brief Splits the operands of an instruction on the commas outside of the brackets and quotes.
+ * @return The number of operands.
+ */
+static int split_operands(Assembly *as, char *text, char **operands){
+    int nb = 0, depth = 0;
+    char quote = 0;
+    if(!*text)
+        return 0;
+    operands[nb++] = text;
+    for(char *c = text; *c; ++c){
+        if(quote){
+            quote = *c == quote ? 0 : quote;
+            continue;
+        }
+        if(*c == '\'' || *c == '"')
+            quote = *c;
+        else if(*c == '[')
+            depth++;
+        else if(*c == ']')
+            depth--;
+        else if(*c == ',' && !depth){
+            if(nb == MAX_OPERANDS)
+                asm_error(as, "too many operands", NULL);
+            *c = '\0';
+            operands[nb++] = c + 1;
+        }
+    }
+    return nb;
+}
+
+/**
+ * @brief Writes the data of a db, dw, dd or dq directive: numbers and strings between quotes.
+ */
+static void assemble_data(Assembly *as, char *text, int size){
+    char *items[4096];
+    int nb = 0;
+    char quote = 0;
+    items[nb++] = text;
+    for(char *c = text; *c; ++c){
+        if(quote){
+            quote = *c == quote ? 0 : quote;
+            continue;
+        }
+        if(*c == '\'' || *c == '"')
+            quote = *c;
+        else if(*c == ','){
+            if(nb == 4096)
+                asm_error(as, "too many items", NULL);
+            *c = '\0';
+            items[nb++] = c + 1;
+        }
+    }
+    for(int i = 0; i < nb; ++i){
+        char *item = trim(items[i]);
+        long value;
+        int len = strlen(item);
+        if(len >= 2 && (item[0] == '"' || item[0] == '\'') && item[len - 1] == item[0] && size == 1){
+            for(int j = 1; j < len - 1; ++j)
+                emit(as, (unsigned char) item[j]);
+        }else if(parse_number(item, &value))
+            emit_value(as, value, size);
+        else
+            asm_error(as, "invalid data", item);
+    }
+}
+
+static int data_size(char *directive, char kind){
+    static const char *units = "bwdq";
+    if(strlen(directive) != (kind == 'r' ? 4 : 2) || strncmp(directive, kind == 'r' ? "res" : "d", kind == 'r' ? 3 : 1))
+        return 0;
+    for(int i = 0; i < 4; ++i)
+        if(directive[strlen(directive) - 1] == units[i])
+            return 1 << i;
+    return 0;
+}
+
+static void assemble_instruction(Assembly *as, char *mnemonic, char *rest){
+    Operand ops[MAX_OPERANDS];
+    char *operands[MAX_OPERANDS], name[32];
+    int nb_ops;
+    if(!strcmp(mnemonic, "rep")){
+        snprintf(name, sizeof(name), "rep %s", trim(rest));
+        mnemonic = name;
+        rest = "";
+    }
+    nb_ops = split_operands(as, rest, operands);
+    for(int i = 0; i < nb_ops; ++i)
+        parse_operand(as, operands[i], &ops[i]);
+    if(as->section != ASM_TEXT)
+        asm_error(as, "instruction outside of .text", mnemonic);
+    for(int i = 0; i < (int)(sizeof(instructions) / sizeof(Instruction)); ++i)
+        if(!strcmp(instructions[i].name, mnemonic)){
+            instructions[i].encode(as, ops, nb_ops, instructions[i].code);
+            return;
+        }
+    for(int i = 0; i < 16; ++i){
+        if(mnemonic[0] == 'j' && !strcmp(mnemonic + 1, conditions[i])){
+            encode_jump(as, ops, nb_ops, i);
+            return;
+        }
+        if(!strncmp(mnemonic, "set", 3) && !strcmp(mnemonic + 3, conditions[i])){
+            encode_set(as, ops, nb_ops, i);
+            return;
+        }
+    }
+    if(mnemonic[0] == 'j' && (!strcmp(mnemonic + 1, "z") || !strcmp(mnemonic + 1, "nz")))
+        encode_jump(as, ops, nb_ops, mnemonic[1] == 'z' ? 4 : 5);
+    else if(!strcmp(mnemonic, "setz") || !strcmp(mnemonic, "setnz"))
+        encode_set(as, ops, nb_ops, mnemonic[3] == 'z' ? 4 : 5);
+    else
+        asm_error(as, "unknown instruction", mnemonic);
+}
+
+/**
+ * @brief Assembles a line: a label, a directive, a data definition or an instruction.
+ */
+static void assemble_line(Assembly *as, char *line){
+    char *text = line, *mnemonic, *rest, *directive, *arguments, quote = 0;
+    int size;
+    for(char *c = line; *c; ++c){
+        if(quote)
+            quote = *c == quote ? 0 : quote;
+        else if(*c == '\'' || *c == '"')
+            quote = *c;
+        else if(*c == ';'){
+            *c = '\0';
+            break;
+        }
+    }
+    text = trim(text);
+    if(!*text)
+        return;
+    if(text[strlen(text) - 1] == ':' && !strchr(text, ' ')){
+        text[strlen(text) - 1] = '\0';
+        define_symbol(as, text);
+        return;
+    }
+    mnemonic = text;
+    rest = text + strcspn(text, " \t");
+    if(*rest)
+        *rest++ = '\0';
+    rest = trim(rest);
+    if(!strcmp(mnemonic, "global") || !strcmp(mnemonic, "extern"))
+        return;
+    if(!strcmp(mnemonic, "section")){
+        if(!strcmp(rest, ".text"))
+            as->section = ASM_TEXT;
+        else if(!strcmp(rest, ".rodata"))
+            as->section = ASM_RODATA;
+        else if(!strcmp(rest, ".bss"))
+            as->section = ASM_BSS;
+        else
+            asm_error(as, "unknown section", rest);
+        return;
+    }
+    if(!strcmp(mnemonic, "align")){
+        align_section(as, atol(rest));
+        return;
+    }
+    directive = rest;
+    arguments = rest + strcspn(rest, " \t");
+    if(*arguments)
+        *arguments++ = '\0';
+    if((size = data_size(directive, 'r')) || (size = data_size(directive, 'd'))){
+        align_section(as, 8);
+        define_symbol(as, mnemonic);
+        if(directive[0] == 'r')
+            reserve(as, atol(arguments) * size);
+        else
+            assemble_data(as, trim(arguments), size);
+        return;
+    }
+    if(*arguments)
+        arguments[-1] = ' ';
+    assemble_instruction(as, mnemonic, rest);
+}
+
+static void assemble_text(Assembly *as, char *text){
+    char *copy = strdup(text), *line = copy, *end;
+    as->section = ASM_TEXT;
+    as->lineno = 0;
+    while(line && *line){
+        if((end = strchr(line, '\n')))
+            *end = '\0';
+        as->lineno++;
+        assemble_line(as, line);
+        line = end ? end + 1 : NULL;
+    }
+    free(copy);
+}
+
+void free_assembly(Assembly *assembly){
+    for(int i = 0; i < ASM_SECTIONS; ++i)
+        free(assembly->sections[i].bytes);
+    for(int i = 0; i < assembly->nb_symbols; ++i)
+        free(assembly->symbols[i].name);
+    free(assembly->symbols);
+    free(assembly->hash);
+    free(assembly->fixups);
+    free(assembly->long_jumps);
+    free(assembly);
+}
+
+/**
+ * @brief Assembles a source after the previous ones, each starting in .text.
+ */
+static void assemble_source(Assembly *as, char *source){
+    for(int i = 0; i < ASM_SECTIONS; ++i){
+        as->section = i;
+        align_section(as, 16);
+    }
+    assemble_text(as, source);
+}
+
+/**
+ * @brief Assembles some sources one after the other.
+ * @param long_jumps Jumps needing 4 bytes, owned by the new assembly.
+ */
+static Assembly *assemble_sources(char **sources, int nb_sources, char *long_jumps){
+    Assembly *as = (Assembly*) try(calloc(1, sizeof(Assembly)), NULL);
+    as->long_jumps = long_jumps;
+    for(int i = 0; i < nb_sources; ++i)
+        assemble_source(as, sources[i]);
+    return as;
+}
+
+/**
+ * @brief Marks the short jumps whose target is too far, now that the code is laid out.
+ * @return 1 if a jump was marked, 0 otherwise.
+ */
+static int mark_long_jumps(Assembly *as){
+    int changed = 0;
+    for(int i = 0; i < as->nb_fixups; ++i){
+        AsmFixup *fixup = &as->fixups[i];
+        AsmSymbol *target = &as->symbols[fixup->symbol];
+        if(fixup->kind != FIX_REL8 || target->section < 0)
+            continue;
+        if(target->section != fixup->section || !fits8(target->offset - fixup->offset - 1)){
+            if(!as->long_jumps)
+                as->long_jumps = (char*) try(calloc(as->nb_jumps, sizeof(char)), NULL);
+            as->long_jumps[fixup->jump] = 1;
+            changed = 1;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief Assembles a program and the routines of the runtime it uses.
+ *
+ * The routines are added for the symbols left undefined, each one possibly needing others. The
+ * jumps are written on 2 bytes first, and the program is assembled again with the jumps found
+ * too far on 4 bytes until each short jump reaches its target. A jump only grows, so this ends.
+ * @return The assembled program, whose fixups are resolved once its sections are placed.
+ */
+Assembly *assemble_program(char *program){
+    char *sources[RUNTIME_MAX + 1] = {program};
+    int nb_sources = 1;
+    Assembly *as = assemble_sources(sources, nb_sources, NULL);
+    for(int i = 0; i < as->nb_symbols && nb_sources <= RUNTIME_MAX; ++i){
+        char *routine;
+        if(as->symbols[i].section >= 0 || !(routine = build_runtime_defining(as->symbols[i].name)))
+            continue;
+        sources[nb_sources++] = routine;
+        assemble_source(as, routine);
+    }
+    while(mark_long_jumps(as)){
+        char *long_jumps = as->long_jumps;
+        as->long_jumps = NULL;
+        free_assembly(as);
+        as = assemble_sources(sources, nb_sources, long_jumps);
+    }
+    for(int i = 1; i < nb_sources; ++i)
+        free(sources[i]);
+    for(int i = 0; i < as->nb_symbols; ++i)
+        if(as->symbols[i].section < 0){
+            fprintf(stderr, "Assembler error: undefined symbol %s\n", as->symbols[i].name);
+            exit(EXIT_ERROR);
+        }
+    return as;
+}
+
+long symbol_address(Assembly *assembly, char *name, long *addresses){
+    for(int i = 0; i < assembly->nb_symbols; ++i)
+        if(!strcmp(assembly->symbols[i].name, name))
+            return assembly->symbols[i].section < 0 ? -1 : addresses[assembly->symbols[i].section] + assembly->symbols[i].offset;
+    return -1;
+}
+
+/**
+ * @brief Writes the addresses of the symbols in the fields referring to them.
+ * @param addresses Address of each section in memory.
+ */
+void resolve_fixups(Assembly *assembly, long *addresses){
+    for(int i = 0; i < assembly->nb_fixups; ++i){
+        AsmFixup *fixup = &assembly->fixups[i];
+        AsmSymbol *symbol = &assembly->symbols[fixup->symbol];
+        long value = addresses[symbol->section] + symbol->offset + fixup->addend;
+        unsigned char *field = assembly->sections[fixup->section].bytes + fixup->offset;
+        int size = fixup->kind == FIX_REL8 ? 1 : fixup->kind == FIX_ABS64 ? 8 : 4;
+        if(fixup->kind == FIX_REL8 || fixup->kind == FIX_REL32)
+            value -= addresses[fixup->section] + fixup->offset;
+        if((size == 1 && !fits8(value)) || (size == 4 && !fits32(value))){
+            fprintf(stderr, "Assembler error: address of %s out of range\n", symbol->name);
+            exit(EXIT_ERROR);
+        }
+        for(int j = 0; j < size; ++j)
+            field[j] = (value >> (8 * j)) & 0xff;
+    }
+}
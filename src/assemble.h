@@ -0,0 +1,76 @@
+/**
+ * @file assemble.h
+ * @brief Encoding of the generated assembly in x86-64 machine code, without an external assembler.
+ */
+
+#ifndef __ASSEMBLE__H
+#define __ASSEMBLE__H
+
+#include "compile.h"
+
+#define ASM_TEXT 0     ///< Section of the code.
+#define ASM_RODATA 1   ///< Section of the constant data.
+#define ASM_BSS 2      ///< Section of the zeroed data, which takes no bytes in the file.
+#define ASM_SECTIONS 3 ///< Number of sections.
+
+#define FIX_REL8 0     ///< Displacement of a short jump, from the end of its byte.
+#define FIX_REL32 1    ///< Displacement of a call or of a near jump, from the end of its 4 bytes.
+#define FIX_ABS32 2    ///< Address on 4 bytes, sign extended by the processor.
+#define FIX_ABS64 3    ///< Address on 8 bytes.
+
+/**
+ * @brief Bytes of a section.
+ */
+typedef struct{
+    unsigned char *bytes; ///< Contents of the section, NULL for .bss.
+    long size;            ///< Size of the section.
+    long capacity;        ///< Number of bytes allocated.
+}AsmSection;
+
+/**
+ * @brief A label, defined once its section is known.
+ */
+typedef struct{
+    char *name;   ///< Name of the label.
+    int section;  ///< Section of the label, -1 while it's undefined.
+    long offset;  ///< Offset of the label in its section.
+}AsmSymbol;
+
+/**
+ * @brief A field of a section holding the address of a symbol, written once the sections are placed.
+ */
+typedef struct{
+    int section;  ///< Section of the field.
+    long offset;  ///< Offset of the field in its section.
+    int symbol;   ///< Symbol whose address is written.
+    long addend;  ///< Value added to the address.
+    int kind;     ///< Kind of the field, one of the FIX_ constants.
+    int jump;     ///< Number of the jump for a FIX_REL8, -1 otherwise.
+}AsmFixup;
+
+/**
+ * @brief Machine code of a program with its symbols.
+ */
+typedef struct{
+    AsmSection sections[ASM_SECTIONS];
+    AsmSymbol *symbols;
+    int nb_symbols;
+    int *hash;         ///< Hash table of the symbols, -1 in the free slots.
+    int hash_size;     ///< Number of slots of the hash table, a power of 2.
+    AsmFixup *fixups;
+    int nb_fixups;
+    char *long_jumps;  ///< Flag of each jump needing 4 bytes, found by the previous passes.
+    int nb_jumps;      ///< Number of jumps met so far.
+    int section;       ///< Section being written.
+    int lineno;        ///< Line being assembled, for the error messages.
+}Assembly;
+
+Assembly *assemble_program(char *program); ///< Function to assemble a program with the routines of the runtime it uses.
+
+long symbol_address(Assembly *assembly, char *name, long *addresses); ///< Function to get the address of a symbol once the sections are placed, -1 if it's undefined.
+
+void resolve_fixups(Assembly *assembly, long *addresses); ///< Function to write the addresses of the symbols once the sections are placed.
+
+void free_assembly(Assembly *assembly); ///< Function to free an assembled program.
+
+#endif
@@ -1,129 +1,310 @@
 #include "build.h"
 
+int line_buffered = 0;
+
+/**
+ * @brief Starts the text of a routine with its symbols.
+ * @param globals Symbols defined by the routine, ending with NULL.
+ * @param externs Symbols of the other routines it uses, ending with NULL.
+ */
+static void build_header(FILE *file, char **globals, char **externs){
+    for(int i = 0; globals[i]; ++i)
+        fprintf(file, "global %s\n", globals[i]);
+    for(int i = 0; externs[i]; ++i)
+        fprintf(file, "extern %s\n", externs[i]);
+    fprintf(file, "section .text\n");
+}
+
+/**
+ * @brief Builds the function writing the output buffer on the standard output.
+ *
+ * A write may take only a part of the bytes, so the rest is written again until the buffer is
+ * empty. On an error the bytes left are dropped, there is nowhere to report it. Only rax, rcx,
+ * rdx, rsi, rdi and r11 are modified, like by a system call.
+ */
+static void build_flush(FILE *file){
+    build_header(file, (char*[]){"_flush", "_out_buffer", "_out_length", NULL}, (char*[]){NULL});
+    fprintf(file, "_flush:\n");
+    fprintf(file, "mov rsi, _out_buffer ; début des octets à écrire\n");
+    fprintf(file, "mov rdx, [_out_length] ; nombre d'octets à écrire\n");
+    fprintf(file, "_flush_loop:\n");
+    fprintf(file, "cmp rdx, 0\n");
+    fprintf(file, "jle _flush_end ; plus rien à écrire\n");
+    fprintf(file, "mov rax, 1\n");
+    fprintf(file, "mov rdi, 1\n");
+    fprintf(file, "syscall\n");
+    fprintf(file, "cmp rax, 0\n");
+    fprintf(file, "jle _flush_end ; erreur, on abandonne le reste\n");
+    fprintf(file, "add rsi, rax ; on avance des octets écrits\n");
+    fprintf(file, "sub rdx, rax\n");
+    fprintf(file, "jmp _flush_loop\n");
+    fprintf(file, "_flush_end:\n");
+    fprintf(file, "mov qword [_out_length], 0 ; le tampon est vide\n");
+    fprintf(file, "ret\n");
+    fprintf(file, "section .bss\n");
+    fprintf(file, "_out_buffer resb %d\n", OUT_BUFFER_SIZE);
+    fprintf(file, "_out_length resq 1\n");
+}
+
+/**
+ * @brief Builds the function reading the standard input into the input buffer, after writing
+ * the output left, so that a prompt is shown before the program waits.
+ *
+ * The number of bytes read is left in rax, 0 or less at the end of the input. The registers
+ * modified are the ones of _flush.
+ */
+static void build_fill(FILE *file){
+    build_header(file, (char*[]){"_fill", "_in_buffer", "_in_start", "_in_end", NULL}, (char*[]){"_flush", NULL});
+    fprintf(file, "_fill:\n");
+    fprintf(file, "call _flush\n");
+    fprintf(file, "mov rax, 0 ; on veut lire\n");
+    fprintf(file, "mov rdi, 0 ; sur l'entrée standard\n");
+    fprintf(file, "mov rsi, _in_buffer\n");
+    fprintf(file, "mov rdx, %d ; autant que le tampon peut contenir\n", IN_BUFFER_SIZE);
+    fprintf(file, "syscall\n");
+    fprintf(file, "mov qword [_in_start], 0\n");
+    fprintf(file, "mov qword [_in_end], 0\n");
+    fprintf(file, "cmp rax, 0\n");
+    fprintf(file, "jle _fill_end ; fin de l'entrée ou erreur, le tampon reste vide\n");
+    fprintf(file, "mov [_in_end], rax\n");
+    fprintf(file, "_fill_end:\n");
+    fprintf(file, "ret\n");
+    fprintf(file, "section .bss\n");
+    fprintf(file, "_in_buffer resb %d\n", IN_BUFFER_SIZE);
+    fprintf(file, "_in_start resq 1\n");
+    fprintf(file, "_in_end resq 1\n");
+}
+
+/**
+ * @brief Builds getchar, which takes the next character of the input buffer, filled when empty.
+ *
+ * At the end of the input, 0 is returned, each call trying to read again.
+ */
 static void build_getchar(FILE *file){
+    build_header(file, (char*[]){"_getchar", NULL}, (char*[]){"_fill", "_in_buffer", "_in_start", "_in_end", NULL});
     fprintf(file, "_getchar:\n");
-    fprintf(file, "push rbp\n");
-    fprintf(file, "mov rbp, rsp\n");
-    fprintf(file, "push 0 ; on initialise 1 octet sur la pile à 0\n");
-    fprintf(file, "mov rax, 0 ; utilisé par syscall pour savoir qu'il faut lire\n");
-    fprintf(file, "mov rdi, 0 ; fichier depuis lequelle on lit\n");
-    fprintf(file, "mov rsi, rsp ; zone mémoire ou on veut copier les données\n");
-    fprintf(file, "mov rdx, 1 ; nombre d'octets qu'on veut lire\n");
-    fprintf(file, "syscall ; appel système\n");
-    fprintf(file, "pop rax ; on récupére l'octets lu depuis la pile\n");
-    fprintf(file, "mov rsp, rbp\n");
-    fprintf(file, "pop rbp\n");
+    fprintf(file, "mov rcx, [_in_start]\n");
+    fprintf(file, "cmp rcx, [_in_end]\n");
+    fprintf(file, "jl _getchar_load ; il reste des caractères dans le tampon\n");
+    fprintf(file, "call _fill\n");
+    fprintf(file, "cmp rax, 0\n");
+    fprintf(file, "jle _getchar_eof\n");
+    fprintf(file, "mov rcx, 0\n");
+    fprintf(file, "_getchar_load:\n");
+    fprintf(file, "movzx rax, byte [_in_buffer + rcx]\n");
+    fprintf(file, "inc rcx\n");
+    fprintf(file, "mov [_in_start], rcx\n");
+    fprintf(file, "ret\n");
+    fprintf(file, "_getchar_eof:\n");
+    fprintf(file, "mov rax, 0\n");
     fprintf(file, "ret\n");
 }
 
+/**
+ * @brief Builds getint, which reads an optional '-' then the digits of an integer.
+ *
+ * The first character comes from getchar, then the digits are converted straight from the
+ * input buffer, refilled when a number crosses its end. The character following the number is
+ * consumed. Without any digit or '-' first, the program exits with code 5.
+ */
 static void build_getint(FILE *file){
+    build_header(file, (char*[]){"_getint", NULL}, (char*[]){"_getchar", "_fill", "_flush", "_in_buffer", "_in_start", "_in_end", NULL});
     fprintf(file, "_getint:\n");
-    fprintf(file, "push rbp\n");
-    fprintf(file, "mov rbp, rsp\n");
-    fprintf(file, "mov r12, 0 ; on met 0 dans r12\n") ;
-    fprintf(file, "mov r10, 1 ; on met 1 dans r10\n") ;
-    fprintf(file, "mov r11, rsp\n") ;
-    fprintf(file, "sub rsp, 8\n") ;
-    fprintf(file, "and rsp, -16\n") ;
-    fprintf(file, "mov qword [rsp], r11\n") ;
-    fprintf(file, "call _getchar ; on récupère un caractère\n") ;
-    fprintf(file, "pop rsp\n") ;
-    fprintf(file, "cmp rax, 48\n");
-    fprintf(file, "jl end\n");
-    fprintf(file, "cmp rax, 57\n");
-    fprintf(file, "jg end\n");
-    fprintf(file, "cmp rax, 45 ; on compare avec '-'\n") ;
-    fprintf(file, "jne test_digit ; si c'est pas '-' on teste si c'est un chiffre\n") ;
-    fprintf(file, "back:\n");
-    fprintf(file, "mov r10, -1 ; si c'est '-' on met -1 dans r10\n") ;
-    fprintf(file, "read_digit:\n") ;
-    fprintf(file, "mov r11, rsp\n") ;
-    fprintf(file, "sub rsp, 8\n") ;
-    fprintf(file, "and rsp, -16\n") ;
-    fprintf(file, "mov qword [rsp], r11\n") ;
-    fprintf(file, "call _getchar ; on récupère un caractère\n") ;
-    fprintf(file, "pop rsp\n") ;
-    fprintf(file, "test_digit:\n") ;
-    fprintf(file, "cmp rax, 48 ; on compare avec '0'\n") ;
-    fprintf(file, "jl end_read_digit ; si c'est plus petit que 0 on arrête\n") ;
-    fprintf(file, "cmp rax, 57 ; on compare avec '9'\n") ;
-    fprintf(file, "jg end_read_digit ; si c'est plus grand que 9 on arrête\n") ;
-    fprintf(file, "sub rax, 48 ; on convertit le caractère en entier\n") ;
-    fprintf(file, "imul r12, 10 ; on multiplie le chiffre par 10\n") ;
-    fprintf(file, "add r12, rax ; on ajoute le chiffre\n") ;
-    fprintf(file, "jmp read_digit ; on recommence\n") ;
-    fprintf(file, "end_read_digit:\n") ;
-    fprintf(file, "mov rax, r12 ; on met le résultat dans rax\n") ;
-    fprintf(file, "imul rax, r10 ; on multiplie par -1 si besoin\n") ;
-    fprintf(file, "mov rsp, rbp\n");
-    fprintf(file, "pop rbp\n");
+    fprintf(file, "mov r12, 0 ; valeur lue\n");
+    fprintf(file, "mov r10, 1 ; signe\n");
+    fprintf(file, "call _getchar\n");
+    fprintf(file, "cmp rax, '-'\n");
+    fprintf(file, "jne _getint_first\n");
+    fprintf(file, "mov r10, -1\n");
+    fprintf(file, "jmp _getint_load\n");
+    fprintf(file, "_getint_first:\n");
+    fprintf(file, "sub rax, '0'\n");
+    fprintf(file, "cmp rax, 9\n");
+    fprintf(file, "ja _getint_error ; ce n'est pas un chiffre\n");
+    fprintf(file, "mov r12, rax\n");
+    fprintf(file, "_getint_load:\n");
+    fprintf(file, "mov rcx, [_in_start]\n");
+    fprintf(file, "_getint_digit:\n");
+    fprintf(file, "cmp rcx, [_in_end]\n");
+    fprintf(file, "jge _getint_fill ; le nombre continue peut-être après le tampon\n");
+    fprintf(file, "movzx rax, byte [_in_buffer + rcx]\n");
+    fprintf(file, "inc rcx\n");
+    fprintf(file, "sub rax, '0'\n");
+    fprintf(file, "cmp rax, 9\n");
+    fprintf(file, "ja _getint_end ; fin du nombre\n");
+    fprintf(file, "imul r12, 10\n");
+    fprintf(file, "add r12, rax\n");
+    fprintf(file, "jmp _getint_digit\n");
+    fprintf(file, "_getint_fill:\n");
+    fprintf(file, "call _fill\n");
+    fprintf(file, "mov rcx, 0\n");
+    fprintf(file, "cmp rax, 0\n");
+    fprintf(file, "jg _getint_digit\n");
+    fprintf(file, "_getint_end:\n");
+    fprintf(file, "mov [_in_start], rcx\n");
+    fprintf(file, "mov rax, r12\n");
+    fprintf(file, "imul rax, r10 ; on multiplie par -1 si besoin\n");
     fprintf(file, "ret\n");
-    fprintf(file, "end:\n");
-    fprintf(file, "cmp rax, 45\n");
-    fprintf(file, "je back\n");
+    fprintf(file, "_getint_error:\n");
+    fprintf(file, "call _flush\n");
     fprintf(file, "mov rdi, 5\n");
     fprintf(file, "mov rax, 60\n");
     fprintf(file, "syscall\n");
 }
 
+/**
+ * @brief Builds putchar, which adds its character to the output buffer, flushed once full.
+ *
+ * When _line_buffered is set, by _start for the option -l, the buffer is also flushed after each
+ * newline.
+ */
 static void build_putchar(FILE *file){
+    build_header(file, (char*[]){"_putchar", "_line_buffered", NULL}, (char*[]){"_flush", "_out_buffer", "_out_length", NULL});
     fprintf(file, "_putchar:\n");
-    fprintf(file, "push rbp\n");
-    fprintf(file, "mov rbp, rsp\n");
-    fprintf(file, "mov r12, rbp\n");
-    fprintf(file, "add r12, 16 ; On recupère le caractère à afficher\n");
-    fprintf(file, "mov rax, 1\n");
-    fprintf(file, "mov rdi, 1\n");
-    fprintf(file, "mov rsi, r12\n");
-    fprintf(file, "mov rdx, 1\n");
-    fprintf(file, "syscall\n");
-    fprintf(file, "mov rsp, rbp\n");
-    fprintf(file, "pop rbp\n");
+    fprintf(file, "mov rax, [_out_length]\n");
+    fprintf(file, "cmp rax, %d\n", OUT_BUFFER_SIZE);
+    fprintf(file, "jl _putchar_store ; il reste de la place dans le tampon\n");
+    fprintf(file, "call _flush\n");
+    fprintf(file, "mov rax, 0\n");
+    fprintf(file, "_putchar_store:\n");
+    fprintf(file, "mov rcx, [rsp + 8] ; On recupère le caractère à afficher\n");
+    fprintf(file, "mov [_out_buffer + rax], cl\n");
+    fprintf(file, "inc rax\n");
+    fprintf(file, "mov [_out_length], rax\n");
+    fprintf(file, "cmp cl, 10\n");
+    fprintf(file, "jne _putchar_end\n");
+    fprintf(file, "cmp byte [_line_buffered], 0\n");
+    fprintf(file, "je _putchar_end\n");
+    fprintf(file, "call _flush ; fin de ligne\n");
+    fprintf(file, "_putchar_end:\n");
     fprintf(file, "ret\n");
+    fprintf(file, "section .bss\n");
+    fprintf(file, "_line_buffered resb 1\n");
 }
 
+/**
+ * @brief Builds putint, which converts its integer in a scratch area on the stack, two digits
+ * at a time from the last ones, then copies the scratch area to the output buffer at once.
+ *
+ * The magnitude is converted as an unsigned 64 bit number, so that the smallest integer needs
+ * no special case. A quotient by 100 is a multiplication by the reciprocal 0x28F5C28F5C28F5C3
+ * of 400 after a shift by 2, and the remainder indexes the table _digit_pairs of the pairs of
+ * characters "00" to "99". The copy moves PUTINT_SCRATCH bytes whatever the length, so the
+ * buffer is flushed first when it has less room than that.
+ */
 static void build_putint(FILE *file){
+    build_header(file, (char*[]){"_putint", NULL}, (char*[]){"_flush", "_out_buffer", "_out_length", NULL});
     fprintf(file, "_putint:\n");
-    fprintf(file, "push rbp\n");
-    fprintf(file, "mov rbp, rsp\n");
-    fprintf(file, "mov rax, [rbp + 16] ; On recupère n\n");
-    fprintf(file, "cmp rax, 0 ; On compare n à 0\n");
-    fprintf(file, "jge is_positive ; Si n est positif ou 0, sauter à is_positive\n");
-    fprintf(file, "push rax ; On empile n\n");
-    fprintf(file, "push '-' ; On empile le signe moins\n");
-    fprintf(file, "call _putchar ; On affiche le signe moins\n");
-    fprintf(file, "add rsp, 8 ; On dépile le signe moins\n");
-    fprintf(file, "pop rax ; On dépile n\n");
-    fprintf(file, "neg rax ; rendre n positif\n");
-    fprintf(file, "is_positive:\n");
-    fprintf(file, "mov r10, 0 ; On met le compteur de chiffres à 0\n");
-    fprintf(file, "convert_loop:\n");
-    fprintf(file, "mov rdx, 0 ; On met rdx à 0\n");
-    fprintf(file, "mov rbx, 10 ; On met rbx à 10\n");
-    fprintf(file, "div rbx ; On divise rax par rbx et on met le reste dans rdx\n");
-    fprintf(file, "add rdx, '0'\n");
-    fprintf(file, "push rdx ; On empile le reste\n");
-    fprintf(file, "inc r10 ; On incrémente le compteur de chiffres\n");
-    fprintf(file, "cmp rax, 0 ; On compare rax à 0\n");
-    fprintf(file, "jne convert_loop\n");
-    fprintf(file, "print_loop:\n");
-    fprintf(file, "dec r10 ; On décrémente le compteur de chiffres\n");
-    fprintf(file, "mov rax, 1 ; On veut ecrire\n");
-    fprintf(file, "mov rdi, 1 ; Sur la sortie standard\n");
-    fprintf(file, "mov rsi, rsp ; On met le reste dans rsi\n");
-    fprintf(file, "mov rdx, 1 ; On veut lire un octet\n");
-    fprintf(file, "syscall ; On appelle le systeme\n");
-    fprintf(file, "pop r12 ; On dépile le reste\n");
-    fprintf(file, "cmp r10, 0\n");
-    fprintf(file, "jne print_loop ; si i n'est pas 0, continuer la boucle\n");
-    fprintf(file, "mov rsp, rbp\n");
-    fprintf(file, "pop rbp\n");
+    fprintf(file, "mov rax, [_out_length]\n");
+    fprintf(file, "cmp rax, %d\n", OUT_BUFFER_SIZE - PUTINT_SCRATCH);
+    fprintf(file, "jle _putint_convert ; il reste de la place pour la zone de conversion\n");
+    fprintf(file, "call _flush\n");
+    fprintf(file, "_putint_convert:\n");
+    fprintf(file, "mov rax, [rsp + 8] ; On recupère n\n");
+    fprintf(file, "mov r11, rax ; On garde son signe\n");
+    fprintf(file, "mov rsi, rsp ; fin de la zone de conversion\n");
+    fprintf(file, "sub rsp, %d\n", PUTINT_SCRATCH);
+    fprintf(file, "mov r10, rsi ; premier caractère converti\n");
+    fprintf(file, "cmp rax, 0\n");
+    fprintf(file, "jge _putint_pair\n");
+    fprintf(file, "neg rax ; rendre n positif, comme entier non signé\n");
+    fprintf(file, "_putint_pair:\n");
+    fprintf(file, "cmp rax, 100\n");
+    fprintf(file, "jb _putint_last ; il reste un ou deux chiffres\n");
+    fprintf(file, "mov rcx, rax\n");
+    fprintf(file, "shr rax, 2\n");
+    fprintf(file, "mov rdx, 0x28F5C28F5C28F5C3\n");
+    fprintf(file, "mul rdx\n");
+    fprintf(file, "shr rdx, 2 ; quotient par 100\n");
+    fprintf(file, "mov rax, rdx\n");
+    fprintf(file, "imul rdx, rdx, 100\n");
+    fprintf(file, "sub rcx, rdx ; reste, les deux derniers chiffres\n");
+    fprintf(file, "movzx edx, word [_digit_pairs + rcx * 2]\n");
+    fprintf(file, "sub r10, 2\n");
+    fprintf(file, "mov [r10], dx\n");
+    fprintf(file, "jmp _putint_pair\n");
+    fprintf(file, "_putint_last:\n");
+    fprintf(file, "cmp rax, 10\n");
+    fprintf(file, "jb _putint_digit\n");
+    fprintf(file, "movzx edx, word [_digit_pairs + rax * 2]\n");
+    fprintf(file, "sub r10, 2\n");
+    fprintf(file, "mov [r10], dx\n");
+    fprintf(file, "jmp _putint_sign\n");
+    fprintf(file, "_putint_digit:\n");
+    fprintf(file, "add al, '0'\n");
+    fprintf(file, "dec r10\n");
+    fprintf(file, "mov [r10], al\n");
+    fprintf(file, "_putint_sign:\n");
+    fprintf(file, "cmp r11, 0\n");
+    fprintf(file, "jge _putint_copy\n");
+    fprintf(file, "dec r10\n");
+    fprintf(file, "mov byte [r10], '-'\n");
+    fprintf(file, "_putint_copy:\n");
+    fprintf(file, "mov rdi, [_out_length]\n");
+    for(int i = 0; i < PUTINT_SCRATCH; i += 8){
+        fprintf(file, "mov rax, [r10 + %d]\n", i);
+        fprintf(file, "mov [_out_buffer + rdi + %d], rax\n", i);
+    }
+    fprintf(file, "sub rsi, r10 ; longueur du nombre\n");
+    fprintf(file, "add rdi, rsi\n");
+    fprintf(file, "mov [_out_length], rdi\n");
+    fprintf(file, "add rsp, %d\n", PUTINT_SCRATCH);
     fprintf(file, "ret\n");
+    fprintf(file, "section .rodata\n");
+    fprintf(file, "_digit_pairs db \"");
+    for(int i = 0; i < 100; ++i)
+        fprintf(file, "%02d", i);
+    fprintf(file, "\"\n");
 }
 
-void build_external_fcts(FILE *file){
-    build_getchar(file);
-    build_getint(file);
-    build_putchar(file);
-    build_putint(file);
-}
\ No newline at end of file
+static const Routine routines[] = {
+    {"_getchar", build_getchar},
+    {"_getint", build_getint},
+    {"_putchar", build_putchar},
+    {"_putint", build_putint},
+    {"_flush", build_flush},
+    {"_fill", build_fill},
+};
+
+/**
+ * @brief Builds one routine of the runtime, assembled on its own and archived with the others.
+ *
+ * The output is kept in a buffer of OUT_BUFFER_SIZE bytes, written when full, before reading the
+ * standard input, and on exit by _start or by getint. Whatever is left in it is lost if the
+ * program is killed, by a division by zero for instance. The input is read ahead by blocks of
+ * IN_BUFFER_SIZE bytes, the characters from _in_start to _in_end being still unread. Each buffer
+ * belongs to the routine emptying or filling it, so that a program only links the routines
+ * reached from its calls.
+ * @param name Symbol of the routine, _getchar for instance.
+ * @return 0 if there is no routine of this name, 1 otherwise.
+ */
+int build_runtime(FILE *file, char *name){
+    for(int i = 0; i < (int)(sizeof(routines) / sizeof(Routine)); ++i)
+        if(!strcmp(routines[i].name, name)){
+            routines[i].build(file);
+            return 1;
+        }
+    return 0;
+}
+
+/**
+ * @brief Builds the routine of the runtime defining a symbol, for the programs assembled without
+ * the archive.
+ * @return The text of the routine, to free, or NULL if no routine defines the symbol.
+ */
+char *build_runtime_defining(char *symbol){
+    for(int i = 0; i < (int)(sizeof(routines) / sizeof(Routine)); ++i){
+        char *text, *line;
+        size_t size;
+        FILE *file = open_memstream(&text, &size);
+        if(!file)
+            return NULL;
+        routines[i].build(file);
+        fclose(file);
+        for(line = text; !strncmp(line, "global ", 7); line = strchr(line, '\n') + 1)
+            if(!strncmp(line + 7, symbol, strlen(symbol)) && line[7 + strlen(symbol)] == '\n')
+                return text;
+        free(text);
+    }
+    return NULL;
+}
@@ -3,7 +3,25 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-void build_external_fcts(FILE *file); ///< Function to build the external functions.
+#define OUT_BUFFER_SIZE 4096 ///< Size of the buffer of the standard output.
+#define IN_BUFFER_SIZE 65536 ///< Size of the buffer of the standard input.
+#define PUTINT_SCRATCH 24    ///< Bytes converted by putint, a multiple of 8 holding the longest integer with its sign.
+#define RUNTIME_MAX 6        ///< Number of routines of the runtime.
 
-#endif
\ No newline at end of file
+extern int line_buffered; ///< Flag making _start ask putchar to flush the standard output after each newline.
+
+/**
+ * @brief A routine of the runtime and the function writing its assembly.
+ */
+typedef struct{
+    char *name;                 ///< Symbol of the routine.
+    void (*build)(FILE *file);  ///< Function writing the routine, its symbols and its data.
+}Routine;
+
+int build_runtime(FILE *file, char *name); ///< Function to build the assembly of a routine of the runtime, returning 0 for an unknown name.
+
+char *build_runtime_defining(char *symbol); ///< Function to build the text of the routine of the runtime defining a symbol, NULL if there is none.
+
+#endif
@@ -0,0 +1,779 @@
+#include "burs.h"
+#include "frame.h"
+
+#define NT_REG 0 ///< Value in a register.
+#define NT_IMM 1 ///< Constant, used as an immediate operand.
+#define NT_MEM 2 ///< Scalar read as a 64-bit memory operand.
+#define NB_NT 3
+
+#define LOAD_QWORD 0  ///< Read of the 8 bytes of a slot.
+#define LOAD_SEXT32 1 ///< Read of a dword, sign extended.
+#define LOAD_SEXT8 2  ///< Read of a byte, sign extended.
+
+#define STACK_COST 8 ///< Cost of an expression left to the stack code.
+
+static const char *regs64[BURS_NB_REGS] = {"rax", "rcx", "rsi", "rdi", "r8", "r9", "r10", "r11"};
+static const char *regs32[BURS_NB_REGS] = {"eax", "ecx", "esi", "edi", "r8d", "r9d", "r10d", "r11d"};
+static const char *regs8[BURS_NB_REGS] = {"al", "cl", "sil", "dil", "r8b", "r9b", "r10b", "r11b"};
+
+/**
+ * @brief Conditions of the jumps and of the sets: the condition, its negation, and the condition
+ * holding once the operands are swapped.
+ */
+static const char *conditions[][3] = {
+    {"e", "ne", "e"}, {"ne", "e", "ne"}, {"l", "ge", "g"}, {"le", "g", "ge"}, {"g", "le", "l"}, {"ge", "l", "le"}
+};
+
+static const char *operators[][2] = {{"==", "e"}, {"!=", "ne"}, {"<", "l"}, {"<=", "le"}, {">", "g"}, {">=", "ge"}};
+
+/**
+ * @brief Rules of the tree grammar, named after the nonterminal they derive.
+ */
+typedef enum{
+    R_NONE,
+    R_CONST,     ///< imm: Num | Character
+    R_SCALAR,    ///< mem: scalar parameter or local variable
+    R_LOAD_IMM,  ///< reg: imm
+    R_LOAD_MEM,  ///< reg: mem
+    R_LOAD,      ///< reg: global scalar | array element
+    R_STACK,     ///< reg: any expression, written by the stack code
+    R_OP_IMM,    ///< reg: op(reg, imm)
+    R_OP_MEM,    ///< reg: op(reg, mem)
+    R_OP_REG,    ///< reg: op(reg, reg)
+    R_SWAP_IMM,  ///< reg: op(imm, reg), op commutative or a comparison
+    R_SWAP_MEM,  ///< reg: op(mem, reg), op commutative or a comparison
+    R_UNARY,     ///< reg: -reg | +reg
+    R_NOT        ///< reg: !reg
+}Rule;
+
+/**
+ * @brief Variable or array element read or written by an instruction.
+ */
+typedef struct{
+    int kind;             ///< IV_GLOBAL, IV_PARAM or IV_LOCAL.
+    Element *var;         ///< Variable accessed, NULL through a pointer.
+    IvPointer *pointer;   ///< Pointer of an access strength reduced in the loop being written, or NULL.
+    long displacement;    ///< Constant part of the index, in elements.
+    Node *index;          ///< Variable part of the index, or NULL.
+    int load;             ///< How a read widens the value to 64 bits, LOAD_QWORD to LOAD_SEXT8.
+    int size;             ///< Size written by a store.
+}Access;
+
+/**
+ * @brief Labelled node: the cheapest rule deriving each nonterminal at the node.
+ */
+typedef struct burs_state{
+    Node *node;                  ///< Node, out of its Expression nodes.
+    int cost[NB_NT];             ///< Instructions written by the cheapest derivation, BURS_INFINITE if none.
+    Rule rule[NB_NT];            ///< Rule of the cheapest derivation.
+    Access access;               ///< Variable read by R_SCALAR and R_LOAD.
+    struct burs_state *kids[2];  ///< Operands, or the variable part of an index.
+}BursState;
+
+/**
+ * @brief State of the selection in the function being written.
+ */
+typedef struct{
+    FILE *file;
+    SymTabs *global_vars;
+    SymTabsFct **functions;
+    int nb_functions;
+    char *function_name;
+    SymTabsFct *function;  ///< Table of the function being written.
+    IvLoop *iv_loops;      ///< Strength reductions of the function being written.
+    int iv_frame;          ///< Size of the variables of the function, below which the pointers are kept.
+}BursCtx;
+
+static void emit_reg(BursCtx *ctx, BursState *state, int reg);
+
+static BursCtx make_ctx(FILE *file, IvLoop *iv_loops, int iv_frame, SymTabs *global_vars, SymTabsFct **functions,
+    int nb_functions, char *function_name){
+    BursCtx ctx = {file, global_vars, functions, nb_functions, function_name, NULL, iv_loops, iv_frame};
+    for(int i = 0; i < nb_functions; ++i)
+        if(function_name && !strcmp(functions[i]->ident, function_name))
+            ctx.function = functions[i];
+    return ctx;
+}
+
+static Node *unwrap(Node *root){
+    while(root->label == Expression)
+        root = FIRSTCHILD(root);
+    return root;
+}
+
+static long imm_value(Node *root){
+    return root->label == Num ? root->num : character_value(root);
+}
+
+static int has_call(Node *root){
+    if(is_function_call(root))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(has_call(child))
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Tells if two expressions are the same, ignoring the Expression nodes around them and
+ * their siblings.
+ */
+static int same_expr(Node *a, Node *b){
+    Node *x, *y;
+    a = unwrap(a);
+    b = unwrap(b);
+    if(a->label != b->label || a->num != b->num || (!a->ident) != (!b->ident) || (a->ident && strcmp(a->ident, b->ident)))
+        return 0;
+    for(x = FIRSTCHILD(a), y = FIRSTCHILD(b); x && y; x = x->nextSibling, y = y->nextSibling)
+        if(!same_expr(x, y))
+            return 0;
+    return !x && !y;
+}
+
+static Element *find_element(Table *table, char *var_name){
+    for(Table *current = table; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return &current->var;
+    return NULL;
+}
+
+static const char *size_name(int size){
+    return size == 8 ? "qword" : size == 4 ? "dword" : "byte";
+}
+
+static const char *sized_reg(int reg, int size){
+    return size == 8 ? regs64[reg] : size == 4 ? regs32[reg] : regs8[reg];
+}
+
+static int load_size(int load){
+    return load == LOAD_QWORD ? 8 : load == LOAD_SEXT32 ? 4 : 1;
+}
+
+static const char *operator_condition(Node *root){
+    for(int i = 0; i < 6; ++i)
+        if(!strcmp(operators[i][0], root->ident))
+            return operators[i][1];
+    return "ne";
+}
+
+/**
+ * @brief Gives a condition once negated (column 1) or once its operands are swapped (column 2).
+ */
+static const char *transform_condition(const char *condition, int column){
+    for(int i = 0; i < 6; ++i)
+        if(!strcmp(conditions[i][0], condition))
+            return conditions[i][column];
+    return condition;
+}
+
+/**
+ * @brief Gives the widths of an element as the stack code reads and writes it: the arrays are
+ * packed and their elements read sign extended.
+ */
+static void element_widths(Access *access, int is_int){
+    access->load = is_int ? LOAD_SEXT32 : LOAD_SEXT8;
+    access->size = element_size(is_int);
+}
+
+/**
+ * @brief Splits an index in a variable part and a constant displacement, folded in the address.
+ */
+static void split_index(Node *index, Access *access){
+    index = unwrap(index);
+    access->index = index;
+    if(index->label == Num){
+        access->displacement = index->num;
+        access->index = NULL;
+    }
+    else if(index->label == Addsub && SECONDCHILD(index)){
+        Node *left = unwrap(FIRSTCHILD(index)), *right = unwrap(SECONDCHILD(index));
+        if(right->label == Num){
+            access->displacement = index->ident[0] == '+' ? right->num : -right->num;
+            access->index = left;
+        }
+        else if(left->label == Num && index->ident[0] == '+'){
+            access->displacement = left->num;
+            access->index = right;
+        }
+    }
+}
+
+/**
+ * @brief Resolves the variable of an Ident or Array node as the code generation does, globals first.
+ * @return 0 if the node is the address of an array, or isn't known.
+ */
+static int resolve_access(BursCtx *ctx, Node *target, Access *access){
+    char *var_name = target->label == Array ? FIRSTCHILD(target)->ident : target->ident;
+    int displacement;
+    memset(access, 0, sizeof(Access));
+    if(target->label == Array && (access->pointer = get_iv_pointer(ctx->iv_loops, target, &displacement))){
+        access->kind = access->pointer->kind;
+        access->displacement = displacement;
+        element_widths(access, access->pointer->is_int);
+        return 1;
+    }
+    if((access->var = find_element(ctx->global_vars->first, var_name)))
+        access->kind = IV_GLOBAL;
+    else if(ctx->function && (access->var = find_element(ctx->function->parameters, var_name)))
+        access->kind = IV_PARAM;
+    else if(ctx->function && (access->var = find_element(ctx->function->variables, var_name)))
+        access->kind = IV_LOCAL;
+    else
+        return 0;
+    if(target->label == Array){
+        if(!access->var->is_array)
+            return 0;
+        split_index(FIRSTCHILD(FIRSTCHILD(target)), access);
+        element_widths(access, access->var->is_int);
+        return 1;
+    }
+    if(access->var->is_array && access->kind != IV_PARAM)
+        return 0;
+    access->load = access->kind != IV_GLOBAL ? LOAD_QWORD : access->var->is_int ? LOAD_SEXT32 : LOAD_SEXT8;
+    access->size = access->kind != IV_GLOBAL ? 8 : access->var->is_int ? 4 : 1;
+    return 1;
+}
+
+static int needs_base(BursState *state){
+    return state->access.pointer || (state->access.kind == IV_PARAM && FIRSTCHILD(state->node)->label == Array);
+}
+
+/**
+ * @brief Gives the cost of the computation of the address of an access.
+ */
+static int address_cost(BursState *state){
+    return (state->kids[0] ? state->kids[0]->cost[NT_REG] : 0) + needs_base(state);
+}
+
+static void record(BursState *state, int nt, Rule rule, int cost){
+    if(cost < state->cost[nt]){
+        state->cost[nt] = cost;
+        state->rule[nt] = rule;
+    }
+}
+
+static int operator_cost(Node *root){
+    if(root->label == Addsub || (root->label == Divstar && root->ident[0] == '*'))
+        return 1;
+    return 3;
+}
+
+static BursState *label_tree(BursCtx *ctx, Node *root);
+
+static void label_variable(BursCtx *ctx, BursState *state){
+    Access *access = &state->access;
+    if(!resolve_access(ctx, FIRSTCHILD(state->node), access))
+        return;
+    if(access->index)
+        state->kids[0] = label_tree(ctx, access->index);
+    if(FIRSTCHILD(state->node)->label == Ident && access->load == LOAD_QWORD)
+        record(state, NT_MEM, R_SCALAR, 0);
+    else
+        record(state, NT_REG, R_LOAD, address_cost(state) + 1);
+}
+
+/**
+ * @brief Labels a binary operator. The operand read from memory or given as an immediate can be
+ * the first one when the operator commutes, the comparisons commuting once their condition is swapped.
+ */
+static void label_operator(BursCtx *ctx, BursState *state){
+    Node *root = state->node;
+    BursState *left = state->kids[0] = label_tree(ctx, FIRSTCHILD(root));
+    BursState *right = state->kids[1] = label_tree(ctx, SECONDCHILD(root));
+    int cost = operator_cost(root), division = root->label == Divstar && root->ident[0] != '*';
+    int commutes = root->label == Eq || root->label == Order || root->ident[0] == '+' || root->ident[0] == '*';
+    record(state, NT_REG, R_OP_REG, left->cost[NT_REG] + right->cost[NT_REG] + cost);
+    record(state, NT_REG, R_OP_MEM, left->cost[NT_REG] + right->cost[NT_MEM] + cost);
+    if(!division)
+        record(state, NT_REG, R_OP_IMM, left->cost[NT_REG] + right->cost[NT_IMM] + cost);
+    if(commutes){
+        record(state, NT_REG, R_SWAP_MEM, right->cost[NT_REG] + left->cost[NT_MEM] + cost);
+        record(state, NT_REG, R_SWAP_IMM, right->cost[NT_REG] + left->cost[NT_IMM] + cost);
+    }
+}
+
+/**
+ * @brief Labels an expression bottom-up with the cheapest derivation of each nonterminal.
+ *
+ * The nodes no rule covers, the calls, the logical operators and the addresses of the arrays,
+ * are left to the stack code, the registers in use being saved around it.
+ */
+static BursState *label_tree(BursCtx *ctx, Node *root){
+    BursState *state = (BursState*) try(calloc(1, sizeof(BursState)), NULL);
+    state->node = root = unwrap(root);
+    for(int i = 0; i < NB_NT; ++i)
+        state->cost[i] = BURS_INFINITE;
+    switch(root->label){
+        case Num:
+        case Character:
+            record(state, NT_IMM, R_CONST, 0);
+            break;
+        case Variable:
+            label_variable(ctx, state);
+            break;
+        case Addsub:
+            if(!SECONDCHILD(root)){
+                state->kids[0] = label_tree(ctx, FIRSTCHILD(root));
+                record(state, NT_REG, R_UNARY, state->kids[0]->cost[NT_REG] + (root->ident[0] == '-'));
+                break;
+            }
+            label_operator(ctx, state);
+            break;
+        case Divstar:
+        case Eq:
+        case Order:
+            label_operator(ctx, state);
+            break;
+        case Not:
+            state->kids[0] = label_tree(ctx, FIRSTCHILD(root));
+            record(state, NT_REG, R_NOT, state->kids[0]->cost[NT_REG] + 3);
+            break;
+        default:
+            break;
+    }
+    record(state, NT_REG, R_LOAD_IMM, state->cost[NT_IMM] + 1);
+    record(state, NT_REG, R_LOAD_MEM, state->cost[NT_MEM] + 1);
+    if(state->cost[NT_REG] >= BURS_INFINITE)
+        record(state, NT_REG, R_STACK, STACK_COST);
+    return state;
+}
+
+static void free_state(BursState *state){
+    if(!state)
+        return;
+    free_state(state->kids[0]);
+    free_state(state->kids[1]);
+    free(state);
+}
+
+static char *format_address(char *buffer, const char *base, long displacement, const char *index, int scale){
+    int length = sprintf(buffer, "[%s", base);
+    if(displacement)
+        length += sprintf(buffer + length, " %c %ld", displacement < 0 ? '-' : '+', labs(displacement));
+    if(index)
+        length += sprintf(buffer + length, " + %s * %d", index, scale);
+    sprintf(buffer + length, "]");
+    return buffer;
+}
+
+/**
+ * @brief Writes the computation of the address of an access, and gives the address.
+ * @param reg Register receiving the variable part of the index, the next one receiving the
+ * address of an array parameter.
+ */
+static char *emit_address(BursCtx *ctx, BursState *state, int reg, char *buffer){
+    Access *access = &state->access;
+    const char *index = NULL;
+    int scale = access->size;
+    if(access->pointer){
+        fprintf(ctx->file, "mov %s, [rbp - %d]\n", regs64[reg], ctx->iv_frame + 8 * (access->pointer->slot + 1));
+        return format_address(buffer, regs64[reg], access->displacement * access->pointer->stride, NULL, 0);
+    }
+    if(state->kids[0]){
+        emit_reg(ctx, state->kids[0], reg);
+        index = regs64[reg++];
+    }
+    switch(access->kind){
+        case IV_GLOBAL:
+            return format_address(buffer, "global_vars", access->var->deplct + access->displacement * scale, index, scale);
+        case IV_PARAM:
+            if(FIRSTCHILD(state->node)->label == Ident)
+                return format_address(buffer, "rbp", access->var->deplct, NULL, 0);
+            fprintf(ctx->file, "mov %s, [rbp + %d]\n", regs64[reg], access->var->deplct);
+            return format_address(buffer, regs64[reg], access->displacement * scale, index, scale);
+        default:
+            return format_address(buffer, "rbp", access->displacement * scale - access->var->deplct, index, scale);
+    }
+}
+
+static void emit_load(BursCtx *ctx, BursState *state, int reg){
+    char address[64];
+    emit_address(ctx, state, reg, address);
+    switch(state->access.load){
+        case LOAD_QWORD:
+            fprintf(ctx->file, "mov %s, qword %s\n", regs64[reg], address);
+            break;
+        case LOAD_SEXT32:
+            fprintf(ctx->file, "movsx %s, dword %s\n", regs64[reg], address);
+            break;
+        default:
+            fprintf(ctx->file, "movsx %s, byte %s\n", regs64[reg], address);
+    }
+}
+
+/**
+ * @brief Gives the memory operand of a scalar derived as mem.
+ */
+static char *memory_operand(BursCtx *ctx, BursState *state, char *buffer){
+    char address[64];
+    emit_address(ctx, state, 0, address);
+    sprintf(buffer, "qword %s", address);
+    return buffer;
+}
+
+static void emit_constant(BursCtx *ctx, long value, int reg){
+    if(!value)
+        fprintf(ctx->file, "xor %s, %s\n", regs32[reg], regs32[reg]);
+    else if(value > 0)
+        fprintf(ctx->file, "mov %s, %ld\n", regs32[reg], value);
+    else
+        fprintf(ctx->file, "mov %s, %ld\n", regs64[reg], value);
+}
+
+/**
+ * @brief Writes the save of the registers in use around the stack code of an expression.
+ */
+static void emit_stack(BursCtx *ctx, Node *root, int reg){
+    for(int i = 0; i < reg; ++i)
+        fprintf(ctx->file, "push %s\n", regs64[i]);
+    get_value(root, ctx->file, ctx->global_vars, NULL, NULL, ctx->functions, ctx->nb_functions, ctx->function_name);
+    fprintf(ctx->file, "pop %s\n", regs64[reg]);
+    for(int i = reg - 1; i >= 0; --i)
+        fprintf(ctx->file, "pop %s\n", regs64[i]);
+}
+
+static void emit_multiply(BursCtx *ctx, long value, int reg){
+    const char *r = regs64[reg];
+    if(value == 1)
+        return;
+    if(value == -1)
+        fprintf(ctx->file, "neg %s\n", r);
+    else if(value > 0 && !(value & (value - 1))){
+        int shift = 0;
+        while((1L << shift) != value)
+            shift++;
+        fprintf(ctx->file, "shl %s, %d\n", r, shift);
+    }
+    else if(value == 3 || value == 5 || value == 9)
+        fprintf(ctx->file, "lea %s, [%s + %s * %ld]\n", r, r, r, value - 1);
+    else
+        fprintf(ctx->file, "imul %s, %s, %ld\n", r, r, value);
+}
+
+/**
+ * @brief Writes a signed division, rax being exchanged with the register of the dividend.
+ */
+static void emit_division(BursCtx *ctx, int reg, const char *divisor, int remainder){
+    if(reg)
+        fprintf(ctx->file, "xchg rax, %s\n", regs64[reg]);
+    fprintf(ctx->file, "cqo\n");
+    fprintf(ctx->file, "idiv %s\n", divisor);
+    if(remainder)
+        fprintf(ctx->file, "mov rax, rdx\n");
+    if(reg)
+        fprintf(ctx->file, "xchg rax, %s\n", regs64[reg]);
+}
+
+/**
+ * @brief Writes an operator, its first operand being in a register.
+ * @param source Second operand: register, memory or immediate.
+ * @param imm The immediate operand, or NULL.
+ * @param swapped Flag telling if the operands are in the reverse order of the tree.
+ */
+static void emit_operation(BursCtx *ctx, Node *root, int reg, const char *source, Node *imm, int swapped){
+    const char *r = regs64[reg], *condition;
+    long value = imm ? imm_value(imm) : 0;
+    switch(root->label){
+        case Addsub:
+            if(imm && (value == 1 || value == -1))
+                fprintf(ctx->file, "%s %s\n", (root->ident[0] == '+') == (value == 1) ? "inc" : "dec", r);
+            else
+                fprintf(ctx->file, "%s %s, %s\n", root->ident[0] == '+' ? "add" : "sub", r, source);
+            break;
+        case Divstar:
+            if(root->ident[0] != '*')
+                emit_division(ctx, reg, source, root->ident[0] == '%');
+            else if(imm)
+                emit_multiply(ctx, value, reg);
+            else
+                fprintf(ctx->file, "imul %s, %s\n", r, source);
+            break;
+        default:
+            condition = operator_condition(root);
+            if(swapped)
+                condition = transform_condition(condition, 2);
+            if(imm && !value)
+                fprintf(ctx->file, "test %s, %s\n", r, r);
+            else
+                fprintf(ctx->file, "cmp %s, %s\n", r, source);
+            fprintf(ctx->file, "set%s %s\n", condition, regs8[reg]);
+            fprintf(ctx->file, "movzx %s, %s\n", regs32[reg], regs8[reg]);
+    }
+}
+
+/**
+ * @brief Gives the number of registers a rule uses from the register of its result.
+ */
+static int needed_registers(BursState *state){
+    if(state->rule[NT_REG] == R_OP_REG)
+        return 2;
+    if(state->rule[NT_REG] == R_LOAD && state->kids[0] && needs_base(state))
+        return 2;
+    return 1;
+}
+
+/**
+ * @brief Writes the derivation of an expression as reg into a register, the lower ones being in use.
+ */
+static void emit_reg(BursCtx *ctx, BursState *state, int reg){
+    Node *root = state->node;
+    BursState *left = state->kids[0], *right = state->kids[1];
+    char source[80];
+    if(reg + needed_registers(state) > BURS_NB_REGS){
+        emit_stack(ctx, root, reg);
+        return;
+    }
+    switch(state->rule[NT_REG]){
+        case R_LOAD_IMM:
+            emit_constant(ctx, imm_value(root), reg);
+            break;
+        case R_LOAD_MEM:
+            fprintf(ctx->file, "mov %s, %s\n", regs64[reg], memory_operand(ctx, state, source));
+            break;
+        case R_LOAD:
+            emit_load(ctx, state, reg);
+            break;
+        case R_UNARY:
+            emit_reg(ctx, left, reg);
+            if(root->ident[0] == '-')
+                fprintf(ctx->file, "neg %s\n", regs64[reg]);
+            break;
+        case R_NOT:
+            emit_reg(ctx, left, reg);
+            fprintf(ctx->file, "test %s, %s\n", regs64[reg], regs64[reg]);
+            fprintf(ctx->file, "sete %s\n", regs8[reg]);
+            fprintf(ctx->file, "movzx %s, %s\n", regs32[reg], regs8[reg]);
+            break;
+        case R_OP_REG:
+            emit_reg(ctx, left, reg);
+            emit_reg(ctx, right, reg + 1);
+            emit_operation(ctx, root, reg, regs64[reg + 1], NULL, 0);
+            break;
+        case R_OP_MEM:
+            emit_reg(ctx, left, reg);
+            emit_operation(ctx, root, reg, memory_operand(ctx, right, source), NULL, 0);
+            break;
+        case R_OP_IMM:
+            emit_reg(ctx, left, reg);
+            sprintf(source, "%ld", imm_value(right->node));
+            emit_operation(ctx, root, reg, source, right->node, 0);
+            break;
+        case R_SWAP_MEM:
+            emit_reg(ctx, right, reg);
+            emit_operation(ctx, root, reg, memory_operand(ctx, left, source), NULL, 1);
+            break;
+        case R_SWAP_IMM:
+            emit_reg(ctx, right, reg);
+            sprintf(source, "%ld", imm_value(left->node));
+            emit_operation(ctx, root, reg, source, left->node, 1);
+            break;
+        default:
+            emit_stack(ctx, root, reg);
+    }
+}
+
+/**
+ * @brief Writes the computation of an expression into rax.
+ * @return 0 if the expression is left to the stack code, nothing being written.
+ */
+int select_value(Node *root, FILE *file, IvLoop *iv_loops, int iv_frame, SymTabs *global_vars, SymTabsFct **functions,
+    int nb_functions, char *function_name){
+    BursCtx ctx = make_ctx(file, iv_loops, iv_frame, global_vars, functions, nb_functions, function_name);
+    BursState *state = label_tree(&ctx, root);
+    int selected = state->rule[NT_REG] != R_STACK;
+    if(selected)
+        emit_reg(&ctx, state, 0);
+    free_state(state);
+    return selected;
+}
+
+/**
+ * @brief Gives the operand of an assignment like v = v + e, v = e + v or v = v - e, or NULL.
+ */
+static Node *update_operand(Node *root){
+    Node *value = unwrap(SECONDCHILD(root));
+    if(value->label != Addsub || !SECONDCHILD(value))
+        return NULL;
+    if(same_expr(FIRSTCHILD(value), FIRSTCHILD(root)))
+        return SECONDCHILD(value);
+    if(value->ident[0] == '+' && same_expr(SECONDCHILD(value), FIRSTCHILD(root)))
+        return FIRSTCHILD(value);
+    return NULL;
+}
+
+/**
+ * @brief Writes an assignment like v = v + e as an operation on memory, at the width the
+ * variable is read with: the bytes above it are never read back.
+ */
+static void emit_update(BursCtx *ctx, BursState *target, Node *root, Node *operand){
+    BursState *state = label_tree(ctx, operand);
+    int size = load_size(target->access.load), add = unwrap(SECONDCHILD(root))->ident[0] == '+', reg = 0;
+    char address[64];
+    if(state->cost[NT_IMM] > 0){
+        emit_reg(ctx, state, 0);
+        reg = 1;
+    }
+    emit_address(ctx, target, reg, address);
+    if(reg)
+        fprintf(ctx->file, "%s %s %s, %s\n", add ? "add" : "sub", size_name(size), address, sized_reg(0, size));
+    else if(imm_value(state->node) == 1 || imm_value(state->node) == -1)
+        fprintf(ctx->file, "%s %s %s\n", add == (imm_value(state->node) == 1) ? "inc" : "dec", size_name(size), address);
+    else
+        fprintf(ctx->file, "%s %s %s, %ld\n", add ? "add" : "sub", size_name(size), address,
+            size == 1 ? (long)(signed char)imm_value(state->node) : imm_value(state->node));
+    free_state(state);
+}
+
+/**
+ * @brief Writes an assignment: the value is stored from an immediate or a register, or the
+ * variable is updated in memory.
+ * @return 0 if the target isn't a variable known by the selection, nothing being written.
+ */
+int select_assignment(Node *root, FILE *file, IvLoop *iv_loops, int iv_frame, SymTabs *global_vars,
+    SymTabsFct **functions, int nb_functions, char *function_name){
+    BursCtx ctx = make_ctx(file, iv_loops, iv_frame, global_vars, functions, nb_functions, function_name);
+    BursState *target = label_tree(&ctx, FIRSTCHILD(root)), *value;
+    Node *operand = update_operand(root);
+    char address[64], source[32];
+    int reg = 0, size = target->access.size;
+    if(target->rule[NT_REG] == R_STACK){
+        free_state(target);
+        return 0;
+    }
+    if(operand && !has_call(operand) && !(target->access.index && has_call(target->access.index))){
+        emit_update(&ctx, target, root, operand);
+        free_state(target);
+        return 1;
+    }
+    value = label_tree(&ctx, SECONDCHILD(root));
+    if(value->cost[NT_IMM] == 0)
+        sprintf(source, "%ld", size == 1 ? (long)(signed char)imm_value(value->node) : imm_value(value->node));
+    else{
+        emit_reg(&ctx, value, 0);
+        sprintf(source, "%s", sized_reg(0, size));
+        reg = 1;
+    }
+    emit_address(&ctx, target, reg, address);
+    fprintf(file, "mov %s %s, %s\n", size_name(size), address, source);
+    free_state(value);
+    free_state(target);
+    return 1;
+}
+
+/**
+ * @brief Gives the size of the memory operand of a variable compared with an immediate, 0 if the
+ * variable must be loaded.
+ */
+static int compared_size(BursState *state, long imm){
+    if(state->rule[NT_MEM] == R_SCALAR)
+        return 8;
+    if(state->rule[NT_REG] != R_LOAD)
+        return 0;
+    if(state->access.load == LOAD_SEXT8 && (imm < -128 || imm > 127))
+        return 0;
+    return load_size(state->access.load);
+}
+
+/**
+ * @brief Writes the comparison of two operands and the jump taken when it holds, choosing the
+ * cheapest of the memory, immediate and register forms.
+ */
+static void emit_compare(BursCtx *ctx, BursState *left, BursState *right, const char *condition, char *label){
+    BursState *first, *second;
+    char source[80];
+    int costs[4], best = 0;
+    // Memory form then register form, with the operands in order then swapped.
+    for(int i = 0; i < 2; ++i){
+        BursState *a = i ? right : left, *b = i ? left : right;
+        int imm = b->cost[NT_IMM] == 0, mem = b->cost[NT_MEM] == 0;
+        costs[2 * i] = imm && compared_size(a, imm_value(b->node)) ? address_cost(a) + 1 : BURS_INFINITE;
+        costs[2 * i + 1] = a->cost[NT_REG] + 1 + (imm || mem ? 0 : b->cost[NT_REG]);
+        if(i && !imm && !mem)
+            costs[2 * i + 1] = BURS_INFINITE;
+    }
+    for(int i = 1; i < 4; ++i)
+        if(costs[i] < costs[best])
+            best = i;
+    first = best < 2 ? left : right;
+    second = best < 2 ? right : left;
+    if(best >= 2)
+        condition = transform_condition(condition, 2);
+    if(best % 2 == 0){
+        long imm = imm_value(second->node);
+        emit_address(ctx, first, 0, source);
+        fprintf(ctx->file, "cmp %s %s, %ld\n", size_name(compared_size(first, imm)), source, imm);
+    }
+    else{
+        emit_reg(ctx, first, 0);
+        if(second->cost[NT_IMM] == 0 && !imm_value(second->node))
+            fprintf(ctx->file, "test rax, rax\n");
+        else if(second->cost[NT_IMM] == 0)
+            fprintf(ctx->file, "cmp rax, %ld\n", imm_value(second->node));
+        else if(second->cost[NT_MEM] == 0)
+            fprintf(ctx->file, "cmp rax, %s\n", memory_operand(ctx, second, source));
+        else{
+            emit_reg(ctx, second, 1);
+            fprintf(ctx->file, "cmp rax, rcx\n");
+        }
+    }
+    fprintf(ctx->file, "j%s %s\n", condition, label);
+}
+
+static void emit_branch(BursCtx *ctx, Node *root, char *label, int when){
+    static Node zero = {.label = Num, .num = 0};
+    BursState *left, *right;
+    root = unwrap(root);
+    switch(root->label){
+        case Num:
+        case Character:
+            if((imm_value(root) != 0) == when)
+                fprintf(ctx->file, "jmp %s\n", label);
+            return;
+        case Not:
+            emit_branch(ctx, FIRSTCHILD(root), label, !when);
+            return;
+        case And:
+        case Or:
+            if(has_call(SECONDCHILD(root)))
+                break;
+            if((root->label == And) != when){
+                emit_branch(ctx, FIRSTCHILD(root), label, when);
+                emit_branch(ctx, SECONDCHILD(root), label, when);
+            }
+            else{
+                char *skip = create_label();
+                emit_branch(ctx, FIRSTCHILD(root), skip, !when);
+                emit_branch(ctx, SECONDCHILD(root), label, when);
+                fprintf(ctx->file, "%s:\n", skip);
+                free(skip);
+            }
+            return;
+        case Eq:
+        case Order:
+            left = label_tree(ctx, FIRSTCHILD(root));
+            right = label_tree(ctx, SECONDCHILD(root));
+            emit_compare(ctx, left, right, transform_condition(operator_condition(root), when ? 0 : 1), label);
+            free_state(left);
+            free_state(right);
+            return;
+        default:
+            break;
+    }
+    left = label_tree(ctx, root);
+    right = label_tree(ctx, &zero);
+    emit_compare(ctx, left, right, when ? "ne" : "e", label);
+    free_state(left);
+    free_state(right);
+}
+
+/**
+ * @brief Writes a jump to a label taken when a condition is true, or false, comparing its operands
+ * directly. The logical operators jump as soon as their value is known when their second operand
+ * calls no function, which the stack code would call anyway.
+ * @param when 1 to jump when the condition holds, 0 to jump when it doesn't.
+ */
+void select_branch(Node *root, FILE *file, char *label, int when, IvLoop *iv_loops, int iv_frame,
+    SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
+    BursCtx ctx = make_ctx(file, iv_loops, iv_frame, global_vars, functions, nb_functions, function_name);
+    emit_branch(&ctx, root, label, when);
+}
@@ -0,0 +1,21 @@
+/**
+ * @file burs.h
+ * @brief Instruction selection by tree pattern matching on the expressions and the assignments.
+ */
+
+#ifndef __BURS__H
+#define __BURS__H
+
+#include "compile.h"
+#include "ivsr.h"
+
+#define BURS_NB_REGS 8       ///< Registers holding the operands of an expression: rax, rcx, rsi, rdi and r8 to r11.
+#define BURS_INFINITE 1000000 ///< Cost of a nonterminal that no rule derives.
+
+int select_value(Node *root, FILE *file, IvLoop *iv_loops, int iv_frame, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name); ///< Function to write the computation of an expression into rax, unless the stack code must write it.
+
+int select_assignment(Node *root, FILE *file, IvLoop *iv_loops, int iv_frame, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name); ///< Function to write an assignment.
+
+void select_branch(Node *root, FILE *file, char *label, int when, IvLoop *iv_loops, int iv_frame, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name); ///< Function to write a jump to a label taken when a condition is true, or false.
+
+#endif
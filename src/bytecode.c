@@ -0,0 +1,617 @@
+#include "bytecode.h"
+#include "frame.h"
+
+#define BC_REGISTER 0 ///< Scalar held by a register of the frame: a parameter or a local variable.
+#define BC_GLOBAL 1   ///< Global scalar, read and written in the memory of the global variables.
+#define BC_ARRAY 2    ///< Array whose address is held by a register of the frame.
+
+/**
+ * @brief Number of operands of each instruction, BC_PUTS having its characters too.
+ */
+static const int nb_operands[BC_OPCODES] = {
+    [BC_MOVE] = 2, [BC_CONST] = 2, [BC_ADD] = 3, [BC_SUB] = 3, [BC_MUL] = 3, [BC_DIV] = 3, [BC_MOD] = 3,
+    [BC_ADDK] = 3, [BC_MULK] = 3, [BC_NEG] = 2, [BC_NOT] = 2,
+    [BC_EQ] = 3, [BC_NE] = 3, [BC_LT] = 3, [BC_LE] = 3, [BC_GT] = 3, [BC_GE] = 3,
+    [BC_JMP] = 1, [BC_JZ] = 2, [BC_JNZ] = 2,
+    [BC_JEQ] = 3, [BC_JNE] = 3, [BC_JLT] = 3, [BC_JLE] = 3, [BC_JGT] = 3, [BC_JGE] = 3,
+    [BC_JEQK] = 3, [BC_JNEK] = 3, [BC_JLTK] = 3, [BC_JLEK] = 3, [BC_JGTK] = 3, [BC_JGEK] = 3,
+    [BC_LDGI] = 2, [BC_LDGC] = 2, [BC_STGI] = 2, [BC_STGC] = 2,
+    [BC_LDI] = 3, [BC_LDC] = 3, [BC_STI] = 3, [BC_STC] = 3, [BC_LDIK] = 3, [BC_LDCK] = 3, [BC_STIK] = 3, [BC_STCK] = 3,
+    [BC_FRAME] = 2, [BC_CALL] = 3, [BC_RET] = 1, [BC_RET0] = 0,
+    [BC_GETCHAR] = 1, [BC_GETINT] = 1, [BC_PUTCHAR] = 1, [BC_PUTINT] = 1, [BC_PUTS] = 1
+};
+
+static const int inverse_comparison[] = {1, 0, 5, 4, 3, 2}; ///< Comparison holding when one of ==, !=, <, <=, >, >= doesn't.
+static const int mirror_comparison[] = {0, 1, 4, 5, 2, 3};  ///< Comparison holding with the operands swapped.
+
+/**
+ * @brief Storage of a variable seen from the function being translated.
+ */
+typedef struct{
+    char *name;    ///< Name of the variable.
+    int kind;      ///< BC_REGISTER, BC_GLOBAL or BC_ARRAY.
+    int reg;       ///< Register of the scalar or of the address of the array, -1 for a global scalar.
+    int is_int;    ///< Flag telling if the variable or its elements are int.
+    char *address; ///< Address of a global variable.
+}BcVar;
+
+/**
+ * @brief State of the translation.
+ *
+ * The registers of a frame are the parameters, then the local scalars, the addresses of the
+ * arrays and the temporaries, allocated like a stack: a value computed in a temporary takes the
+ * first free register, and the registers above it are free again once it's used. The arguments
+ * of a call are the last temporaries, so that they are the first registers of the frame of the
+ * called function.
+ */
+typedef struct{
+    Bytecode *program;
+    BcVar *globals;        ///< Global variables of the program.
+    int nb_globals;        ///< Number of global variables.
+    BcVar *vars;           ///< Global arrays used, parameters and local variables of the current function.
+    int nb_vars;           ///< Number of variables of the current function.
+    int nb_fixed;          ///< Registers of the variables, below the temporaries.
+    int top;               ///< First free register.
+    int nb_registers;      ///< Registers used so far by the current function.
+    long *labels;          ///< Offset of each label of the current function, -1 until it's placed.
+    int nb_labels;         ///< Number of labels.
+    long *fixups;          ///< Offsets of the jump targets, holding the number of their label until it's placed.
+    int nb_fixups;         ///< Number of jump targets.
+}BcCtx;
+
+int bytecode_operands(long *code){
+    if(code[0] == BC_PUTS)
+        return 1 + (code[1] + 7) / 8;
+    return nb_operands[code[0]];
+}
+
+static Node *unwrap(Node *root){
+    while(root->label == Expression)
+        root = FIRSTCHILD(root);
+    return root;
+}
+
+static int constant_value(Node *root, long *value){
+    root = unwrap(root);
+    if(root->label == Num)
+        *value = root->num;
+    else if(root->label == Character)
+        *value = character_value(root);
+    else
+        return 0;
+    return 1;
+}
+
+static int has_call(Node *root){
+    if(root->label == Function)
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(has_call(child))
+            return 1;
+    return 0;
+}
+
+static int comparison(Node *root){
+    static char *operators[] = {"==", "!=", "<", "<=", ">", ">="};
+    int res = 0;
+    while(res < 5 && strcmp(operators[res], root->ident))
+        res++;
+    return res;
+}
+
+static long *reserve(Bytecode *program, int nb_words){
+    long *res;
+    if(program->size + nb_words > program->capacity){
+        program->capacity = max(program->capacity * 2, program->size + nb_words + 256);
+        program->code = (long*) try(realloc(program->code, sizeof(long) * program->capacity), NULL);
+    }
+    res = program->code + program->size;
+    program->size += nb_words;
+    return res;
+}
+
+static void emit(BcCtx *ctx, BcOpcode opcode, long a, long b, long c){
+    long operands[3] = {a, b, c}, *code = reserve(ctx->program, 1 + nb_operands[opcode]);
+    code[0] = opcode;
+    for(int i = 0; i < nb_operands[opcode]; ++i)
+        code[i + 1] = operands[i];
+}
+
+static int new_label(BcCtx *ctx){
+    ctx->labels = (long*) try(realloc(ctx->labels, sizeof(long) * (ctx->nb_labels + 1)), NULL);
+    ctx->labels[ctx->nb_labels] = -1;
+    return ctx->nb_labels++;
+}
+
+static void place_label(BcCtx *ctx, int label){
+    ctx->labels[label] = ctx->program->size;
+}
+
+/**
+ * @brief Writes a jump, its target being the last operand, given by a label.
+ */
+static void emit_jump(BcCtx *ctx, BcOpcode opcode, long a, long b, int label){
+    if(opcode == BC_JMP)
+        emit(ctx, opcode, label, 0, 0);
+    else if(opcode == BC_JZ || opcode == BC_JNZ)
+        emit(ctx, opcode, a, label, 0);
+    else
+        emit(ctx, opcode, a, b, label);
+    ctx->fixups = (long*) try(realloc(ctx->fixups, sizeof(long) * (ctx->nb_fixups + 1)), NULL);
+    ctx->fixups[ctx->nb_fixups++] = ctx->program->size - 1;
+}
+
+static int new_temp(BcCtx *ctx){
+    ctx->nb_registers = max(ctx->nb_registers, ctx->top + 1);
+    return ctx->top++;
+}
+
+static int result_register(BcCtx *ctx, int dest){
+    return dest >= 0 ? dest : new_temp(ctx);
+}
+
+static int move_to(BcCtx *ctx, int reg, int dest){
+    if(dest < 0 || dest == reg)
+        return reg;
+    emit(ctx, BC_MOVE, dest, reg, 0);
+    return dest;
+}
+
+static void add_var(BcCtx *ctx, char *name, int kind, int reg, int is_int, char *address){
+    ctx->vars = (BcVar*) try(realloc(ctx->vars, sizeof(BcVar) * (ctx->nb_vars + 1)), NULL);
+    ctx->vars[ctx->nb_vars++] = (BcVar){name, kind, reg, is_int, address};
+}
+
+static BcVar *find_global(BcCtx *ctx, char *name){
+    for(int i = 0; i < ctx->nb_globals; ++i)
+        if(!strcmp(ctx->globals[i].name, name))
+            return &ctx->globals[i];
+    return NULL;
+}
+
+/**
+ * @brief Finds a variable like the native code: the globals first, then the parameters and the
+ * local variables.
+ */
+static BcVar *find_var(BcCtx *ctx, char *name){
+    BcVar *global = find_global(ctx, name);
+    if(global && global->kind == BC_GLOBAL)
+        return global;
+    for(int i = 0; i < ctx->nb_vars; ++i)
+        if(!strcmp(ctx->vars[i].name, name))
+            return &ctx->vars[i];
+    fprintf(stderr, "Bytecode error: unknown variable %s\n", name);
+    exit(EXIT_ERROR);
+}
+
+static int find_function(Bytecode *program, char *name){
+    for(int i = 0; i < program->nb_functions; ++i)
+        if(!strcmp(program->functions[i].name, name))
+            return i;
+    return -1;
+}
+
+static int compile_expr(BcCtx *ctx, Node *root, int dest);
+
+static void compile_branch(BcCtx *ctx, Node *root, int label, int when);
+
+/**
+ * @brief Translates a call, of a builtin or of a function of the program.
+ * @param dest Register of the value, -1 for any temporary.
+ * @return The register of the value, -1 for putchar and putint.
+ */
+static int compile_call(BcCtx *ctx, Node *root, int dest){
+    char *function_name = FIRSTCHILD(root)->ident;
+    Node *args = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root)));
+    int saved = ctx->top, nb_args = 0, reg;
+    for(Node *arg = args; arg && arg->label != Void; arg = arg->nextSibling)
+        nb_args++;
+    if(!strcmp(function_name, "getchar") || !strcmp(function_name, "getint")){
+        reg = result_register(ctx, dest);
+        emit(ctx, function_name[3] == 'c' ? BC_GETCHAR : BC_GETINT, reg, 0, 0);
+        return reg;
+    }
+    if(!strcmp(function_name, "putchar") && nb_args > 1){
+        long *code = reserve(ctx->program, 2 + (nb_args + 7) / 8);
+        char *characters = (char*) (code + 2);
+        long value;
+        code[0] = BC_PUTS;
+        code[1] = nb_args;
+        memset(characters, 0, (nb_args + 7) / 8 * 8);
+        for(Node *arg = args; arg; arg = arg->nextSibling)
+            if(constant_value(arg, &value))
+                *characters++ = value;
+        return -1;
+    }
+    if(!strcmp(function_name, "putchar") || !strcmp(function_name, "putint")){
+        reg = compile_expr(ctx, args, -1);
+        emit(ctx, function_name[3] == 'c' ? BC_PUTCHAR : BC_PUTINT, reg, 0, 0);
+        ctx->top = saved;
+        return -1;
+    }
+    for(Node *arg = args; arg && arg->label != Void; arg = arg->nextSibling)
+        compile_expr(ctx, arg, new_temp(ctx));
+    ctx->top = saved;
+    reg = result_register(ctx, dest);
+    emit(ctx, BC_CALL, find_function(ctx->program, function_name), saved, reg);
+    return reg;
+}
+
+static int compile_read(BcCtx *ctx, Node *root, int dest){
+    Node *target = FIRSTCHILD(root), *index;
+    int saved = ctx->top, reg, index_reg;
+    BcVar *var;
+    long value;
+    if(target->label == Ident){
+        var = find_var(ctx, target->ident);
+        if(var->kind != BC_GLOBAL)
+            return move_to(ctx, var->reg, dest);
+        reg = result_register(ctx, dest);
+        emit(ctx, var->is_int ? BC_LDGI : BC_LDGC, reg, (long) var->address, 0);
+        return reg;
+    }
+    var = find_var(ctx, FIRSTCHILD(target)->ident);
+    index = FIRSTCHILD(FIRSTCHILD(target));
+    if(constant_value(index, &value)){
+        reg = result_register(ctx, dest);
+        emit(ctx, var->is_int ? BC_LDIK : BC_LDCK, reg, var->reg, value);
+        return reg;
+    }
+    index_reg = compile_expr(ctx, index, -1);
+    ctx->top = saved;
+    reg = result_register(ctx, dest);
+    emit(ctx, var->is_int ? BC_LDI : BC_LDC, reg, var->reg, index_reg);
+    return reg;
+}
+
+static int compile_binary(BcCtx *ctx, Node *root, int dest){
+    int saved = ctx->top, reg, left, right;
+    long value;
+    BcOpcode opcode;
+    if(root->label == Eq || root->label == Order)
+        opcode = BC_EQ + comparison(root);
+    else if(root->label == Addsub)
+        opcode = root->ident[0] == '+' ? BC_ADD : BC_SUB;
+    else
+        opcode = root->ident[0] == '*' ? BC_MUL : root->ident[0] == '/' ? BC_DIV : BC_MOD;
+    if((opcode == BC_ADD || opcode == BC_SUB || opcode == BC_MUL) && constant_value(SECONDCHILD(root), &value)){
+        left = compile_expr(ctx, FIRSTCHILD(root), -1);
+        ctx->top = saved;
+        reg = result_register(ctx, dest);
+        emit(ctx, opcode == BC_MUL ? BC_MULK : BC_ADDK, reg, left, opcode == BC_SUB ? -value : value);
+        return reg;
+    }
+    if((opcode == BC_ADD || opcode == BC_MUL) && constant_value(FIRSTCHILD(root), &value)){
+        right = compile_expr(ctx, SECONDCHILD(root), -1);
+        ctx->top = saved;
+        reg = result_register(ctx, dest);
+        emit(ctx, opcode == BC_MUL ? BC_MULK : BC_ADDK, reg, right, value);
+        return reg;
+    }
+    left = compile_expr(ctx, FIRSTCHILD(root), -1);
+    right = compile_expr(ctx, SECONDCHILD(root), -1);
+    ctx->top = saved;
+    reg = result_register(ctx, dest);
+    emit(ctx, opcode, reg, left, right);
+    return reg;
+}
+
+/**
+ * @brief Translates an expression.
+ * @param dest Register that must receive the value, -1 for any register.
+ * @return The register holding the value: dest, the register of a variable, or a temporary
+ * allocated at the first free register.
+ */
+static int compile_expr(BcCtx *ctx, Node *root, int dest){
+    int saved = ctx->top, reg, operand, label;
+    long value;
+    root = unwrap(root);
+    if(constant_value(root, &value)){
+        reg = result_register(ctx, dest);
+        emit(ctx, BC_CONST, reg, value, 0);
+        return reg;
+    }
+    switch(root->label){
+        case Variable:
+            return compile_read(ctx, root, dest);
+        case Function:
+            return compile_call(ctx, root, dest);
+        case Not:
+        case Addsub:
+            if(root->label == Addsub && SECONDCHILD(root))
+                return compile_binary(ctx, root, dest);
+            if(root->label == Addsub && root->ident[0] == '+')
+                return compile_expr(ctx, FIRSTCHILD(root), dest);
+            operand = compile_expr(ctx, FIRSTCHILD(root), -1);
+            ctx->top = saved;
+            reg = result_register(ctx, dest);
+            emit(ctx, root->label == Not ? BC_NOT : BC_NEG, reg, operand, 0);
+            return reg;
+        case And:
+        case Or:
+            reg = new_temp(ctx);
+            label = new_label(ctx);
+            emit(ctx, BC_CONST, reg, 0, 0);
+            compile_branch(ctx, root, label, 0);
+            emit(ctx, BC_CONST, reg, 1, 0);
+            place_label(ctx, label);
+            ctx->top = saved + 1;
+            if(dest < 0)
+                return reg;
+            ctx->top = saved;
+            return move_to(ctx, reg, dest);
+        default:
+            return compile_binary(ctx, root, dest);
+    }
+}
+
+/**
+ * @brief Translates a condition as a jump.
+ *
+ * Like the native code, the second operand of a && or a || is only evaluated when needed if it
+ * has no call, both operands being evaluated otherwise.
+ * @param label Label of the jump.
+ * @param when 1 to jump when the condition holds, 0 when it doesn't.
+ */
+static void compile_branch(BcCtx *ctx, Node *root, int label, int when){
+    int saved = ctx->top, left, right, skip, cmp;
+    long value;
+    root = unwrap(root);
+    if(constant_value(root, &value)){
+        if((value != 0) == when)
+            emit_jump(ctx, BC_JMP, 0, 0, label);
+        return;
+    }
+    switch(root->label){
+        case Not:
+            compile_branch(ctx, FIRSTCHILD(root), label, !when);
+            return;
+        case And:
+        case Or:
+            if(!has_call(SECONDCHILD(root))){
+                if((root->label == And) != when){
+                    compile_branch(ctx, FIRSTCHILD(root), label, when);
+                    compile_branch(ctx, SECONDCHILD(root), label, when);
+                }
+                else{
+                    skip = new_label(ctx);
+                    compile_branch(ctx, FIRSTCHILD(root), skip, !when);
+                    compile_branch(ctx, SECONDCHILD(root), label, when);
+                    place_label(ctx, skip);
+                }
+                return;
+            }
+            left = compile_expr(ctx, FIRSTCHILD(root), -1);
+            right = compile_expr(ctx, SECONDCHILD(root), -1);
+            if((root->label == And) != when){
+                emit_jump(ctx, when ? BC_JNZ : BC_JZ, left, 0, label);
+                emit_jump(ctx, when ? BC_JNZ : BC_JZ, right, 0, label);
+            }
+            else{
+                skip = new_label(ctx);
+                emit_jump(ctx, when ? BC_JZ : BC_JNZ, left, 0, skip);
+                emit_jump(ctx, when ? BC_JNZ : BC_JZ, right, 0, label);
+                place_label(ctx, skip);
+            }
+            break;
+        case Eq:
+        case Order:
+            cmp = when ? comparison(root) : inverse_comparison[comparison(root)];
+            if(constant_value(SECONDCHILD(root), &value)){
+                left = compile_expr(ctx, FIRSTCHILD(root), -1);
+                emit_jump(ctx, BC_JEQK + cmp, left, value, label);
+            }
+            else if(constant_value(FIRSTCHILD(root), &value)){
+                right = compile_expr(ctx, SECONDCHILD(root), -1);
+                emit_jump(ctx, BC_JEQK + mirror_comparison[cmp], right, value, label);
+            }
+            else{
+                left = compile_expr(ctx, FIRSTCHILD(root), -1);
+                right = compile_expr(ctx, SECONDCHILD(root), -1);
+                emit_jump(ctx, BC_JEQ + cmp, left, right, label);
+            }
+            break;
+        default:
+            left = compile_expr(ctx, root, -1);
+            emit_jump(ctx, when ? BC_JNZ : BC_JZ, left, 0, label);
+            break;
+    }
+    ctx->top = saved;
+}
+
+static void compile_assignment(BcCtx *ctx, Node *root){
+    Node *target = FIRSTCHILD(FIRSTCHILD(root)), *index;
+    BcVar *var;
+    int value_reg;
+    long value;
+    if(target->label == Ident){
+        var = find_var(ctx, target->ident);
+        if(var->kind == BC_REGISTER){
+            compile_expr(ctx, SECONDCHILD(root), var->reg);
+            return;
+        }
+        value_reg = compile_expr(ctx, SECONDCHILD(root), -1);
+        emit(ctx, var->is_int ? BC_STGI : BC_STGC, (long) var->address, value_reg, 0);
+        return;
+    }
+    var = find_var(ctx, FIRSTCHILD(target)->ident);
+    index = FIRSTCHILD(FIRSTCHILD(target));
+    value_reg = compile_expr(ctx, SECONDCHILD(root), -1);
+    if(constant_value(index, &value))
+        emit(ctx, var->is_int ? BC_STIK : BC_STCK, var->reg, value, value_reg);
+    else
+        emit(ctx, var->is_int ? BC_STI : BC_STC, var->reg, compile_expr(ctx, index, -1), value_reg);
+}
+
+/**
+ * @brief Translates an instruction, or every instruction of a block.
+ */
+static void compile_stmt(BcCtx *ctx, Node *root){
+    int else_label, end_label, body_label, cond_label;
+    if(!root)
+        return;
+    ctx->top = ctx->nb_fixed;
+    switch(root->label){
+        case Instructions:
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+                compile_stmt(ctx, current);
+            break;
+        case Equals:
+            compile_assignment(ctx, root);
+            break;
+        case If:
+            else_label = new_label(ctx);
+            compile_branch(ctx, FIRSTCHILD(root), else_label, 0);
+            compile_stmt(ctx, SECONDCHILD(root));
+            if(SECONDCHILD(root) && THIRDCHILD(root)){
+                end_label = new_label(ctx);
+                emit_jump(ctx, BC_JMP, 0, 0, end_label);
+                place_label(ctx, else_label);
+                compile_stmt(ctx, THIRDCHILD(root));
+                place_label(ctx, end_label);
+            }
+            else
+                place_label(ctx, else_label);
+            break;
+        case While:
+            body_label = new_label(ctx);
+            cond_label = new_label(ctx);
+            emit_jump(ctx, BC_JMP, 0, 0, cond_label);
+            place_label(ctx, body_label);
+            compile_stmt(ctx, SECONDCHILD(root));
+            place_label(ctx, cond_label);
+            compile_branch(ctx, FIRSTCHILD(root), body_label, 1);
+            break;
+        case Return:
+            if(FIRSTCHILD(root)->label == Void)
+                emit(ctx, BC_RET0, 0, 0, 0);
+            else
+                emit(ctx, BC_RET, compile_expr(ctx, FIRSTCHILD(root), -1), 0, 0);
+            break;
+        case Function:
+            compile_call(ctx, root, -1);
+            break;
+        default:
+            break;
+    }
+    ctx->top = ctx->nb_fixed;
+}
+
+/**
+ * @brief Gives a register to each global array used by a function, holding its address.
+ */
+static void collect_global_arrays(BcCtx *ctx, Node *root){
+    for(; root; root = root->nextSibling){
+        if(root->label == Variable){
+            char *var_name = FIRSTCHILD(root)->label == Array ? FIRSTCHILD(FIRSTCHILD(root))->ident : FIRSTCHILD(root)->ident;
+            BcVar *global = find_global(ctx, var_name);
+            int known = 0;
+            for(int i = 0; i < ctx->nb_vars; ++i)
+                known |= !strcmp(ctx->vars[i].name, var_name);
+            if(global && global->kind == BC_ARRAY && !known){
+                add_var(ctx, var_name, BC_ARRAY, new_temp(ctx), global->is_int, global->address);
+                emit(ctx, BC_CONST, ctx->top - 1, (long) global->address, 0);
+            }
+        }
+        collect_global_arrays(ctx, FIRSTCHILD(root));
+    }
+}
+
+/**
+ * @brief Translates a function: the addresses of its arrays computed first, then its body.
+ */
+static void compile_function(BcCtx *ctx, Node *decl, SymTabsFct *table, BcFunction *function){
+    int frame_bytes = 0;
+    ctx->nb_vars = ctx->top = ctx->nb_registers = ctx->nb_labels = ctx->nb_fixups = 0;
+    function->entry = ctx->program->size;
+    for(Node *param = FIRSTCHILD(THIRDCHILD(decl)); param && param->label == Type; param = param->nextSibling){
+        int is_array = FIRSTCHILD(param)->label == Array;
+        add_var(ctx, is_array ? FIRSTCHILD(FIRSTCHILD(param))->ident : FIRSTCHILD(param)->ident,
+            is_array ? BC_ARRAY : BC_REGISTER, new_temp(ctx), !strcmp(param->ident, "int"), NULL);
+    }
+    function->nb_params = ctx->top;
+    for(Table *current = table ? table->variables : NULL; current; current = current->next)
+        if(!current->var.is_array)
+            add_var(ctx, current->var.ident, BC_REGISTER, new_temp(ctx), current->var.is_int, NULL);
+    function->nb_locals = ctx->top - function->nb_params;
+    for(Table *current = table ? table->variables : NULL; current; current = current->next)
+        if(current->var.is_array){
+            int size = element_size(current->var.is_int);
+            frame_bytes = (frame_bytes + size - 1) / size * size;
+            add_var(ctx, current->var.ident, BC_ARRAY, new_temp(ctx), current->var.is_int, NULL);
+            emit(ctx, BC_FRAME, ctx->top - 1, frame_bytes, 0);
+            frame_bytes += current->var.size * size;
+        }
+    function->frame_bytes = (frame_bytes + FRAME_ALIGN - 1) / FRAME_ALIGN * FRAME_ALIGN;
+    collect_global_arrays(ctx, FIRSTCHILD(FOURTHCHILD(decl)));
+    ctx->nb_fixed = ctx->top;
+    for(Node *current = FIRSTCHILD(FOURTHCHILD(decl)); current; current = current->nextSibling)
+        compile_stmt(ctx, current);
+    emit(ctx, BC_RET0, 0, 0, 0);
+    for(int i = 0; i < ctx->nb_fixups; ++i)
+        ctx->program->code[ctx->fixups[i]] = ctx->labels[ctx->program->code[ctx->fixups[i]]];
+    function->nb_registers = ctx->nb_registers;
+}
+
+/**
+ * @brief Places the global variables in the memory of the program, each on 8 bytes at least.
+ */
+static void layout_globals(BcCtx *ctx, SymTabs *global_vars){
+    long size = 0;
+    for(Table *current = global_vars->first; current; current = current->next)
+        ctx->nb_globals++;
+    ctx->globals = (BcVar*) try(malloc(sizeof(BcVar) * (ctx->nb_globals + 1)), NULL);
+    ctx->nb_globals = 0;
+    for(Table *current = global_vars->first; current; current = current->next){
+        Element *var = &current->var;
+        ctx->globals[ctx->nb_globals++] = (BcVar){var->ident, var->is_array ? BC_ARRAY : BC_GLOBAL, -1, var->is_int, (char*) size};
+        size += ((var->is_array ? var->size : 1) * element_size(var->is_int) + 7) / 8 * 8;
+    }
+    ctx->program->globals = (char*) try(calloc(size + 8, sizeof(char)), NULL);
+    for(int i = 0; i < ctx->nb_globals; ++i)
+        ctx->globals[i].address = ctx->program->globals + (long) ctx->globals[i].address;
+}
+
+/**
+ * @brief Translates the checked tree in bytecode, after the optimization passes.
+ *
+ * Each function of the tree gets a frame of registers, its scalars being registers rather than
+ * memory, while the global variables and the arrays keep the size of their elements in memory,
+ * read sign extended and written truncated like the native code.
+ * @return The bytecode of the program, to run with run_bytecode().
+ */
+Bytecode *compile_bytecode(SymTabs *global_vars, SymTabsFct **functions, int nb_functions){
+    Bytecode *program = (Bytecode*) try(calloc(1, sizeof(Bytecode)), NULL);
+    BcCtx ctx = {program, NULL, 0, NULL, 0, 0, 0, 0, NULL, 0, NULL, 0};
+    int index = 0;
+    layout_globals(&ctx, global_vars);
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling)
+        program->nb_functions += current->label == Function;
+    program->functions = (BcFunction*) try(calloc(program->nb_functions + 1, sizeof(BcFunction)), NULL);
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling)
+        if(current->label == Function)
+            program->functions[index++].name = SECONDCHILD(current)->ident;
+    program->main_function = find_function(program, "main");
+    index = 0;
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        SymTabsFct *table = NULL;
+        if(current->label != Function)
+            continue;
+        for(int i = 0; i < nb_functions && !table; ++i)
+            if(!strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                table = functions[i];
+        compile_function(&ctx, current, table, &program->functions[index++]);
+    }
+    free(ctx.globals);
+    free(ctx.vars);
+    free(ctx.labels);
+    free(ctx.fixups);
+    return program;
+}
+
+void free_bytecode(Bytecode *program){
+    free(program->code);
+    free(program->functions);
+    free(program->globals);
+    free(program);
+}
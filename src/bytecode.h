@@ -0,0 +1,107 @@
+/**
+ * @file bytecode.h
+ * @brief Translation of the checked tree in the bytecode of the virtual machine.
+ */
+
+#ifndef __BYTECODE__H
+#define __BYTECODE__H
+
+#include "compile.h"
+
+/**
+ * @brief Instructions of the virtual machine, each followed by its operands in the code.
+ *
+ * The operands named d, a, b, s, base and index are registers of the current frame, k is a
+ * constant, addr an address in the memory of the global variables and target an offset in the
+ * code. The comparisons write 0 or 1, and the conditional jumps branch when their comparison
+ * holds.
+ */
+typedef enum{
+    BC_MOVE,    ///< d s: copies a register.
+    BC_CONST,   ///< d k: loads a constant.
+    BC_ADD,     ///< d a b
+    BC_SUB,     ///< d a b
+    BC_MUL,     ///< d a b
+    BC_DIV,     ///< d a b, raises SIGFPE like idiv for a division by 0 or an overflow.
+    BC_MOD,     ///< d a b, raises SIGFPE like idiv for a division by 0 or an overflow.
+    BC_ADDK,    ///< d a k
+    BC_MULK,    ///< d a k
+    BC_NEG,     ///< d a
+    BC_NOT,     ///< d a
+    BC_EQ,      ///< d a b
+    BC_NE,      ///< d a b
+    BC_LT,      ///< d a b
+    BC_LE,      ///< d a b
+    BC_GT,      ///< d a b
+    BC_GE,      ///< d a b
+    BC_JMP,     ///< target
+    BC_JZ,      ///< a target
+    BC_JNZ,     ///< a target
+    BC_JEQ,     ///< a b target
+    BC_JNE,     ///< a b target
+    BC_JLT,     ///< a b target
+    BC_JLE,     ///< a b target
+    BC_JGT,     ///< a b target
+    BC_JGE,     ///< a b target
+    BC_JEQK,    ///< a k target
+    BC_JNEK,    ///< a k target
+    BC_JLTK,    ///< a k target
+    BC_JLEK,    ///< a k target
+    BC_JGTK,    ///< a k target
+    BC_JGEK,    ///< a k target
+    BC_LDGI,    ///< d addr: reads a global int, sign extended.
+    BC_LDGC,    ///< d addr: reads a global char, sign extended.
+    BC_STGI,    ///< addr s: writes the low 4 bytes of s in a global int.
+    BC_STGC,    ///< addr s: writes the low byte of s in a global char.
+    BC_LDI,     ///< d base index: reads an element of an array of int.
+    BC_LDC,     ///< d base index: reads an element of an array of char.
+    BC_STI,     ///< base index s
+    BC_STC,     ///< base index s
+    BC_LDIK,    ///< d base k: reads the element k of an array of int.
+    BC_LDCK,    ///< d base k
+    BC_STIK,    ///< base k s
+    BC_STCK,    ///< base k s
+    BC_FRAME,   ///< d k: address of the local array at the offset k of the memory of the frame.
+    BC_CALL,    ///< function base d: calls a function whose parameters are the registers from base, its value going to d.
+    BC_RET,     ///< s
+    BC_RET0,    ///< returns without value, 0 for the caller.
+    BC_GETCHAR, ///< d
+    BC_GETINT,  ///< d
+    BC_PUTCHAR, ///< s
+    BC_PUTINT,  ///< s
+    BC_PUTS,    ///< length, then the characters packed 8 by word.
+    BC_OPCODES  ///< Number of instructions.
+}BcOpcode;
+
+/**
+ * @brief Function of the bytecode.
+ */
+typedef struct{
+    char *name;        ///< Name of the function.
+    long entry;        ///< Offset of its first instruction in the code.
+    int nb_params;     ///< Number of parameters, the first registers of its frame.
+    int nb_locals;     ///< Number of local scalars, the registers following the parameters, zeroed by the call.
+    int nb_registers;  ///< Number of registers of its frame, temporaries included.
+    int frame_bytes;   ///< Bytes of its local arrays.
+}BcFunction;
+
+/**
+ * @brief Bytecode of a whole program with the memory of its global variables.
+ */
+typedef struct{
+    long *code;              ///< Instructions and their operands.
+    long size;               ///< Number of words of the code.
+    long capacity;           ///< Number of words allocated.
+    BcFunction *functions;   ///< Functions of the program.
+    int nb_functions;        ///< Number of functions.
+    int main_function;       ///< Index of main, -1 if there is none.
+    char *globals;           ///< Memory of the global variables, zeroed.
+}Bytecode;
+
+int bytecode_operands(long *code); ///< Function to get the number of operands of the instruction at the start of some code.
+
+Bytecode *compile_bytecode(SymTabs *global_vars, SymTabsFct **functions, int nb_functions); ///< Function to translate the checked tree in bytecode.
+
+void free_bytecode(Bytecode *program); ///< Function to free the bytecode of a program.
+
+#endif
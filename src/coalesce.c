@@ -0,0 +1,71 @@
+#include "coalesce.h"
+
+/**
+ * @brief Gives the constant printed by a statement calling putchar on a constant.
+ * @return The Num or Character node, or NULL for another statement.
+ */
+static Node *constant_putchar(Node *root){
+    Node *argument;
+    if(!is_function_call(root) || strcmp(FIRSTCHILD(root)->ident, "putchar"))
+        return NULL;
+    argument = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root)));
+    if(!argument || argument->nextSibling)
+        return NULL;
+    while(argument->label == Expression)
+        argument = FIRSTCHILD(argument);
+    return argument->label == Num || argument->label == Character ? argument : NULL;
+}
+
+/**
+ * @brief Merges the runs of putchar of constants in a list of statements.
+ *
+ * The argument of each following call is moved to the parameters of the first one, and the
+ * following call is removed.
+ */
+static void coalesce_list(Node *instructions, SymTabsFct *function, int report){
+    for(Node *current = FIRSTCHILD(instructions); current; current = current->nextSibling){
+        Node *last;
+        int length = 1;
+        if(!constant_putchar(current))
+            continue;
+        last = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(current)));
+        while(current->nextSibling && constant_putchar(current->nextSibling) && length < COALESCE_MAX){
+            Node *next = current->nextSibling, *parameters = FIRSTCHILD(FIRSTCHILD(next));
+            last->nextSibling = FIRSTCHILD(parameters);
+            last = last->nextSibling;
+            parameters->firstChild = NULL;
+            current->nextSibling = next->nextSibling;
+            next->nextSibling = NULL;
+            deleteTree(next);
+            length++;
+        }
+        if(report && length > 1)
+            fprintf(stderr, "%s, line %d: %d calls of putchar merged\n", function->ident, current->lineno, length);
+    }
+}
+
+static void coalesce_tree(Node *root, SymTabsFct *function, int report){
+    for(; root; root = root->nextSibling){
+        if(root->label == Instructions)
+            coalesce_list(root, function, report);
+        coalesce_tree(FIRSTCHILD(root), function, report);
+    }
+}
+
+/**
+ * @brief Merges the consecutive calls of putchar on constants.
+ *
+ * A run of statements like putchar('H'); putchar('i'); becomes a single call of putchar with
+ * the characters as its parameters, that the code generation writes as one copy of a string
+ * to the output buffer. The pass comes last, since the other passes expect putchar to take
+ * one parameter.
+ */
+void coalesce_putchars(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report){
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        if(current->label != Function)
+            continue;
+        for(int i = 0; i < nb_functions; ++i)
+            if(!strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                coalesce_tree(FOURTHCHILD(current), functions[i], report);
+    }
+}
@@ -0,0 +1,15 @@
+/**
+ * @file coalesce.h
+ * @brief Merging of the consecutive calls of putchar on constants.
+ */
+
+#ifndef __COALESCE__H
+#define __COALESCE__H
+
+#include "compile.h"
+
+#define COALESCE_MAX 64 ///< Maximum number of characters of a merged call, longer runs being split.
+
+void coalesce_putchars(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report); ///< Function to merge the runs of putchar of constants into calls of several characters, reporting each run on stderr if asked.
+
+#endif
@@ -1,4 +1,16 @@
 #include "compile.h"
+#include "vectorize.h"
+#include "burs.h"
+#include "passes.h"
+#include "frame.h"
+
+static IvLoop *iv_loops = NULL; ///< Strength reductions of the loops of the function being written.
+static int iv_frame = 0;        ///< Size of the variables of the function being written.
+
+static FILE *string_file = NULL; ///< Strings of the merged calls of putchar, written after the code.
+static int nb_strings = 0;       ///< Number of strings written so far.
+
+int inline_builtins = 0;
 
 int count_functions(){
     Node *current = FIRSTCHILD(SECONDCHILD(node));
@@ -266,13 +278,58 @@ SymTabs* fill_func_parameters_table(Node *root){
     return res;
 }
 
-void build_asm(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *filename){
-    FILE * file = try(fopen(filename, "a"), NULL);
+/**
+ * @brief Marks the builtins called in a tree.
+ * @param used Flag of each builtin, in the order of builtins.
+ */
+static void find_builtin_calls(Node *root, char **builtins, int nb_builtins, int *used){
+    for(; root; root = root->nextSibling){
+        if(is_function_call(root))
+            for(int i = 0; i < nb_builtins; ++i)
+                if(!strcmp(FIRSTCHILD(root)->ident, builtins[i]))
+                    used[i] = 1;
+        find_builtin_calls(FIRSTCHILD(root), builtins, nb_builtins, used);
+    }
+}
+
+/**
+ * @brief Writes the entry point of the program and its functions.
+ *
+ * The runtime is not written here but linked from its archive: only the routines of the
+ * builtins still called once the tree is optimized are declared, with _flush that _start calls
+ * to write the output left, so that the linker leaves the other routines out. The calls of
+ * getchar and putchar written inline, and the merged calls of putchar, also use the buffers of
+ * the runtime.
+ */
+void build_asm(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, FILE *file){
+    char *builtins[] = {"getchar", "getint", "putchar", "putint"};
+    int used[4] = {0}, any = 0;
+    find_builtin_calls(FIRSTCHILD(SECONDCHILD(node)), builtins, 4, used);
+    for(int i = 0; i < 4; ++i)
+        if(used[i]){
+            fprintf(file, "extern _%s\n", builtins[i]);
+            any = 1;
+        }
+    if(any)
+        fprintf(file, "extern _flush\n");
+    if(used[2] && line_buffered)
+        fprintf(file, "extern _line_buffered\n");
+    if(used[0] && inline_builtins)
+        fprintf(file, "extern _in_buffer\nextern _in_start\nextern _in_end\n");
+    if(used[2])
+        fprintf(file, "extern _out_buffer\nextern _out_length\n");
     fprintf(file, "global _start\n");
     fprintf(file, "section .text\n");
     fprintf(file, "_start:\n");
+    if(used[2] && line_buffered)
+        fprintf(file, "mov byte [_line_buffered], 1 ; putchar écrit chaque ligne\n");
     fprintf(file, "call main\n");
-    fprintf(file,  "mov rdi, rax\n");
+    if(any){
+        fprintf(file, "push rax\n");
+        fprintf(file, "call _flush ; on écrit la sortie en attente\n");
+        fprintf(file, "pop rdi\n");
+    }else
+        fprintf(file, "mov rdi, rax\n");
     fprintf(file, "mov rax, 60\n");
     fprintf(file, "syscall\n");
     build_minimal_asm(file, FIRSTCHILD(SECONDCHILD(node)), global_vars, functions, nb_functions);
@@ -293,6 +350,44 @@ SymTabsFct** fill_decl_functions(int nb_func, SymTabs *global_vars, char *filena
     return all_tables;
 }
 
+/**
+ * @brief Finds the declaration of a function in the tree.
+ * @param function_name The name of the function.
+ * @return The Function node, or NULL for a builtin or an unknown function.
+ */
+Node *find_function_decl(char *function_name){
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling)
+        if(current->label == Function && !strcmp(SECONDCHILD(current)->ident, function_name))
+            return current;
+    return NULL;
+}
+
+int is_function_call(Node *root){
+    return root->label == Function && FIRSTCHILD(root) && FIRSTCHILD(root)->label == Ident;
+}
+
+int is_builtin_function(char *function_name){
+    return !strcmp(function_name, "getint") || !strcmp(function_name, "getchar")
+        || !strcmp(function_name, "putint") || !strcmp(function_name, "putchar");
+}
+
+/**
+ * @brief Rebuilds the tables of the declared functions once the tree has been transformed.
+ * @param functions The current tables, freed by the function.
+ * @param nb_functions Updated with the new number of functions.
+ * @return The new tables.
+ */
+SymTabsFct** update_decl_functions(SymTabsFct **functions, int *nb_functions, SymTabs *global_vars){
+    for(int i = 0; i < *nb_functions; ++i){
+        free_table(functions[i]->parameters);
+        free_table(functions[i]->variables);
+        free(functions[i]);
+    }
+    free(functions);
+    *nb_functions = count_functions();
+    return fill_decl_functions(*nb_functions, global_vars, NULL);
+}
+
 /**
  * @brief Fills a symbol table with global variables.
  * @param t The symbol table to fill.
@@ -409,12 +504,12 @@ static void divstar_calc(Node *root, FILE * file, SymTabs *global_vars, SymTabsF
         fprintf(file, "push rax\n");
     }
     else if(root->ident[0] == '%'){
-        fprintf(file, "mov rdx, 0\n");
+        fprintf(file, "cqo\n");
         fprintf(file, "idiv rcx\n");
         fprintf(file, "push rdx\n");
     }
     else{
-        fprintf(file, "mov rdx, 0\n");
+        fprintf(file, "cqo\n");
         fprintf(file, "idiv rcx\n");
         fprintf(file, "push rax\n");
     }
@@ -468,26 +563,23 @@ static void num_calc(Node *root, FILE * file){
 
 static int get_offset_global_vars(Node *root, SymTabs *global_vars, int *type, FILE *file, SymTabsFct **functions,
     int nb_functions, char *function_name){
-    int offset = -1, size = 0, array_offset = 0;
+    int offset = -1;
     for(Table *current = global_vars->first; current; current = current->next){
         switch(root->label){
             case Array:
                 if(!strcmp(current->var.ident, FIRSTCHILD(root)->ident)){
-                    offset = current->var.deplct + FIRSTCHILD(root)->num * (current->var.is_int ? 4 : 1);
-                    size = current->var.is_int ? 4 : 1;
+                    offset = current->var.deplct;
                     *type = current->var.is_int;
-                    array_offset = expression_result(FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
                 }
                 break;
             default:
                 if(!strcmp(current->var.ident, root->ident)){
                     offset = current->var.deplct;
                     *type = current->var.is_int;
-                    size = current->var.is_int ? 4 : 1;
                 }
         }
     }
-    return offset + size * array_offset;
+    return offset;
 }
 
 static int get_offset_table(Node *root, Table *table, int *type){
@@ -555,8 +647,8 @@ static int use_funct_params(Node *root, FILE * file, SymTabsFct **functions, int
                         functions, nb_functions, function_name);
                     fprintf(file, "pop rax\n");
                     fprintf(file, "pop rcx\n");
-                    fprintf(file, "mov %s, %s [rcx + 8 * rax]\n", current->var.is_int ? "eax" : "al",
-                        current->var.is_int ? "dword" : "byte");
+                    fprintf(file, "movsx rax, %s [rcx + %d * rax]\n", current->var.is_int ? "dword" : "byte",
+                        element_size(current->var.is_int));
                     fprintf(file, "push rax\n");
                 }
                     return 1;
@@ -579,11 +671,8 @@ static int use_funct_vars(Node *root, FILE * file, SymTabsFct **functions, int n
                             get_value(FIRSTCHILD(FIRSTCHILD(root)), file, global_vars, NULL, NULL, functions, nb_functions,
                                 function_name);
                             fprintf(file, "pop rcx\n");
-                            fprintf(file, "mov rax, [rbp - %d + 8 * rcx]\n", current->var.deplct);
-                            fprintf(file, "push rax\n");
-                            fprintf(file, "pop rcx\n");
-                            fprintf(file, "mov %s, %s\n", current->var.is_int ? "eax" : "al",
-                                current->var.is_int ? "ecx" : "cl");
+                            fprintf(file, "movsx rax, %s [rbp - %d + %d * rcx]\n", current->var.is_int ? "dword" : "byte",
+                                current->var.deplct, element_size(current->var.is_int));
                         }
                         else{
                             fprintf(file, "mov rax, [rbp - %d]\n", current->var.deplct);
@@ -604,10 +693,138 @@ static int use_funct_vars(Node *root, FILE * file, SymTabsFct **functions, int n
     return 0;
 }
 
+static int iv_slot_offset(int slot){
+    return iv_frame + 8 * (slot + 1);
+}
+
+static int offset_by_name(Table *table, char *var_name){
+    for(Table *current = table; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return current->var.deplct;
+    return -1;
+}
+
+/**
+ * @brief Writes the computation of the address of an element, the index being in rax, into rcx.
+ */
+static void iv_element_address(IvPointer *pointer, FILE *file, SymTabs *global_vars, SymTabsFct **functions,
+    int nb_functions, char *function_name){
+    int offset = -1;
+    for(int i = 0; i < nb_functions; ++i)
+        if(!strcmp(function_name, functions[i]->ident))
+            offset = offset_by_name(pointer->kind == IV_PARAM ? functions[i]->parameters : functions[i]->variables,
+                pointer->array);
+    switch(pointer->kind){
+        case IV_GLOBAL:
+            fprintf(file, "mov rcx, global_vars\n");
+            fprintf(file, "lea rcx, [rcx + %d + %d * rax]\n", offset_by_name(global_vars->first, pointer->array),
+                pointer->stride);
+            break;
+        case IV_PARAM:
+            fprintf(file, "mov rcx, [rbp + %d]\n", offset);
+            fprintf(file, "lea rcx, [rcx + %d * rax]\n", pointer->stride);
+            break;
+        default:
+            fprintf(file, "lea rcx, [rbp - %d + %d * rax]\n", offset, pointer->stride);
+    }
+}
+
+/**
+ * @brief Writes the initialization of the pointers of a loop, and of the bound of its exit test.
+ */
+static void iv_init(IvLoop *loop, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions,
+    char *function_name){
+    for(int i = 0; i < loop->nb_pointers; ++i){
+        Node counter = {.label = Ident, .ident = loop->pointers[i].counter};
+        get_value(&(Node){.label = Variable, .firstChild = &counter}, file, global_vars, NULL, NULL, functions,
+            nb_functions, function_name);
+        fprintf(file, "pop rax\n");
+        iv_element_address(&loop->pointers[i], file, global_vars, functions, nb_functions, function_name);
+        fprintf(file, "mov [rbp - %d], rcx\n", iv_slot_offset(loop->pointers[i].slot));
+    }
+    if(loop->eliminated){
+        get_value(loop->bound, file, global_vars, NULL, NULL, functions, nb_functions, function_name);
+        fprintf(file, "pop rax\n");
+        iv_element_address(loop->test_pointer, file, global_vars, functions, nb_functions, function_name);
+        fprintf(file, "mov [rbp - %d], rcx\n", iv_slot_offset(loop->bound_slot));
+    }
+    loop->active = 1;
+}
+
+/**
+ * @brief Writes the exit test of a loop whose counter is replaced by a pointer.
+ * @param negate Flag telling if the jump is taken when the test fails.
+ */
+static void iv_test(IvLoop *loop, FILE *file, char *label, int negate){
+    static const char *negations[][2] = {{"l", "ge"}, {"le", "g"}, {"g", "le"}, {"ge", "l"}, {"ne", "e"}};
+    const char *condition = loop->condition;
+    for(int i = 0; negate && i < 5; ++i)
+        if(!strcmp(negations[i][0], loop->condition))
+            condition = negations[i][1];
+    fprintf(file, "mov rax, [rbp - %d]\n", iv_slot_offset(loop->test_pointer->slot));
+    fprintf(file, "cmp rax, [rbp - %d]\n", iv_slot_offset(loop->bound_slot));
+    fprintf(file, "j%s %s\n", condition, label);
+}
+
+static IvLoop *iv_counter_loop(char *var_name){
+    for(IvLoop *current = iv_loops; current; current = current->next)
+        if(current->active && get_iv_step(current, var_name))
+            return current;
+    return NULL;
+}
+
+/**
+ * @brief Writes the increase of the pointers following an induction variable.
+ */
+static void iv_bump(IvLoop *loop, char *counter, FILE *file){
+    for(int i = 0; i < loop->nb_pointers; ++i)
+        if(!strcmp(loop->pointers[i].counter, counter))
+            fprintf(file, "add qword [rbp - %d], %d\n", iv_slot_offset(loop->pointers[i].slot),
+                get_iv_step(loop, counter) * loop->pointers[i].stride);
+}
+
+/**
+ * @brief Writes the read of an array element through its pointer. The value is sign extended,
+ * as the other accesses to the arrays do.
+ */
+static void iv_load(IvPointer *pointer, int displacement, FILE *file){
+    fprintf(file, "mov rcx, [rbp - %d]\n", iv_slot_offset(pointer->slot));
+    if(displacement)
+        fprintf(file, "add rcx, %d\n", displacement * pointer->stride);
+    fprintf(file, "movsx rax, %s [rcx]\n", pointer->is_int ? "dword" : "byte");
+    fprintf(file, "push rax\n");
+}
+
+static void iv_store(IvPointer *pointer, int displacement, FILE *file){
+    fprintf(file, "pop rax\n");
+    fprintf(file, "mov rcx, [rbp - %d]\n", iv_slot_offset(pointer->slot));
+    if(displacement)
+        fprintf(file, "add rcx, %d\n", displacement * pointer->stride);
+    fprintf(file, "mov %s [rcx], %s\n", pointer->is_int ? "dword" : "byte", pointer->is_int ? "eax" : "al");
+}
+
 static void affectation_calc(Node *root, FILE * file, SymTabs *global_vars, SymTabsFct **functions,
     int nb_functions, char *function_name){
+    Node *target = FIRSTCHILD(FIRSTCHILD(root));
+    int displacement;
+    IvPointer *pointer = target->label == Array ? get_iv_pointer(iv_loops, target, &displacement) : NULL;
+    IvLoop *counter_loop = target->label == Ident ? iv_counter_loop(target->ident) : NULL;
+    if(counter_loop && counter_loop->eliminated && !strcmp(counter_loop->eliminated, target->ident)){
+        iv_bump(counter_loop, target->ident, file);
+        return;
+    }
+    if(optimize_level >= OPT_BASIC
+        && select_assignment(root, file, iv_loops, iv_frame, global_vars, functions, nb_functions, function_name)){
+        if(counter_loop)
+            iv_bump(counter_loop, target->ident, file);
+        return;
+    }
     get_value(SECONDCHILD(root), file, global_vars, NULL, NULL, functions, nb_functions,
         function_name);
+    if(pointer){
+        iv_store(pointer, displacement, file);
+        return;
+    }
     int type = 0, is_array = FIRSTCHILD(FIRSTCHILD(root))->label == Ident ? 0 : 1;
     int offset = get_offset_global_vars(FIRSTCHILD(FIRSTCHILD(root)), global_vars, &type, file, functions,
         nb_functions, function_name);
@@ -617,8 +834,8 @@ static void affectation_calc(Node *root, FILE * file, SymTabs *global_vars, SymT
                         NULL, functions,nb_functions, function_name);
             fprintf(file, "pop rax\n");
             fprintf(file, "pop rcx\n");
-            fprintf(file, "mov %s [global_vars + rax * %d], %s\n", type == INT ? "dword" : "byte",
-            type == INT ? 4 : 1, type == INT ? "ecx" : "cl");
+            fprintf(file, "mov %s [global_vars + %d + rax * %d], %s\n", type == INT ? "dword" : "byte",
+                offset, element_size(type), type == INT ? "ecx" : "cl");
         }
         else{
             fprintf(file, "pop rax\n");
@@ -636,7 +853,8 @@ static void affectation_calc(Node *root, FILE * file, SymTabs *global_vars, SymT
                 fprintf(file, "pop rax\n");
                 fprintf(file, "pop rcx\n");
                 fprintf(file, "mov r12, [rbp + %d]\n", offset);
-                fprintf(file, "mov [r12 + rax * 8], rcx\n");
+                fprintf(file, "mov %s [r12 + rax * %d], %s\n", type == INT ? "dword" : "byte", element_size(type),
+                    type == INT ? "ecx" : "cl");
             }
             else{
                 fprintf(file, "pop rax\n");
@@ -652,7 +870,8 @@ static void affectation_calc(Node *root, FILE * file, SymTabs *global_vars, SymT
                         NULL, functions,nb_functions, function_name);
                     fprintf(file, "pop rax\n");
                     fprintf(file, "pop rcx\n");
-                    fprintf(file, "mov [rbp - %d + rax * 8], rcx\n", offset);
+                    fprintf(file, "mov %s [rbp - %d + rax * %d], %s\n", type == INT ? "dword" : "byte", offset,
+                        element_size(type), type == INT ? "ecx" : "cl");
                 }
                 else{
                     fprintf(file, "pop rax\n");
@@ -661,6 +880,8 @@ static void affectation_calc(Node *root, FILE * file, SymTabs *global_vars, SymT
             }
         }
     }
+    if(counter_loop)
+        iv_bump(counter_loop, target->ident, file);
 }
 
 int is_ident_array_in_table(char *ident, Table *table){
@@ -680,6 +901,12 @@ int is_ident_array_in_table(char *ident, Table *table){
 static void ident_calc(Node *root, FILE * file, SymTabs *global_vars, SymTabsFct **functions,
     int nb_functions, char *function_name){
     printf("Entering ident_calc\n");
+    int displacement;
+    IvPointer *pointer = root->label == Array ? get_iv_pointer(iv_loops, root, &displacement) : NULL;
+    if(pointer){
+        iv_load(pointer, displacement, file);
+        return;
+    }
     int type, is_array = (root->label == Ident ? 0 : 1), is_adress = !is_array && (is_ident_array_in_table(root->ident,
         global_vars->first) == 1);
     printf("ok\n");
@@ -688,9 +915,9 @@ static void ident_calc(Node *root, FILE * file, SymTabs *global_vars, SymTabsFct
         if(is_array){
             get_value(FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))), file, global_vars, NULL,
                         NULL, functions,nb_functions, function_name);
-            fprintf(file, "pop rcx\n");
+            fprintf(file, "pop rax\n");
             fprintf(file, "movsx rax, %s [global_vars + %d + rax * %d]\n", type == INT ? "dword" : "byte", offset,
-                type == INT ? 4 : 1);
+                element_size(type));
         }
         else if(is_adress){
             fprintf(file, "mov r12, global_vars\n");
@@ -703,23 +930,42 @@ static void ident_calc(Node *root, FILE * file, SymTabs *global_vars, SymTabsFct
         fprintf(file, "push rax\n");
     }
     else{
-        is_adress = !is_array && (is_ident_array_in_table(root->ident, functions[0]->parameters) == 1);
         if(use_funct_params(root, file, functions, nb_functions, function_name, global_vars))
             return;
-        is_adress = !is_array && (is_ident_array_in_table(root->ident, functions[0]->variables) == 1);
+        for(int i = 0; i < nb_functions; ++i)
+            if(!strcmp(function_name, functions[i]->ident))
+                is_adress = !is_array && (is_ident_array_in_table(root->ident, functions[i]->variables) == 1);
         use_funct_vars(root, file, functions, nb_functions, function_name, is_adress, global_vars);
     }
     printf("Exiting ident_calc\n");
 }
 
 
+/**
+ * @brief Gets the value of a character literal, escape sequences included.
+ * @param root The Character node.
+ * @return The code of the character.
+ */
+int character_value(Node *root){
+    if(root->ident[1] == '\\')
+        switch(root->ident[2]){
+            case 'n':
+                return '\n';
+            case 't':
+                return '\t';
+            default:
+                return root->ident[2];
+        }
+    return root->ident[1];
+}
+
 /**
  * @brief Writes the value of a character to a file as an assembly instruction.
  * @param root The node whose value is to be written.
  * @param file The file to write the assembly instruction to.
  */
 static void character_calc(Node *root, FILE * file){
-    fprintf(file, "mov rax, %d\n", root->ident[1]);
+    fprintf(file, "mov rax, %d\n", character_value(root));
     fprintf(file, "push rax\n");
 }
 
@@ -732,19 +978,6 @@ int nb_params_function(SymTabsFct **functions, int nb_functions, char *function_
     return params;
 }
 
-int nb_vars_function(SymTabsFct **functions, int nb_functions, char *function_name){
-    int vars = 0;
-    for(int i = 0; i < nb_functions; ++i)
-        if(!strcmp(function_name, functions[i]->ident))
-            for(Table *current = functions[i]->variables; current; current = current->next){
-                if(!current->var.is_array)
-                    vars++;
-                else
-                    vars += current->var.size;
-            }
-    return vars;
-}
-
 static int get_function_type(char *function_name, SymTabsFct **functions, int nb_functions){
     for(int i = 0; i < nb_functions; ++i)
         if(!strcmp(function_name, functions[i]->ident))
@@ -759,24 +992,86 @@ static int get_function_type(char *function_name, SymTabsFct **functions, int nb
     exit(SEMANTIC_ERROR);
 }
 
-static int get_var_table(Table *table){
-    int nb = 0;
-    for(Table *current = table; current; current = current->next)
-        nb += 1 * (current->var.is_array ? current->var.size : 1);
-    return nb;
+/**
+ * @brief Writes a call to putchar as a store in the output buffer, its character being on the
+ * stack, the routine being only called to flush the buffer when it's full.
+ */
+static void inline_putchar(FILE *file){
+    char *store_label = create_label();
+    fprintf(file, "mov rax, [_out_length]\n");
+    fprintf(file, "cmp rax, %d\n", OUT_BUFFER_SIZE);
+    fprintf(file, "jl %s\n", store_label);
+    fprintf(file, "call _flush\n");
+    fprintf(file, "mov rax, 0\n");
+    fprintf(file, "%s:\n", store_label);
+    fprintf(file, "pop rcx\n");
+    fprintf(file, "mov [_out_buffer + rax], cl\n");
+    fprintf(file, "inc rax\n");
+    fprintf(file, "mov [_out_length], rax\n");
+    free(store_label);
 }
 
-static void change_offset(SymTabsFct *function){
-    int offset_params = 8;
-    int offset_vars = 8 * get_var_table(function->variables);
-    for(Table *current = function->variables; current; current = current->next){
-        current->var.deplct = offset_vars;
-        offset_vars -= 8 * (current->var.is_array ? current->var.size : 1);
+/**
+ * @brief Writes a call to putchar on several constants, merged by coalesce_putchars(), as a copy
+ * of a string of .rodata to the output buffer, flushed first when it hasn't room for it.
+ *
+ * The string is copied 8 bytes at a time, so it's padded to a multiple of 8 with zeros, that
+ * the next characters written overwrite. With -l, the buffer is flushed after a string holding
+ * a newline.
+ */
+static void putchars_calc(Node *root, FILE *file){
+    char *store_label = create_label();
+    int length = get_params(root), padded = (length + 7) / 8 * 8, newline = 0;
+    fprintf(string_file, "_string%d db ", nb_strings);
+    for(Node *param = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); param; param = param->nextSibling){
+        Node *value = param;
+        int character;
+        while(value->label == Expression)
+            value = FIRSTCHILD(value);
+        character = (value->label == Num ? value->num : character_value(value)) & 0xff;
+        newline |= character == '\n';
+        fprintf(string_file, "%s%d", param == FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))) ? "" : ",", character);
     }
-    for(Table *current = function->parameters; current; current = current->next){
-        offset_params += 8 * (current->var.is_array ? current->var.size : 1);
-        current->var.deplct = offset_params;
+    for(int i = length; i < padded; ++i)
+        fprintf(string_file, ",0");
+    fprintf(string_file, "\n");
+    fprintf(file, "mov rax, [_out_length]\n");
+    fprintf(file, "cmp rax, %d\n", OUT_BUFFER_SIZE - padded);
+    fprintf(file, "jle %s\n", store_label);
+    fprintf(file, "call _flush\n");
+    fprintf(file, "mov rax, 0\n");
+    fprintf(file, "%s:\n", store_label);
+    for(int i = 0; i < padded; i += 8){
+        fprintf(file, "mov rcx, [_string%d + %d]\n", nb_strings, i);
+        fprintf(file, "mov [_out_buffer + rax + %d], rcx\n", i);
     }
+    fprintf(file, "add rax, %d\n", length);
+    fprintf(file, "mov [_out_length], rax\n");
+    if(line_buffered && newline)
+        fprintf(file, "call _flush\n");
+    nb_strings++;
+    free(store_label);
+}
+
+/**
+ * @brief Writes a call to getchar as a load from the input buffer, the routine being only called
+ * to fill the buffer when it's empty.
+ */
+static void inline_getchar(FILE *file){
+    char *load_label = create_label(), *end_label = create_label();
+    fprintf(file, "mov rcx, [_in_start]\n");
+    fprintf(file, "cmp rcx, [_in_end]\n");
+    fprintf(file, "jl %s\n", load_label);
+    fprintf(file, "call _getchar\n");
+    fprintf(file, "jmp %s\n", end_label);
+    fprintf(file, "%s:\n", load_label);
+    fprintf(file, "movzx rax, byte [_in_buffer + rcx]\n");
+    fprintf(file, "inc rcx\n");
+    fprintf(file, "mov [_in_start], rcx\n");
+    fprintf(file, "%s:\n", end_label);
+    fprintf(file, "push rax\n");
+    free(load_label);
+    free(end_label);
 }
 
 /**
@@ -787,12 +1082,25 @@ static void change_offset(SymTabsFct *function){
  */
 static void function_calc(Node *root, FILE * file, SymTabs * global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
     int args = get_params(root);
+    if(args > 1 && !strcmp(FIRSTCHILD(root)->ident, "putchar")){
+        fprintf(file, ";Function putchar, %d characters\n", args);
+        putchars_calc(root, file);
+        return;
+    }
     Node *params = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root)));
     while(params && params->label != Void){
         get_value(params, file, global_vars, NULL, NULL, functions, nb_functions, function_name);
         params = params->nextSibling;
     }
     fprintf(file, ";Function %s\n", FIRSTCHILD(root)->ident);
+    if(inline_builtins && !strcmp(FIRSTCHILD(root)->ident, "getchar")){
+        inline_getchar(file);
+        return;
+    }
+    if(inline_builtins && !line_buffered && !strcmp(FIRSTCHILD(root)->ident, "putchar")){
+        inline_putchar(file);
+        return;
+    }
     if(!strcmp(FIRSTCHILD(root)->ident, "getchar"))
         fprintf(file, "call _getchar\n");
     else if(!strcmp(FIRSTCHILD(root)->ident, "getint"))
@@ -808,54 +1116,81 @@ static void function_calc(Node *root, FILE * file, SymTabs * global_vars, SymTab
         fprintf(file, "push rax\n");
 }
 
-static char *create_label(){
+char *create_label(){
     static int label = 0;
-    char *res = (char*) try(malloc(sizeof(char) * 10), NULL);
-    sprintf(res, "_l_label%d", label++);
+    char *res = (char*) try(malloc(sizeof(char) * (strlen(LAYOUT_LABEL_PREFIX) + 12)), NULL);
+    sprintf(res, LAYOUT_LABEL_PREFIX "%d", label++);
     return res;
 }
 
-static void manage_if_then_else(Node *root, FILE *file, SymTabs *global_vars, char *then_label,
- char *else_label, char *end_label, SymTabsFct **functions, int nb_functions, char *function_name){
+/**
+ * @brief Writes the code of an instruction, or of every instruction of a block.
+ * @param root The instruction or the Instructions node.
+ */
+static void instructions_calc(Node *root, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
+    if(!root)
+        return;
+    if(root->label == Instructions)
+        for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+            instructions_calc(current, file, global_vars, functions, nb_functions, function_name);
+    else
+        do_calc(root, file, global_vars, functions, nb_functions, function_name);
+}
+
+/**
+ * @brief Writes the computation of an expression into rax.
+ */
+static void value_calc(Node *root, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
+    if(optimize_level >= OPT_BASIC
+        && select_value(root, file, iv_loops, iv_frame, global_vars, functions, nb_functions, function_name))
+        return;
+    get_value(root, file, global_vars, NULL, NULL, functions, nb_functions, function_name);
+    fprintf(file, "pop rax\n");
+}
+
+/**
+ * @brief Writes a jump to a label taken when a condition is true, or false.
+ * @param when 1 to jump when the condition holds, 0 to jump when it doesn't.
+ */
+static void branch_calc(Node *root, FILE *file, SymTabs *global_vars, char *label, int when, SymTabsFct **functions, int nb_functions, char *function_name){
+    if(optimize_level >= OPT_BASIC){
+        select_branch(root, file, label, when, iv_loops, iv_frame, global_vars, functions, nb_functions, function_name);
+        return;
+    }
+    get_value(root, file, global_vars, NULL, NULL, functions, nb_functions, function_name);
     fprintf(file, "pop rax\n");
     fprintf(file, "cmp rax, 0\n");
-    fprintf(file, "je %s\n", else_label);
+    fprintf(file, "%s %s\n", when ? "jne" : "je", label);
+}
+
+static void manage_if_then_else(Node *root, FILE *file, SymTabs *global_vars, char *then_label,
+ char *else_label, char *end_label, SymTabsFct **functions, int nb_functions, char *function_name){
     fprintf(file, ";Then\n");
     fprintf(file, "%s:\n", then_label);
-    switch(SECONDCHILD(root)->label){
-        case Instructions:
-            do_calc(FIRSTCHILD(SECONDCHILD(root)), file, global_vars, functions, nb_functions, function_name);
-            break;
-        default:
-            do_calc(SECONDCHILD(root), file, global_vars, functions, nb_functions, function_name);
-            break;
-    }
-    fprintf(file, "jmp %s\n", end_label);
+    instructions_calc(SECONDCHILD(root), file, global_vars, functions, nb_functions, function_name);
+    if(THIRDCHILD(root))
+        fprintf(file, "jmp %s\n", end_label);
     fprintf(file, ";Else\n");
     fprintf(file, "%s:\n", else_label);
-    if(THIRDCHILD(root)){
-        switch (THIRDCHILD(root)->label){
-            case Instructions:
-                do_calc(FIRSTCHILD(THIRDCHILD(root)), file, global_vars, functions, nb_functions, function_name);
-                break;
-            default:
-                do_calc(THIRDCHILD(root), file, global_vars, functions, nb_functions, function_name);
-                break;
-        }
-    }
+    if(THIRDCHILD(root))
+        instructions_calc(THIRDCHILD(root), file, global_vars, functions, nb_functions, function_name);
 }
 
-static void manage_while(Node *root, FILE *file, SymTabs *global_vars, char *begin_label, char *end_label, SymTabsFct **functions, int nb_functions, char *function_name){
-    fprintf(file, "pop rax\n");
-    fprintf(file, "cmp rax, 0\n");
-    fprintf(file, "je %s\n", end_label);
-    Node *current = FIRSTCHILD(SECONDCHILD(root));
-    while(current){
-        do_calc(current, file, global_vars, functions, nb_functions, function_name);
-        current = current->nextSibling;
+/**
+ * @brief Writes the body of a while loop followed by its test.
+ *
+ * The test is at the bottom of the loop, so an iteration only executes the conditional jump
+ * back to the body.
+ */
+static void manage_while(Node *root, FILE *file, SymTabs *global_vars, char *body_label, char *test_label, IvLoop *iv, SymTabsFct **functions, int nb_functions, char *function_name){
+    fprintf(file, "%s:\n", body_label);
+    instructions_calc(SECONDCHILD(root), file, global_vars, functions, nb_functions, function_name);
+    fprintf(file, "%s:\n", test_label);
+    if(iv && iv->eliminated){
+        iv_test(iv, file, body_label, 0);
+        return;
     }
-    fprintf(file, "jmp %s\n", begin_label);
-    fprintf(file, "%s:\n", end_label);
+    branch_calc(FIRSTCHILD(root), file, global_vars, body_label, 1, functions, nb_functions, function_name);
 }
 
 /**
@@ -869,21 +1204,41 @@ static void if_calc(Node *root, FILE *file, SymTabs *global_vars, SymTabsFct **f
     char *else_label = create_label();
     char *end_label = create_label();
     fprintf(file, ";If\n");
-    get_value(FIRSTCHILD(root), file, global_vars, then_label, else_label, functions, nb_functions, function_name);
+    branch_calc(FIRSTCHILD(root), file, global_vars, else_label, 0, functions, nb_functions, function_name);
     manage_if_then_else(root, file, global_vars, then_label, else_label, end_label, functions, nb_functions, function_name);
     fprintf(file, "%s:\n", end_label);
     free(then_label);
     free(else_label);
 }
 
+/**
+ * @brief Writes a rotated while loop.
+ *
+ * A small condition is duplicated to guard the entry of the loop, otherwise the loop is entered
+ * by a jump to the test.
+ */
 static void while_calc(Node *root, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
-    char *begin_label = create_label();
+    char *body_label = create_label();
+    char *test_label = create_label();
     char *end_label = create_label();
+    IvLoop *iv = get_iv_loop(iv_loops, root);
     fprintf(file, ";While\n");
-    fprintf(file, "%s:\n", begin_label);
-    get_value(FIRSTCHILD(root), file, global_vars, begin_label, end_label, functions, nb_functions, function_name);
-    manage_while(root, file, global_vars, begin_label, end_label, functions, nb_functions, function_name);
-    free(begin_label);
+    if(optimize_level >= OPT_FULL)
+        vectorize_loop(root, file, global_vars, functions, nb_functions, function_name);
+    if(iv)
+        iv_init(iv, file, global_vars, functions, nb_functions, function_name);
+    if(iv && iv->eliminated)
+        iv_test(iv, file, end_label, 1);
+    else if(countNodes(FIRSTCHILD(root)) <= ROTATE_MAX_COND)
+        branch_calc(FIRSTCHILD(root), file, global_vars, end_label, 0, functions, nb_functions, function_name);
+    else
+        fprintf(file, "jmp %s\n", test_label);
+    manage_while(root, file, global_vars, body_label, test_label, iv, functions, nb_functions, function_name);
+    fprintf(file, "%s:\n", end_label);
+    if(iv)
+        iv->active = 0;
+    free(body_label);
+    free(test_label);
     free(end_label);
 }
 
@@ -914,11 +1269,11 @@ static void or_calc(Node *root, FILE *file, SymTabs *global_vars, char *then_lab
     char * tmp2 = create_label();
     get_value(FIRSTCHILD(root), file, global_vars, then_label, else_label, functions, nb_functions, function_name);
     get_value(SECONDCHILD(root), file, global_vars, then_label, else_label, functions, nb_functions, function_name);
+    fprintf(file, "pop rcx\n");
     fprintf(file, "pop rax\n");
     fprintf(file, "cmp rax, 0\n");
     fprintf(file, "jne %s\n", tmp1);
-    fprintf(file, "pop rax\n");
-    fprintf(file, "cmp rax, 0\n");
+    fprintf(file, "cmp rcx, 0\n");
     fprintf(file, "jne %s\n", tmp1);
     fprintf(file, "mov rax, 0\n");
     fprintf(file, "jmp %s\n", tmp2);
@@ -935,11 +1290,11 @@ static void and_calc(Node *root, FILE *file, SymTabs *global_vars, char *then_la
     char * tmp2 = create_label();
     get_value(FIRSTCHILD(root), file, global_vars, then_label, else_label, functions, nb_functions, function_name);
     get_value(SECONDCHILD(root), file, global_vars, then_label, else_label, functions, nb_functions, function_name);
+    fprintf(file, "pop rcx\n");
     fprintf(file, "pop rax\n");
     fprintf(file, "cmp rax, 0\n");
     fprintf(file, "je %s\n", tmp1);
-    fprintf(file, "pop rax\n");
-    fprintf(file, "cmp rax, 0\n");
+    fprintf(file, "cmp rcx, 0\n");
     fprintf(file, "je %s\n", tmp1);
     fprintf(file, "mov rax, 1\n");
     fprintf(file, "jmp %s\n", tmp2);
@@ -995,10 +1350,8 @@ static void negative_calc(Node *root, FILE *file, SymTabs *global_vars, char *th
 }
 
 static void return_calc(Node *root, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
-    if(FIRSTCHILD(root)->label != Void){
-        get_value(FIRSTCHILD(root), file, global_vars, NULL, NULL, functions, nb_functions, function_name);
-        fprintf(file, "pop rax\n");
-    }
+    if(FIRSTCHILD(root)->label != Void)
+        value_calc(FIRSTCHILD(root), file, global_vars, functions, nb_functions, function_name);
     fprintf(file, "mov rsp, rbp\n");
     fprintf(file, "pop rbp\n");
     fprintf(file, "ret\n");
@@ -1012,6 +1365,11 @@ static void return_calc(Node *root, FILE *file, SymTabs *global_vars, SymTabsFct
  */
 void get_value(Node * root, FILE * file, SymTabs * global_vars, char *then_label,
  char *else_label, SymTabsFct **functions, int nb_functions, char *function_name){
+    if(optimize_level >= OPT_BASIC
+        && select_value(root, file, iv_loops, iv_frame, global_vars, functions, nb_functions, function_name)){
+        fprintf(file, "push rax\n");
+        return;
+    }
     switch(root->label){
         case Variable:
             ident_calc(FIRSTCHILD(root), file, global_vars, functions, nb_functions, function_name);
@@ -1055,15 +1413,22 @@ void get_value(Node * root, FILE * file, SymTabs * global_vars, char *then_label
     }
 }
 
-static void enter_func_calc(Node *root, FILE *file, SymTabsFct **functions, int nb_functions, char *function_name){
+static void enter_func_calc(Node *root, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
+    int nb_slots = 0;
     function_name = SECONDCHILD(root)->ident;
     fprintf(file, "%s:\n", function_name);
+    free_iv_loops(iv_loops);
+    iv_loops = NULL;
+    iv_frame = 0;
     for(int i = 0; i < nb_functions; ++i)
-        if(!strcmp(function_name, functions[i]->ident))
-            change_offset(functions[i]);
+        if(!strcmp(function_name, functions[i]->ident)){
+            iv_frame = layout_frame(functions[i]);
+            if(optimize_level >= OPT_BASIC)
+                iv_loops = find_iv_loops(FOURTHCHILD(root), functions[i], global_vars, &nb_slots);
+        }
     fprintf(file, "push rbp\n");
     fprintf(file, "mov rbp, rsp\n");
-    fprintf(file, "sub rsp, %d\n", nb_vars_function(functions, nb_functions, function_name) * 8);
+    fprintf(file, "sub rsp, %d\n", iv_frame + 8 * nb_slots);
 }
 
 int find_label_return(Node *root){
@@ -1116,7 +1481,7 @@ int do_calc(Node *root, FILE * file, SymTabs *global_vars, SymTabsFct **function
             return 1;
         case Function:
             if(FIRSTCHILD(root)->label == Type || FIRSTCHILD(root)->label == Void){
-                enter_func_calc(root, file, functions, nb_functions, function_name);
+                enter_func_calc(root, file, global_vars, functions, nb_functions, function_name);
                 return 0;
             }
             else{
@@ -1210,15 +1575,13 @@ int expression_type(Node *root, SymTabs *global_vars, SymTabsFct **functions, in
  * 
  * @param t The symbols table containing the global variables.
  */
-void build_global_vars_asm(SymTabs *t, char *filename){
-    FILE * file = try(fopen(filename, "w"), NULL);
+void build_global_vars_asm(SymTabs *t, FILE *file){
     int size = 0;
     fprintf(file, "section .bss\n");
     for(Table *current = t->first; current; current = current->next)
         size += current->var.is_array ? current->var.size * (current->var.is_int ? 4 : 1) : (current->var.is_int ? 4 : 1);
     if(size > 0)
         fprintf(file, "global_vars resb %d\n", size);
-    try(fclose(file));
 }
 
 /**
@@ -1226,10 +1589,20 @@ void build_global_vars_asm(SymTabs *t, char *filename){
  * @param root The root node of the tree.
  */
 void build_minimal_asm(FILE *file, Node *root, SymTabs *global_vars, SymTabsFct **functions, int nb_functions){
-    char *function_name = NULL;
-    in_depth_course(root, do_calc, NULL, NULL, global_vars, file, functions, nb_functions, function_name);
-    build_external_fcts(file);
-    try(fclose(file));
+    char *function_name = NULL, *code = NULL, *strings = NULL;
+    size_t size = 0, strings_size = 0;
+    FILE *code_file = try(open_memstream(&code, &size), NULL);
+    string_file = try(open_memstream(&strings, &strings_size), NULL);
+    in_depth_course(root, do_calc, NULL, NULL, global_vars, code_file, functions, nb_functions, function_name);
+    free_iv_loops(iv_loops);
+    iv_loops = NULL;
+    try(fclose(code_file));
+    layout_code(code, file);
+    free(code);
+    try(fclose(string_file));
+    if(nb_strings)
+        fprintf(file, "section .rodata\n%s", strings);
+    free(strings);
 }
 
 /**
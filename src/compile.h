@@ -14,6 +14,7 @@
 #include "try.h"
 #include "tree.h"
 #include "build.h"
+#include "layout.h"
 #include "../obj/tpcc.h"
 
 #define EXIT_ERROR 3
@@ -23,8 +24,10 @@
 #define CHAR 0
 #define VOID -1
 #define UNKNOWN -2
+#define ROTATE_MAX_COND 16 ///< Conditions with more nodes than this are not duplicated by loop rotation.
 
 extern Node *node;
+extern int inline_builtins; ///< Flag writing the calls of getchar and putchar inline, on the buffers of the runtime.
 
 /**
  * @brief Structure representing an element in the symbol table.
@@ -101,6 +104,14 @@ void fill_global_vars(SymTabs* t); ///< Function to fill the table with global v
 
 SymTabsFct** fill_decl_functions(int nb_func, SymTabs *global_vars, char *filename); ///< Function to fill the table with declared functions.
 
+Node *find_function_decl(char *function_name); ///< Function to find the declaration of a function in the tree.
+
+int is_function_call(Node *root); ///< Function to check if a node is a call (and not a declaration).
+
+int is_builtin_function(char *function_name); ///< Function to check if a function is one of the builtins.
+
+SymTabsFct** update_decl_functions(SymTabsFct **functions, int *nb_functions, SymTabs *global_vars); ///< Function to rebuild the tables of the declared functions.
+
 void in_depth_course(Node * root, int (*calc)(Node *, FILE *, SymTabs *, SymTabsFct **, int, char *),
  void (*table)(SymTabs *, Node *), void (*check)(Node *), SymTabs *t, FILE * file, SymTabsFct **functions, int nb_functions, char *function_name); ///< Function to traverse the tree in depth.
 
@@ -139,12 +150,15 @@ int nb_params_function(SymTabsFct **functions, int nb_functions, char *function_
 
 int find_label_return(Node *root); ///< Function to find the label of a return statement.
 
-int nb_vars_function(SymTabsFct **functions, int nb_functions, char *function_name); ///< Function to get the number of variables of a function.
 
 int expression_result(Node *root); ///< Function to get the result of an expression.
 
-void build_asm(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *filename); ///< Function to build assembly code from the tree.
+int character_value(Node *root); ///< Function to get the value of a character literal.
+
+char *create_label(); ///< Function to create a new label for the layout of the code.
+
+void build_asm(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, FILE *file); ///< Function to build assembly code from the tree.
 
-void build_global_vars_asm(SymTabs *t, char *filename); ///< Function to build assembly code for global variables.
+void build_global_vars_asm(SymTabs *t, FILE *file); ///< Function to build assembly code for global variables.
 
 #endif
\ No newline at end of file
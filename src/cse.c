@@ -0,0 +1,466 @@
+#include "cse.h"
+#include "vectorize.h"
+
+/**
+ * @brief State of the elimination in a function.
+ */
+typedef struct{
+    SymTabs *global_vars;
+    SymTabsFct **functions;
+    int nb_functions;
+    SymTabsFct *function;  ///< Table of the current function.
+    Node *corps;           ///< Body of the current function.
+    char **temps;          ///< Temporaries created so far, not in the tables yet.
+    int nb_temps;          ///< Number of temporaries.
+    int report;            ///< Flag telling if the eliminated expressions are reported on stderr.
+    int eliminated;        ///< Number of expressions eliminated in the current function.
+}CseCtx;
+
+static int function_index(CseCtx *ctx, char *function_name){
+    for(int i = 0; i < ctx->nb_functions; ++i)
+        if(!strcmp(ctx->functions[i]->ident, function_name))
+            return i;
+    return -1;
+}
+
+static int is_temp(CseCtx *ctx, char *var_name){
+    for(int i = 0; i < ctx->nb_temps; ++i)
+        if(!strcmp(ctx->temps[i], var_name))
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Gives the kind of a variable as the code generation resolves it, globals first.
+ */
+static int var_kind(CseCtx *ctx, char *var_name){
+    if(check_in_table(*ctx->global_vars, var_name))
+        return IV_GLOBAL;
+    if(check_in_table_fct(ctx->function->parameters, var_name))
+        return IV_PARAM;
+    return IV_LOCAL;
+}
+
+static Node *unwrap(Node *root){
+    return root->label == Expression ? FIRSTCHILD(root) : root;
+}
+
+/**
+ * @brief Tells if two expressions compute the same value, ignoring the Expression nodes
+ * around them and their siblings.
+ */
+static int same_expr(Node *a, Node *b){
+    Node *x, *y;
+    a = unwrap(a);
+    b = unwrap(b);
+    if(a->label != b->label || a->num != b->num || (!a->ident) != (!b->ident) || (a->ident && strcmp(a->ident, b->ident)))
+        return 0;
+    for(x = FIRSTCHILD(a), y = FIRSTCHILD(b); x && y; x = x->nextSibling, y = y->nextSibling)
+        if(!same_expr(x, y))
+            return 0;
+    return !x && !y;
+}
+
+static int has_call(Node *root, int user_only){
+    if(is_function_call(root) && (!user_only || !is_builtin_function(FIRSTCHILD(root)->ident)))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(has_call(child, user_only))
+            return 1;
+    return 0;
+}
+
+static int is_array_read(Node *root){
+    return root->label == Variable && FIRSTCHILD(root)->label == Array;
+}
+
+/**
+ * @brief Tells if an expression is worth a value number: arithmetic operators on variables
+ * and array elements, without any call since getint or getchar give a new value each time.
+ */
+static int is_candidate(Node *root){
+    if(root->label == Addsub || root->label == Divstar){
+        int constants = 1;
+        for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+            if(unwrap(child)->label != Num && unwrap(child)->label != Character)
+                constants = 0;
+        if(constants)
+            return 0;
+    }
+    else if(!is_array_read(root))
+        return 0;
+    return !has_call(root, 0);
+}
+
+/**
+ * @brief Tells if an expression reads a scalar variable, or an element of an array, with this name.
+ */
+static int reads_var(Node *root, char *var_name, int array){
+    if(root->label == Variable && is_array_read(root) == array
+        && !strcmp(array ? FIRSTCHILD(FIRSTCHILD(root))->ident : FIRSTCHILD(root)->ident, var_name))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(reads_var(child, var_name, array))
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Tells if an expression reads memory that a called function may assign: arrays and
+ * global variables.
+ */
+static int reads_memory(CseCtx *ctx, Node *root){
+    if(root->label == Variable && (is_array_read(root) || var_kind(ctx, FIRSTCHILD(root)->ident) == IV_GLOBAL))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(reads_memory(ctx, child))
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Tells if an expression reads an array that may share its elements with a stored one.
+ *
+ * A parameter array may be any array of the caller, so it aliases the global arrays and the
+ * other parameter arrays. The local arrays only alias themselves.
+ */
+static int reads_stored_array(CseCtx *ctx, Node *root, char *array){
+    if(is_array_read(root)){
+        char *name = FIRSTCHILD(FIRSTCHILD(root))->ident;
+        int kind = var_kind(ctx, array), other = var_kind(ctx, name);
+        if(!strcmp(name, array) || (kind != IV_LOCAL && other != IV_LOCAL && (kind == IV_PARAM || other == IV_PARAM)))
+            return 1;
+    }
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(reads_stored_array(ctx, child, array))
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Tells if a statement may change the value of an expression: it assigns a variable
+ * read by the expression, stores into an array it reads, or calls a function while the
+ * expression reads memory.
+ */
+static int kills(CseCtx *ctx, Node *stmt, Node *expr){
+    Node *target;
+    if(has_call(stmt, 1) && reads_memory(ctx, expr))
+        return 1;
+    if(stmt->label != Equals)
+        return 0;
+    target = FIRSTCHILD(FIRSTCHILD(stmt));
+    if(target->label == Array)
+        return reads_stored_array(ctx, expr, FIRSTCHILD(target)->ident);
+    return reads_var(expr, target->ident, 0);
+}
+
+/**
+ * @brief Tells if a statement belongs to a basic block: assignments, calls and returns.
+ */
+static int is_simple(Node *stmt){
+    return stmt->label == Equals || stmt->label == Return || is_function_call(stmt);
+}
+
+/**
+ * @brief Gives the expressions a simple statement evaluates, in the order of the code.
+ * @return Their number.
+ */
+static int stmt_expressions(Node *stmt, Node **exprs){
+    int nb = 0;
+    if(stmt->label == Equals){
+        if(FIRSTCHILD(FIRSTCHILD(stmt))->label == Array)
+            exprs[nb++] = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(stmt))));
+        exprs[nb++] = SECONDCHILD(stmt);
+    }
+    else if(stmt->label == Return){
+        if(FIRSTCHILD(stmt) && FIRSTCHILD(stmt)->label != Void)
+            exprs[nb++] = FIRSTCHILD(stmt);
+    }
+    else
+        exprs[nb++] = FIRSTCHILD(FIRSTCHILD(stmt));
+    return nb;
+}
+
+static void collect(Node *root, Node *expr, Node ***uses, int *nb_uses){
+    for(; root; root = root->nextSibling){
+        if(root->label != Expression && same_expr(root, expr)){
+            *uses = (Node**) try(realloc(*uses, sizeof(Node*) * (*nb_uses + 1)), NULL);
+            (*uses)[(*nb_uses)++] = root;
+        }
+        else
+            collect(FIRSTCHILD(root), expr, uses, nb_uses);
+    }
+}
+
+static void collect_stmt(Node *stmt, Node *expr, Node ***uses, int *nb_uses){
+    Node *exprs[2];
+    int nb = stmt_expressions(stmt, exprs);
+    for(int i = 0; i < nb; ++i){
+        Node *next = exprs[i]->nextSibling;
+        exprs[i]->nextSibling = NULL;
+        collect(exprs[i], expr, uses, nb_uses);
+        exprs[i]->nextSibling = next;
+    }
+}
+
+static char *temp_name(CseCtx *ctx){
+    static int counter = 0;
+    char *name = (char*) try(malloc(sizeof(char) * (strlen(CSE_TEMP_PREFIX) + 12)), NULL);
+    do
+        sprintf(name, CSE_TEMP_PREFIX "%d", ++counter);
+    while(is_temp(ctx, name) || check_in_table_fct(ctx->function->parameters, name) || check_in_table_fct(ctx->function->variables, name)
+        || check_in_table(*ctx->global_vars, name) || find_function_decl(name));
+    ctx->temps = (char**) try(realloc(ctx->temps, sizeof(char*) * (ctx->nb_temps + 1)), NULL);
+    ctx->temps[ctx->nb_temps++] = name;
+    return name;
+}
+
+static void declare_temp(CseCtx *ctx, char *name, int type){
+    Node *decl = makeNode(Type), *ident = makeNode(Ident);
+    decl->ident = strdup(type == CHAR ? "char" : "int");
+    ident->ident = strdup(name);
+    addChild(decl, ident);
+    decl->nextSibling = ctx->corps->firstChild;
+    ctx->corps->firstChild = decl;
+}
+
+static void replace_by_var(Node *root, char *var_name){
+    Node *ident = makeNode(Ident), *next = root->nextSibling;
+    ident->ident = strdup(var_name);
+    if(FIRSTCHILD(root))
+        deleteTree(FIRSTCHILD(root));
+    root->firstChild = NULL;
+    root->label = Variable;
+    root->ident = NULL;
+    root->num = 0;
+    addChild(root, ident);
+    root->nextSibling = next;
+}
+
+static void print_expr(FILE *file, Node *root){
+    root = unwrap(root);
+    switch(root->label){
+        case Num:
+            fprintf(file, "%d", root->num);
+            break;
+        case Character:
+            fprintf(file, "%s", root->ident);
+            break;
+        case Variable:
+            if(is_array_read(root)){
+                fprintf(file, "%s[", FIRSTCHILD(FIRSTCHILD(root))->ident);
+                print_expr(file, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
+                fprintf(file, "]");
+            }
+            else
+                fprintf(file, "%s", FIRSTCHILD(root)->ident);
+            break;
+        case Function:
+            fprintf(file, "%s(", FIRSTCHILD(root)->ident);
+            for(Node *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); arg; arg = arg->nextSibling){
+                print_expr(file, arg);
+                if(arg->nextSibling)
+                    fprintf(file, ", ");
+            }
+            fprintf(file, ")");
+            break;
+        default:
+            if(!SECONDCHILD(root)){
+                fprintf(file, "%s", root->label == Not ? "!" : root->ident);
+                print_expr(file, FIRSTCHILD(root));
+                break;
+            }
+            fprintf(file, "(");
+            print_expr(file, FIRSTCHILD(root));
+            fprintf(file, " %s ", root->ident ? root->ident : root->label == And ? "&&" : "||");
+            print_expr(file, SECONDCHILD(root));
+            fprintf(file, ")");
+            break;
+    }
+}
+
+/**
+ * @brief Gives the other uses of the value of an assignment to a scalar, until the scalar or
+ * an operand of the value is assigned again.
+ * @return The number of uses found, 0 when the value can't be read back from the scalar.
+ */
+static int reuse_assigned(CseCtx *ctx, Node *affect, Node ***uses){
+    Node *target = FIRSTCHILD(FIRSTCHILD(affect)), *value = unwrap(SECONDCHILD(affect));
+    int nb_uses = 0;
+    if(target->label == Array || var_kind(ctx, target->ident) == IV_GLOBAL || !is_candidate(value) || reads_var(value, target->ident, 0)
+        || (find_type_in_fct(target->ident, ctx->function) == CHAR
+            && expression_type(value, ctx->global_vars, ctx->functions, ctx->nb_functions, ctx->function->ident) != CHAR))
+        return 0;
+    for(Node *stmt = affect->nextSibling; stmt && is_simple(stmt); stmt = stmt->nextSibling){
+        if(!has_call(stmt, 1) || !reads_memory(ctx, value))
+            collect_stmt(stmt, value, uses, &nb_uses);
+        if(stmt->label == Return || kills(ctx, stmt, value) || (stmt->label == Equals && reads_var(FIRSTCHILD(stmt), target->ident, 0)))
+            break;
+    }
+    return nb_uses;
+}
+
+/**
+ * @brief Computes an expression of a statement once for all its uses in the rest of the block.
+ * @param link Pointer to the statement in its list.
+ * @return 1 if the expression is used several times and was replaced by a temporary.
+ */
+static int eliminate_expr(CseCtx *ctx, Node **link, Node *expr){
+    Node **uses = NULL, *affect, *var, *ident, *value;
+    int nb_uses = 0;
+    char *name;
+    for(Node *stmt = *link; stmt && is_simple(stmt); stmt = stmt->nextSibling){
+        if(!has_call(stmt, 1) || !reads_memory(ctx, expr))
+            collect_stmt(stmt, expr, &uses, &nb_uses);
+        if(stmt->label == Return || kills(ctx, stmt, expr))
+            break;
+    }
+    if(nb_uses < 2){
+        free(uses);
+        return 0;
+    }
+    affect = makeNode(Equals);
+    var = makeNode(Variable);
+    ident = makeNode(Ident);
+    value = makeNode(Expression);
+    name = temp_name(ctx);
+    ident->ident = strdup(name);
+    declare_temp(ctx, name, expression_type(expr, ctx->global_vars, ctx->functions, ctx->nb_functions, ctx->function->ident));
+    affect->ident = "=";
+    affect->lineno = (*link)->lineno;
+    addChild(var, ident);
+    addChild(value, copyTree(unwrap(expr)));
+    addChild(affect, var);
+    addChild(affect, value);
+    if(ctx->report){
+        fprintf(stderr, "%s, line %d: ", ctx->function->ident, (*link)->lineno);
+        print_expr(stderr, expr);
+        fprintf(stderr, " computed once for %d uses\n", nb_uses);
+    }
+    for(int i = 0; i < nb_uses; ++i)
+        replace_by_var(uses[i], name);
+    affect->nextSibling = *link;
+    *link = affect;
+    ctx->eliminated++;
+    free(uses);
+    return 1;
+}
+
+/**
+ * @brief Finds the first expression of a statement, in preorder, that the rest of its block uses again.
+ */
+static int eliminate_in_expressions(CseCtx *ctx, Node **link, Node *root){
+    if(root->label != Expression && is_candidate(root) && eliminate_expr(ctx, link, root))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(eliminate_in_expressions(ctx, link, child))
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Eliminates one common subexpression in the basic blocks of a list of statements.
+ * @return 1 if an expression was eliminated.
+ */
+static int eliminate_once(CseCtx *ctx, Node **first){
+    for(Node **link = first; *link; link = &(*link)->nextSibling){
+        Node *exprs[2], **uses = NULL;
+        int nb, nb_uses;
+        if(!is_simple(*link))
+            continue;
+        if((*link)->label == Equals && (nb_uses = reuse_assigned(ctx, *link, &uses))){
+            Node *affect = *link;
+            char *var_name = FIRSTCHILD(FIRSTCHILD(affect))->ident;
+            if(ctx->report){
+                fprintf(stderr, "%s, line %d: ", ctx->function->ident, affect->lineno);
+                print_expr(stderr, SECONDCHILD(affect));
+                fprintf(stderr, " reused from %s for %d use%s\n", var_name, nb_uses, nb_uses > 1 ? "s" : "");
+            }
+            for(int i = 0; i < nb_uses; ++i)
+                replace_by_var(uses[i], var_name);
+            ctx->eliminated++;
+            free(uses);
+            return 1;
+        }
+        nb = stmt_expressions(*link, exprs);
+        for(int i = 0; i < nb; ++i)
+            if(eliminate_in_expressions(ctx, link, exprs[i]))
+                return 1;
+    }
+    return 0;
+}
+
+static void eliminate_stmt(CseCtx *ctx, Node **link, int in_list);
+
+static void eliminate_list(CseCtx *ctx, Node **first){
+    for(int round = 0; round < CSE_MAX_ROUNDS && eliminate_once(ctx, first); ++round);
+    for(Node **link = first; *link; link = &(*link)->nextSibling)
+        eliminate_stmt(ctx, link, 1);
+}
+
+/**
+ * @brief Eliminates the common subexpressions of the blocks nested in a statement.
+ * @param link Pointer to the statement in its parent.
+ * @param in_list Flag telling if the statement is in a list of instructions. Otherwise it is
+ * wrapped in a new list when temporaries are assigned before it.
+ */
+static void eliminate_stmt(CseCtx *ctx, Node **link, int in_list){
+    Node *root = *link;
+    if(!in_list && is_simple(root)){
+        Node *block = makeNode(Instructions);
+        block->nextSibling = root->nextSibling;
+        root->nextSibling = NULL;
+        block->firstChild = root;
+        eliminate_list(ctx, &block->firstChild);
+        if(block->firstChild->nextSibling)
+            *link = block;
+        else{
+            root->nextSibling = block->nextSibling;
+            free(block);
+        }
+        return;
+    }
+    switch(root->label){
+        case Instructions:
+            eliminate_list(ctx, &root->firstChild);
+            break;
+        case If:
+            eliminate_stmt(ctx, &FIRSTCHILD(root)->nextSibling, 0);
+            if(THIRDCHILD(root))
+                eliminate_stmt(ctx, &SECONDCHILD(root)->nextSibling, 0);
+            break;
+        case While:
+            if(!is_vectorizable(root, ctx->global_vars, ctx->function))
+                eliminate_stmt(ctx, &FIRSTCHILD(root)->nextSibling, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Computes the expressions used several times in a basic block only once.
+ *
+ * A basic block is a run of assignments, calls and returns. Each expression gets a value number
+ * by comparing its tree with the later ones of the block, until a statement kills it: an
+ * assignment of one of its variables, a store into an array it reads or may alias, or a call
+ * when it reads arrays or globals. The first computation is assigned to a temporary read by
+ * all the uses, or read back from the scalar it was assigned to.
+ * @return The tables of the functions, temporaries included.
+ */
+SymTabsFct** eliminate_common_subexpressions(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    CseCtx ctx = {global_vars, functions, *nb_functions, NULL, NULL, NULL, 0, report, 0};
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        int index;
+        if(current->label != Function || (index = function_index(&ctx, SECONDCHILD(current)->ident)) < 0)
+            continue;
+        ctx.function = functions[index];
+        ctx.corps = FOURTHCHILD(current);
+        ctx.eliminated = 0;
+        eliminate_list(&ctx, &ctx.corps->firstChild);
+        if(report && ctx.eliminated)
+            fprintf(stderr, "%s: %d common subexpression%s eliminated\n", ctx.function->ident, ctx.eliminated, ctx.eliminated > 1 ? "s" : "");
+    }
+    free(ctx.temps);
+    return update_decl_functions(functions, nb_functions, global_vars);
+}
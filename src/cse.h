@@ -0,0 +1,16 @@
+/**
+ * @file cse.h
+ * @brief Local value numbering and elimination of the common subexpressions.
+ */
+
+#ifndef __CSE__H
+#define __CSE__H
+
+#include "compile.h"
+
+#define CSE_TEMP_PREFIX "cse"  ///< Prefix of the variables holding the reused expressions.
+#define CSE_MAX_ROUNDS 256     ///< Maximum number of expressions eliminated in a list of statements.
+
+SymTabsFct** eliminate_common_subexpressions(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report); ///< Function to compute the expressions used several times in a basic block only once, reporting them on stderr if asked.
+
+#endif
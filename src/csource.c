@@ -0,0 +1,740 @@
+#include "csource.h"
+#include "build.h"
+
+#define C_GETCHAR 0 ///< Index of getchar in the builtins used.
+#define C_GETINT 1  ///< Index of getint in the builtins used.
+#define C_PUTCHAR 2 ///< Index of putchar with one character in the builtins used.
+#define C_PUTINT 3  ///< Index of putint in the builtins used.
+#define C_PUTS 4    ///< Index of putchar with several characters in the builtins used.
+
+/**
+ * @brief Start of the C file: the arithmetic wrapping on 64 bits like the registers, and the
+ * division stopping the program with SIGFPE like idiv.
+ */
+static const char *c_prelude =
+    "#include <signal.h>\n"
+    "#include <stdint.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <unistd.h>\n"
+    "\n"
+    "static inline int64_t tpc_add(int64_t a, int64_t b){ return (int64_t) ((uint64_t) a + (uint64_t) b); }\n"
+    "static inline int64_t tpc_sub(int64_t a, int64_t b){ return (int64_t) ((uint64_t) a - (uint64_t) b); }\n"
+    "static inline int64_t tpc_mul(int64_t a, int64_t b){ return (int64_t) ((uint64_t) a * (uint64_t) b); }\n"
+    "static inline int64_t tpc_neg(int64_t a){ return (int64_t) (0 - (uint64_t) a); }\n"
+    "\n"
+    "static inline void tpc_divide_error(void){\n"
+    "    raise(SIGFPE);\n"
+    "    abort();\n"
+    "}\n"
+    "\n"
+    "static inline int64_t tpc_div(int64_t a, int64_t b){\n"
+    "    if(b == 0 || (a == INT64_MIN && b == -1))\n"
+    "        tpc_divide_error();\n"
+    "    return a / b;\n"
+    "}\n"
+    "\n"
+    "static inline int64_t tpc_mod(int64_t a, int64_t b){\n"
+    "    if(b == 0 || (a == INT64_MIN && b == -1))\n"
+    "        tpc_divide_error();\n"
+    "    return a %% b;\n"
+    "}\n"
+    "\n"
+    "static char tpc_out[%d];\n"
+    "static int64_t tpc_out_length = 0;\n"
+    "#define TPC_LINE_BUFFERED %d\n"
+    "\n"
+    "/* Écrit le tampon de sortie, une écriture partielle étant suivie d'une autre. */\n"
+    "static inline void tpc_flush(void){\n"
+    "    int64_t done = 0, res;\n"
+    "    while(done < tpc_out_length && (res = write(1, tpc_out + done, tpc_out_length - done)) > 0)\n"
+    "        done += res;\n"
+    "    tpc_out_length = 0;\n"
+    "}\n";
+
+/**
+ * @brief Routines of the runtime in C, with the same buffers and the same flushes as the
+ * routines in assembly.
+ */
+static const char *c_input =
+    "\n"
+    "static unsigned char tpc_in[%d];\n"
+    "static int64_t tpc_in_start = 0, tpc_in_end = 0;\n"
+    "\n"
+    "/* Remplit le tampon d'entrée, après avoir écrit la sortie en attente. */\n"
+    "static inline int64_t tpc_fill(void){\n"
+    "    int64_t res;\n"
+    "    tpc_flush();\n"
+    "    res = read(0, tpc_in, sizeof(tpc_in));\n"
+    "    tpc_in_start = 0;\n"
+    "    tpc_in_end = res > 0 ? res : 0;\n"
+    "    return res;\n"
+    "}\n"
+    "\n"
+    "/* 0 à la fin de l'entrée. */\n"
+    "static inline int64_t tpc_getchar(void){\n"
+    "    if(tpc_in_start >= tpc_in_end && tpc_fill() <= 0)\n"
+    "        return 0;\n"
+    "    return tpc_in[tpc_in_start++];\n"
+    "}\n";
+
+static const char *c_getint =
+    "\n"
+    "/* Un '-' facultatif puis des chiffres, le caractère suivant étant consommé. Sans chiffre ni '-',\n"
+    "   le programme s'arrête avec le code 5. */\n"
+    "static inline int64_t tpc_getint(void){\n"
+    "    uint64_t value = 0, digit;\n"
+    "    int64_t sign = 1, first = tpc_getchar();\n"
+    "    if(first == '-')\n"
+    "        sign = -1;\n"
+    "    else if((uint64_t) (first - '0') > 9){\n"
+    "        tpc_flush();\n"
+    "        exit(5);\n"
+    "    }\n"
+    "    else\n"
+    "        value = first - '0';\n"
+    "    while(tpc_in_start < tpc_in_end || tpc_fill() > 0){\n"
+    "        digit = tpc_in[tpc_in_start++] - (uint64_t) '0';\n"
+    "        if(digit > 9)\n"
+    "            break;\n"
+    "        value = value * 10 + digit;\n"
+    "    }\n"
+    "    return (int64_t) (value * (uint64_t) sign);\n"
+    "}\n";
+
+static const char *c_putchar =
+    "\n"
+    "static inline void tpc_putchar(int64_t character){\n"
+    "    if(tpc_out_length >= (int64_t) sizeof(tpc_out))\n"
+    "        tpc_flush();\n"
+    "    tpc_out[tpc_out_length++] = (char) character;\n"
+    "    if((char) character == '\\n' && TPC_LINE_BUFFERED)\n"
+    "        tpc_flush();\n"
+    "}\n";
+
+static const char *c_putint =
+    "\n"
+    "/* Les chiffres sont écrits deux par deux, depuis la fin. */\n"
+    "static inline void tpc_putint(int64_t value){\n"
+    "    static const char digits[] = \"%s\";\n"
+    "    char scratch[%d], *first = scratch + sizeof(scratch);\n"
+    "    uint64_t magnitude = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;\n"
+    "    if(tpc_out_length > (int64_t) (sizeof(tpc_out) - sizeof(scratch)))\n"
+    "        tpc_flush();\n"
+    "    for(; magnitude >= 100; magnitude /= 100){\n"
+    "        first -= 2;\n"
+    "        memcpy(first, digits + magnitude %% 100 * 2, 2);\n"
+    "    }\n"
+    "    if(magnitude >= 10){\n"
+    "        first -= 2;\n"
+    "        memcpy(first, digits + magnitude * 2, 2);\n"
+    "    }\n"
+    "    else\n"
+    "        *--first = '0' + magnitude;\n"
+    "    if(value < 0)\n"
+    "        *--first = '-';\n"
+    "    memcpy(tpc_out + tpc_out_length, first, scratch + sizeof(scratch) - first);\n"
+    "    tpc_out_length += scratch + sizeof(scratch) - first;\n"
+    "}\n";
+
+static const char *c_puts =
+    "\n"
+    "/* Les caractères d'un appel de putchar sur plusieurs constantes, écrits d'un coup. */\n"
+    "static inline void tpc_puts(const char *characters, int64_t length){\n"
+    "    if(tpc_out_length > (int64_t) sizeof(tpc_out) - (length + 7) / 8 * 8)\n"
+    "        tpc_flush();\n"
+    "    memcpy(tpc_out + tpc_out_length, characters, length);\n"
+    "    tpc_out_length += length;\n"
+    "    if(TPC_LINE_BUFFERED && memchr(characters, '\\n', length))\n"
+    "        tpc_flush();\n"
+    "}\n";
+
+
+/**
+ * @brief State of the translation of a function.
+ *
+ * C leaves the order of the operands and of the arguments unspecified, so the operands of an
+ * instruction calling a function are computed first in temporaries, in the order of the native
+ * code, the reads of the memory included since a later call could change it. The instruction
+ * then reads the temporaries.
+ */
+typedef struct{
+    FILE *file;              ///< Body of the functions.
+    SymTabs *global_vars;
+    SymTabsFct *function;    ///< Table of the current function.
+    Node **hoisted;          ///< Operands of the current instruction computed in a temporary.
+    int nb_hoisted;          ///< Number of operands computed, the temporary of the i-th being i + 1.
+    int nb_temps;            ///< Temporaries of the current function.
+    int depth;               ///< Indentation of the current instruction.
+    int used[5];             ///< Flags of the routines of the runtime used, C_GETCHAR to C_PUTS.
+}CCtx;
+
+static Node *unwrap(Node *root){
+    while(root->label == Expression)
+        root = FIRSTCHILD(root);
+    return root;
+}
+
+static int has_call(Node *root){
+    if(root->label == Function)
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(has_call(child))
+            return 1;
+    return 0;
+}
+
+static Element *find_element(Table *table, char *var_name){
+    for(Table *current = table; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return &current->var;
+    return NULL;
+}
+
+/**
+ * @brief Finds a variable like the native code: the global scalars first, then the parameters,
+ * the local variables and the global arrays.
+ * @param is_global Set to 1 for a global variable.
+ */
+static Element *find_variable(CCtx *ctx, char *var_name, int *is_global){
+    Element *var = find_element(ctx->global_vars->first, var_name), *local = NULL;
+    if(!var || var->is_array)
+        local = find_element(ctx->function->parameters, var_name);
+    if((!var || var->is_array) && !local)
+        local = find_element(ctx->function->variables, var_name);
+    *is_global = local == NULL;
+    return local ? local : var;
+}
+
+/**
+ * @brief Tells if a name appears in the instructions of a function, its declarations aside.
+ */
+static int uses_name(Node *root, char *var_name){
+    for(; root; root = root->nextSibling)
+        if(root->label != Type && ((root->label == Ident && root->ident && !strcmp(root->ident, var_name))
+            || uses_name(FIRSTCHILD(root), var_name)))
+            return 1;
+    return 0;
+}
+
+static void indent(CCtx *ctx){
+    for(int i = 0; i < ctx->depth; ++i)
+        fprintf(ctx->file, "    ");
+}
+
+static int nb_args(Node *root){
+    int res = 0;
+    for(Node *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); arg && arg->label != Void; arg = arg->nextSibling)
+        res++;
+    return res;
+}
+
+static void write_number(FILE *file, long value){
+    if(value == -2147483648L)
+        fprintf(file, "(-2147483647 - 1)");
+    else if(value < 0)
+        fprintf(file, "(%ld)", value);
+    else
+        fprintf(file, "%ld", value);
+}
+
+static char *c_type(int is_int){
+    return is_int ? "int32_t" : "int8_t";
+}
+
+static void write_variable_name(CCtx *ctx, char *var_name){
+    int is_global;
+    find_variable(ctx, var_name, &is_global);
+    fprintf(ctx->file, "%s%s", is_global ? C_GLOBAL_PREFIX : C_VAR_PREFIX, var_name);
+}
+
+static void write_call(CCtx *ctx, Node *root);
+
+static void write_expr(CCtx *ctx, Node *root);
+
+/**
+ * @brief Writes the condition of an if or of a while, between the parentheses of the keyword.
+ */
+static void write_condition(CCtx *ctx, char *keyword, Node *root){
+    label_t label = unwrap(root)->label;
+    fprintf(ctx->file, "%s", keyword);
+    if(label == And || label == Or || label == Eq || label == Order)
+        write_expr(ctx, root);
+    else{
+        fprintf(ctx->file, "(");
+        write_expr(ctx, root);
+        fprintf(ctx->file, ")");
+    }
+}
+
+static void write_expr(CCtx *ctx, Node *root){
+    static char *helpers[] = {"tpc_add", "tpc_sub", "tpc_mul", "tpc_div", "tpc_mod"};
+    root = unwrap(root);
+    for(int i = 0; i < ctx->nb_hoisted; ++i)
+        if(ctx->hoisted[i] == root){
+            fprintf(ctx->file, C_TEMP_PREFIX "%d", i + 1);
+            return;
+        }
+    switch(root->label){
+        case Num:
+            write_number(ctx->file, root->num);
+            return;
+        case Character:
+            write_number(ctx->file, character_value(root));
+            return;
+        case Variable:
+            if(FIRSTCHILD(root)->label == Ident){
+                write_variable_name(ctx, FIRSTCHILD(root)->ident);
+                return;
+            }
+            write_variable_name(ctx, FIRSTCHILD(FIRSTCHILD(root))->ident);
+            fprintf(ctx->file, "[");
+            write_expr(ctx, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
+            fprintf(ctx->file, "]");
+            return;
+        case Function:
+            write_call(ctx, root);
+            return;
+        case Not:
+            fprintf(ctx->file, "!");
+            write_expr(ctx, FIRSTCHILD(root));
+            return;
+        case And:
+        case Or:
+        case Eq:
+        case Order:
+            fprintf(ctx->file, "(");
+            write_expr(ctx, FIRSTCHILD(root));
+            fprintf(ctx->file, " %s ", root->label == And ? "&&" : root->label == Or ? "||" : root->ident);
+            write_expr(ctx, SECONDCHILD(root));
+            fprintf(ctx->file, ")");
+            return;
+        case Addsub:
+            if(!SECONDCHILD(root)){
+                fprintf(ctx->file, root->ident[0] == '-' ? "tpc_neg(" : "(");
+                write_expr(ctx, FIRSTCHILD(root));
+                fprintf(ctx->file, ")");
+                return;
+            }
+            fprintf(ctx->file, "%s(", helpers[root->ident[0] == '-']);
+            break;
+        case Divstar:
+            fprintf(ctx->file, "%s(", helpers[root->ident[0] == '*' ? 2 : root->ident[0] == '/' ? 3 : 4]);
+            break;
+        default:
+            fprintf(ctx->file, "0");
+            return;
+    }
+    write_expr(ctx, FIRSTCHILD(root));
+    fprintf(ctx->file, ", ");
+    write_expr(ctx, SECONDCHILD(root));
+    fprintf(ctx->file, ")");
+}
+
+/**
+ * @brief Writes a call, the arrays given to a function being cast to the type of its parameter.
+ */
+static void write_call(CCtx *ctx, Node *root){
+    char *function_name = FIRSTCHILD(root)->ident;
+    Node *args = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))), *param = NULL, *decl;
+    if(!strcmp(function_name, "putchar") && nb_args(root) > 1){
+        fprintf(ctx->file, "tpc_puts(\"");
+        for(Node *arg = args; arg; arg = arg->nextSibling){
+            Node *value = unwrap(arg);
+            int character = (value->label == Num ? value->num : character_value(value)) & 0xff;
+            if(character >= ' ' && character <= '~' && character != '"' && character != '\\' && character != '?')
+                fprintf(ctx->file, "%c", character);
+            else
+                fprintf(ctx->file, "\\%03o", character);
+        }
+        fprintf(ctx->file, "\", %d)", nb_args(root));
+        return;
+    }
+    if(is_builtin_function(function_name))
+        fprintf(ctx->file, "tpc_%s(", function_name);
+    else{
+        fprintf(ctx->file, C_FUNCTION_PREFIX "%s(", function_name);
+        if((decl = find_function_decl(function_name)))
+            param = FIRSTCHILD(THIRDCHILD(decl));
+    }
+    for(Node *arg = args; arg && arg->label != Void; arg = arg->nextSibling){
+        if(arg != args)
+            fprintf(ctx->file, ", ");
+        if(param && param->label == Type && FIRSTCHILD(param)->label == Array)
+            fprintf(ctx->file, "(%s *) ", c_type(!strcmp(param->ident, "int")));
+        write_expr(ctx, arg);
+        if(param)
+            param = param->nextSibling;
+    }
+    fprintf(ctx->file, ")");
+}
+
+static int is_trivial(CCtx *ctx, Node *root){
+    int is_global;
+    Element *var;
+    root = unwrap(root);
+    if(root->label == Num || root->label == Character)
+        return 1;
+    if(root->label != Variable || FIRSTCHILD(root)->label != Ident)
+        return 0;
+    var = find_variable(ctx, FIRSTCHILD(root)->ident, &is_global);
+    return !is_global || (var && var->is_array);
+}
+
+static void hoist_operand(CCtx *ctx, Node *root);
+
+/**
+ * @brief Computes in temporaries the operands of an expression calling a function, in the order
+ * of the native code, so that only the constants and the local scalars are left in it.
+ *
+ * The second operand of && and || stays in the expression when it calls no function, the native
+ * code not computing it then.
+ */
+static void hoist_operands(CCtx *ctx, Node *root){
+    int nb_calls = 0;
+    root = unwrap(root);
+    if(root->label == Function)
+        for(Node *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); arg && arg->label != Void; arg = arg->nextSibling)
+            nb_calls += has_call(arg);
+    else
+        nb_calls = has_call(root);
+    if(!nb_calls)
+        return;
+    switch(root->label){
+        case Function:
+            for(Node *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); arg && arg->label != Void; arg = arg->nextSibling)
+                hoist_operand(ctx, arg);
+            break;
+        case Variable:
+            hoist_operand(ctx, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
+            break;
+        case And:
+        case Or:
+            hoist_operand(ctx, FIRSTCHILD(root));
+            if(has_call(SECONDCHILD(root)))
+                hoist_operand(ctx, SECONDCHILD(root));
+            break;
+        default:
+            for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+                hoist_operand(ctx, child);
+            break;
+    }
+}
+
+static void hoist_operand(CCtx *ctx, Node *root){
+    if(is_trivial(ctx, root))
+        return;
+    hoist_operands(ctx, root);
+    ctx->hoisted = (Node**) try(realloc(ctx->hoisted, sizeof(Node*) * (ctx->nb_hoisted + 1)), NULL);
+    indent(ctx);
+    fprintf(ctx->file, C_TEMP_PREFIX "%d = ", ctx->nb_hoisted + 1);
+    write_expr(ctx, root);
+    fprintf(ctx->file, ";\n");
+    ctx->hoisted[ctx->nb_hoisted++] = unwrap(root);
+    ctx->nb_temps = max(ctx->nb_temps, ctx->nb_hoisted);
+}
+
+static void write_stmt(CCtx *ctx, Node *root);
+
+static void write_block(CCtx *ctx, Node *root){
+    fprintf(ctx->file, "{\n");
+    ctx->depth++;
+    write_stmt(ctx, root);
+    ctx->depth--;
+    indent(ctx);
+    fprintf(ctx->file, "}");
+}
+
+/**
+ * @brief Writes an assignment, the value being computed before the index like the native code,
+ * and truncated to the size of a global variable or of an element of an array.
+ */
+static void write_assignment(CCtx *ctx, Node *root){
+    Node *target = FIRSTCHILD(FIRSTCHILD(root));
+    int is_global, is_array = target->label == Array;
+    Element *var = find_variable(ctx, is_array ? FIRSTCHILD(target)->ident : target->ident, &is_global);
+    if(is_array && has_call(FIRSTCHILD(FIRSTCHILD(target)))){
+        hoist_operand(ctx, SECONDCHILD(root));
+        hoist_operands(ctx, FIRSTCHILD(FIRSTCHILD(target)));
+    }
+    else
+        hoist_operands(ctx, SECONDCHILD(root));
+    indent(ctx);
+    write_expr(ctx, FIRSTCHILD(root));
+    fprintf(ctx->file, " = ");
+    if(var && (is_array || is_global))
+        fprintf(ctx->file, "(%s) ", c_type(var->is_int));
+    write_expr(ctx, SECONDCHILD(root));
+    fprintf(ctx->file, ";\n");
+}
+
+/**
+ * @brief Writes an instruction, or every instruction of a block.
+ *
+ * A while loop whose condition calls a function becomes an endless loop computing the condition
+ * at the start of each iteration.
+ */
+static void write_stmt(CCtx *ctx, Node *root){
+    if(!root)
+        return;
+    ctx->nb_hoisted = 0;
+    switch(root->label){
+        case Instructions:
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+                write_stmt(ctx, current);
+            break;
+        case Equals:
+            write_assignment(ctx, root);
+            break;
+        case If:
+            hoist_operands(ctx, FIRSTCHILD(root));
+            indent(ctx);
+            write_condition(ctx, "if", FIRSTCHILD(root));
+            write_block(ctx, SECONDCHILD(root));
+            if(SECONDCHILD(root) && THIRDCHILD(root)){
+                fprintf(ctx->file, "\n");
+                indent(ctx);
+                fprintf(ctx->file, "else");
+                write_block(ctx, THIRDCHILD(root));
+            }
+            fprintf(ctx->file, "\n");
+            break;
+        case While:
+            indent(ctx);
+            if(!has_call(FIRSTCHILD(root))){
+                write_condition(ctx, "while", FIRSTCHILD(root));
+                write_block(ctx, SECONDCHILD(root));
+                fprintf(ctx->file, "\n");
+                break;
+            }
+            fprintf(ctx->file, "for(;;){\n");
+            ctx->depth++;
+            hoist_operands(ctx, FIRSTCHILD(root));
+            indent(ctx);
+            fprintf(ctx->file, "if(!");
+            write_expr(ctx, FIRSTCHILD(root));
+            fprintf(ctx->file, ")\n");
+            indent(ctx);
+            fprintf(ctx->file, "    break;\n");
+            write_stmt(ctx, SECONDCHILD(root));
+            ctx->depth--;
+            indent(ctx);
+            fprintf(ctx->file, "}\n");
+            break;
+        case Return:
+            if(FIRSTCHILD(root)->label != Void)
+                hoist_operands(ctx, FIRSTCHILD(root));
+            indent(ctx);
+            if(FIRSTCHILD(root)->label == Void)
+                fprintf(ctx->file, ctx->function->type == VOID ? "return;\n" : "return 0;\n");
+            else if(ctx->function->type == VOID){
+                fprintf(ctx->file, "(void) ");
+                write_expr(ctx, FIRSTCHILD(root));
+                fprintf(ctx->file, ";\n");
+                indent(ctx);
+                fprintf(ctx->file, "return;\n");
+            }
+            else{
+                fprintf(ctx->file, "return ");
+                write_expr(ctx, FIRSTCHILD(root));
+                fprintf(ctx->file, ";\n");
+            }
+            break;
+        case Function:
+            hoist_operands(ctx, root);
+            indent(ctx);
+            write_call(ctx, root);
+            fprintf(ctx->file, ";\n");
+            break;
+        default:
+            break;
+    }
+    ctx->nb_hoisted = 0;
+}
+
+/**
+ * @brief Finds the routines of the runtime called by the program.
+ */
+static void find_builtins(CCtx *ctx, Node *root){
+    for(; root; root = root->nextSibling){
+        if(root->label == Function && FIRSTCHILD(root) && FIRSTCHILD(root)->label == Ident && is_function_call(root)){
+            char *function_name = FIRSTCHILD(root)->ident;
+            if(!strcmp(function_name, "getchar"))
+                ctx->used[C_GETCHAR] = 1;
+            else if(!strcmp(function_name, "getint"))
+                ctx->used[C_GETINT] = 1;
+            else if(!strcmp(function_name, "putint"))
+                ctx->used[C_PUTINT] = 1;
+            else if(!strcmp(function_name, "putchar"))
+                ctx->used[nb_args(root) > 1 ? C_PUTS : C_PUTCHAR] = 1;
+        }
+        find_builtins(ctx, FIRSTCHILD(root));
+    }
+}
+
+static void write_runtime(CCtx *ctx, FILE *file){
+    fprintf(file, c_prelude, OUT_BUFFER_SIZE, line_buffered);
+    if(ctx->used[C_GETCHAR] || ctx->used[C_GETINT])
+        fprintf(file, c_input, IN_BUFFER_SIZE);
+    if(ctx->used[C_GETINT])
+        fputs(c_getint, file);
+    if(ctx->used[C_PUTCHAR])
+        fputs(c_putchar, file);
+    if(ctx->used[C_PUTINT]){
+        char digits[201];
+        for(int i = 0; i < 100; ++i)
+            sprintf(digits + 2 * i, "%02d", i);
+        fprintf(file, c_putint, digits, PUTINT_SCRATCH);
+    }
+    if(ctx->used[C_PUTS])
+        fputs(c_puts, file);
+}
+
+static void write_signature(FILE *file, Node *decl, SymTabsFct *table){
+    Node *params = FIRSTCHILD(THIRDCHILD(decl));
+    fprintf(file, "static %s " C_FUNCTION_PREFIX "%s(", table->type == VOID ? "void" : "int64_t", table->ident);
+    if(!params || params->label != Type)
+        fprintf(file, "void");
+    for(Node *param = params; param && param->label == Type; param = param->nextSibling){
+        if(param != params)
+            fprintf(file, ", ");
+        if(FIRSTCHILD(param)->label == Array)
+            fprintf(file, "%s *" C_VAR_PREFIX "%s", c_type(!strcmp(param->ident, "int")), FIRSTCHILD(FIRSTCHILD(param))->ident);
+        else
+            fprintf(file, "int64_t " C_VAR_PREFIX "%s", FIRSTCHILD(param)->ident);
+    }
+    fprintf(file, ")");
+}
+
+/**
+ * @brief Writes a function: its local variables zeroed like the native code, its temporaries,
+ * then its body.
+ */
+static void write_function(CCtx *ctx, FILE *file, Node *decl){
+    Node *last;
+    char *body;
+    size_t length;
+    FILE *saved = ctx->file;
+    ctx->file = try(open_memstream(&body, &length), NULL);
+    ctx->nb_temps = 0;
+    ctx->depth = 1;
+    for(Node *current = FIRSTCHILD(FOURTHCHILD(decl)); current; current = current->nextSibling)
+        write_stmt(ctx, current);
+    fclose(ctx->file);
+    ctx->file = saved;
+    write_signature(file, decl, ctx->function);
+    fprintf(file, "{\n");
+    for(Table *current = ctx->function->variables; current; current = current->next){
+        if(!uses_name(FIRSTCHILD(FOURTHCHILD(decl)), current->var.ident))
+            continue;
+        if(current->var.is_array)
+            fprintf(file, "    %s " C_VAR_PREFIX "%s[%d] = {0};\n", c_type(current->var.is_int), current->var.ident, current->var.size);
+        else
+            fprintf(file, "    int64_t " C_VAR_PREFIX "%s = 0;\n", current->var.ident);
+    }
+    if(ctx->nb_temps){
+        fprintf(file, "    int64_t ");
+        for(int i = 1; i <= ctx->nb_temps; ++i)
+            fprintf(file, C_TEMP_PREFIX "%d%s", i, i < ctx->nb_temps ? ", " : ";\n");
+    }
+    fputs(body, file);
+    for(last = FIRSTCHILD(FOURTHCHILD(decl)); last && (last->nextSibling || last->label == Instructions);)
+        last = last->nextSibling ? last->nextSibling : FIRSTCHILD(last);
+    if(ctx->function->type != VOID && !(last && last->label == Return))
+        fprintf(file, "    return 0;\n");
+    fprintf(file, "}\n\n");
+    free(body);
+}
+
+/**
+ * @brief Writes the main function of C, giving to main the words of the native stack: argc, the
+ * arguments ended by NULL, then the environment.
+ */
+static void write_main(FILE *file, Node *decl, SymTabsFct *table){
+    int nb_params = 0, i = 0;
+    for(Node *param = FIRSTCHILD(THIRDCHILD(decl)); param && param->label == Type; param = param->nextSibling)
+        nb_params++;
+    if(nb_params > 1)
+        fprintf(file, "int main(int argc, char **argv, char **envp){\n");
+    else
+        fprintf(file, nb_params ? "int main(int argc, char **argv){\n    (void) argv;\n" : "int main(void){\n");
+    fprintf(file, "    int64_t value = 0;\n");
+    if(nb_params > 1)
+        fprintf(file, "    int64_t words[%d] = {argc};\n"
+            "    for(int i = 1, nb_env = 0; i < %d; ++i)\n"
+            "        words[i] = (int64_t) (intptr_t) (i <= argc + 1 ? argv[i - 1] : envp[nb_env] ? envp[nb_env++] : 0);\n",
+            nb_params, nb_params);
+    fprintf(file, "    %s" C_FUNCTION_PREFIX "main(", table->type == VOID ? "" : "value = ");
+    for(Node *param = FIRSTCHILD(THIRDCHILD(decl)); param && param->label == Type; param = param->nextSibling, i++){
+        if(i == 0)
+            fprintf(file, "argc");
+        else if(FIRSTCHILD(param)->label == Array)
+            fprintf(file, ", (%s *) (intptr_t) words[%d]", c_type(!strcmp(param->ident, "int")), i);
+        else
+            fprintf(file, ", words[%d]", i);
+    }
+    fprintf(file, ");\n    tpc_flush();\n    return (int) value;\n}\n");
+}
+
+/**
+ * @brief Translates the checked tree in C, after the optimization passes, in the file named
+ * like the assembly file with .c instead of .asm.
+ *
+ * The parameters and the local scalars are 64 bits integers like the registers of the native
+ * code, while the global variables and the arrays keep the size of their elements, read sign
+ * extended and written truncated. The builtins are the routines of the runtime in C, with the
+ * same buffers.
+ */
+void build_c_source(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *asm_filename){
+    CCtx ctx = {NULL, global_vars, NULL, NULL, 0, 0, 0, {0}};
+    char *filename = (char*) try(malloc(strlen(asm_filename) + 3), NULL);
+    Node *main_decl = NULL;
+    SymTabsFct *main_table = NULL;
+    FILE *file;
+    strcpy(filename, asm_filename);
+    if(strlen(filename) >= 4 && !strcmp(filename + strlen(filename) - 4, ".asm"))
+        filename[strlen(filename) - 4] = '\0';
+    strcat(filename, ".c");
+    file = try(fopen(filename, "w"), NULL);
+    find_builtins(&ctx, FIRSTCHILD(SECONDCHILD(node)));
+    fprintf(file, "/* Programme TPC traduit en C par tpcc --emit=c. */\n\n");
+    write_runtime(&ctx, file);
+    fprintf(file, "\n");
+    for(Table *current = global_vars->first; current; current = current->next){
+        if(current->var.is_array)
+            fprintf(file, "static %s " C_GLOBAL_PREFIX "%s[%d];\n", c_type(current->var.is_int), current->var.ident, current->var.size);
+        else
+            fprintf(file, "static %s " C_GLOBAL_PREFIX "%s;\n", c_type(current->var.is_int), current->var.ident);
+    }
+    if(global_vars->first)
+        fprintf(file, "\n");
+    for(int pass = 0; pass < 2; ++pass){
+        for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+            if(current->label != Function)
+                continue;
+            ctx.function = NULL;
+            for(int i = 0; i < nb_functions && !ctx.function; ++i)
+                if(!strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                    ctx.function = functions[i];
+            if(!ctx.function)
+                continue;
+            if(!strcmp(ctx.function->ident, "main")){
+                main_decl = current;
+                main_table = ctx.function;
+            }
+            if(pass == 0){
+                write_signature(file, current, ctx.function);
+                fprintf(file, ";\n");
+            }
+            else
+                write_function(&ctx, file, current);
+        }
+        if(pass == 0)
+            fprintf(file, "\n");
+    }
+    if(main_decl)
+        write_main(file, main_decl, main_table);
+    fclose(file);
+    free(ctx.hoisted);
+    free(filename);
+}
@@ -0,0 +1,18 @@
+/**
+ * @file csource.h
+ * @brief Translation of the checked tree in portable C, compiled by a C compiler instead of nasm.
+ */
+
+#ifndef __CSOURCE__H
+#define __CSOURCE__H
+
+#include "compile.h"
+
+#define C_VAR_PREFIX "v_"        ///< Prefix of the parameters and the local variables in C, keeping them apart from the keywords.
+#define C_GLOBAL_PREFIX "g_"     ///< Prefix of the global variables in C.
+#define C_FUNCTION_PREFIX "f_"   ///< Prefix of the functions in C, main being called by the main of C.
+#define C_TEMP_PREFIX "tpc_t"    ///< Prefix of the temporaries holding the values of the calls.
+
+void build_c_source(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *asm_filename); ///< Function to write the program in C, in the file named like the assembly file with .c instead of .asm.
+
+#endif
@@ -0,0 +1,354 @@
+#include "dce.h"
+
+/**
+ * @brief State of the liveness analysis in a function.
+ */
+typedef struct{
+    SymTabs *global_vars;
+    char **vars;  ///< Scalar parameters and local variables of the current function.
+    int nb_vars;  ///< Number of variables.
+    int removed;  ///< Number of assignments removed.
+}DceCtx;
+
+static int has_call(Node *root){
+    if(is_function_call(root))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(has_call(child))
+            return 1;
+    return 0;
+}
+
+static void replace_by_void(Node *root){
+    if(FIRSTCHILD(root))
+        deleteTree(FIRSTCHILD(root));
+    root->firstChild = NULL;
+    root->label = Void;
+    root->ident = NULL;
+}
+
+/**
+ * @brief Flags the functions called from a function, and the functions they call.
+ */
+static void mark_reachable(Node *root, SymTabsFct **functions, int nb_functions, char *reachable){
+    if(is_function_call(root) && !is_builtin_function(FIRSTCHILD(root)->ident))
+        for(int i = 0; i < nb_functions; ++i)
+            if(!reachable[i] && !strcmp(functions[i]->ident, FIRSTCHILD(root)->ident)){
+                Node *decl = find_function_decl(functions[i]->ident);
+                reachable[i] = 1;
+                if(decl)
+                    mark_reachable(FOURTHCHILD(decl), functions, nb_functions, reachable);
+            }
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        mark_reachable(child, functions, nb_functions, reachable);
+}
+
+/**
+ * @brief Removes the declarations of the functions that main never reaches.
+ * @param report Flag telling if the removed functions are written on stderr.
+ */
+static void remove_unreachable_functions(SymTabsFct **functions, int nb_functions, int report){
+    char *reachable = (char*) try(calloc(nb_functions + 1, sizeof(char)), NULL);
+    Node *main_decl = find_function_decl("main");
+    if(!main_decl){
+        free(reachable);
+        return;
+    }
+    for(int i = 0; i < nb_functions; ++i)
+        if(!strcmp(functions[i]->ident, "main"))
+            reachable[i] = 1;
+    mark_reachable(FOURTHCHILD(main_decl), functions, nb_functions, reachable);
+    for(Node **link = &SECONDCHILD(node)->firstChild; *link;){
+        Node *current = *link;
+        int keep = current->label != Function;
+        for(int i = 0; i < nb_functions && !keep; ++i)
+            if(reachable[i] && !strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                keep = 1;
+        if(keep){
+            link = &current->nextSibling;
+            continue;
+        }
+        if(report)
+            fprintf(stderr, "%s: never called, removed\n", SECONDCHILD(current)->ident);
+        *link = current->nextSibling;
+        current->nextSibling = NULL;
+        deleteTree(current);
+    }
+    free(reachable);
+}
+
+/**
+ * @brief Tells if the control never goes past a statement.
+ */
+static int always_returns(Node *root){
+    switch(root->label){
+        case Return:
+            return 1;
+        case Instructions:
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+                if(always_returns(current))
+                    return 1;
+            return 0;
+        case If:
+            return THIRDCHILD(root) && always_returns(SECONDCHILD(root)) && always_returns(THIRDCHILD(root));
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Removes the statements following a return, and the empty statements of the lists.
+ */
+static void remove_unreachable_stmts(Node *root){
+    if(root->label == Instructions){
+        for(Node **link = &root->firstChild; *link;){
+            Node *current = *link;
+            if(current->label == Void){
+                *link = current->nextSibling;
+                current->nextSibling = NULL;
+                deleteTree(current);
+                continue;
+            }
+            if(always_returns(current) && current->nextSibling){
+                deleteTree(current->nextSibling);
+                current->nextSibling = NULL;
+            }
+            link = &current->nextSibling;
+        }
+    }
+    if(root->label == If && !THIRDCHILD(root) && !has_call(FIRSTCHILD(root))
+        && (SECONDCHILD(root)->label == Void || (SECONDCHILD(root)->label == Instructions && !FIRSTCHILD(SECONDCHILD(root))))){
+        replace_by_void(root);
+        return;
+    }
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(child->label == Instructions || child->label == If || child->label == While)
+            remove_unreachable_stmts(child);
+}
+
+static int var_index(DceCtx *ctx, char *var_name){
+    for(int i = 0; i < ctx->nb_vars; ++i)
+        if(!strcmp(ctx->vars[i], var_name))
+            return i;
+    return -1;
+}
+
+static void add_vars(DceCtx *ctx, Table *table){
+    for(Table *current = table; current; current = current->next){
+        if(current->var.is_array || check_in_table(*ctx->global_vars, current->var.ident))
+            continue;
+        ctx->vars = (char**) try(realloc(ctx->vars, sizeof(char*) * (ctx->nb_vars + 1)), NULL);
+        ctx->vars[ctx->nb_vars++] = current->var.ident;
+    }
+}
+
+/**
+ * @brief Flags the variables read by an expression as live.
+ */
+static void mark_uses(DceCtx *ctx, Node *root, char *live){
+    int index;
+    if(root->label == Variable && FIRSTCHILD(root)->label == Ident && (index = var_index(ctx, FIRSTCHILD(root)->ident)) >= 0)
+        live[index] = 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        mark_uses(ctx, child, live);
+}
+
+/**
+ * @brief Computes the variables live before a statement from the ones live after it.
+ *
+ * An assignment of a variable that isn't live afterwards is dead, unless its value calls a
+ * function: it doesn't make its operands live, and it is removed once the loops are stable.
+ * @param live Variables live after the statement, updated with the ones live before it.
+ * @param remove Flag telling if the dead assignments are replaced by empty statements.
+ */
+static void live_stmt(DceCtx *ctx, Node *root, char *live, int remove){
+    char *then_live, *body_live, *header_live;
+    Node *target;
+    int index, changed;
+    switch(root->label){
+        case Corps:
+        case Instructions:;
+            int nb = 0;
+            Node **stmts = NULL;
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling){
+                stmts = (Node**) try(realloc(stmts, sizeof(Node*) * (nb + 1)), NULL);
+                stmts[nb++] = current;
+            }
+            while(nb > 0)
+                live_stmt(ctx, stmts[--nb], live, remove);
+            free(stmts);
+            break;
+        case Equals:
+            target = FIRSTCHILD(FIRSTCHILD(root));
+            if(target->label == Ident && (index = var_index(ctx, target->ident)) >= 0){
+                if(!live[index] && !has_call(SECONDCHILD(root))){
+                    if(remove){
+                        replace_by_void(root);
+                        ctx->removed++;
+                    }
+                    break;
+                }
+                live[index] = 0;
+            }
+            if(target->label == Array)
+                mark_uses(ctx, FIRSTCHILD(root), live);
+            mark_uses(ctx, SECONDCHILD(root), live);
+            break;
+        case Return:
+            memset(live, 0, ctx->nb_vars);
+            mark_uses(ctx, root, live);
+            break;
+        case Function:
+            mark_uses(ctx, root, live);
+            break;
+        case If:
+            then_live = (char*) try(malloc(ctx->nb_vars + 1), NULL);
+            memcpy(then_live, live, ctx->nb_vars);
+            live_stmt(ctx, SECONDCHILD(root), then_live, remove);
+            if(THIRDCHILD(root))
+                live_stmt(ctx, THIRDCHILD(root), live, remove);
+            for(int i = 0; i < ctx->nb_vars; ++i)
+                live[i] |= then_live[i];
+            mark_uses(ctx, FIRSTCHILD(root), live);
+            free(then_live);
+            break;
+        case While:
+            header_live = (char*) try(malloc(ctx->nb_vars + 1), NULL);
+            body_live = (char*) try(malloc(ctx->nb_vars + 1), NULL);
+            memcpy(header_live, live, ctx->nb_vars);
+            mark_uses(ctx, FIRSTCHILD(root), header_live);
+            do{
+                memcpy(body_live, header_live, ctx->nb_vars);
+                live_stmt(ctx, SECONDCHILD(root), body_live, 0);
+                changed = 0;
+                for(int i = 0; i < ctx->nb_vars; ++i)
+                    if(body_live[i] && !header_live[i])
+                        header_live[i] = changed = 1;
+            }while(changed);
+            if(remove){
+                memcpy(body_live, header_live, ctx->nb_vars);
+                live_stmt(ctx, SECONDCHILD(root), body_live, 1);
+            }
+            memcpy(live, header_live, ctx->nb_vars);
+            free(header_live);
+            free(body_live);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Removes the assignments of the parameters and local variables that are never read afterwards.
+ * @param report Flag telling if the number of removed assignments is written on stderr.
+ */
+static void remove_dead_stores(SymTabs *global_vars, SymTabsFct *function, Node *corps, int report){
+    DceCtx ctx = {global_vars, NULL, 0, 0};
+    char *live;
+    add_vars(&ctx, function->parameters);
+    add_vars(&ctx, function->variables);
+    live = (char*) try(calloc(ctx.nb_vars + 1, sizeof(char)), NULL);
+    live_stmt(&ctx, corps, live, 1);
+    if(report && ctx.removed)
+        fprintf(stderr, "%s: %d dead assignment%s removed\n", function->ident, ctx.removed, ctx.removed > 1 ? "s" : "");
+    free(live);
+    free(ctx.vars);
+}
+
+/**
+ * @brief Tells if a global variable is read somewhere, passing an array to a function included.
+ */
+static int is_read(Node *root, char *var_name){
+    Node *name;
+    if(root->label == Equals){
+        Node *target = FIRSTCHILD(FIRSTCHILD(root));
+        return (target->label == Array && is_read(FIRSTCHILD(FIRSTCHILD(target)), var_name)) || is_read(SECONDCHILD(root), var_name);
+    }
+    if(root->label == Variable){
+        name = FIRSTCHILD(root)->label == Array ? FIRSTCHILD(FIRSTCHILD(root)) : FIRSTCHILD(root);
+        if(!strcmp(name->ident, var_name))
+            return 1;
+    }
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(is_read(child, var_name))
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Removes the assignments of a global variable that is never read, when they call no function.
+ * @return 1 if an assignment with a call is left.
+ */
+static int remove_global_stores(Node *root, char *var_name){
+    int left = 0;
+    if(root->label == Equals){
+        Node *target = FIRSTCHILD(FIRSTCHILD(root));
+        Node *name = target->label == Array ? FIRSTCHILD(target) : target;
+        if(strcmp(name->ident, var_name))
+            return 0;
+        if(has_call(root))
+            return 1;
+        replace_by_void(root);
+        return 0;
+    }
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        left |= remove_global_stores(child, var_name);
+    return left;
+}
+
+/**
+ * @brief Removes the global variables that no function reads, and their assignments.
+ * @param report Flag telling if the removed globals are written on stderr.
+ */
+static void remove_unused_globals(SymTabs *global_vars, int report){
+    if(!FIRSTCHILD(node))
+        return;
+    for(Node *decl = FIRSTCHILD(FIRSTCHILD(node)); decl; decl = decl->nextSibling){
+        if(decl->label != Type)
+            continue;
+        for(Node **link = &decl->firstChild; *link;){
+            Node *current = *link;
+            char *var_name = current->label == Array ? FIRSTCHILD(current)->ident : current->ident;
+            if(is_read(SECONDCHILD(node), var_name) || remove_global_stores(SECONDCHILD(node), var_name)){
+                link = &current->nextSibling;
+                continue;
+            }
+            if(report)
+                fprintf(stderr, "global %s: never read, removed\n", var_name);
+            *link = current->nextSibling;
+            current->nextSibling = NULL;
+            deleteTree(current);
+        }
+    }
+    free_table(global_vars->first);
+    global_vars->first = NULL;
+    global_vars->offset = 0;
+    fill_global_vars(global_vars);
+}
+
+/**
+ * @brief Removes the code that can't change the output of the program.
+ *
+ * Only the functions reachable from main through the call graph are kept. In each of them,
+ * the statements after a return are removed, then a backward liveness analysis over the
+ * scalar parameters and local variables removes the dead assignments. The globals that
+ * are never read lose their assignments and their space in .bss.
+ * @param report Flag telling if the removed functions, assignments and globals are written on stderr.
+ * @return The tables of the remaining functions.
+ */
+SymTabsFct** eliminate_dead_code(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    remove_unreachable_functions(functions, *nb_functions, report);
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        if(current->label != Function)
+            continue;
+        remove_unreachable_stmts(FOURTHCHILD(current));
+        for(int i = 0; i < *nb_functions; ++i)
+            if(!strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                remove_dead_stores(global_vars, functions[i], FOURTHCHILD(current), report);
+    }
+    remove_unused_globals(global_vars, report);
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling)
+        if(current->label == Function)
+            remove_unreachable_stmts(FOURTHCHILD(current));
+    return update_decl_functions(functions, nb_functions, global_vars);
+}
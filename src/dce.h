@@ -0,0 +1,13 @@
+/**
+ * @file dce.h
+ * @brief Elimination of the dead code: unreachable functions and statements, dead stores and unused globals.
+ */
+
+#ifndef __DCE__H
+#define __DCE__H
+
+#include "compile.h"
+
+SymTabsFct** eliminate_dead_code(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report); ///< Function to remove the code that can't change the output of the program.
+
+#endif
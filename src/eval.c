@@ -0,0 +1,559 @@
+#include <limits.h>
+#include <setjmp.h>
+#include "eval.h"
+
+#define EVAL_MAX_ARGS 32
+
+/**
+ * @brief Storage of a variable inside an interpreted call.
+ */
+typedef struct{
+    Element *var;  ///< Symbol of the variable.
+    long *values;  ///< Value of the scalar or values of the array elements.
+    char *init;    ///< Flags telling which values have been written.
+}Slot;
+
+/**
+ * @brief Activation record of an interpreted call.
+ */
+typedef struct{
+    Slot *slots;   ///< Parameters and local variables of the function.
+    int nb_slots;  ///< Number of slots.
+    long ret;      ///< Returned value.
+    int has_ret;   ///< Flag indicating if a value has been returned.
+}Frame;
+
+/**
+ * @brief State of the interpreter.
+ *
+ * The interpreter gives up (longjmp to abort) as soon as something can't be known at compile time:
+ * a read of an uninitialized variable, an impure call, an out of bounds access, a division by zero,
+ * or when the step or depth limits are reached.
+ */
+typedef struct{
+    SymTabsFct **functions;          ///< Declared functions.
+    int nb_functions;                ///< Number of declared functions.
+    char *pure;                      ///< Purity of each declared function.
+    int steps;                       ///< Number of nodes interpreted for the current folding.
+    int depth;                       ///< Current call depth.
+    int folded;                      ///< Number of expressions replaced by their value in the current function.
+    int pruned;                      ///< Number of If and While removed for their constant condition in the current function.
+    Frame *frames[EVAL_MAX_DEPTH];   ///< Frames of the calls being interpreted.
+    jmp_buf abort;                   ///< Where to go back when the evaluation is given up.
+}EvalCtx;
+
+static int function_index(char *function_name, SymTabsFct **functions, int nb_functions){
+    for(int i = 0; i < nb_functions; ++i)
+        if(!strcmp(functions[i]->ident, function_name))
+            return i;
+    return -1;
+}
+
+static int has_array_param(SymTabsFct *function){
+    for(Table *current = function->parameters; current; current = current->next)
+        if(current->var.is_array)
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief Checks that a body only uses its own variables and doesn't call a builtin.
+ * @param root The first node of the body.
+ * @param function The symbol table of the function.
+ * @return 1 if the body is pure on its own, 0 otherwise.
+ */
+static int locally_pure(Node *root, SymTabsFct *function, SymTabsFct **functions, int nb_functions){
+    if(!root)
+        return 1;
+    if(root->label == Variable){
+        char *var_name = FIRSTCHILD(root)->label == Array ? FIRSTCHILD(FIRSTCHILD(root))->ident : FIRSTCHILD(root)->ident;
+        if(!check_in_table_fct(function->parameters, var_name) && !check_in_table_fct(function->variables, var_name))
+            return 0;
+    }
+    if(is_function_call(root) && (is_builtin_function(FIRSTCHILD(root)->ident)
+        || function_index(FIRSTCHILD(root)->ident, functions, nb_functions) < 0))
+        return 0;
+    return locally_pure(FIRSTCHILD(root), function, functions, nb_functions)
+        && locally_pure(root->nextSibling, function, functions, nb_functions);
+}
+
+static int calls_impure(Node *root, char *pure, SymTabsFct **functions, int nb_functions){
+    if(!root)
+        return 0;
+    if(is_function_call(root)){
+        int index = function_index(FIRSTCHILD(root)->ident, functions, nb_functions);
+        if(index < 0 || !pure[index])
+            return 1;
+    }
+    return calls_impure(FIRSTCHILD(root), pure, functions, nb_functions)
+        || calls_impure(root->nextSibling, pure, functions, nb_functions);
+}
+
+/**
+ * @brief Computes which functions are pure.
+ *
+ * A function is pure if it has no array parameter, uses no global variable, doesn't call a builtin
+ * and only calls pure functions. The last rule is solved as a fixpoint so mutual recursion is handled.
+ *
+ * @return An array of flags, one per declared function.
+ */
+static char *compute_purity(SymTabsFct **functions, int nb_functions){
+    char *pure = (char*) try(malloc(sizeof(char) * (nb_functions + 1)), NULL);
+    int changed = 1;
+    for(int i = 0; i < nb_functions; ++i){
+        Node *decl = find_function_decl(functions[i]->ident);
+        pure[i] = decl && !has_array_param(functions[i])
+            && locally_pure(FIRSTCHILD(FOURTHCHILD(decl)), functions[i], functions, nb_functions);
+    }
+    while(changed){
+        changed = 0;
+        for(int i = 0; i < nb_functions; ++i)
+            if(pure[i] && calls_impure(FIRSTCHILD(FOURTHCHILD(find_function_decl(functions[i]->ident))),
+                pure, functions, nb_functions)){
+                pure[i] = 0;
+                changed = 1;
+            }
+    }
+    return pure;
+}
+
+int is_pure_function(char *function_name, SymTabs *global_vars, SymTabsFct **functions, int nb_functions){
+    int index = function_index(function_name, functions, nb_functions), res = 0;
+    if(index >= 0){
+        char *pure = compute_purity(functions, nb_functions);
+        res = pure[index];
+        free(pure);
+    }
+    return res;
+}
+
+static void eval_abort(EvalCtx *ctx){
+    longjmp(ctx->abort, 1);
+}
+
+static void eval_step(EvalCtx *ctx){
+    if(++ctx->steps > EVAL_MAX_STEPS)
+        eval_abort(ctx);
+}
+
+static Frame *create_frame(SymTabsFct *function){
+    Frame *frame = (Frame*) try(malloc(sizeof(Frame)), NULL);
+    int nb = 0, i = 0;
+    for(Table *current = function->parameters; current; current = current->next)
+        nb++;
+    for(Table *current = function->variables; current; current = current->next)
+        nb++;
+    frame->slots = (Slot*) try(malloc(sizeof(Slot) * (nb + 1)), NULL);
+    frame->nb_slots = nb;
+    frame->has_ret = 0;
+    for(int pass = 0; pass < 2; ++pass)
+        for(Table *current = pass ? function->variables : function->parameters; current; current = current->next, ++i){
+            int size = current->var.is_array ? current->var.size : 1;
+            frame->slots[i].var = &current->var;
+            frame->slots[i].values = (long*) try(calloc(size, sizeof(long)), NULL);
+            frame->slots[i].init = (char*) try(calloc(size, sizeof(char)), NULL);
+        }
+    return frame;
+}
+
+static void free_frame(Frame *frame){
+    for(int i = 0; i < frame->nb_slots; ++i){
+        free(frame->slots[i].values);
+        free(frame->slots[i].init);
+    }
+    free(frame->slots);
+    free(frame);
+}
+
+static Slot *find_slot(Frame *frame, char *var_name){
+    for(int i = 0; frame && i < frame->nb_slots; ++i)
+        if(!strcmp(frame->slots[i].var->ident, var_name))
+            return &frame->slots[i];
+    return NULL;
+}
+
+static long eval_expr(EvalCtx *ctx, Frame *frame, Node *root);
+
+static int exec_stmt(EvalCtx *ctx, Frame *frame, Node *root);
+
+/**
+ * @brief Finds the storage designated by a Variable node.
+ * @param init Set to the initialization flag of the storage.
+ * @return A pointer to the value.
+ */
+static long *lvalue_ref(EvalCtx *ctx, Frame *frame, Node *root, char **init){
+    Node *target = FIRSTCHILD(root);
+    long index = 0;
+    char *var_name = target->ident;
+    Slot *slot;
+    if(target->label == Array){
+        var_name = FIRSTCHILD(target)->ident;
+        index = eval_expr(ctx, frame, FIRSTCHILD(FIRSTCHILD(target)));
+    }
+    slot = find_slot(frame, var_name);
+    if(!slot || slot->var->is_array != (target->label == Array))
+        eval_abort(ctx);
+    if(index < 0 || index >= (slot->var->is_array ? slot->var->size : 1))
+        eval_abort(ctx);
+    *init = &slot->init[index];
+    return &slot->values[index];
+}
+
+static long eval_call(EvalCtx *ctx, Frame *caller, Node *root, int need_value){
+    char *function_name = FIRSTCHILD(root)->ident;
+    int index = function_index(function_name, ctx->functions, ctx->nb_functions), nb_args = 0;
+    Node *decl, *param, *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root)));
+    long args[EVAL_MAX_ARGS];
+    Frame *frame;
+    if(index < 0 || !ctx->pure[index] || ctx->depth >= EVAL_MAX_DEPTH)
+        eval_abort(ctx);
+    decl = find_function_decl(function_name);
+    for(; arg && arg->label != Void; arg = arg->nextSibling){
+        if(nb_args >= EVAL_MAX_ARGS)
+            eval_abort(ctx);
+        args[nb_args++] = eval_expr(ctx, caller, arg);
+    }
+    frame = create_frame(ctx->functions[index]);
+    ctx->frames[ctx->depth++] = frame;
+    nb_args = 0;
+    for(param = FIRSTCHILD(THIRDCHILD(decl)); param && param->label == Type; param = param->nextSibling){
+        Slot *slot = find_slot(frame, FIRSTCHILD(param)->ident);
+        slot->values[0] = args[nb_args++];
+        slot->init[0] = 1;
+    }
+    for(Node *current = FIRSTCHILD(FOURTHCHILD(decl)); current; current = current->nextSibling)
+        if(exec_stmt(ctx, frame, current))
+            break;
+    if(need_value && !frame->has_ret)
+        eval_abort(ctx);
+    ctx->depth--;
+    long ret = frame->ret;
+    free_frame(frame);
+    return ret;
+}
+
+/**
+ * @brief Computes a binary operator on two constants, with the 64-bit wrapping arithmetic of the
+ * generated code.
+ * @param root The Addsub, Divstar, Eq, Order, And or Or node of the operator.
+ * @return 1 if the result has been set, 0 for another node or a division that would trap.
+ */
+int fold_binary(Node *root, long left, long right, long *result){
+    switch(root->label){
+        case Addsub:
+            if(root->ident[0] == '+')
+                *result = (long)((unsigned long)left + (unsigned long)right);
+            else
+                *result = (long)((unsigned long)left - (unsigned long)right);
+            return 1;
+        case Divstar:
+            if(root->ident[0] == '*'){
+                *result = (long)((unsigned long)left * (unsigned long)right);
+                return 1;
+            }
+            if(right == 0 || (left == LONG_MIN && right == -1))
+                return 0;
+            *result = root->ident[0] == '/' ? left / right : left % right;
+            return 1;
+        case Eq:
+            *result = !strcmp(root->ident, "==") ? left == right : left != right;
+            return 1;
+        case Order:
+            if(!strcmp(root->ident, "<"))
+                *result = left < right;
+            else if(!strcmp(root->ident, "<="))
+                *result = left <= right;
+            else if(!strcmp(root->ident, ">"))
+                *result = left > right;
+            else
+                *result = left >= right;
+            return 1;
+        case And:
+            *result = left && right;
+            return 1;
+        case Or:
+            *result = left || right;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static long eval_expr(EvalCtx *ctx, Frame *frame, Node *root){
+    long left, right;
+    char *init;
+    eval_step(ctx);
+    switch(root->label){
+        case Num:
+            return root->num;
+        case Character:
+            return character_value(root);
+        case Expression:
+            return eval_expr(ctx, frame, FIRSTCHILD(root));
+        case Variable:;
+            long *value = lvalue_ref(ctx, frame, root, &init);
+            if(!*init)
+                eval_abort(ctx);
+            return *value;
+        case Function:
+            return eval_call(ctx, frame, root, 1);
+        case Not:
+            return !eval_expr(ctx, frame, FIRSTCHILD(root));
+        case Addsub:
+            if(!SECONDCHILD(root)){
+                left = eval_expr(ctx, frame, FIRSTCHILD(root));
+                return root->ident[0] == '-' ? (long)(0UL - (unsigned long)left) : left;
+            }
+            break;
+        default:
+            break;
+    }
+    if(!FIRSTCHILD(root) || !SECONDCHILD(root))
+        eval_abort(ctx);
+    left = eval_expr(ctx, frame, FIRSTCHILD(root));
+    right = eval_expr(ctx, frame, SECONDCHILD(root));
+    if(!fold_binary(root, left, right, &left))
+        eval_abort(ctx);
+    return left;
+}
+
+/**
+ * @brief Interprets one instruction.
+ * @return 1 if the instruction returned from the function, 0 otherwise.
+ */
+static int exec_stmt(EvalCtx *ctx, Frame *frame, Node *root){
+    char *init;
+    eval_step(ctx);
+    switch(root->label){
+        case Instructions:
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+                if(exec_stmt(ctx, frame, current))
+                    return 1;
+            return 0;
+        case Equals:;
+            long value = eval_expr(ctx, frame, SECONDCHILD(root));
+            long *ref = lvalue_ref(ctx, frame, FIRSTCHILD(root), &init);
+            Node *target = FIRSTCHILD(FIRSTCHILD(root));
+            if(target->label == Array)
+                value = find_slot(frame, FIRSTCHILD(target)->ident)->var->is_int ? (int)value : (signed char)value;
+            *ref = value;
+            *init = 1;
+            return 0;
+        case If:
+            if(eval_expr(ctx, frame, FIRSTCHILD(root)))
+                return exec_stmt(ctx, frame, SECONDCHILD(root));
+            if(THIRDCHILD(root))
+                return exec_stmt(ctx, frame, THIRDCHILD(root));
+            return 0;
+        case While:
+            while(eval_expr(ctx, frame, FIRSTCHILD(root)))
+                if(exec_stmt(ctx, frame, SECONDCHILD(root)))
+                    return 1;
+            return 0;
+        case Return:
+            if(FIRSTCHILD(root)->label != Void){
+                frame->ret = eval_expr(ctx, frame, FIRSTCHILD(root));
+                frame->has_ret = 1;
+            }
+            return 1;
+        case Function:
+            eval_call(ctx, frame, root, 0);
+            return 0;
+        case Type:
+        case Void:
+            return 0;
+        default:
+            eval_abort(ctx);
+    }
+    return 0;
+}
+
+static void init_ctx(EvalCtx *ctx, SymTabsFct **functions, int nb_functions){
+    ctx->functions = functions;
+    ctx->nb_functions = nb_functions;
+    ctx->pure = compute_purity(functions, nb_functions);
+    ctx->steps = 0;
+    ctx->depth = 0;
+    ctx->folded = 0;
+    ctx->pruned = 0;
+}
+
+/**
+ * @brief Evaluates an expression with the interpreter.
+ * @return 1 if the value is known at compile time, 0 otherwise.
+ */
+static int try_eval(EvalCtx *ctx, Node *root, long *result){
+    ctx->steps = 0;
+    ctx->depth = 0;
+    if(setjmp(ctx->abort)){
+        while(ctx->depth > 0)
+            free_frame(ctx->frames[--ctx->depth]);
+        return 0;
+    }
+    *result = eval_expr(ctx, NULL, root);
+    return 1;
+}
+
+int eval_constant(Node *root, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, long *result){
+    EvalCtx ctx;
+    int res;
+    init_ctx(&ctx, functions, nb_functions);
+    res = try_eval(&ctx, root, result);
+    free(ctx.pure);
+    return res;
+}
+
+static void replace_by_num(Node *root, long value){
+    if(FIRSTCHILD(root))
+        deleteTree(FIRSTCHILD(root));
+    root->firstChild = NULL;
+    root->label = Num;
+    root->num = (int)value;
+    root->ident = NULL;
+}
+
+static int is_constant(Node *root){
+    return root->label == Num || root->label == Character;
+}
+
+/**
+ * @brief Folds an expression bottom-up.
+ *
+ * Operators whose operands are constants and calls whose arguments are constants are
+ * replaced by a Num node when the interpreter manages to compute them.
+ */
+static void fold_expr(EvalCtx *ctx, Node *root){
+    long value;
+    int all_constant = 1;
+    switch(root->label){
+        case Expression:
+            fold_expr(ctx, FIRSTCHILD(root));
+            return;
+        case Variable:
+            if(FIRSTCHILD(root)->label == Array)
+                fold_expr(ctx, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
+            return;
+        case Function:
+            for(Node *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); arg && arg->label != Void; arg = arg->nextSibling)
+                fold_expr(ctx, arg);
+            break;
+        case Addsub:
+        case Divstar:
+        case Eq:
+        case Order:
+        case And:
+        case Or:
+        case Not:
+            for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling){
+                fold_expr(ctx, child);
+                if(!is_constant(child->label == Expression ? FIRSTCHILD(child) : child))
+                    all_constant = 0;
+            }
+            if(!all_constant)
+                return;
+            break;
+        default:
+            return;
+    }
+    if(try_eval(ctx, root, &value) && value >= INT_MIN && value <= INT_MAX){
+        replace_by_num(root, value);
+        ctx->folded++;
+    }
+}
+
+/**
+ * @brief Replaces a node by one of its children, keeping its place among its siblings.
+ */
+static void replace_by_child(Node *root, Node *child){
+    Node *next = root->nextSibling, **link = &root->firstChild;
+    while(*link != child)
+        link = &(*link)->nextSibling;
+    *link = child->nextSibling;
+    child->nextSibling = NULL;
+    if(FIRSTCHILD(root))
+        deleteTree(FIRSTCHILD(root));
+    *root = *child;
+    root->nextSibling = next;
+    free(child);
+}
+
+static void replace_by_void(Node *root){
+    if(FIRSTCHILD(root))
+        deleteTree(FIRSTCHILD(root));
+    root->firstChild = NULL;
+    root->label = Void;
+    root->ident = NULL;
+}
+
+static Node *constant_condition(Node *root){
+    Node *cond = FIRSTCHILD(root)->label == Expression ? FIRSTCHILD(FIRSTCHILD(root)) : FIRSTCHILD(root);
+    return cond->label == Num ? cond : NULL;
+}
+
+static void fold_stmt(EvalCtx *ctx, Node *root){
+    Node *cond;
+    if(!root)
+        return;
+    switch(root->label){
+        case Instructions:
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+                fold_stmt(ctx, current);
+            break;
+        case Equals:
+            fold_expr(ctx, FIRSTCHILD(root));
+            fold_expr(ctx, SECONDCHILD(root));
+            break;
+        case If:
+        case While:
+            fold_expr(ctx, FIRSTCHILD(root));
+            for(Node *current = SECONDCHILD(root); current; current = current->nextSibling)
+                fold_stmt(ctx, current);
+            if((cond = constant_condition(root))){
+                ctx->pruned += root->label == If || !cond->num;
+                if(root->label == If && cond->num && SECONDCHILD(root))
+                    replace_by_child(root, SECONDCHILD(root));
+                else if(root->label == If && !cond->num && SECONDCHILD(root) && THIRDCHILD(root))
+                    replace_by_child(root, THIRDCHILD(root));
+                else if(!cond->num)
+                    replace_by_void(root);
+            }
+            break;
+        case Return:
+            if(FIRSTCHILD(root)->label != Void)
+                fold_expr(ctx, FIRSTCHILD(root));
+            break;
+        case Function:
+            for(Node *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); arg && arg->label != Void; arg = arg->nextSibling)
+                fold_expr(ctx, arg);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Replaces constant expressions and pure calls with constant arguments by their value.
+ *
+ * Extends expression_result: the operands may be calls, which are interpreted with the
+ * EVAL_MAX_STEPS and EVAL_MAX_DEPTH limits. A call that can't be computed is kept as is.
+ * An If or a While whose condition becomes constant is replaced by the arm that is taken.
+ * @param report Flag telling if the number of folded expressions and removed branches of each
+ * function is written on stderr.
+ */
+void fold_constant_calls(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report){
+    EvalCtx ctx;
+    init_ctx(&ctx, functions, nb_functions);
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        if(current->label != Function)
+            continue;
+        ctx.folded = ctx.pruned = 0;
+        for(Node *stmt = FIRSTCHILD(FOURTHCHILD(current)); stmt; stmt = stmt->nextSibling)
+            fold_stmt(&ctx, stmt);
+        if(report && ctx.folded)
+            fprintf(stderr, "%s: %d expression%s folded\n", SECONDCHILD(current)->ident, ctx.folded, ctx.folded > 1 ? "s" : "");
+        if(report && ctx.pruned)
+            fprintf(stderr, "%s: %d branch%s of constant condition removed\n", SECONDCHILD(current)->ident, ctx.pruned,
+                ctx.pruned > 1 ? "es" : "");
+    }
+    free(ctx.pure);
+}
@@ -0,0 +1,22 @@
+/**
+ * @file eval.h
+ * @brief Compile-time evaluation of pure functions.
+ */
+
+#ifndef __EVAL__H
+#define __EVAL__H
+
+#include "compile.h"
+
+#define EVAL_MAX_STEPS 100000 ///< Maximum number of nodes interpreted for one folded call.
+#define EVAL_MAX_DEPTH 256    ///< Maximum call depth of the interpreter.
+
+int is_pure_function(char *function_name, SymTabs *global_vars, SymTabsFct **functions, int nb_functions); ///< Function to check if a function has no side effect and only depends on its parameters.
+
+int fold_binary(Node *root, long left, long right, long *result); ///< Function to compute a binary operator on two constants, returning 0 if it can't be folded.
+
+int eval_constant(Node *root, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, long *result); ///< Function to evaluate a constant expression, calls to pure functions included.
+
+void fold_constant_calls(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report); ///< Function to replace constant expressions and pure calls by their value.
+
+#endif
@@ -0,0 +1,141 @@
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "executable.h"
+
+static long page_align(long value){
+    return (value + ELF_PAGE - 1) / ELF_PAGE * ELF_PAGE;
+}
+
+/**
+ * @brief Writes the executable of the assembly generated by build_asm(), named like the assembly
+ * file without .asm.
+ *
+ * The program and the routines of the runtime it calls are assembled in memory, see
+ * assemble_program(). Each section gets its own segment, starting on a new page: the code at
+ * ELF_BASE + ELF_PAGE, readable and executable, then the constants, readable, and the zeroed
+ * data, writable and taking no bytes in the file. The executable has no section headers nor
+ * symbols, only what the kernel needs to load it and jump to _start.
+ */
+void build_executable(char *text, char *asm_filename){
+    static const int flags[ASM_SECTIONS] = {PF_R | PF_X, PF_R, PF_R | PF_W};
+    char *exe_filename = strdup(asm_filename);
+    Assembly *assembly = assemble_program(text);
+    Elf64_Phdr headers[ASM_SECTIONS];
+    long addresses[ASM_SECTIONS], offsets[ASM_SECTIONS], offset = ELF_PAGE;
+    int nb_headers = 0;
+    Elf64_Ehdr elf_header = {
+        .e_ident = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV},
+        .e_type = ET_EXEC,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_phoff = sizeof(Elf64_Ehdr),
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_phentsize = sizeof(Elf64_Phdr),
+    };
+    FILE *file;
+    for(int i = 0; i < ASM_SECTIONS; ++i){
+        offsets[i] = offset;
+        addresses[i] = ELF_BASE + offset;
+        if(assembly->sections[i].size)
+            headers[nb_headers++] = (Elf64_Phdr){PT_LOAD, flags[i], i == ASM_BSS ? 0 : offset, addresses[i], addresses[i],
+                i == ASM_BSS ? 0 : assembly->sections[i].size, assembly->sections[i].size, ELF_PAGE};
+        offset = page_align(offset + assembly->sections[i].size);
+    }
+    resolve_fixups(assembly, addresses);
+    if((elf_header.e_entry = symbol_address(assembly, "_start", addresses)) == (Elf64_Addr) -1){
+        fprintf(stderr, "Assembler error: no _start\n");
+        exit(EXIT_ERROR);
+    }
+    elf_header.e_phnum = nb_headers;
+    if(strstr(exe_filename, ".asm"))
+        strstr(exe_filename, ".asm")[0] = '\0';
+    file = try(fopen(exe_filename, "w"), NULL);
+    fwrite(&elf_header, sizeof(Elf64_Ehdr), 1, file);
+    fwrite(headers, sizeof(Elf64_Phdr), nb_headers, file);
+    for(int i = 0; i < ASM_BSS; ++i){
+        fseek(file, offsets[i], SEEK_SET);
+        fwrite(assembly->sections[i].bytes, 1, assembly->sections[i].size, file);
+    }
+    fclose(file);
+    try(chmod(exe_filename, 0755));
+    free_assembly(assembly);
+    free(exe_filename);
+}
+
+/**
+ * @brief Maps a stack for a program run in memory, starting like the one of a new process: argc,
+ * argv and the environment, since main may read its parameters above them.
+ * @param base Set to the start of the mapping.
+ * @return The top of the stack, 16 bytes aligned like at the entry of _start.
+ */
+static long *map_stack(char *asm_filename, char **base){
+    extern char **environ;
+    char *stack = try(mmap(NULL, RUN_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0), MAP_FAILED);
+    char *name = stack + RUN_STACK_SIZE - strlen(asm_filename) - 1;
+    long *top;
+    int nb_env = 0;
+    while(environ[nb_env])
+        nb_env++;
+    strcpy(name, asm_filename);
+    if(strstr(name, ".asm"))
+        strstr(name, ".asm")[0] = '\0';
+    top = (long*) (((long) name - sizeof(long) * (nb_env + 4)) & ~15L);
+    top[0] = 1;
+    top[1] = (long) name;
+    top[2] = 0;
+    for(int i = 0; i < nb_env; ++i)
+        top[3 + i] = (long) environ[i];
+    top[3 + nb_env] = 0;
+    *base = stack;
+    return top;
+}
+
+/**
+ * @brief Runs the program of the assembly generated by build_asm() in the memory of the
+ * compiler, without writing any file.
+ *
+ * The program is assembled with _run, calling main like _start does but on a stack of its own
+ * and returning to the compiler. The sections are mapped below 2 GB, so that their addresses
+ * fit in the 32 bit fields of the code, the code being made executable once its addresses are
+ * written. A program stopped by getint, by a signal or by a division by zero stops the compiler
+ * the same way.
+ * @param asm_filename Name the assembly file would have, argv[0] being its name without .asm.
+ * @return The value returned by main.
+ */
+int run_in_memory(char *text, char *asm_filename){
+    static const int protections[ASM_SECTIONS] = {PROT_READ | PROT_EXEC, PROT_READ, PROT_READ | PROT_WRITE};
+    char *program, *stack_base;
+    Assembly *assembly;
+    unsigned char *memory;
+    long addresses[ASM_SECTIONS], offsets[ASM_SECTIONS], size = 0, line_buffered_address, *stack;
+    long (*run)(long *stack);
+    int status;
+    program = (char*) try(malloc(strlen(text) + strlen(RUN_ENTRY) + 1), NULL);
+    strcat(strcpy(program, text), RUN_ENTRY);
+    assembly = assemble_program(program);
+    for(int i = 0; i < ASM_SECTIONS; ++i){
+        offsets[i] = size;
+        size = page_align(size + assembly->sections[i].size);
+    }
+    memory = try(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0), MAP_FAILED);
+    for(int i = 0; i < ASM_SECTIONS; ++i)
+        addresses[i] = (long) memory + offsets[i];
+    resolve_fixups(assembly, addresses);
+    for(int i = 0; i < ASM_SECTIONS; ++i){
+        if(i != ASM_BSS)
+            memcpy(memory + offsets[i], assembly->sections[i].bytes, assembly->sections[i].size);
+        if(assembly->sections[i].size)
+            try(mprotect(memory + offsets[i], page_align(assembly->sections[i].size), protections[i]));
+    }
+    if(line_buffered && (line_buffered_address = symbol_address(assembly, "_line_buffered", addresses)) >= 0)
+        *(char*) line_buffered_address = 1;
+    run = (long (*)(long*)) symbol_address(assembly, "_run", addresses);
+    stack = map_stack(asm_filename, &stack_base);
+    free_assembly(assembly);
+    free(program);
+    status = run(stack);
+    munmap(stack_base, RUN_STACK_SIZE);
+    munmap(memory, size);
+    return status;
+}
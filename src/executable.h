@@ -0,0 +1,29 @@
+/**
+ * @file executable.h
+ * @brief Writing of the programs as static ELF64 executables, without an assembler nor a linker.
+ */
+
+#ifndef __EXECUTABLE__H
+#define __EXECUTABLE__H
+
+#include "assemble.h"
+
+#define ELF_BASE 0x400000 ///< Address of the headers in memory, the sections following page by page.
+#define ELF_PAGE 0x1000   ///< Size of a page, alignment of the segments.
+
+#define RUN_STACK_SIZE (8 << 20) ///< Size of the stack of a program run in memory, the usual limit of a process.
+
+/**
+ * @brief Entry of a program run in memory, given its stack in rdi: main called on this stack with
+ * the registers of the compiler saved, and the output flushed.
+ */
+#define RUN_ENTRY "section .text\n_run:\npush rbx\npush rbp\npush r12\npush r13\npush r14\npush r15\n" \
+    "mov [_run_stack], rsp ; pile du compilateur\nmov rsp, rdi ; pile du programme, comme à l'entrée de _start\n" \
+    "call main\npush rax\ncall _flush ; on écrit la sortie en attente\npop rax\nmov rsp, [_run_stack]\n" \
+    "pop r15\npop r14\npop r13\npop r12\npop rbp\npop rbx\nret\nsection .bss\n_run_stack resq 1\n"
+
+void build_executable(char *text, char *asm_filename); ///< Function to write the executable of some assembly, named like its file without .asm.
+
+int run_in_memory(char *text, char *asm_filename); ///< Function to run the program of some assembly in the memory of the compiler, returning the value of main.
+
+#endif
@@ -0,0 +1,50 @@
+#include "frame.h"
+
+/**
+ * @brief Gives the size of an array element in memory, the same for the global, local and
+ * parameter arrays: 4 bytes for an int, 1 for a char.
+ */
+int element_size(int is_int){
+    return is_int ? 4 : 1;
+}
+
+static int align(int offset, int alignment){
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief Places the local variables of one kind below the ones already placed.
+ * @param offset Distance from rbp to the lowest byte used so far, updated.
+ */
+static void place_vars(Table *variables, int is_array, int is_int, int *offset){
+    for(Table *current = variables; current; current = current->next){
+        if(current->var.is_array != is_array || (is_array && current->var.is_int != is_int))
+            continue;
+        if(is_array)
+            *offset = align(*offset + current->var.size * element_size(is_int), element_size(is_int));
+        else
+            *offset += FRAME_SLOT;
+        current->var.deplct = *offset;
+    }
+}
+
+/**
+ * @brief Gives their offsets to the parameters and the local variables of a function.
+ *
+ * The parameters are pushed by the caller, one slot each above the return address. The local
+ * scalars come first below rbp, then the int arrays and the char arrays, packed by the size of
+ * their elements, so that the scalars get the shortest displacements and no padding is needed
+ * between the arrays. Each local is at [rbp - deplct], its elements going up from there.
+ * @return The size of the local variables, a multiple of FRAME_ALIGN.
+ */
+int layout_frame(SymTabsFct *function){
+    int offset_params = FRAME_SLOT, offset_vars = 0;
+    for(Table *current = function->parameters; current; current = current->next){
+        offset_params += FRAME_SLOT;
+        current->var.deplct = offset_params;
+    }
+    place_vars(function->variables, 0, 0, &offset_vars);
+    place_vars(function->variables, 1, 1, &offset_vars);
+    place_vars(function->variables, 1, 0, &offset_vars);
+    return align(offset_vars, FRAME_ALIGN);
+}
@@ -0,0 +1,18 @@
+/**
+ * @file frame.h
+ * @brief Layout of the stack frames: offsets of the parameters and of the local variables.
+ */
+
+#ifndef __FRAME__H
+#define __FRAME__H
+
+#include "compile.h"
+
+#define FRAME_SLOT 8  ///< Size of a parameter and of a local scalar, which hold a whole register.
+#define FRAME_ALIGN 8 ///< Alignment of the frame size, so that the hidden slots below it stay aligned.
+
+int element_size(int is_int); ///< Function to get the size of an array element in memory.
+
+int layout_frame(SymTabsFct *function); ///< Function to give their offsets to the parameters and the local variables of a function, returning the size of its frame.
+
+#endif
@@ -0,0 +1,709 @@
+#include <stdarg.h>
+#include "ir.h"
+
+static const char *ir_op_names[] = {
+    "const", "undef", "param",
+    "add", "sub", "mul", "div", "mod",
+    "eq", "ne", "lt", "le", "gt", "ge",
+    "and", "or",
+    "neg", "not",
+    "load", "store", "load_elem", "store_elem", "addr", "call", "phi",
+    "jump", "branch", "ret"
+};
+
+/**
+ * @brief State of a block while its function is lowered.
+ */
+typedef struct{
+    int *defs;            ///< Current value of each variable in the block, IR_NO_VALUE if not known yet.
+    int sealed;           ///< Flag telling if all the predecessors of the block are known.
+    IrInstr **phis;       ///< Phis created before the block was sealed, waiting for their operands.
+    int *phi_vars;        ///< Variable of each waiting phi.
+    int nb_phis;          ///< Number of waiting phis.
+}BlockState;
+
+/**
+ * @brief State of the lowering of a function.
+ *
+ * The scalar parameters and local variables are renamed into values while the statements are
+ * lowered: a read looks for the current value in the block, then in its predecessors through
+ * phis. The phis of a block whose predecessors aren't all known yet, like a loop header, get
+ * their operands when the block is sealed.
+ */
+typedef struct{
+    IrFunction *function;
+    SymTabs *global_vars;
+    SymTabsFct **functions;
+    int nb_functions;
+    SymTabsFct *table;     ///< Table of the lowered function.
+    char **vars;           ///< Scalar parameters and local variables.
+    int nb_vars;           ///< Number of variables.
+    BlockState *states;    ///< State of each block.
+    int current;           ///< Block receiving the instructions.
+    int lineno;            ///< Line of the statement being lowered.
+}Lowering;
+
+static int is_terminator(IrOp op){
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RET;
+}
+
+static int successors(IrBlock *block, int *succ){
+    if(!block->last || !is_terminator(block->last->op) || block->last->op == IR_RET)
+        return 0;
+    succ[0] = block->last->targets[0];
+    if(block->last->op == IR_JUMP)
+        return 1;
+    succ[1] = block->last->targets[1];
+    return 2;
+}
+
+static int new_block(Lowering *low){
+    IrFunction *function = low->function;
+    function->blocks = (IrBlock*) try(realloc(function->blocks, sizeof(IrBlock) * (function->nb_blocks + 1)), NULL);
+    function->blocks[function->nb_blocks] = (IrBlock){NULL, NULL, NULL, 0, -1, -1};
+    low->states = (BlockState*) try(realloc(low->states, sizeof(BlockState) * (function->nb_blocks + 1)), NULL);
+    low->states[function->nb_blocks] = (BlockState){NULL, 0, NULL, NULL, 0};
+    low->states[function->nb_blocks].defs = (int*) try(malloc(sizeof(int) * (low->nb_vars + 1)), NULL);
+    for(int i = 0; i < low->nb_vars; ++i)
+        low->states[function->nb_blocks].defs[i] = IR_NO_VALUE;
+    return function->nb_blocks++;
+}
+
+static void add_pred(Lowering *low, int block, int pred){
+    IrBlock *current = &low->function->blocks[block];
+    current->preds = (int*) try(realloc(current->preds, sizeof(int) * (current->nb_preds + 1)), NULL);
+    current->preds[current->nb_preds++] = pred;
+}
+
+static IrInstr *new_instr(Lowering *low, IrOp op, int type, int nb_args){
+    IrInstr *instr = (IrInstr*) try(malloc(sizeof(IrInstr)), NULL);
+    instr->op = op;
+    instr->type = type;
+    instr->id = type == VOID ? IR_NO_VALUE : low->function->nb_values++;
+    instr->args = nb_args ? (int*) try(malloc(sizeof(int) * nb_args), NULL) : NULL;
+    instr->nb_args = nb_args;
+    instr->value = 0;
+    instr->name = NULL;
+    instr->targets[0] = instr->targets[1] = -1;
+    instr->lineno = low->lineno;
+    instr->next = NULL;
+    return instr;
+}
+
+static void append(Lowering *low, IrInstr *instr){
+    IrBlock *block = &low->function->blocks[low->current];
+    if(block->last)
+        block->last->next = instr;
+    else
+        block->first = instr;
+    block->last = instr;
+}
+
+static void prepend(IrBlock *block, IrInstr *instr){
+    instr->next = block->first;
+    block->first = instr;
+    if(!block->last)
+        block->last = instr;
+}
+
+static IrInstr *emit(Lowering *low, IrOp op, int type, int nb_args, ...){
+    IrInstr *instr = new_instr(low, op, type, nb_args);
+    va_list args;
+    va_start(args, nb_args);
+    for(int i = 0; i < nb_args; ++i)
+        instr->args[i] = va_arg(args, int);
+    va_end(args);
+    append(low, instr);
+    return instr;
+}
+
+static void jump(Lowering *low, int target){
+    IrInstr *instr = emit(low, IR_JUMP, VOID, 0);
+    instr->targets[0] = target;
+    add_pred(low, target, low->current);
+}
+
+static int read_var(Lowering *low, int var, int block);
+
+static void add_phi_operands(Lowering *low, IrInstr *phi, int var, int block){
+    IrBlock *current = &low->function->blocks[block];
+    phi->args = (int*) try(realloc(phi->args, sizeof(int) * (current->nb_preds + 1)), NULL);
+    phi->nb_args = current->nb_preds;
+    for(int i = 0; i < current->nb_preds; ++i)
+        phi->args[i] = read_var(low, var, low->function->blocks[block].preds[i]);
+}
+
+/**
+ * @brief Gives the value of a variable at the end of a block, creating the phis it needs.
+ */
+static int read_var(Lowering *low, int var, int block){
+    BlockState *state = &low->states[block];
+    IrBlock *current = &low->function->blocks[block];
+    IrInstr *instr;
+    if(state->defs[var] != IR_NO_VALUE)
+        return state->defs[var];
+    if(!state->sealed){
+        instr = new_instr(low, IR_PHI, INT, 0);
+        prepend(current, instr);
+        state->phis = (IrInstr**) try(realloc(state->phis, sizeof(IrInstr*) * (state->nb_phis + 1)), NULL);
+        state->phi_vars = (int*) try(realloc(state->phi_vars, sizeof(int) * (state->nb_phis + 1)), NULL);
+        state->phis[state->nb_phis] = instr;
+        state->phi_vars[state->nb_phis++] = var;
+        return state->defs[var] = instr->id;
+    }
+    if(current->nb_preds == 0){
+        instr = new_instr(low, IR_UNDEF, INT, 0);
+        prepend(current, instr);
+        return state->defs[var] = instr->id;
+    }
+    if(current->nb_preds == 1)
+        return state->defs[var] = read_var(low, var, current->preds[0]);
+    instr = new_instr(low, IR_PHI, INT, 0);
+    prepend(current, instr);
+    low->states[block].defs[var] = instr->id;
+    add_phi_operands(low, instr, var, block);
+    return instr->id;
+}
+
+static void seal(Lowering *low, int block){
+    BlockState *state = &low->states[block];
+    for(int i = 0; i < state->nb_phis; ++i)
+        add_phi_operands(low, low->states[block].phis[i], low->states[block].phi_vars[i], block);
+    state = &low->states[block];
+    free(state->phis);
+    free(state->phi_vars);
+    state->phis = NULL;
+    state->phi_vars = NULL;
+    state->nb_phis = 0;
+    state->sealed = 1;
+}
+
+static int var_index(Lowering *low, char *var_name){
+    if(check_in_table(*low->global_vars, var_name))
+        return -1;
+    for(int i = 0; i < low->nb_vars; ++i)
+        if(!strcmp(low->vars[i], var_name))
+            return i;
+    return -1;
+}
+
+static void add_vars(Lowering *low, Table *table){
+    for(Table *current = table; current; current = current->next){
+        if(current->var.is_array)
+            continue;
+        low->vars = (char**) try(realloc(low->vars, sizeof(char*) * (low->nb_vars + 1)), NULL);
+        low->vars[low->nb_vars++] = current->var.ident;
+    }
+}
+
+/**
+ * @brief Gives the type of an array element or a global, as the code generation resolves it.
+ */
+static int var_type(Lowering *low, char *var_name){
+    if(check_in_table(*low->global_vars, var_name))
+        return find_type_in_sb(var_name, low->global_vars) ? INT : CHAR;
+    return find_type_in_fct(var_name, low->table) ? INT : CHAR;
+}
+
+static int is_array_name(Lowering *low, char *var_name){
+    if(check_in_table(*low->global_vars, var_name))
+        return check_is_array(var_name, low->global_vars->first) == 1;
+    return check_is_array(var_name, low->table->parameters) == 1 || check_is_array(var_name, low->table->variables) == 1;
+}
+
+static int function_type(Lowering *low, char *function_name){
+    if(!strcmp(function_name, "getint"))
+        return INT;
+    if(!strcmp(function_name, "getchar"))
+        return CHAR;
+    if(is_builtin_function(function_name))
+        return VOID;
+    for(int i = 0; i < low->nb_functions; ++i)
+        if(!strcmp(low->functions[i]->ident, function_name))
+            return low->functions[i]->type;
+    return VOID;
+}
+
+static int lower_expr(Lowering *low, Node *root);
+
+static int lower_call(Lowering *low, Node *root){
+    int type = function_type(low, FIRSTCHILD(root)->ident), nb_args = 0, *args = NULL;
+    IrInstr *instr;
+    for(Node *arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))); arg && arg->label != Void; arg = arg->nextSibling){
+        args = (int*) try(realloc(args, sizeof(int) * (nb_args + 1)), NULL);
+        args[nb_args++] = lower_expr(low, arg);
+    }
+    instr = emit(low, IR_CALL, type, 0);
+    instr->args = args;
+    instr->nb_args = nb_args;
+    instr->name = FIRSTCHILD(root)->ident;
+    return instr->id;
+}
+
+static IrOp binary_op(Node *root){
+    switch(root->label){
+        case Addsub:
+            return root->ident[0] == '+' ? IR_ADD : IR_SUB;
+        case Divstar:
+            return root->ident[0] == '*' ? IR_MUL : root->ident[0] == '/' ? IR_DIV : IR_MOD;
+        case Eq:
+            return strcmp(root->ident, "==") ? IR_NE : IR_EQ;
+        case Order:
+            if(!strcmp(root->ident, "<"))
+                return IR_LT;
+            if(!strcmp(root->ident, "<="))
+                return IR_LE;
+            return strcmp(root->ident, ">") ? IR_GE : IR_GT;
+        case And:
+            return IR_AND;
+        default:
+            return IR_OR;
+    }
+}
+
+/**
+ * @brief Lowers an expression, both operands of && and || included as the code generation does.
+ * @return Value number of the result.
+ */
+static int lower_expr(Lowering *low, Node *root){
+    IrInstr *instr;
+    int left, right, var;
+    switch(root->label){
+        case Expression:
+            return lower_expr(low, FIRSTCHILD(root));
+        case Num:
+            instr = emit(low, IR_CONST, INT, 0);
+            instr->value = root->num;
+            return instr->id;
+        case Character:
+            instr = emit(low, IR_CONST, CHAR, 0);
+            instr->value = character_value(root);
+            return instr->id;
+        case Variable:
+            if(FIRSTCHILD(root)->label == Array){
+                char *array = FIRSTCHILD(FIRSTCHILD(root))->ident;
+                left = lower_expr(low, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
+                instr = emit(low, IR_LOAD_ELEM, var_type(low, array), 1, left);
+                instr->name = array;
+                return instr->id;
+            }
+            if((var = var_index(low, FIRSTCHILD(root)->ident)) >= 0)
+                return read_var(low, var, low->current);
+            instr = emit(low, is_array_name(low, FIRSTCHILD(root)->ident) ? IR_ADDR : IR_LOAD,
+                is_array_name(low, FIRSTCHILD(root)->ident) ? IR_ADDRESS : var_type(low, FIRSTCHILD(root)->ident), 0);
+            instr->name = FIRSTCHILD(root)->ident;
+            return instr->id;
+        case Function:
+            return lower_call(low, root);
+        case Not:
+            return emit(low, IR_NOT, INT, 1, lower_expr(low, FIRSTCHILD(root)))->id;
+        case Addsub:
+            if(!SECONDCHILD(root)){
+                left = lower_expr(low, FIRSTCHILD(root));
+                return root->ident[0] == '-' ? emit(low, IR_NEG, INT, 1, left)->id : left;
+            }
+            break;
+        default:
+            break;
+    }
+    left = lower_expr(low, FIRSTCHILD(root));
+    right = lower_expr(low, SECONDCHILD(root));
+    return emit(low, binary_op(root), INT, 2, left, right)->id;
+}
+
+/**
+ * @brief Lowers a statement, starting a new unreachable block after a return.
+ */
+static void lower_stmt(Lowering *low, Node *root){
+    IrInstr *instr;
+    int value, var, then_block, else_block, join, header, body;
+    low->lineno = root->lineno;
+    switch(root->label){
+        case Corps:
+        case Instructions:
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+                lower_stmt(low, current);
+            break;
+        case Equals:;
+            Node *target = FIRSTCHILD(FIRSTCHILD(root));
+            value = lower_expr(low, SECONDCHILD(root));
+            if(target->label == Array){
+                instr = emit(low, IR_STORE_ELEM, VOID, 2, lower_expr(low, FIRSTCHILD(FIRSTCHILD(target))), value);
+                instr->name = FIRSTCHILD(target)->ident;
+            }
+            else if((var = var_index(low, target->ident)) >= 0)
+                low->states[low->current].defs[var] = value;
+            else
+                emit(low, IR_STORE, VOID, 1, value)->name = target->ident;
+            break;
+        case Function:
+            if(is_function_call(root))
+                lower_call(low, root);
+            break;
+        case Return:
+            if(FIRSTCHILD(root)->label != Void)
+                emit(low, IR_RET, VOID, 1, lower_expr(low, FIRSTCHILD(root)));
+            else
+                emit(low, IR_RET, VOID, 0);
+            low->current = new_block(low);
+            seal(low, low->current);
+            break;
+        case If:
+            value = lower_expr(low, FIRSTCHILD(root));
+            instr = emit(low, IR_BRANCH, VOID, 1, value);
+            then_block = new_block(low);
+            else_block = new_block(low);
+            join = THIRDCHILD(root) ? new_block(low) : else_block;
+            instr->targets[0] = then_block;
+            instr->targets[1] = else_block;
+            add_pred(low, then_block, low->current);
+            add_pred(low, else_block, low->current);
+            seal(low, then_block);
+            low->current = then_block;
+            lower_stmt(low, SECONDCHILD(root));
+            jump(low, join);
+            if(THIRDCHILD(root)){
+                seal(low, else_block);
+                low->current = else_block;
+                lower_stmt(low, THIRDCHILD(root));
+                jump(low, join);
+            }
+            seal(low, join);
+            low->current = join;
+            break;
+        case While:
+            header = new_block(low);
+            jump(low, header);
+            low->current = header;
+            value = lower_expr(low, FIRSTCHILD(root));
+            instr = emit(low, IR_BRANCH, VOID, 1, value);
+            body = new_block(low);
+            join = new_block(low);
+            instr->targets[0] = body;
+            instr->targets[1] = join;
+            add_pred(low, body, header);
+            add_pred(low, join, header);
+            seal(low, body);
+            low->current = body;
+            lower_stmt(low, SECONDCHILD(root));
+            jump(low, header);
+            seal(low, header);
+            seal(low, join);
+            low->current = join;
+            break;
+        default:
+            break;
+    }
+}
+
+static void remove_trivial_phis(IrFunction *function);
+
+/**
+ * @brief Lowers a checked function to SSA form.
+ *
+ * The globals, the arrays and the scalars that have the name of a global are accessed in
+ * memory, the other scalars become values. A function falling off its end returns nothing.
+ * @param decl The Function node of the declaration.
+ */
+IrFunction *lower_function(Node *decl, SymTabs *global_vars, SymTabsFct **functions, int nb_functions){
+    Lowering low = {NULL, global_vars, functions, nb_functions, NULL, NULL, 0, NULL, 0, decl->lineno};
+    int index = 0, var;
+    for(int i = 0; i < nb_functions; ++i)
+        if(!strcmp(functions[i]->ident, SECONDCHILD(decl)->ident))
+            low.table = functions[i];
+    if(!low.table)
+        return NULL;
+    low.function = (IrFunction*) try(malloc(sizeof(IrFunction)), NULL);
+    *low.function = (IrFunction){low.table->ident, low.table->type, NULL, 0, 0};
+    add_vars(&low, low.table->parameters);
+    add_vars(&low, low.table->variables);
+    low.current = new_block(&low);
+    seal(&low, low.current);
+    for(Node *param = FIRSTCHILD(THIRDCHILD(decl)); param; param = param->nextSibling){
+        if(param->label != Type)
+            continue;
+        for(Node *current = FIRSTCHILD(param); current; current = current->nextSibling, ++index)
+            if(current->label == Ident && (var = var_index(&low, current->ident)) >= 0){
+                IrInstr *instr = emit(&low, IR_PARAM, strcmp(param->ident, "char") ? INT : CHAR, 0);
+                instr->value = index;
+                instr->name = current->ident;
+                low.states[low.current].defs[var] = instr->id;
+            }
+    }
+    lower_stmt(&low, FOURTHCHILD(decl));
+    emit(&low, IR_RET, VOID, 0);
+    for(int i = 0; i < low.function->nb_blocks; ++i){
+        free(low.states[i].defs);
+        free(low.states[i].phis);
+        free(low.states[i].phi_vars);
+    }
+    free(low.states);
+    free(low.vars);
+    remove_trivial_phis(low.function);
+    compute_dominators(low.function);
+    return low.function;
+}
+
+static void replace_uses(IrFunction *function, int old, int value){
+    for(int b = 0; b < function->nb_blocks; ++b)
+        for(IrInstr *instr = function->blocks[b].first; instr; instr = instr->next)
+            for(int i = 0; i < instr->nb_args; ++i)
+                if(instr->args[i] == old)
+                    instr->args[i] = value;
+}
+
+/**
+ * @brief Removes the phis merging a single value with themselves, like the ones of the
+ * variables that a loop doesn't assign.
+ */
+static void remove_trivial_phis(IrFunction *function){
+    int changed = 1;
+    while(changed){
+        changed = 0;
+        for(int b = 0; b < function->nb_blocks; ++b)
+            for(IrInstr **link = &function->blocks[b].first; *link && (*link)->op == IR_PHI;){
+                IrInstr *phi = *link;
+                int value = IR_NO_VALUE, trivial = 1;
+                for(int i = 0; i < phi->nb_args && trivial; ++i)
+                    if(phi->args[i] != phi->id && phi->args[i] != value){
+                        trivial = value == IR_NO_VALUE;
+                        value = phi->args[i];
+                    }
+                if(!trivial || value == IR_NO_VALUE){
+                    link = &phi->next;
+                    continue;
+                }
+                *link = phi->next;
+                if(function->blocks[b].last == phi)
+                    function->blocks[b].last = NULL;
+                replace_uses(function, phi->id, value);
+                free(phi->args);
+                free(phi);
+                changed = 1;
+            }
+    }
+}
+
+static void postorder(IrFunction *function, int block, char *visited, int *order, int *nb){
+    int succ[2], nb_succ;
+    visited[block] = 1;
+    nb_succ = successors(&function->blocks[block], succ);
+    for(int i = 0; i < nb_succ; ++i)
+        if(succ[i] >= 0 && succ[i] < function->nb_blocks && !visited[succ[i]])
+            postorder(function, succ[i], visited, order, nb);
+    order[(*nb)++] = block;
+}
+
+static int intersect(IrFunction *function, int a, int b){
+    while(a != b){
+        while(function->blocks[a].order > function->blocks[b].order)
+            a = function->blocks[a].idom;
+        while(function->blocks[b].order > function->blocks[a].order)
+            b = function->blocks[b].idom;
+    }
+    return a;
+}
+
+/**
+ * @brief Computes the immediate dominators with the iterative algorithm of Cooper, Harvey and Kennedy.
+ */
+void compute_dominators(IrFunction *function){
+    char *visited = (char*) try(calloc(function->nb_blocks + 1, sizeof(char)), NULL);
+    int *order = (int*) try(malloc(sizeof(int) * (function->nb_blocks + 1)), NULL);
+    int nb = 0, changed = 1;
+    for(int i = 0; i < function->nb_blocks; ++i){
+        function->blocks[i].order = -1;
+        function->blocks[i].idom = -1;
+    }
+    postorder(function, 0, visited, order, &nb);
+    for(int i = 0; i < nb; ++i)
+        function->blocks[order[nb - 1 - i]].order = i;
+    function->blocks[0].idom = 0;
+    while(changed){
+        changed = 0;
+        for(int i = nb - 2; i >= 0; --i){
+            IrBlock *block = &function->blocks[order[i]];
+            int idom = -1;
+            for(int j = 0; j < block->nb_preds; ++j){
+                int pred = block->preds[j];
+                if(function->blocks[pred].idom < 0)
+                    continue;
+                idom = idom < 0 ? pred : intersect(function, pred, idom);
+            }
+            if(idom != block->idom){
+                block->idom = idom;
+                changed = 1;
+            }
+        }
+    }
+    function->blocks[0].idom = -1;
+    free(visited);
+    free(order);
+}
+
+int ir_dominates(IrFunction *function, int a, int b){
+    if(function->blocks[b].order < 0)
+        return a == b;
+    for(; b >= 0; b = function->blocks[b].idom)
+        if(b == a)
+            return 1;
+    return 0;
+}
+
+static int report(IrFunction *function, FILE *file, int block, char *message, int value){
+    fprintf(file, "IR verifier, function %s, block %d: ", function->name, block);
+    fprintf(file, message, value);
+    fprintf(file, "\n");
+    return 1;
+}
+
+/**
+ * @brief Checks that a function is well formed.
+ *
+ * Each block ends with its only terminator, whose targets list the block among their
+ * predecessors, and the phis come first with one operand per predecessor. Each value is
+ * defined once, before its uses in its block and in a block dominating them; the operand of
+ * a phi must be available at the end of its predecessor. Addresses are only passed to calls.
+ * @return The number of broken invariants, written on file.
+ */
+int verify_function(IrFunction *function, FILE *file){
+    int errors = 0, *def_block, *def_pos;
+    def_block = (int*) try(malloc(sizeof(int) * (function->nb_values + 1)), NULL);
+    def_pos = (int*) try(malloc(sizeof(int) * (function->nb_values + 1)), NULL);
+    for(int i = 0; i < function->nb_values; ++i)
+        def_block[i] = -1;
+    for(int b = 0; b < function->nb_blocks; ++b){
+        int pos = 0;
+        for(IrInstr *instr = function->blocks[b].first; instr; instr = instr->next, ++pos){
+            if(instr->id == IR_NO_VALUE)
+                continue;
+            if(instr->id < 0 || instr->id >= function->nb_values || def_block[instr->id] >= 0)
+                errors += report(function, file, b, "value %%%d defined twice", instr->id);
+            else{
+                def_block[instr->id] = b;
+                def_pos[instr->id] = pos;
+            }
+        }
+    }
+    for(int b = 0; b < function->nb_blocks; ++b){
+        IrBlock *block = &function->blocks[b];
+        int pos = 0, phis = 1, succ[2], nb_succ;
+        if(!block->last || !is_terminator(block->last->op))
+            errors += report(function, file, b, "no terminator", 0);
+        for(IrInstr *instr = block->first; instr; instr = instr->next, ++pos){
+            if(is_terminator(instr->op) && instr != block->last)
+                errors += report(function, file, b, "terminator in the middle of the block", 0);
+            if(instr->op == IR_PHI && !phis)
+                errors += report(function, file, b, "phi %%%d after another instruction", instr->id);
+            if(instr->op != IR_PHI)
+                phis = 0;
+            if(instr->op == IR_PHI && instr->nb_args != block->nb_preds)
+                errors += report(function, file, b, "phi %%%d without one operand per predecessor", instr->id);
+            if(block->order < 0)
+                continue;
+            for(int i = 0; i < instr->nb_args; ++i){
+                int arg = instr->args[i], from;
+                if(arg < 0 || arg >= function->nb_values || def_block[arg] < 0){
+                    errors += report(function, file, b, "use of the undefined value %%%d", arg);
+                    continue;
+                }
+                if(instr->op == IR_PHI){
+                    from = i < block->nb_preds ? block->preds[i] : b;
+                    if(function->blocks[from].order >= 0 && !ir_dominates(function, def_block[arg], from))
+                        errors += report(function, file, b, "phi operand %%%d not available in its predecessor", arg);
+                }
+                else if(def_block[arg] == b ? def_pos[arg] >= pos : !ir_dominates(function, def_block[arg], b))
+                    errors += report(function, file, b, "use of %%%d not dominated by its definition", arg);
+            }
+        }
+        nb_succ = successors(block, succ);
+        for(int i = 0; i < nb_succ; ++i){
+            int found = 0;
+            if(succ[i] < 0 || succ[i] >= function->nb_blocks){
+                errors += report(function, file, b, "jump to the unknown block %d", succ[i]);
+                continue;
+            }
+            for(int j = 0; j < function->blocks[succ[i]].nb_preds; ++j)
+                found |= function->blocks[succ[i]].preds[j] == b;
+            if(!found)
+                errors += report(function, file, b, "missing from the predecessors of block %d", succ[i]);
+        }
+        for(int i = 0; i < block->nb_preds; ++i){
+            int pred = block->preds[i], found = 0;
+            nb_succ = successors(&function->blocks[pred], succ);
+            for(int j = 0; j < nb_succ; ++j)
+                found |= succ[j] == b;
+            if(!found)
+                errors += report(function, file, b, "predecessor %d doesn't jump to the block", pred);
+        }
+    }
+    for(int b = 0; b < function->nb_blocks; ++b)
+        for(IrInstr *instr = function->blocks[b].first; instr; instr = instr->next)
+            for(int i = 0; i < instr->nb_args; ++i){
+                int arg = instr->args[i];
+                if(arg < 0 || arg >= function->nb_values || def_block[arg] < 0 || instr->op == IR_CALL)
+                    continue;
+                for(IrInstr *def = function->blocks[def_block[arg]].first; def; def = def->next)
+                    if(def->id == arg && def->type == IR_ADDRESS)
+                        errors += report(function, file, b, "address %%%d used outside of a call", arg);
+            }
+    free(def_block);
+    free(def_pos);
+    return errors;
+}
+
+static const char *type_name(int type){
+    return type == INT ? "int" : type == CHAR ? "char" : type == IR_ADDRESS ? "addr" : "void";
+}
+
+void print_function(IrFunction *function, FILE *file){
+    fprintf(file, "function %s: %s\n", function->name, type_name(function->type));
+    for(int b = 0; b < function->nb_blocks; ++b){
+        IrBlock *block = &function->blocks[b];
+        fprintf(file, "b%d:", b);
+        if(block->nb_preds){
+            fprintf(file, " preds");
+            for(int i = 0; i < block->nb_preds; ++i)
+                fprintf(file, " b%d", block->preds[i]);
+        }
+        if(block->order < 0)
+            fprintf(file, " unreachable");
+        else if(block->idom >= 0)
+            fprintf(file, " idom b%d", block->idom);
+        fprintf(file, "\n");
+        for(IrInstr *instr = block->first; instr; instr = instr->next){
+            fprintf(file, "    ");
+            if(instr->id != IR_NO_VALUE)
+                fprintf(file, "%%%d: %s = ", instr->id, type_name(instr->type));
+            fprintf(file, "%s", ir_op_names[instr->op]);
+            if(instr->op == IR_CONST || instr->op == IR_PARAM)
+                fprintf(file, " %ld", instr->value);
+            if(instr->name)
+                fprintf(file, " %s", instr->name);
+            for(int i = 0; i < instr->nb_args; ++i)
+                fprintf(file, "%s%%%d", i ? ", " : " ", instr->args[i]);
+            if(instr->op == IR_JUMP)
+                fprintf(file, " b%d", instr->targets[0]);
+            if(instr->op == IR_BRANCH)
+                fprintf(file, ", b%d, b%d", instr->targets[0], instr->targets[1]);
+            fprintf(file, "\n");
+        }
+    }
+}
+
+void free_function(IrFunction *function){
+    if(!function)
+        return;
+    for(int b = 0; b < function->nb_blocks; ++b){
+        IrInstr *instr = function->blocks[b].first;
+        while(instr){
+            IrInstr *next = instr->next;
+            free(instr->args);
+            free(instr);
+            instr = next;
+        }
+        free(function->blocks[b].preds);
+    }
+    free(function->blocks);
+    free(function);
+}
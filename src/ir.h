@@ -0,0 +1,88 @@
+/**
+ * @file ir.h
+ * @brief Typed intermediate representation in SSA form over the control flow graph of each function.
+ */
+
+#ifndef __IR__H
+#define __IR__H
+
+#include "compile.h"
+
+#define IR_ADDRESS 2  ///< Type of the address of an array passed to a function, beside INT, CHAR and VOID.
+#define IR_NO_VALUE -1 ///< Value number of an instruction without result.
+
+/**
+ * @brief Operations of the instructions.
+ */
+typedef enum{
+    IR_CONST,        ///< Constant value.
+    IR_UNDEF,        ///< Value of a variable read before any assignment.
+    IR_PARAM,        ///< Value of the value-th parameter on entry.
+    IR_ADD, IR_SUB, IR_MUL, IR_DIV, IR_MOD,
+    IR_EQ, IR_NE, IR_LT, IR_LE, IR_GT, IR_GE,
+    IR_AND, IR_OR,
+    IR_NEG, IR_NOT,
+    IR_LOAD,         ///< Read of a global scalar.
+    IR_STORE,        ///< Write of a global scalar.
+    IR_LOAD_ELEM,    ///< Read of an array element, indexed by its argument.
+    IR_STORE_ELEM,   ///< Write of an array element, with the index and the value as arguments.
+    IR_ADDR,         ///< Address of an array.
+    IR_CALL,         ///< Call of a function with its arguments.
+    IR_PHI,          ///< Merge of one value per predecessor, in the order of the predecessors.
+    IR_JUMP,         ///< Jump to the first target.
+    IR_BRANCH,       ///< Jump to the first target if the argument isn't 0, to the second one otherwise.
+    IR_RET           ///< Return, with the returned value as argument if any.
+}IrOp;
+
+/**
+ * @brief Instruction of a basic block.
+ */
+typedef struct ir_instr{
+    IrOp op;                ///< Operation.
+    int type;               ///< INT, CHAR, VOID or IR_ADDRESS.
+    int id;                 ///< Value number of the result, IR_NO_VALUE if none.
+    int *args;              ///< Value numbers of the operands.
+    int nb_args;            ///< Number of operands.
+    long value;             ///< Constant of IR_CONST, index of IR_PARAM.
+    char *name;             ///< Global, array, parameter or function of the instruction.
+    int targets[2];         ///< Successors of IR_JUMP and IR_BRANCH.
+    int lineno;             ///< Line of the statement of the instruction.
+    struct ir_instr *next;  ///< Next instruction of the block.
+}IrInstr;
+
+/**
+ * @brief Basic block, ended by IR_JUMP, IR_BRANCH or IR_RET.
+ */
+typedef struct{
+    IrInstr *first;    ///< First instruction, phis first.
+    IrInstr *last;     ///< Terminator once the block is complete.
+    int *preds;        ///< Predecessors, in the order of the operands of the phis.
+    int nb_preds;      ///< Number of predecessors.
+    int idom;          ///< Immediate dominator, -1 for the entry and the unreachable blocks.
+    int order;         ///< Index in reverse postorder, -1 if the block is unreachable.
+}IrBlock;
+
+/**
+ * @brief Function lowered in SSA form.
+ */
+typedef struct{
+    char *name;         ///< Name of the function.
+    int type;           ///< Returned type.
+    IrBlock *blocks;    ///< Blocks, the first one is the entry.
+    int nb_blocks;      ///< Number of blocks.
+    int nb_values;      ///< Number of value numbers.
+}IrFunction;
+
+IrFunction *lower_function(Node *decl, SymTabs *global_vars, SymTabsFct **functions, int nb_functions); ///< Function to lower the declaration of a checked function to SSA form.
+
+void compute_dominators(IrFunction *function); ///< Function to compute the reverse postorder and the immediate dominators of the blocks.
+
+int ir_dominates(IrFunction *function, int a, int b); ///< Function to check if a block dominates another one.
+
+int verify_function(IrFunction *function, FILE *file); ///< Function to check the invariants of a function in SSA form, reporting the broken ones.
+
+void print_function(IrFunction *function, FILE *file); ///< Function to write a function in SSA form.
+
+void free_function(IrFunction *function); ///< Function to free a function in SSA form.
+
+#endif
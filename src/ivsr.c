@@ -0,0 +1,320 @@
+#include "ivsr.h"
+#include "frame.h"
+
+static Node *unwrap(Node *root){
+    return root->label == Expression ? FIRSTCHILD(root) : root;
+}
+
+/**
+ * @brief Gives the name of a scalar variable read by an expression, or NULL for another expression.
+ */
+static char *scalar_name(Node *root){
+    root = unwrap(root);
+    return root->label == Variable && FIRSTCHILD(root)->label == Ident ? FIRSTCHILD(root)->ident : NULL;
+}
+
+static Element *find_element(Table *table, char *var_name){
+    for(Table *current = table; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return &current->var;
+    return NULL;
+}
+
+/**
+ * @brief Tells if a name is a scalar of the function. As in the code generation, globals come first.
+ */
+static int is_local_scalar(SymTabsFct *function, SymTabs *global_vars, char *var_name){
+    Element *var = find_element(function->variables, var_name);
+    if(!var)
+        var = find_element(function->parameters, var_name);
+    return var && !var->is_array && !find_element(global_vars->first, var_name);
+}
+
+static int count_assignments(Node *root, char *var_name){
+    int nb = 0;
+    for(; root; root = root->nextSibling){
+        if(root->label == Equals && FIRSTCHILD(FIRSTCHILD(root))->label == Ident
+            && !strcmp(FIRSTCHILD(FIRSTCHILD(root))->ident, var_name))
+            nb++;
+        nb += count_assignments(FIRSTCHILD(root), var_name);
+    }
+    return nb;
+}
+
+static int count_uses(Node *root, char *var_name){
+    int nb = 0;
+    for(; root; root = root->nextSibling){
+        if(root->label == Variable && FIRSTCHILD(root)->label == Ident && !strcmp(FIRSTCHILD(root)->ident, var_name))
+            nb++;
+        nb += count_uses(FIRSTCHILD(root), var_name);
+    }
+    return nb;
+}
+
+/**
+ * @brief Gives the increment of a statement like v = v + c, v = c + v or v = v - c.
+ * @return The increment, or 0 if the statement isn't an increment of var_name.
+ */
+int increment_step(Node *stmt, char *var_name){
+    Node *expr;
+    if(stmt->label != Equals || FIRSTCHILD(FIRSTCHILD(stmt))->label != Ident
+        || strcmp(FIRSTCHILD(FIRSTCHILD(stmt))->ident, var_name))
+        return 0;
+    expr = unwrap(SECONDCHILD(stmt));
+    if(expr->label != Addsub || !SECONDCHILD(expr))
+        return 0;
+    if(scalar_name(FIRSTCHILD(expr)) && !strcmp(scalar_name(FIRSTCHILD(expr)), var_name)
+        && unwrap(SECONDCHILD(expr))->label == Num)
+        return expr->ident[0] == '-' ? -unwrap(SECONDCHILD(expr))->num : unwrap(SECONDCHILD(expr))->num;
+    if(expr->ident[0] == '+' && unwrap(FIRSTCHILD(expr))->label == Num
+        && scalar_name(SECONDCHILD(expr)) && !strcmp(scalar_name(SECONDCHILD(expr)), var_name))
+        return unwrap(FIRSTCHILD(expr))->num;
+    return 0;
+}
+
+/**
+ * @brief Finds the induction variables of a loop.
+ *
+ * An induction variable is a local scalar assigned only once in the loop, by an increment
+ * of a constant that is a statement of the body itself, so that it can't be skipped by an if.
+ */
+static void find_counters(IvLoop *iv, SymTabsFct *function, SymTabs *global_vars){
+    Node *body = SECONDCHILD(iv->loop);
+    Node *stmt = body->label == Instructions ? FIRSTCHILD(body) : body;
+    for(; stmt && iv->nb_counters < IVSR_MAX_POINTERS; stmt = body->label == Instructions ? stmt->nextSibling : NULL){
+        char *var_name;
+        int step;
+        if(stmt->label != Equals || FIRSTCHILD(FIRSTCHILD(stmt))->label != Ident)
+            continue;
+        var_name = FIRSTCHILD(FIRSTCHILD(stmt))->ident;
+        if(is_local_scalar(function, global_vars, var_name) && (step = increment_step(stmt, var_name))
+            && count_assignments(FIRSTCHILD(iv->loop), var_name) == 1){
+            iv->counters[iv->nb_counters] = var_name;
+            iv->steps[iv->nb_counters++] = step;
+        }
+    }
+}
+
+/**
+ * @brief Gives the variable of an index like v, v + c, c + v or v - c.
+ * @param displacement Set to the constant added to the variable.
+ * @return The name of the variable, or NULL for another index.
+ */
+char *indexed_variable(Node *index, int *displacement){
+    index = unwrap(index);
+    *displacement = 0;
+    if(index->label != Addsub || !SECONDCHILD(index))
+        return scalar_name(index);
+    if(unwrap(SECONDCHILD(index))->label == Num && scalar_name(FIRSTCHILD(index))){
+        *displacement = index->ident[0] == '-' ? -unwrap(SECONDCHILD(index))->num : unwrap(SECONDCHILD(index))->num;
+        return scalar_name(FIRSTCHILD(index));
+    }
+    if(index->ident[0] == '+' && unwrap(FIRSTCHILD(index))->label == Num && scalar_name(SECONDCHILD(index))){
+        *displacement = unwrap(FIRSTCHILD(index))->num;
+        return scalar_name(SECONDCHILD(index));
+    }
+    return NULL;
+}
+
+static int counter_index(IvLoop *iv, char *var_name){
+    for(int i = 0; var_name && i < iv->nb_counters; ++i)
+        if(!strcmp(iv->counters[i], var_name))
+            return i;
+    return -1;
+}
+
+static IvPointer *find_pointer(IvLoop *iv, char *array, char *counter){
+    for(int i = 0; i < iv->nb_pointers; ++i)
+        if(!strcmp(iv->pointers[i].array, array) && !strcmp(iv->pointers[i].counter, counter))
+            return &iv->pointers[i];
+    return NULL;
+}
+
+static void init_pointer(IvPointer *pointer, char *array, char *counter, SymTabsFct *function, SymTabs *global_vars){
+    Element *var = find_element(global_vars->first, array);
+    pointer->array = array;
+    pointer->counter = counter;
+    pointer->kind = IV_GLOBAL;
+    if(!var){
+        var = find_element(function->parameters, array);
+        pointer->kind = IV_PARAM;
+    }
+    if(!var){
+        var = find_element(function->variables, array);
+        pointer->kind = IV_LOCAL;
+    }
+    pointer->is_int = var ? var->is_int : INT;
+    pointer->stride = element_size(pointer->is_int);
+}
+
+/**
+ * @brief Creates the pointers of the array accesses indexed by an induction variable.
+ * @param reduced Number of accesses using a pointer, for each induction variable.
+ */
+static void find_pointers(IvLoop *iv, Node *root, SymTabsFct *function, SymTabs *global_vars, int *reduced, int *nb_slots){
+    for(; root; root = root->nextSibling){
+        if(root->label == Variable && FIRSTCHILD(root)->label == Array){
+            Node *array = FIRSTCHILD(root);
+            int displacement, counter = counter_index(iv, indexed_variable(FIRSTCHILD(FIRSTCHILD(array)), &displacement));
+            if(counter >= 0){
+                IvPointer *pointer = find_pointer(iv, FIRSTCHILD(array)->ident, iv->counters[counter]);
+                if(!pointer && iv->nb_pointers < IVSR_MAX_POINTERS){
+                    pointer = &iv->pointers[iv->nb_pointers++];
+                    init_pointer(pointer, FIRSTCHILD(array)->ident, iv->counters[counter], function, global_vars);
+                    pointer->slot = (*nb_slots)++;
+                }
+                if(pointer)
+                    reduced[counter]++;
+            }
+        }
+        find_pointers(iv, FIRSTCHILD(root), function, global_vars, reduced, nb_slots);
+    }
+}
+
+/**
+ * @brief Tells if a variable isn't read after a loop of the top level of the function before being assigned.
+ */
+static int is_dead_after(Node *corps, Node *loop, char *var_name){
+    Node *instructions = NULL, *stmt;
+    for(Node *current = FIRSTCHILD(corps); current; current = current->nextSibling)
+        if(current->label == Instructions)
+            instructions = current;
+    if(!instructions)
+        return 0;
+    for(stmt = FIRSTCHILD(instructions); stmt && stmt != loop; stmt = stmt->nextSibling)
+        ;
+    if(!stmt)
+        return 0;
+    for(stmt = stmt->nextSibling; stmt; stmt = stmt->nextSibling){
+        if(stmt->label == Equals && FIRSTCHILD(FIRSTCHILD(stmt))->label == Ident
+            && !strcmp(FIRSTCHILD(FIRSTCHILD(stmt))->ident, var_name) && !count_uses(SECONDCHILD(stmt), var_name))
+            return 1;
+        if(count_uses(FIRSTCHILD(stmt), var_name))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Replaces the induction variable of the exit test by a pointer when it's only used for addressing.
+ *
+ * The test must compare the variable to an invariant bound in the direction of its increment,
+ * and the variable must be dead after the loop.
+ */
+static void eliminate_counter(IvLoop *iv, Node *corps, SymTabsFct *function, SymTabs *global_vars, int *reduced, int *nb_slots){
+    Node *cond = unwrap(FIRSTCHILD(iv->loop)), *bound;
+    char *bound_name;
+    int counter, step;
+    if((cond->label != Order && (cond->label != Eq || strcmp(cond->ident, "!="))) || !SECONDCHILD(cond))
+        return;
+    if((counter = counter_index(iv, scalar_name(FIRSTCHILD(cond)))) < 0 || !reduced[counter])
+        return;
+    step = iv->steps[counter];
+    if((cond->ident[0] == '<' && step < 0) || (cond->ident[0] == '>' && step > 0))
+        return;
+    bound = unwrap(SECONDCHILD(cond));
+    bound_name = scalar_name(bound);
+    if(bound->label != Num && bound->label != Character
+        && (!bound_name || !is_local_scalar(function, global_vars, bound_name) || count_assignments(FIRSTCHILD(iv->loop), bound_name)))
+        return;
+    if(count_uses(FIRSTCHILD(iv->loop), iv->counters[counter]) != reduced[counter] + 3
+        || !is_dead_after(corps, iv->loop, iv->counters[counter]))
+        return;
+    iv->eliminated = iv->counters[counter];
+    for(int i = 0; !iv->test_pointer; ++i)
+        if(!strcmp(iv->pointers[i].counter, iv->eliminated))
+            iv->test_pointer = &iv->pointers[i];
+    iv->bound = SECONDCHILD(cond);
+    if(!strcmp(cond->ident, "!="))
+        iv->condition = "ne";
+    else
+        iv->condition = cond->ident[0] == '<' ? (cond->ident[1] ? "le" : "l") : (cond->ident[1] ? "ge" : "g");
+    iv->bound_slot = (*nb_slots)++;
+}
+
+static IvLoop *analyze_loop(Node *loop, Node *corps, SymTabsFct *function, SymTabs *global_vars, int *nb_slots){
+    IvLoop *iv = (IvLoop*) try(calloc(1, sizeof(IvLoop)), NULL);
+    int reduced[IVSR_MAX_POINTERS] = {0};
+    iv->loop = loop;
+    find_counters(iv, function, global_vars);
+    if(iv->nb_counters){
+        find_pointers(iv, FIRSTCHILD(loop), function, global_vars, reduced, nb_slots);
+        eliminate_counter(iv, corps, function, global_vars, reduced, nb_slots);
+    }
+    if(!iv->nb_pointers){
+        free(iv);
+        return NULL;
+    }
+    return iv;
+}
+
+static void find_loops(Node *root, Node *corps, SymTabsFct *function, SymTabs *global_vars, int *nb_slots, IvLoop ***last){
+    for(; root; root = root->nextSibling){
+        if(root->label == While){
+            IvLoop *iv = analyze_loop(root, corps, function, global_vars, nb_slots);
+            if(iv){
+                **last = iv;
+                *last = &iv->next;
+            }
+        }
+        find_loops(FIRSTCHILD(root), corps, function, global_vars, nb_slots, last);
+    }
+}
+
+/**
+ * @brief Finds the array accesses of the loops of a function that can use a pointer.
+ *
+ * An access whose index is an induction variable of a loop, possibly plus a constant, uses a
+ * pointer set before the loop and increased with the induction variable. Each pointer needs a hidden
+ * slot in the frame of the function, and so does the bound of an eliminated counter.
+ * @param corps The body of the function.
+ * @param function The table of the function.
+ * @param global_vars The table of the global variables.
+ * @param nb_slots Set to the number of hidden slots needed.
+ * @return The loops with at least one pointer.
+ */
+IvLoop *find_iv_loops(Node *corps, SymTabsFct *function, SymTabs *global_vars, int *nb_slots){
+    IvLoop *loops = NULL, **last = &loops;
+    *nb_slots = 0;
+    find_loops(FIRSTCHILD(corps), corps, function, global_vars, nb_slots, &last);
+    return loops;
+}
+
+IvLoop *get_iv_loop(IvLoop *loops, Node *loop){
+    for(; loops; loops = loops->next)
+        if(loops->loop == loop)
+            return loops;
+    return NULL;
+}
+
+/**
+ * @brief Gets the pointer of an array access in the loops being written.
+ * @param access The Array node of the access.
+ * @param displacement Set to the index of the element relative to the pointer.
+ * @return The pointer, or NULL if the access must compute its address.
+ */
+IvPointer *get_iv_pointer(IvLoop *loops, Node *access, int *displacement){
+    char *counter = indexed_variable(FIRSTCHILD(FIRSTCHILD(access)), displacement);
+    if(!counter)
+        return NULL;
+    for(; loops; loops = loops->next)
+        if(loops->active){
+            IvPointer *pointer = find_pointer(loops, FIRSTCHILD(access)->ident, counter);
+            if(pointer)
+                return pointer;
+        }
+    return NULL;
+}
+
+int get_iv_step(IvLoop *loop, char *counter){
+    int index = counter_index(loop, counter);
+    return index < 0 ? 0 : loop->steps[index];
+}
+
+void free_iv_loops(IvLoop *loops){
+    while(loops){
+        IvLoop *next = loops->next;
+        free(loops);
+        loops = next;
+    }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file ivsr.h
+ * @brief Strength reduction of the array accesses indexed by an induction variable.
+ */
+
+#ifndef __IVSR__H
+#define __IVSR__H
+
+#include "compile.h"
+
+#define IVSR_MAX_POINTERS 8 ///< Maximum number of pointers of a loop.
+
+#define IV_LOCAL 0  ///< Array declared in the function.
+#define IV_PARAM 1  ///< Array received as a parameter.
+#define IV_GLOBAL 2 ///< Global array.
+
+/**
+ * @brief Pointer following the element of an array indexed by an induction variable.
+ */
+typedef struct{
+    char *array;   ///< Name of the array.
+    char *counter; ///< Name of the induction variable.
+    int kind;      ///< IV_LOCAL, IV_PARAM or IV_GLOBAL.
+    int stride;    ///< Size of an element of the array in memory.
+    int is_int;    ///< Flag indicating if the elements are integers.
+    int slot;      ///< Index of the hidden slot holding the address.
+}IvPointer;
+
+/**
+ * @brief Strength reduction of a while loop.
+ */
+typedef struct iv_loop{
+    Node *loop;                              ///< The While node.
+    IvPointer pointers[IVSR_MAX_POINTERS];   ///< Pointers of the loop.
+    int nb_pointers;                         ///< Number of pointers.
+    char *counters[IVSR_MAX_POINTERS];       ///< Induction variables of the pointers.
+    int steps[IVSR_MAX_POINTERS];            ///< Increments of the induction variables.
+    int nb_counters;                         ///< Number of induction variables.
+    char *eliminated;                        ///< Counter replaced by a pointer in the exit test, or NULL.
+    IvPointer *test_pointer;                 ///< Pointer compared in the exit test.
+    Node *bound;                             ///< Bound of the exit test of the eliminated counter.
+    char *condition;                         ///< Jump taken while the exit test holds, without its 'j'.
+    int bound_slot;                          ///< Index of the hidden slot holding the address of the bound.
+    int active;                              ///< Flag telling if the loop is being written.
+    struct iv_loop *next;                    ///< Next loop of the function.
+}IvLoop;
+
+IvLoop *find_iv_loops(Node *corps, SymTabsFct *function, SymTabs *global_vars, int *nb_slots); ///< Function to find the array accesses of the loops of a function that can use a pointer.
+
+IvLoop *get_iv_loop(IvLoop *loops, Node *loop); ///< Function to get the strength reduction of a loop.
+
+IvPointer *get_iv_pointer(IvLoop *loops, Node *access, int *displacement); ///< Function to get the pointer of an array access in the active loops.
+
+int increment_step(Node *stmt, char *var_name); ///< Function to get the increment of a statement like v = v + c, 0 if it's not one.
+
+char *indexed_variable(Node *index, int *displacement); ///< Function to get the variable of an index like v + c, NULL for another index.
+
+int get_iv_step(IvLoop *loop, char *counter); ///< Function to get the increment of an induction variable, 0 if it's not one.
+
+void free_iv_loops(IvLoop *loops); ///< Function to free the strength reductions of a function.
+
+#endif
@@ -0,0 +1,362 @@
+#include "compile.h"
+
+#define TERM_NONE 0
+#define TERM_JMP 1
+#define TERM_JCC 2
+#define TERM_RET 3
+
+/**
+ * @brief A basic block of the generated code.
+ */
+typedef struct{
+    char *label;   ///< Label starting the block, or NULL.
+    char **lines;  ///< Lines of the block, label excluded.
+    int nb_lines;  ///< Number of lines of the block.
+    char *extra;   ///< Jump added after the lines by the new order, or NULL.
+    int term;      ///< Kind of the last instruction of the block.
+    char *target;  ///< Target of the last instruction when it's a jump.
+    int reachable; ///< Flag telling if the block can be executed.
+    int placed;    ///< Position of the block in the new order, or -1.
+    int falls_in;  ///< Flag telling if the previous block falls through into this one.
+}Block;
+
+typedef struct{
+    Block *blocks;
+    int nb_blocks;
+    int *by_number; ///< Blocks of the compiler's labels, indexed by their number.
+    int max_number;
+}Cfg;
+
+static const char *conditions[][2] = {
+    {"e", "ne"}, {"ne", "e"}, {"z", "nz"}, {"nz", "z"},
+    {"l", "ge"}, {"ge", "l"}, {"g", "le"}, {"le", "g"},
+    {"b", "ae"}, {"ae", "b"}, {"a", "be"}, {"be", "a"}
+};
+
+static char *skip_spaces(char *line){
+    while(*line == ' ' || *line == '\t')
+        line++;
+    return line;
+}
+
+static int is_label_line(char *line){
+    int len = strlen(line);
+    return len > 1 && line[len - 1] == ':' && !strchr(line, ' ') && *line != ';';
+}
+
+static int is_compiler_label(char *label){
+    return !strncmp(label, LAYOUT_LABEL_PREFIX, strlen(LAYOUT_LABEL_PREFIX));
+}
+
+/**
+ * @brief Gives the kind of a line ending a block.
+ * @param target Set to the target of the jump, if any.
+ * @return TERM_NONE if the line doesn't end a block.
+ */
+static int terminator(char *line, char **target){
+    char *s = skip_spaces(line);
+    *target = NULL;
+    if(!strncmp(s, "ret", 3) && (!s[3] || s[3] == ' '))
+        return TERM_RET;
+    if(s[0] != 'j' || !strchr(s, ' '))
+        return TERM_NONE;
+    *target = skip_spaces(strchr(s, ' '));
+    return strncmp(s, "jmp ", 4) ? TERM_JCC : TERM_JMP;
+}
+
+static int label_number(char *label){
+    return atoi(label + strlen(LAYOUT_LABEL_PREFIX));
+}
+
+static int find_block(Cfg *cfg, char *label){
+    int len = strlen(label);
+    if(is_compiler_label(label)){
+        int number = label_number(label);
+        return number <= cfg->max_number ? cfg->by_number[number] : -1;
+    }
+    for(int i = 0; i < cfg->nb_blocks; ++i)
+        if(cfg->blocks[i].label && !strncmp(cfg->blocks[i].label, label, len) && cfg->blocks[i].label[len] == ':')
+            return i;
+    return -1;
+}
+
+static Block *new_block(Cfg *cfg, char *label, char **lines){
+    Block *block = &cfg->blocks[cfg->nb_blocks++];
+    block->label = label;
+    block->lines = lines;
+    block->nb_lines = 0;
+    block->extra = NULL;
+    block->term = TERM_NONE;
+    block->target = NULL;
+    block->reachable = 0;
+    block->placed = -1;
+    block->falls_in = 0;
+    return block;
+}
+
+/**
+ * @brief Splits some code into basic blocks.
+ *
+ * A block starts at a label or after a jump, and ends with a jump or a ret.
+ */
+static void build_cfg(Cfg *cfg, char **lines, int nb_lines){
+    Block *current = NULL;
+    cfg->blocks = (Block*) try(malloc(sizeof(Block) * (nb_lines + 1)), NULL);
+    cfg->nb_blocks = 0;
+    cfg->max_number = -1;
+    for(int i = 0; i < nb_lines; ++i){
+        if(is_label_line(lines[i])){
+            current = new_block(cfg, lines[i], &lines[i + 1]);
+            if(is_compiler_label(lines[i]) && label_number(lines[i]) > cfg->max_number)
+                cfg->max_number = label_number(lines[i]);
+            continue;
+        }
+        if(!current)
+            current = new_block(cfg, NULL, &lines[i]);
+        current->nb_lines++;
+        if((current->term = terminator(lines[i], &current->target)) != TERM_NONE)
+            current = NULL;
+    }
+    cfg->by_number = (int*) try(malloc(sizeof(int) * (cfg->max_number + 1)), NULL);
+    for(int i = 0; i <= cfg->max_number; ++i)
+        cfg->by_number[i] = -1;
+    for(int i = 0; i < cfg->nb_blocks; ++i)
+        if(cfg->blocks[i].label && is_compiler_label(cfg->blocks[i].label))
+            cfg->by_number[label_number(cfg->blocks[i].label)] = i;
+}
+
+static int falls_through(Block *block){
+    return block->term != TERM_JMP && block->term != TERM_RET;
+}
+
+static int jump_target(Cfg *cfg, Block *block){
+    return block->target ? find_block(cfg, block->target) : -1;
+}
+
+/**
+ * @brief Marks the blocks reachable from the entry of the functions.
+ */
+static void mark_reachable(Cfg *cfg){
+    int *stack = (int*) try(malloc(sizeof(int) * (cfg->nb_blocks + 1)), NULL), top = 0;
+    for(int i = 0; i < cfg->nb_blocks; ++i)
+        if(i == 0 || (cfg->blocks[i].label && !is_compiler_label(cfg->blocks[i].label))){
+            cfg->blocks[i].reachable = 1;
+            stack[top++] = i;
+        }
+    while(top){
+        int i = stack[--top], succ[2] = {-1, -1};
+        if(falls_through(&cfg->blocks[i]) && i + 1 < cfg->nb_blocks)
+            succ[0] = i + 1;
+        succ[1] = jump_target(cfg, &cfg->blocks[i]);
+        for(int j = 0; j < 2; ++j)
+            if(succ[j] >= 0 && !cfg->blocks[succ[j]].reachable){
+                cfg->blocks[succ[j]].reachable = 1;
+                stack[top++] = succ[j];
+            }
+    }
+    free(stack);
+}
+
+/**
+ * @brief Gives the block following a block when it falls through, ignoring the unreachable ones.
+ */
+static int next_reachable(Cfg *cfg, int i){
+    for(++i; i < cfg->nb_blocks; ++i)
+        if(cfg->blocks[i].reachable)
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Orders the reachable blocks in chains.
+ *
+ * A block ending with a jmp is followed by its target when nothing else falls through into it,
+ * and a block falling through is always followed by its successor when it's not placed yet.
+ * @return The order of the blocks.
+ */
+static int *order_blocks(Cfg *cfg, int *nb_placed){
+    int *order = (int*) try(malloc(sizeof(int) * (cfg->nb_blocks + 1)), NULL);
+    *nb_placed = 0;
+    for(int i = 0; i < cfg->nb_blocks; ++i)
+        if(cfg->blocks[i].reachable && falls_through(&cfg->blocks[i])){
+            int next = next_reachable(cfg, i);
+            if(next >= 0)
+                cfg->blocks[next].falls_in = 1;
+        }
+    for(int i = 0; i < cfg->nb_blocks; ++i){
+        int current = i;
+        if(!cfg->blocks[i].reachable || cfg->blocks[i].placed >= 0)
+            continue;
+        while(current >= 0){
+            Block *block = &cfg->blocks[current];
+            int next = -1;
+            block->placed = *nb_placed;
+            order[(*nb_placed)++] = current;
+            if(falls_through(block))
+                next = next_reachable(cfg, current);
+            else if(block->term == TERM_JMP){
+                next = jump_target(cfg, block);
+                if(next >= 0 && (cfg->blocks[next].falls_in || !is_compiler_label(cfg->blocks[next].label)))
+                    next = -1;
+            }
+            current = next >= 0 && cfg->blocks[next].placed < 0 ? next : -1;
+        }
+    }
+    return order;
+}
+
+static char *format_jump(const char *mnemonic, char *target, int target_len){
+    char *line = (char*) try(malloc(sizeof(char) * (strlen(mnemonic) + target_len + 2)), NULL);
+    sprintf(line, "%s %.*s", mnemonic, target_len, target);
+    return line;
+}
+
+/**
+ * @brief Gives the jump with the opposite condition of a conditional jump, or NULL.
+ */
+static char *invert_jcc(char *line, char *target){
+    char *s = skip_spaces(line);
+    int len = strchr(s, ' ') - s - 1;
+    for(int i = 0; i < (int)(sizeof(conditions) / sizeof(conditions[0])); ++i)
+        if((int)strlen(conditions[i][0]) == len && !strncmp(s + 1, conditions[i][0], len)){
+            char mnemonic[8];
+            sprintf(mnemonic, "j%s", conditions[i][1]);
+            return format_jump(mnemonic, target, strlen(target));
+        }
+    return NULL;
+}
+
+/**
+ * @brief Tells if a line is a jump to a label placed before any other instruction after the block.
+ */
+static int jumps_to_next(Cfg *cfg, int *order, int nb_placed, int position, char *target){
+    for(int i = position + 1; i < nb_placed; ++i){
+        Block *block = &cfg->blocks[order[i]];
+        int len = strlen(target);
+        if(block->label && !strncmp(block->label, target, len) && block->label[len] == ':')
+            return 1;
+        if(block->nb_lines)
+            return 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds the jumps needed by the new order, and removes the useless ones.
+ *
+ * A conditional jump over an unconditional one is inverted.
+ */
+static void fix_jumps(Cfg *cfg, int *order, int nb_placed){
+    for(int i = 0; i < nb_placed; ++i){
+        Block *block = &cfg->blocks[order[i]];
+        int next = next_reachable(cfg, order[i]);
+        if(falls_through(block) && next >= 0 && (i + 1 >= nb_placed || order[i + 1] != next) && cfg->blocks[next].label){
+            block->extra = format_jump("jmp", cfg->blocks[next].label, strlen(cfg->blocks[next].label) - 1);
+            block->term = TERM_JMP;
+            block->target = block->extra + 4;
+        }
+    }
+    for(int i = 0; i < nb_placed; ++i){
+        Block *block = &cfg->blocks[order[i]];
+        if(block->term == TERM_JCC && i + 1 < nb_placed){
+            Block *next = &cfg->blocks[order[i + 1]];
+            if(!next->label && next->nb_lines == 1 && next->term == TERM_JMP
+                && jumps_to_next(cfg, order, nb_placed, i + 1, block->target)){
+                char *inverted = invert_jcc(block->lines[block->nb_lines - 1], next->target);
+                if(inverted){
+                    block->extra = inverted;
+                    block->nb_lines--;
+                    block->target = next->target;
+                    next->nb_lines = 0;
+                    next->term = TERM_NONE;
+                    next->target = NULL;
+                }
+            }
+        }
+        if(block->target && jumps_to_next(cfg, order, nb_placed, i, block->target)){
+            if(block->extra){
+                free(block->extra);
+                block->extra = NULL;
+            }
+            else
+                block->nb_lines--;
+            block->term = TERM_NONE;
+            block->target = NULL;
+        }
+    }
+}
+
+static void mark_referenced(Cfg *cfg, char *line, char *referenced){
+    char *s = line;
+    while((s = strstr(s, LAYOUT_LABEL_PREFIX))){
+        int number = label_number(s);
+        if(number <= cfg->max_number)
+            referenced[number] = 1;
+        s += strlen(LAYOUT_LABEL_PREFIX);
+    }
+}
+
+/**
+ * @brief Writes the blocks in their new order.
+ *
+ * The unreferenced labels of the compiler are dropped, and the heads of the loops are aligned.
+ */
+static void write_blocks(Cfg *cfg, int *order, int nb_placed, FILE *file){
+    char *referenced = (char*) try(calloc(cfg->max_number + 2, sizeof(char)), NULL);
+    char *loop_head = (char*) try(calloc(cfg->nb_blocks + 1, sizeof(char)), NULL);
+    for(int i = 0; i < nb_placed; ++i){
+        Block *block = &cfg->blocks[order[i]];
+        int target;
+        for(int j = 0; j < block->nb_lines; ++j)
+            mark_referenced(cfg, block->lines[j], referenced);
+        if(block->extra)
+            mark_referenced(cfg, block->extra, referenced);
+        if(block->target && (target = find_block(cfg, block->target)) >= 0 && cfg->blocks[target].placed <= i)
+            loop_head[target] = 1;
+    }
+    for(int i = 0; i < nb_placed; ++i){
+        Block *block = &cfg->blocks[order[i]];
+        if(block->label && (!is_compiler_label(block->label) || referenced[label_number(block->label)])){
+            if(loop_head[order[i]])
+                fprintf(file, "align %d\n", LAYOUT_LOOP_ALIGN);
+            fprintf(file, "%s\n", block->label);
+        }
+        for(int j = 0; j < block->nb_lines; ++j)
+            fprintf(file, "%s\n", block->lines[j]);
+        if(block->extra)
+            fprintf(file, "%s\n", block->extra);
+    }
+    free(referenced);
+    free(loop_head);
+}
+
+/**
+ * @brief Reorders the basic blocks of some generated code and writes it.
+ *
+ * Unreachable blocks are removed, the target of a jmp is placed right after it when possible,
+ * jumps to the next instruction are removed and the heads of the loops are aligned.
+ * @param code The code, one instruction or label per line. It's modified by the function.
+ * @param file The file to write the code into.
+ */
+void layout_code(char *code, FILE *file){
+    int nb_lines = 0, max_lines = 1, nb_placed;
+    char **lines, *line;
+    Cfg cfg;
+    int *order;
+    for(char *s = code; *s; ++s)
+        max_lines += *s == '\n';
+    lines = (char**) try(malloc(sizeof(char*) * max_lines), NULL);
+    for(line = strtok(code, "\n"); line; line = strtok(NULL, "\n"))
+        lines[nb_lines++] = line;
+    build_cfg(&cfg, lines, nb_lines);
+    mark_reachable(&cfg);
+    order = order_blocks(&cfg, &nb_placed);
+    fix_jumps(&cfg, order, nb_placed);
+    write_blocks(&cfg, order, nb_placed, file);
+    for(int i = 0; i < cfg.nb_blocks; ++i)
+        free(cfg.blocks[i].extra);
+    free(cfg.blocks);
+    free(cfg.by_number);
+    free(order);
+    free(lines);
+}
@@ -0,0 +1,16 @@
+/**
+ * @file layout.h
+ * @brief Basic block layout of the generated code.
+ */
+
+#ifndef __LAYOUT__H
+#define __LAYOUT__H
+
+#include <stdio.h>
+
+#define LAYOUT_LABEL_PREFIX "_l_label" ///< Prefix of the labels created by the compiler.
+#define LAYOUT_LOOP_ALIGN 16           ///< Alignment of the heads of the loops.
+
+void layout_code(char *code, FILE *file); ///< Function to reorder the basic blocks of some code and write it.
+
+#endif
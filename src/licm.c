@@ -0,0 +1,282 @@
+#include "licm.h"
+
+/**
+ * @brief State of the hoisting in a function.
+ */
+typedef struct{
+    SymTabs *global_vars;
+    SymTabsFct **functions;
+    int nb_functions;
+    char *writes_globals;  ///< Flags telling which functions may assign a global variable.
+    SymTabsFct *function;  ///< Table of the current function.
+    Node *corps;           ///< Body of the current function.
+    Node *hoisted;         ///< Assignments of the temporaries of the current loop.
+    Node *last_hoisted;    ///< Last assignment of the current loop.
+    char **temps;          ///< Temporaries created so far, not in the tables yet.
+    int nb_temps;          ///< Number of temporaries.
+}LicmCtx;
+
+static int function_index(LicmCtx *ctx, char *function_name){
+    for(int i = 0; i < ctx->nb_functions; ++i)
+        if(!strcmp(ctx->functions[i]->ident, function_name))
+            return i;
+    return -1;
+}
+
+static int is_local(LicmCtx *ctx, SymTabsFct *function, char *var_name){
+    for(int i = 0; i < ctx->nb_temps; ++i)
+        if(!strcmp(ctx->temps[i], var_name))
+            return 1;
+    return check_in_table_fct(function->parameters, var_name) || check_in_table_fct(function->variables, var_name);
+}
+
+static char *assigned_name(Node *affect){
+    Node *target = FIRSTCHILD(FIRSTCHILD(affect));
+    return target->label == Array ? FIRSTCHILD(target)->ident : target->ident;
+}
+
+/**
+ * @brief Tells if a tree assigns a global variable or calls a function flagged in writes_globals.
+ */
+static int assigns_globals(LicmCtx *ctx, SymTabsFct *function, Node *root){
+    int index;
+    if(!root)
+        return 0;
+    if(root->label == Equals && !is_local(ctx, function, assigned_name(root)))
+        return 1;
+    if(is_function_call(root) && (index = function_index(ctx, FIRSTCHILD(root)->ident)) >= 0 && ctx->writes_globals[index])
+        return 1;
+    return assigns_globals(ctx, function, FIRSTCHILD(root)) || assigns_globals(ctx, function, root->nextSibling);
+}
+
+static void compute_writes_globals(LicmCtx *ctx){
+    int changed = 1;
+    ctx->writes_globals = (char*) try(calloc(ctx->nb_functions + 1, sizeof(char)), NULL);
+    while(changed){
+        changed = 0;
+        for(int i = 0; i < ctx->nb_functions; ++i){
+            Node *decl = find_function_decl(ctx->functions[i]->ident);
+            if(!ctx->writes_globals[i] && decl && assigns_globals(ctx, ctx->functions[i], FOURTHCHILD(decl)))
+                changed = ctx->writes_globals[i] = 1;
+        }
+    }
+}
+
+static int assigns_var(Node *root, char *var_name){
+    if(!root)
+        return 0;
+    if(root->label == Equals && !strcmp(assigned_name(root), var_name))
+        return 1;
+    return assigns_var(FIRSTCHILD(root), var_name) || assigns_var(root->nextSibling, var_name);
+}
+
+static int is_operator(Node *root){
+    switch(root->label){
+        case Addsub: case Divstar: case Eq: case Order: case And: case Or: case Not:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int is_global_scalar(LicmCtx *ctx, Node *root){
+    return root->label == Variable && FIRSTCHILD(root)->label == Ident && !is_local(ctx, ctx->function, FIRSTCHILD(root)->ident);
+}
+
+static Node *unwrap(Node *root){
+    return root->label == Expression ? FIRSTCHILD(root) : root;
+}
+
+/**
+ * @brief Tells if an expression gives the same value at each iteration of a loop.
+ *
+ * Array elements and calls are never invariant, and a division is only invariant when its
+ * divisor is a non zero constant, so that computing it before the loop can't fail.
+ */
+static int is_invariant(LicmCtx *ctx, Node *loop, Node *root){
+    if(root->label == Expression)
+        return is_invariant(ctx, loop, FIRSTCHILD(root));
+    if(root->label == Num || root->label == Character)
+        return 1;
+    if(root->label == Variable){
+        if(FIRSTCHILD(root)->label != Ident || assigns_var(FIRSTCHILD(loop), FIRSTCHILD(root)->ident))
+            return 0;
+        return !is_global_scalar(ctx, root) || !assigns_globals(ctx, ctx->function, FIRSTCHILD(loop));
+    }
+    if(!is_operator(root))
+        return 0;
+    if(root->label == Divstar && strcmp(root->ident, "*")
+        && (unwrap(SECONDCHILD(root))->label != Num || !unwrap(SECONDCHILD(root))->num))
+        return 0;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(!is_invariant(ctx, loop, child))
+            return 0;
+    return 1;
+}
+
+static int same_tree(Node *a, Node *b){
+    if(!a || !b)
+        return a == b;
+    if(a->label != b->label || a->num != b->num || (!a->ident) != (!b->ident) || (a->ident && strcmp(a->ident, b->ident)))
+        return 0;
+    return same_tree(FIRSTCHILD(a), FIRSTCHILD(b)) && same_tree(a->nextSibling, b->nextSibling);
+}
+
+static char *temp_name(LicmCtx *ctx){
+    static int counter = 0;
+    char *name = (char*) try(malloc(sizeof(char) * (strlen(LICM_TEMP_PREFIX) + 12)), NULL);
+    do
+        sprintf(name, LICM_TEMP_PREFIX "%d", ++counter);
+    while(is_local(ctx, ctx->function, name) || check_in_table(*ctx->global_vars, name) || find_function_decl(name));
+    ctx->temps = (char**) try(realloc(ctx->temps, sizeof(char*) * (ctx->nb_temps + 1)), NULL);
+    ctx->temps[ctx->nb_temps++] = name;
+    return name;
+}
+
+static void declare_temp(LicmCtx *ctx, char *name, int type){
+    Node *decl = makeNode(Type), *ident = makeNode(Ident);
+    decl->ident = strdup(type == CHAR ? "char" : "int");
+    ident->ident = strdup(name);
+    addChild(decl, ident);
+    decl->nextSibling = ctx->corps->firstChild;
+    ctx->corps->firstChild = decl;
+}
+
+/**
+ * @brief Gives the temporary holding an expression, creating its assignment if needed.
+ */
+static char *hoist(LicmCtx *ctx, Node *root){
+    Node *affect, *var, *ident, *expr;
+    for(affect = ctx->hoisted; affect; affect = affect->nextSibling)
+        if(same_tree(FIRSTCHILD(SECONDCHILD(affect)), root) || same_tree(SECONDCHILD(affect), root))
+            return FIRSTCHILD(FIRSTCHILD(affect))->ident;
+    affect = makeNode(Equals);
+    var = makeNode(Variable);
+    ident = makeNode(Ident);
+    expr = makeNode(Expression);
+    ident->ident = temp_name(ctx);
+    declare_temp(ctx, ident->ident, expression_type(root, ctx->global_vars, ctx->functions, ctx->nb_functions, ctx->function->ident));
+    affect->ident = "=";
+    addChild(var, ident);
+    addChild(expr, copyTree(root));
+    addChild(affect, var);
+    addChild(affect, expr);
+    if(ctx->last_hoisted)
+        ctx->last_hoisted->nextSibling = affect;
+    else
+        ctx->hoisted = affect;
+    ctx->last_hoisted = affect;
+    return ident->ident;
+}
+
+/**
+ * @brief Replaces the maximal invariant expressions of a loop by temporaries.
+ *
+ * Only operators and reads of global variables are worth a temporary.
+ */
+static void hoist_expressions(LicmCtx *ctx, Node *loop, Node *root){
+    for(; root; root = root->nextSibling){
+        if(root->label == Equals){
+            if(FIRSTCHILD(FIRSTCHILD(root))->label == Array)
+                hoist_expressions(ctx, loop, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
+            hoist_expressions(ctx, loop, SECONDCHILD(root));
+            continue;
+        }
+        if((is_operator(root) || is_global_scalar(ctx, root)) && is_invariant(ctx, loop, root)){
+            Node *ident = makeNode(Ident), *next = root->nextSibling;
+            ident->ident = strdup(hoist(ctx, root));
+            deleteTree(FIRSTCHILD(root));
+            root->firstChild = NULL;
+            root->label = Variable;
+            root->ident = NULL;
+            root->num = 0;
+            addChild(root, ident);
+            root->nextSibling = next;
+            continue;
+        }
+        if(is_function_call(root))
+            hoist_expressions(ctx, loop, FIRSTCHILD(FIRSTCHILD(root)));
+        else
+            hoist_expressions(ctx, loop, FIRSTCHILD(root));
+    }
+}
+
+static void hoist_stmt(LicmCtx *ctx, Node **link, int in_list);
+
+static void hoist_list(LicmCtx *ctx, Node **link, int in_list){
+    for(; *link; link = &(*link)->nextSibling){
+        Node *before = *link;
+        hoist_stmt(ctx, link, in_list);
+        while(*link != before && (*link)->nextSibling && in_list)
+            link = &(*link)->nextSibling;
+    }
+}
+
+/**
+ * @brief Hoists the invariant expressions of the loops of a statement, outer loops first.
+ * @param link Pointer to the statement in its parent.
+ * @param in_list Flag telling if the statement is in a list of instructions, where the
+ * assignments can be inserted. Otherwise the loop is wrapped in a new list.
+ */
+static void hoist_stmt(LicmCtx *ctx, Node **link, int in_list){
+    Node *root = *link;
+    switch(root->label){
+        case Instructions:
+            hoist_list(ctx, &root->firstChild, 1);
+            break;
+        case If:
+            hoist_stmt(ctx, &FIRSTCHILD(root)->nextSibling, 0);
+            if(THIRDCHILD(root))
+                hoist_stmt(ctx, &SECONDCHILD(root)->nextSibling, 0);
+            break;
+        case While:
+            ctx->hoisted = ctx->last_hoisted = NULL;
+            hoist_expressions(ctx, root, FIRSTCHILD(root));
+            if(ctx->hoisted){
+                if(in_list){
+                    ctx->last_hoisted->nextSibling = root;
+                    *link = ctx->hoisted;
+                }
+                else{
+                    Node *block = makeNode(Instructions);
+                    block->nextSibling = root->nextSibling;
+                    root->nextSibling = NULL;
+                    ctx->last_hoisted->nextSibling = root;
+                    block->firstChild = ctx->hoisted;
+                    *link = block;
+                }
+            }
+            hoist_stmt(ctx, &FIRSTCHILD(root)->nextSibling, 0);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Computes the loop invariant expressions of the while loops in temporaries before the loops.
+ *
+ * An expression is invariant when it only reads constants and scalar variables that aren't
+ * assigned in the loop. A global variable is also considered as assigned when the loop calls a
+ * function that may assign any global variable.
+ * @param report Flag telling if the number of hoisted expressions of each function is written on stderr.
+ * @return The tables of the functions, temporaries included.
+ */
+SymTabsFct** hoist_loop_invariants(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    LicmCtx ctx = {global_vars, functions, *nb_functions, NULL, NULL, NULL, NULL, NULL, NULL, 0};
+    compute_writes_globals(&ctx);
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        int index, nb_temps = ctx.nb_temps;
+        if(current->label != Function || (index = function_index(&ctx, SECONDCHILD(current)->ident)) < 0)
+            continue;
+        ctx.function = functions[index];
+        ctx.corps = FOURTHCHILD(current);
+        hoist_list(&ctx, &ctx.corps->firstChild, 1);
+        if(report && ctx.nb_temps > nb_temps)
+            fprintf(stderr, "%s: %d loop invariant expression%s hoisted\n", ctx.function->ident, ctx.nb_temps - nb_temps,
+                ctx.nb_temps - nb_temps > 1 ? "s" : "");
+    }
+    free(ctx.writes_globals);
+    free(ctx.temps);
+    return update_decl_functions(functions, nb_functions, global_vars);
+}
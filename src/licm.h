@@ -0,0 +1,15 @@
+/**
+ * @file licm.h
+ * @brief Hoisting of the loop invariant expressions out of the while loops.
+ */
+
+#ifndef __LICM__H
+#define __LICM__H
+
+#include "compile.h"
+
+#define LICM_TEMP_PREFIX "licm" ///< Prefix of the variables holding the hoisted expressions.
+
+SymTabsFct** hoist_loop_invariants(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report); ///< Function to compute the loop invariant expressions before their loops.
+
+#endif
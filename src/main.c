@@ -1,6 +1,10 @@
 #include "compile.h"
 #include "semantic.h"
+#include "passes.h"
 #include "parse.h"
+#include "executable.h"
+#include "vm.h"
+#include "csource.h"
 
 int has_suffix(const char *str, const char *suffix) {
     size_t len_str = strlen(str);
@@ -23,20 +27,107 @@ static char *get_filename(int argc, char **argv){
     return name;
 } 
 
-static void compile(int argc, char **argv){
+/**
+ * @brief Writes the routines of the runtime named after --runtime on the standard output.
+ * @return 1 if the option was given, 0 otherwise.
+ */
+static int write_runtime(int argc, char **argv){
+    int found = 0;
+    for(int i = 1; i < argc - 1; i++)
+        if(!strcmp(argv[i], "--runtime")){
+            found = 1;
+            if(!build_runtime(stdout, argv[++i])){
+                fprintf(stderr, "Unknown runtime routine: %s\n", argv[i]);
+                exit(EXIT_ERROR);
+            }
+        }
+    return found;
+}
+
+/**
+ * @brief Writes the assembly generated by build_asm() in its file.
+ * @param filename Name of the assembly file.
+ * @param text Assembly to write.
+ */
+static void write_assembly(char *filename, char *text){
+    FILE *file = try(fopen(filename, "w"), NULL);
+    fputs(text, file);
+    try(fclose(file));
+}
+
+/**
+ * @brief Runs the program in memory with --run, or with the virtual machine with --vm, its
+ * standard input read from the file named after --input if any.
+ * @param output Standard output of the program, the one of the compiler going to stderr.
+ * @param program Bytecode of the program for --vm, NULL for --run.
+ * @param text Assembly of the program for --run, NULL for --vm.
+ * @return The value returned by the program.
+ */
+static int run_program(int argc, char **argv, char *filename, int output, Bytecode *program, char *text){
+    int status;
+    for(int i = 1; i < argc - 1; i++)
+        if(!strcmp(argv[i], "--input")){
+            int fd = try(open(argv[i + 1], O_RDONLY));
+            try(dup2(fd, 0));
+            close(fd);
+        }
+    fflush(stdout);
+    try(dup2(output, 1));
+    status = program ? run_bytecode(program, filename) : run_in_memory(text, filename);
+    try(dup2(2, 1));
+    close(output);
+    return status;
+}
+
+/**
+ * @return The value returned by the program if it was run with --run or --vm, 0 otherwise.
+ */
+static int compile(int argc, char **argv){
     SymTabs *global_vars = creatSymbolsTable();
     SymTabsFct **functions = NULL;
+    Bytecode *program;
+    FILE *asm_file;
+    char *text = NULL;
+    size_t text_size = 0;
+    int status = 0, vm = has_option(argc, argv, "--vm", "--vm"), run = vm || has_option(argc, argv, "--run", "--run");
+    int executable = has_option(argc, argv, "-e", "--executable"), output = run ? try(dup(1)) : -1;
+
+    if(run)
+        try(dup2(2, 1));
 
     char *filename = get_filename(argc, argv);
     int err = yyparse(), nb_func = count_functions();
 
     fill_global_vars(global_vars);
-    build_global_vars_asm(global_vars, filename);
     functions = fill_decl_functions(nb_func, global_vars, filename);
 
     semantic_check(global_vars, functions, nb_func);
-    
-    build_asm(global_vars, functions, nb_func, filename);
+    functions = run_passes(global_vars, functions, &nb_func, optimization_level(argc, argv),
+        (has_option(argc, argv, "-r", "--report") ? PASS_REPORT : 0) | (has_option(argc, argv, "-v", "--verify") ? PASS_VERIFY : 0)
+        | (has_option(argc, argv, "-i", "--ir") ? PASS_DUMP_IR : 0));
+
+    line_buffered = has_option(argc, argv, "-l", "--line-buffered");
+    inline_builtins = has_option(argc, argv, "-b", "--inline-builtins");
+    if(vm){
+        program = compile_bytecode(global_vars, functions, nb_func);
+        status = run_program(argc, argv, filename, output, program, NULL);
+        free_bytecode(program);
+    }
+    else if(has_option(argc, argv, "--emit=c", "--emit=c"))
+        build_c_source(global_vars, functions, nb_func, filename);
+    else{
+        asm_file = try(open_memstream(&text, &text_size), NULL);
+        build_global_vars_asm(global_vars, asm_file);
+        build_asm(global_vars, functions, nb_func, asm_file);
+        try(fclose(asm_file));
+        if(!run || executable)
+            write_assembly(filename, text);
+        if(executable)
+            build_executable(text, filename);
+        if(run)
+            status = run_program(argc, argv, filename, output, NULL, text);
+        free(text);
+    }
     
     if(err == 0){
         parse_args(argc, argv, node, global_vars, functions, nb_func);
@@ -46,6 +137,7 @@ static void compile(int argc, char **argv){
     free_symbols_table(global_vars);
     free_tables(functions, nb_func);
     free(filename);
+    return status;
 }
 
 int main(int argc, char *argv[]){
@@ -57,6 +149,7 @@ int main(int argc, char *argv[]){
     call my_function2
     pop rsp
     */
-    compile(argc, argv);
+    if(!write_runtime(argc, argv))
+        return compile(argc, argv);
     return 0;
 }
\ No newline at end of file
@@ -14,9 +14,34 @@ static void help(){
     printf("Options:\n");
     printf(" -h --help      Display this help message\n");
     printf(" -t --tree      Display the abstract syntax tree\n");
+    printf(" -s --symtabs   Display the symbol tables\n");
+    printf(" -r --report    Report the unrolled loops and the eliminated expressions on stderr\n");
+    printf(" -v --verify    Verify the SSA form of the functions after each optimization\n");
+    printf(" -i --ir        Write the SSA form of the functions on stderr\n");
+    printf(" -l --line-buffered  Write the output of the program after each newline\n");
+    printf(" -b --inline-builtins  Write the calls of getchar and putchar inline\n");
+    printf(" -e --executable  Also write the executable, assembled and linked without nasm nor ld\n");
+    printf(" --run          Run the program in memory, returning its exit code, without writing an\n");
+    printf("                executable\n");
+    printf(" --vm           Run the program with the bytecode virtual machine, returning its exit\n");
+    printf("                code, without writing any assembly\n");
+    printf(" --emit=c       Write the program in portable C, in a .c file instead of the .asm file,\n");
+    printf("                to compile with a C compiler, gcc -O2 for instance\n");
+    printf(" --emit=asm     Write the assembly for nasm, the default\n");
+    printf(" --input FILE   Read the standard input of the program run by --run or --vm from FILE\n");
+    printf(" -O0 -O1 -O2    Optimization level, -O2 by default\n");
+    printf(" --runtime NAME Write the routine NAME of the runtime (_getchar, _getint, _putchar,\n");
+    printf("                _putint, _flush or _fill) instead of compiling\n");
     printf("\n");
 }
 
+int has_option(int argc, char *argv[], char *short_name, char *long_name){
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], short_name) == 0 || strcmp(argv[i], long_name) == 0)
+            return 1;
+    return 0;
+}
+
 void parse_args(int argc, char *argv[], Node * node, SymTabs *global_vars, SymTabsFct **functions, int count){
     int show_help = 0, show_tree = 0, show_tables = 0;
     for (int i = 1; i < argc; i++) {
@@ -26,6 +51,26 @@ void parse_args(int argc, char *argv[], Node * node, SymTabs *global_vars, SymTa
             show_tree = 1;
         else if (strcmp(argv[i], "--symtabs") == 0 || (strcmp(argv[i], "-s") == 0))
             show_tables = 1;
+        else if (strcmp(argv[i], "--report") == 0 || (strcmp(argv[i], "-r") == 0))
+            continue;
+        else if (strcmp(argv[i], "--verify") == 0 || (strcmp(argv[i], "-v") == 0))
+            continue;
+        else if (strcmp(argv[i], "--ir") == 0 || (strcmp(argv[i], "-i") == 0))
+            continue;
+        else if (strcmp(argv[i], "--line-buffered") == 0 || (strcmp(argv[i], "-l") == 0))
+            continue;
+        else if (strcmp(argv[i], "--inline-builtins") == 0 || (strcmp(argv[i], "-b") == 0))
+            continue;
+        else if (strcmp(argv[i], "--executable") == 0 || (strcmp(argv[i], "-e") == 0))
+            continue;
+        else if (strcmp(argv[i], "--run") == 0 || strcmp(argv[i], "--vm") == 0)
+            continue;
+        else if (strcmp(argv[i], "--emit=c") == 0 || strcmp(argv[i], "--emit=asm") == 0)
+            continue;
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+            i++;
+        else if (strcmp(argv[i], "-O0") == 0 || strcmp(argv[i], "-O1") == 0 || strcmp(argv[i], "-O2") == 0)
+            continue;
         else
             fprintf(stderr, "Unknown option or argument: %s\n", argv[i]);
     }
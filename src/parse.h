@@ -5,6 +5,8 @@
 #include <getopt.h>
 #include "compile.h"
 
+int has_option(int argc, char *argv[], char *short_name, char *long_name);
+
 void parse_args(int argc, char *argv[], Node * node, SymTabs *global_vars, SymTabsFct **functions, int count);
 
 #endif //PROJET_PARSE_H
@@ -0,0 +1,123 @@
+#include "passes.h"
+#include "eval.h"
+#include "specialize.h"
+#include "sroa.h"
+#include "sccp.h"
+#include "dce.h"
+#include "licm.h"
+#include "unroll.h"
+#include "cse.h"
+#include "coalesce.h"
+#include "ir.h"
+
+int optimize_level = OPT_DEFAULT;
+
+static SymTabsFct** run_fold(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    fold_constant_calls(global_vars, functions, *nb_functions, report);
+    return functions;
+}
+
+static SymTabsFct** run_specialize(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    return specialize_functions(global_vars, functions, nb_functions, report);
+}
+
+static SymTabsFct** run_sroa(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    return replace_small_arrays(global_vars, functions, nb_functions, report);
+}
+
+static SymTabsFct** run_sccp(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    propagate_constants(global_vars, functions, *nb_functions, report);
+    return functions;
+}
+
+static SymTabsFct** run_dce(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    return eliminate_dead_code(global_vars, functions, nb_functions, report);
+}
+
+static SymTabsFct** run_licm(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    return hoist_loop_invariants(global_vars, functions, nb_functions, report);
+}
+
+static SymTabsFct** run_unroll(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    unroll_loops(global_vars, functions, *nb_functions, report);
+    return functions;
+}
+
+static SymTabsFct** run_cse(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    return eliminate_common_subexpressions(global_vars, functions, nb_functions, report);
+}
+
+static SymTabsFct** run_coalesce(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    coalesce_putchars(global_vars, functions, *nb_functions, report);
+    return functions;
+}
+
+static const Pass passes[] = {
+    {"fold", OPT_BASIC, run_fold},
+    {"specialize", OPT_FULL, run_specialize},
+    {"sroa", OPT_BASIC, run_sroa},
+    {"sccp", OPT_BASIC, run_sccp},
+    {"dce", OPT_BASIC, run_dce},
+    {"licm", OPT_BASIC, run_licm},
+    {"unroll", OPT_FULL, run_unroll},
+    {"cse", OPT_BASIC, run_cse},
+    {"coalesce", OPT_BASIC, run_coalesce},
+};
+
+int optimization_level(int argc, char *argv[]){
+    int level = OPT_DEFAULT;
+    for(int i = 1; i < argc; ++i)
+        if(argv[i][0] == '-' && argv[i][1] == 'O' && argv[i][2] >= '0' && argv[i][2] <= '0' + OPT_FULL && !argv[i][3])
+            level = argv[i][2] - '0';
+    return level;
+}
+
+/**
+ * @brief Lowers each function of the tree to SSA form and checks it.
+ * @param file Where the broken invariants are written.
+ * @param dump Flag writing each function on file.
+ * @return The number of broken invariants.
+ */
+int verify_program(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, FILE *file, int dump){
+    int errors = 0;
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        IrFunction *function;
+        if(current->label != Function || !(function = lower_function(current, global_vars, functions, nb_functions)))
+            continue;
+        errors += verify_function(function, file);
+        if(dump)
+            print_function(function, file);
+        free_function(function);
+    }
+    return errors;
+}
+
+/**
+ * @brief Runs the passes of an optimization level in order.
+ *
+ * The passes all transform the tree, the SSA form being only lowered from it to be verified and
+ * written. The level is also kept in optimize_level for the code generation, which only selects
+ * the instructions by tree patterns and strength reduces the array accesses from -O1, and
+ * vectorizes the loops at -O2. With PASS_VERIFY, the program is lowered to SSA form and verified
+ * before the first pass and after each pass, so that a pass breaking the tree is named.
+ * @return The tables of the functions after the last pass.
+ */
+SymTabsFct** run_passes(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int level, int flags){
+    optimize_level = level;
+    if((flags & PASS_VERIFY) && verify_program(global_vars, functions, *nb_functions, stderr, 0)){
+        fprintf(stderr, "IR verifier: invalid program before the first pass\n");
+        exit(EXIT_ERROR);
+    }
+    for(int i = 0; i < (int)(sizeof(passes) / sizeof(Pass)); ++i){
+        if(passes[i].level > level)
+            continue;
+        functions = passes[i].run(global_vars, functions, nb_functions, flags & PASS_REPORT);
+        if((flags & PASS_VERIFY) && verify_program(global_vars, functions, *nb_functions, stderr, 0)){
+            fprintf(stderr, "IR verifier: invalid program after the pass %s\n", passes[i].name);
+            exit(EXIT_ERROR);
+        }
+    }
+    if(flags & PASS_DUMP_IR)
+        verify_program(global_vars, functions, *nb_functions, stderr, 1);
+    return functions;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file passes.h
+ * @brief Pass manager running the optimizations of an optimization level.
+ */
+
+#ifndef __PASSES__H
+#define __PASSES__H
+
+#include "compile.h"
+
+#define OPT_NONE 0     ///< -O0: the code of the checked tree, without any optimization.
+#define OPT_BASIC 1    ///< -O1: optimizations that never make the code bigger.
+#define OPT_FULL 2     ///< -O2: cloning, unrolling and vectorization too.
+#define OPT_DEFAULT OPT_FULL
+
+#define PASS_REPORT 1  ///< Flag reporting the transformations of the passes on stderr.
+#define PASS_VERIFY 2  ///< Flag lowering the functions to SSA form and verifying them after each pass.
+#define PASS_DUMP_IR 4 ///< Flag writing the SSA form of the functions on stderr after the last pass.
+
+extern int optimize_level; ///< Optimization level of the code generation.
+
+/**
+ * @brief Optimization of the tree between the semantic check and the code generation.
+ */
+typedef struct{
+    char *name;  ///< Name of the pass in the messages.
+    int level;   ///< Lowest optimization level running the pass.
+    SymTabsFct** (*run)(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report); ///< Function of the pass, returning the new tables of the functions.
+}Pass;
+
+int optimization_level(int argc, char *argv[]); ///< Function to get the optimization level given by -O0, -O1 or -O2.
+
+int verify_program(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, FILE *file, int dump); ///< Function to lower every function to SSA form and verify it, writing it if asked.
+
+SymTabsFct** run_passes(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int level, int flags); ///< Function to run the passes of an optimization level.
+
+#endif
@@ -0,0 +1,446 @@
+#include <limits.h>
+#include "sccp.h"
+#include "eval.h"
+
+/**
+ * @brief Abstract value of a scalar variable.
+ */
+typedef struct{
+    int kind;    ///< SCCP_CONST or SCCP_VARYING.
+    long value;  ///< Value of a constant.
+}Value;
+
+/**
+ * @brief Scalar variable tracked by the propagation.
+ */
+typedef struct{
+    char *ident;     ///< Name of the variable.
+    int is_int;      ///< Flag indicating if the variable is an integer.
+    int is_global;   ///< Flag indicating if the variable is global, stored with its size in bytes.
+    int is_written;  ///< Flag indicating if a global variable is assigned somewhere in the program.
+}Var;
+
+/**
+ * @brief Basic block of the control flow graph.
+ */
+typedef struct{
+    Node **stmts;  ///< Assignments, calls and returns of the block, in order.
+    int nb_stmts;  ///< Number of statements.
+    Node *branch;  ///< If or While whose condition ends the block, NULL if none.
+    int succ[2];   ///< Successor when the condition is true (or only successor), when it is false. -1 if none.
+    Value *in;     ///< Values at the entry of the block, NULL while no executable edge reaches it.
+    int queued;    ///< Flag indicating if the block is in the worklist.
+}Block;
+
+/**
+ * @brief State of the propagation in a function.
+ */
+typedef struct{
+    SymTabs *global_vars;
+    SymTabsFct *function;  ///< Table of the current function.
+    Var *vars;             ///< Global variables first, since the code generation looks them up first.
+    int nb_vars;           ///< Number of variables.
+    Block *blocks;         ///< Blocks of the function, the first one is its entry.
+    int nb_blocks;         ///< Number of blocks.
+    int *worklist;         ///< Blocks whose entry values changed.
+    int nb_work;           ///< Number of blocks in the worklist.
+    int replaced;          ///< Number of reads replaced by their value.
+}SccpCtx;
+
+static int is_user_call(Node *root){
+    return is_function_call(root) && !is_builtin_function(FIRSTCHILD(root)->ident);
+}
+
+static int has_user_call(Node *root){
+    if(is_user_call(root))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(has_user_call(child))
+            return 1;
+    return 0;
+}
+
+static int calls_function(Node *root, char *function_name){
+    if(is_function_call(root) && !strcmp(FIRSTCHILD(root)->ident, function_name))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(calls_function(child, function_name))
+            return 1;
+    return 0;
+}
+
+static int assigns_scalar(Node *root, char *var_name){
+    if(root->label == Equals && FIRSTCHILD(FIRSTCHILD(root))->label == Ident
+        && !strcmp(FIRSTCHILD(FIRSTCHILD(root))->ident, var_name))
+        return 1;
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        if(assigns_scalar(child, var_name))
+            return 1;
+    return 0;
+}
+
+static void add_vars(SccpCtx *ctx, Table *table, int is_global){
+    for(Table *current = table; current; current = current->next){
+        if(current->var.is_array)
+            continue;
+        ctx->vars = (Var*) try(realloc(ctx->vars, sizeof(Var) * (ctx->nb_vars + 1)), NULL);
+        ctx->vars[ctx->nb_vars].ident = current->var.ident;
+        ctx->vars[ctx->nb_vars].is_int = current->var.is_int;
+        ctx->vars[ctx->nb_vars].is_global = is_global;
+        ctx->vars[ctx->nb_vars].is_written = is_global && assigns_scalar(node, current->var.ident);
+        ctx->nb_vars++;
+    }
+}
+
+static int var_index(SccpCtx *ctx, char *var_name){
+    for(int i = 0; i < ctx->nb_vars; ++i)
+        if(!strcmp(ctx->vars[i].ident, var_name))
+            return i;
+    return -1;
+}
+
+static int new_block(SccpCtx *ctx){
+    ctx->blocks = (Block*) try(realloc(ctx->blocks, sizeof(Block) * (ctx->nb_blocks + 1)), NULL);
+    ctx->blocks[ctx->nb_blocks] = (Block){NULL, 0, NULL, {-1, -1}, NULL, 0};
+    return ctx->nb_blocks++;
+}
+
+static void add_stmt(SccpCtx *ctx, int block, Node *stmt){
+    Block *current = &ctx->blocks[block];
+    current->stmts = (Node**) try(realloc(current->stmts, sizeof(Node*) * (current->nb_stmts + 1)), NULL);
+    current->stmts[current->nb_stmts++] = stmt;
+}
+
+/**
+ * @brief Adds the statements of a tree to the control flow graph.
+ * @param block Block where the statements start.
+ * @return Block where the control goes after the statements. After a return, it is a new
+ * block that no edge reaches.
+ */
+static int build_cfg(SccpCtx *ctx, Node *root, int block){
+    int then_end, else_end = -1, join, header, body;
+    switch(root->label){
+        case Corps:
+        case Instructions:
+            for(Node *current = FIRSTCHILD(root); current; current = current->nextSibling)
+                block = build_cfg(ctx, current, block);
+            return block;
+        case Equals:
+            add_stmt(ctx, block, root);
+            return block;
+        case Function:
+            if(is_function_call(root))
+                add_stmt(ctx, block, root);
+            return block;
+        case Return:
+            add_stmt(ctx, block, root);
+            return new_block(ctx);
+        case If:
+            then_end = new_block(ctx);
+            ctx->blocks[block].branch = root;
+            ctx->blocks[block].succ[0] = then_end;
+            then_end = build_cfg(ctx, SECONDCHILD(root), then_end);
+            if(THIRDCHILD(root)){
+                else_end = new_block(ctx);
+                ctx->blocks[block].succ[1] = else_end;
+                else_end = build_cfg(ctx, THIRDCHILD(root), else_end);
+            }
+            join = new_block(ctx);
+            ctx->blocks[then_end].succ[0] = join;
+            if(else_end >= 0)
+                ctx->blocks[else_end].succ[0] = join;
+            else
+                ctx->blocks[block].succ[1] = join;
+            return join;
+        case While:
+            header = new_block(ctx);
+            ctx->blocks[block].succ[0] = header;
+            body = new_block(ctx);
+            ctx->blocks[header].branch = root;
+            ctx->blocks[header].succ[0] = body;
+            body = build_cfg(ctx, SECONDCHILD(root), body);
+            ctx->blocks[body].succ[0] = header;
+            join = new_block(ctx);
+            ctx->blocks[header].succ[1] = join;
+            return join;
+        default:
+            return block;
+    }
+}
+
+static Value varying(void){
+    return (Value){SCCP_VARYING, 0};
+}
+
+static Value constant(long value){
+    return (Value){SCCP_CONST, value};
+}
+
+/**
+ * @brief Computes the abstract value of an expression, its operators folded by fold_binary() as in eval_constant.
+ *
+ * Array elements and calls are never known, nor a division by zero.
+ */
+static Value eval_value(SccpCtx *ctx, Value *state, Node *root){
+    Value left, right;
+    int index;
+    switch(root->label){
+        case Num:
+            return constant(root->num);
+        case Character:
+            return constant(character_value(root));
+        case Expression:
+            return eval_value(ctx, state, FIRSTCHILD(root));
+        case Variable:
+            if(FIRSTCHILD(root)->label == Ident && (index = var_index(ctx, FIRSTCHILD(root)->ident)) >= 0)
+                return state[index];
+            return varying();
+        case Not:
+            left = eval_value(ctx, state, FIRSTCHILD(root));
+            return left.kind == SCCP_CONST ? constant(!left.value) : left;
+        case Addsub:
+        case Divstar:
+        case Eq:
+        case Order:
+        case And:
+        case Or:
+            break;
+        default:
+            return varying();
+    }
+    left = eval_value(ctx, state, FIRSTCHILD(root));
+    if(!SECONDCHILD(root)){
+        if(left.kind == SCCP_CONST && root->ident[0] == '-')
+            left.value = (long)(0UL - (unsigned long)left.value);
+        return left;
+    }
+    right = eval_value(ctx, state, SECONDCHILD(root));
+    if(left.kind != SCCP_CONST || right.kind != SCCP_CONST || !fold_binary(root, left.value, right.value, &left.value))
+        return varying();
+    return left;
+}
+
+/**
+ * @brief Forgets the globals that a called function may assign.
+ */
+static void kill_globals(SccpCtx *ctx, Value *state){
+    for(int i = 0; i < ctx->nb_vars; ++i)
+        if(ctx->vars[i].is_written)
+            state[i] = varying();
+}
+
+/**
+ * @brief Applies a statement to the values of the variables.
+ *
+ * A global keeps the value read back from its size in bytes, as the code generation stores
+ * only its low bytes and sign extends them.
+ */
+static void transfer(SccpCtx *ctx, Value *state, Node *stmt){
+    Value value;
+    int index;
+    if(has_user_call(stmt))
+        kill_globals(ctx, state);
+    if(stmt->label != Equals || FIRSTCHILD(FIRSTCHILD(stmt))->label != Ident
+        || (index = var_index(ctx, FIRSTCHILD(FIRSTCHILD(stmt))->ident)) < 0)
+        return;
+    value = eval_value(ctx, state, SECONDCHILD(stmt));
+    if(value.kind == SCCP_CONST && ctx->vars[index].is_global)
+        value.value = ctx->vars[index].is_int ? (long)(int)value.value : (long)(signed char)value.value;
+    state[index] = value;
+}
+
+/**
+ * @brief Merges the values at the end of a block into the entry of a successor.
+ */
+static void propagate(SccpCtx *ctx, int block, Value *state){
+    Block *current = &ctx->blocks[block];
+    int changed = 0;
+    if(!current->in){
+        current->in = (Value*) try(malloc(sizeof(Value) * (ctx->nb_vars + 1)), NULL);
+        memcpy(current->in, state, sizeof(Value) * ctx->nb_vars);
+        changed = 1;
+    }
+    else
+        for(int i = 0; i < ctx->nb_vars; ++i)
+            if(current->in[i].kind == SCCP_CONST
+                && (state[i].kind != SCCP_CONST || state[i].value != current->in[i].value)){
+                current->in[i] = varying();
+                changed = 1;
+            }
+    if(changed && !current->queued){
+        current->queued = 1;
+        ctx->worklist[ctx->nb_work++] = block;
+    }
+}
+
+/**
+ * @brief Computes the values at the entry of each block, following only the executable edges.
+ *
+ * An edge leaving a condition whose value is known is only executable in the direction taken.
+ */
+static void solve(SccpCtx *ctx, Value *entry){
+    Value *state = (Value*) try(malloc(sizeof(Value) * (ctx->nb_vars + 1)), NULL);
+    ctx->worklist = (int*) try(malloc(sizeof(int) * ctx->nb_blocks), NULL);
+    ctx->nb_work = 0;
+    propagate(ctx, 0, entry);
+    while(ctx->nb_work > 0){
+        int block = ctx->worklist[--ctx->nb_work];
+        Block *current = &ctx->blocks[block];
+        current->queued = 0;
+        memcpy(state, current->in, sizeof(Value) * ctx->nb_vars);
+        for(int i = 0; i < current->nb_stmts; ++i)
+            transfer(ctx, state, current->stmts[i]);
+        if(current->branch){
+            Value cond;
+            if(has_user_call(FIRSTCHILD(current->branch)))
+                kill_globals(ctx, state);
+            cond = eval_value(ctx, state, FIRSTCHILD(current->branch));
+            if(cond.kind != SCCP_CONST || cond.value)
+                propagate(ctx, current->succ[0], state);
+            if(cond.kind != SCCP_CONST || !cond.value)
+                propagate(ctx, current->succ[1], state);
+        }
+        else if(current->succ[0] >= 0)
+            propagate(ctx, current->succ[0], state);
+    }
+    free(ctx->worklist);
+    free(state);
+}
+
+static void replace_by_num(Node *root, long value){
+    if(FIRSTCHILD(root))
+        deleteTree(FIRSTCHILD(root));
+    root->firstChild = NULL;
+    root->label = Num;
+    root->num = (int)value;
+    root->ident = NULL;
+}
+
+/**
+ * @brief Replaces the reads of the scalar variables whose value is known by this value.
+ */
+static void substitute(SccpCtx *ctx, Value *state, Node *root){
+    int index;
+    if(root->label == Variable && FIRSTCHILD(root)->label == Ident){
+        index = var_index(ctx, FIRSTCHILD(root)->ident);
+        if(index >= 0 && state[index].kind == SCCP_CONST && state[index].value >= INT_MIN && state[index].value <= INT_MAX){
+            replace_by_num(root, state[index].value);
+            ctx->replaced++;
+        }
+        return;
+    }
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling)
+        substitute(ctx, state, child);
+}
+
+static void substitute_stmt(SccpCtx *ctx, Value *state, Node *stmt){
+    if(has_user_call(stmt))
+        kill_globals(ctx, state);
+    if(stmt->label == Equals){
+        if(FIRSTCHILD(FIRSTCHILD(stmt))->label == Array)
+            substitute(ctx, state, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(stmt)))));
+        substitute(ctx, state, SECONDCHILD(stmt));
+    }
+    else if(stmt->label == Return){
+        if(FIRSTCHILD(stmt)->label != Void)
+            substitute(ctx, state, FIRSTCHILD(stmt));
+    }
+    else
+        substitute(ctx, state, FIRSTCHILD(FIRSTCHILD(stmt)));
+}
+
+/**
+ * @brief Rewrites the executable blocks with the values at their entry.
+ *
+ * A condition whose value is known becomes a constant, so that fold_constant_calls removes
+ * the arm that is never taken.
+ */
+static void rewrite(SccpCtx *ctx){
+    Value *state = (Value*) try(malloc(sizeof(Value) * (ctx->nb_vars + 1)), NULL);
+    for(int block = 0; block < ctx->nb_blocks; ++block){
+        Block *current = &ctx->blocks[block];
+        if(!current->in)
+            continue;
+        memcpy(state, current->in, sizeof(Value) * ctx->nb_vars);
+        for(int i = 0; i < current->nb_stmts; ++i){
+            substitute_stmt(ctx, state, current->stmts[i]);
+            transfer(ctx, state, current->stmts[i]);
+        }
+        if(current->branch){
+            Node *cond = FIRSTCHILD(current->branch);
+            Value value;
+            if(has_user_call(cond))
+                kill_globals(ctx, state);
+            value = eval_value(ctx, state, cond);
+            if(cond->label == Expression)
+                cond = FIRSTCHILD(cond);
+            if(value.kind == SCCP_CONST && cond->label != Num){
+                replace_by_num(cond, value.value != 0);
+                ctx->replaced++;
+            }
+            else if(value.kind != SCCP_CONST)
+                substitute(ctx, state, cond);
+        }
+    }
+    free(state);
+}
+
+static void free_blocks(SccpCtx *ctx){
+    for(int i = 0; i < ctx->nb_blocks; ++i){
+        free(ctx->blocks[i].stmts);
+        free(ctx->blocks[i].in);
+    }
+    free(ctx->blocks);
+    ctx->blocks = NULL;
+    ctx->nb_blocks = 0;
+}
+
+/**
+ * @brief Propagates the values of the scalar variables along the executable paths of each function.
+ *
+ * The body of each function is split into basic blocks linked by the edges of its If and
+ * While statements. Parameters and local variables are unknown at the entry of a function,
+ * globals are 0 if no function assigns them, and at the entry of main if nothing calls it.
+ * The specialized clones keep their constant parameters as locals assigned on entry, so they
+ * are propagated as well. A call to a user function forgets the globals it may assign.
+ *
+ * The reads of variables with a known value are replaced by it, then fold_constant_calls
+ * folds the expressions and removes the branches that can't be taken.
+ * @param report Flag telling if the number of replaced reads of each function is written on stderr.
+ */
+void propagate_constants(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report){
+    SccpCtx ctx = {global_vars, NULL, NULL, 0, NULL, 0, NULL, 0, 0};
+    int main_called = calls_function(node, "main");
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        SymTabsFct *function = NULL;
+        Value *entry;
+        int replaced = ctx.replaced;
+        if(current->label != Function)
+            continue;
+        for(int i = 0; i < nb_functions; ++i)
+            if(!strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                function = functions[i];
+        if(!function)
+            continue;
+        ctx.function = function;
+        ctx.nb_vars = 0;
+        add_vars(&ctx, global_vars->first, 1);
+        add_vars(&ctx, function->parameters, 0);
+        add_vars(&ctx, function->variables, 0);
+        entry = (Value*) try(malloc(sizeof(Value) * (ctx.nb_vars + 1)), NULL);
+        for(int i = 0; i < ctx.nb_vars; ++i)
+            entry[i] = ctx.vars[i].is_global && (!ctx.vars[i].is_written || (!strcmp(function->ident, "main") && !main_called))
+                ? constant(0) : varying();
+        build_cfg(&ctx, FOURTHCHILD(current), new_block(&ctx));
+        solve(&ctx, entry);
+        rewrite(&ctx);
+        free_blocks(&ctx);
+        free(entry);
+        if(report && ctx.replaced > replaced)
+            fprintf(stderr, "%s: %d read%s replaced by a constant\n", function->ident, ctx.replaced - replaced,
+                ctx.replaced - replaced > 1 ? "s" : "");
+    }
+    free(ctx.vars);
+    if(ctx.replaced)
+        fold_constant_calls(global_vars, functions, nb_functions, 0);
+}
@@ -0,0 +1,16 @@
+/**
+ * @file sccp.h
+ * @brief Sparse conditional constant propagation over the control flow graph of each function.
+ */
+
+#ifndef __SCCP__H
+#define __SCCP__H
+
+#include "compile.h"
+
+#define SCCP_CONST 0   ///< The variable holds the same known value on every executable path.
+#define SCCP_VARYING 1 ///< The value of the variable isn't known at compile time.
+
+void propagate_constants(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report); ///< Function to replace the reads of variables holding a known value and to prune the branches that are never taken.
+
+#endif
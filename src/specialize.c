@@ -0,0 +1,251 @@
+#include "specialize.h"
+#include "eval.h"
+
+#define SPEC_MAX_PARAMS 32
+
+/**
+ * @brief A clone of a function for some constant arguments.
+ */
+typedef struct spec{
+    char *function;                    ///< Name of the cloned function.
+    int nb_params;                     ///< Number of parameters of the cloned function.
+    int is_constant[SPEC_MAX_PARAMS];  ///< Flags telling which parameters are replaced by a constant.
+    long values[SPEC_MAX_PARAMS];      ///< Values of the constant parameters.
+    char *clone;                       ///< Name of the clone.
+    struct spec *next;                 ///< Next clone.
+}Spec;
+
+typedef struct{
+    Spec *specs;      ///< Clones already created.
+    int budget;       ///< Number of nodes the clones can still add.
+    SymTabs *global_vars;
+    int report;       ///< Flag telling if the clones are reported on stderr.
+}SpecCtx;
+
+static int constant_arg(Node *arg, long *value){
+    Node *expr = arg->label == Expression ? FIRSTCHILD(arg) : arg;
+    if(expr->label == Num){
+        *value = expr->num;
+        return 1;
+    }
+    if(expr->label == Character){
+        *value = character_value(expr);
+        return 1;
+    }
+    return 0;
+}
+
+static int nb_clones(SpecCtx *ctx, char *function_name){
+    int nb = 0;
+    for(Spec *current = ctx->specs; current; current = current->next)
+        if(!strcmp(current->function, function_name))
+            nb++;
+    return nb;
+}
+
+static Spec *find_spec(SpecCtx *ctx, Spec *pattern){
+    for(Spec *current = ctx->specs; current; current = current->next){
+        int same = !strcmp(current->function, pattern->function) && current->nb_params == pattern->nb_params;
+        for(int i = 0; same && i < pattern->nb_params; ++i)
+            if(current->is_constant[i] != pattern->is_constant[i]
+                || (pattern->is_constant[i] && current->values[i] != pattern->values[i]))
+                same = 0;
+        if(same)
+            return current;
+    }
+    return NULL;
+}
+
+static char *clone_name(char *function_name, SymTabs *global_vars){
+    static int counter = 0;
+    char *name = (char*) try(malloc(sizeof(char) * (strlen(function_name) + 16)), NULL);
+    do
+        sprintf(name, "%s_c%d", function_name, ++counter);
+    while(find_function_decl(name) || check_in_table(*global_vars, name));
+    return name;
+}
+
+/**
+ * @brief Removes the flagged nodes of a list of parameters or arguments.
+ * @param list The Parameters node.
+ * @param removed Flags, one per element of the list.
+ */
+static void remove_elements(Node *list, int *removed){
+    Node *current = FIRSTCHILD(list), *next;
+    int i = 0;
+    list->firstChild = NULL;
+    for(; current; current = next, ++i){
+        next = current->nextSibling;
+        current->nextSibling = NULL;
+        if(removed[i])
+            deleteTree(current);
+        else
+            addChild(list, current);
+    }
+    if(!FIRSTCHILD(list))
+        addChild(list, makeNode(Void));
+}
+
+static int is_assigned(Node *root, char *var_name){
+    if(!root)
+        return 0;
+    if(root->label == Equals && FIRSTCHILD(FIRSTCHILD(root))->label == Ident
+        && !strcmp(FIRSTCHILD(FIRSTCHILD(root))->ident, var_name))
+        return 1;
+    return is_assigned(FIRSTCHILD(root), var_name) || is_assigned(root->nextSibling, var_name);
+}
+
+static void substitute_var(Node *root, char *var_name, long value){
+    if(!root)
+        return;
+    if(root->label == Variable && FIRSTCHILD(root)->label == Ident && !strcmp(FIRSTCHILD(root)->ident, var_name)){
+        deleteTree(FIRSTCHILD(root));
+        root->firstChild = NULL;
+        root->label = Num;
+        root->num = (int)value;
+    }
+    substitute_var(FIRSTCHILD(root), var_name, value);
+    substitute_var(root->nextSibling, var_name, value);
+}
+
+/**
+ * @brief Turns a parameter of a clone into a local variable initialized with its constant.
+ *
+ * Used when the body assigns the parameter, so its uses can't simply be replaced by the constant.
+ */
+static void localize_param(Node *corps, Node *param, long value){
+    Node *decl = makeNode(Type), *instructions = NULL, *affect = makeNode(Equals);
+    Node *var = makeNode(Variable), *ident = makeNode(Ident), *expr = makeNode(Expression), *num = makeNode(Num);
+    decl->ident = strdup(param->ident);
+    addChild(decl, copyTree(FIRSTCHILD(param)));
+    decl->nextSibling = corps->firstChild;
+    corps->firstChild = decl;
+    for(Node *current = FIRSTCHILD(corps); current; current = current->nextSibling)
+        if(current->label == Instructions)
+            instructions = current;
+    if(!instructions){
+        instructions = makeNode(Instructions);
+        addChild(corps, instructions);
+    }
+    ident->ident = strdup(FIRSTCHILD(param)->ident);
+    num->num = (int)value;
+    affect->ident = "=";
+    addChild(var, ident);
+    addChild(expr, num);
+    addChild(affect, var);
+    addChild(affect, expr);
+    affect->nextSibling = instructions->firstChild;
+    instructions->firstChild = affect;
+}
+
+/**
+ * @brief Creates the clone of a function described by a pattern.
+ *
+ * The constant parameters are removed from the clone, and their uses are replaced by the constants.
+ */
+static Spec *create_spec(SpecCtx *ctx, Spec *pattern, Node *decl){
+    Spec *spec = (Spec*) try(malloc(sizeof(Spec)), NULL);
+    Node *clone = copyTree(decl), *param = FIRSTCHILD(THIRDCHILD(clone));
+    *spec = *pattern;
+    spec->clone = clone_name(pattern->function, ctx->global_vars);
+    spec->next = ctx->specs;
+    ctx->specs = spec;
+    free(SECONDCHILD(clone)->ident);
+    SECONDCHILD(clone)->ident = spec->clone;
+    for(int i = 0; param && i < spec->nb_params; param = param->nextSibling, ++i){
+        if(!spec->is_constant[i])
+            continue;
+        if(is_assigned(FOURTHCHILD(clone), FIRSTCHILD(param)->ident))
+            localize_param(FOURTHCHILD(clone), param, spec->values[i]);
+        else
+            substitute_var(FIRSTCHILD(FOURTHCHILD(clone)), FIRSTCHILD(param)->ident, spec->values[i]);
+    }
+    remove_elements(THIRDCHILD(clone), spec->is_constant);
+    addSibling(decl, clone);
+    ctx->budget -= countNodes(clone);
+    if(ctx->report){
+        int nb_constants = 0;
+        for(int i = 0; i < spec->nb_params; ++i)
+            nb_constants += spec->is_constant[i];
+        fprintf(stderr, "%s: cloned as %s for %d constant argument%s\n", spec->function, spec->clone, nb_constants,
+            nb_constants > 1 ? "s" : "");
+    }
+    return spec;
+}
+
+/**
+ * @brief Redirects a call to the clone matching its constant arguments, creating it if needed.
+ * @return 1 if the call has been redirected, 0 otherwise.
+ */
+static int specialize_call(SpecCtx *ctx, Node *root){
+    char *function_name = FIRSTCHILD(root)->ident;
+    Node *decl = find_function_decl(function_name), *param, *arg;
+    Spec pattern, *spec;
+    int nb_constants = 0;
+    if(!decl || is_builtin_function(function_name))
+        return 0;
+    pattern.function = function_name;
+    pattern.nb_params = 0;
+    param = FIRSTCHILD(THIRDCHILD(decl));
+    arg = FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root)));
+    for(; param && param->label == Type && arg && arg->label != Void; param = param->nextSibling, arg = arg->nextSibling){
+        int i = pattern.nb_params++;
+        if(i >= SPEC_MAX_PARAMS)
+            return 0;
+        pattern.is_constant[i] = FIRSTCHILD(param)->label == Ident && constant_arg(arg, &pattern.values[i]);
+        nb_constants += pattern.is_constant[i];
+    }
+    if(!nb_constants)
+        return 0;
+    if(!(spec = find_spec(ctx, &pattern))){
+        int size = countNodes(decl);
+        if(size > SPEC_MAX_BODY || size > ctx->budget || nb_clones(ctx, function_name) >= SPEC_MAX_CLONES)
+            return 0;
+        spec = create_spec(ctx, &pattern, decl);
+    }
+    FIRSTCHILD(root)->ident = spec->clone;
+    remove_elements(FIRSTCHILD(FIRSTCHILD(root)), spec->is_constant);
+    return 1;
+}
+
+static int specialize_calls(SpecCtx *ctx, Node *root){
+    int changed = 0;
+    if(!root)
+        return 0;
+    if(is_function_call(root))
+        changed = specialize_call(ctx, root);
+    changed |= specialize_calls(ctx, FIRSTCHILD(root));
+    changed |= specialize_calls(ctx, root->nextSibling);
+    return changed;
+}
+
+/**
+ * @brief Clones functions for the constant arguments seen at their call sites.
+ *
+ * Each call passing constants to scalar parameters is redirected to a clone without these
+ * parameters, whose body is then folded and simplified. Clones are created while the
+ * SPEC_MAX_CLONES and SPEC_SIZE_BUDGET limits allow it, and calls in the clones themselves
+ * are specialized again during SPEC_MAX_ROUNDS rounds, so recursion stays in the clone.
+ *
+ * @param report Flag telling if each clone is written on stderr.
+ * @return The tables of the functions, clones included.
+ */
+SymTabsFct** specialize_functions(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    SpecCtx ctx = {NULL, SPEC_SIZE_BUDGET, global_vars, report};
+    for(int round = 0; round < SPEC_MAX_ROUNDS; ++round){
+        int changed = 0;
+        for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling)
+            if(current->label == Function)
+                changed |= specialize_calls(&ctx, FOURTHCHILD(current));
+        if(!changed)
+            break;
+        functions = update_decl_functions(functions, nb_functions, global_vars);
+        fold_constant_calls(global_vars, functions, *nb_functions, 0);
+    }
+    while(ctx.specs){
+        Spec *next = ctx.specs->next;
+        free(ctx.specs);
+        ctx.specs = next;
+    }
+    return functions;
+}
@@ -0,0 +1,18 @@
+/**
+ * @file specialize.h
+ * @brief Cloning of functions for the constant arguments of their call sites.
+ */
+
+#ifndef __SPECIALIZE__H
+#define __SPECIALIZE__H
+
+#include "compile.h"
+
+#define SPEC_MAX_CLONES 4      ///< Maximum number of clones of one function.
+#define SPEC_MAX_BODY 300      ///< Functions with more nodes than this are never cloned.
+#define SPEC_SIZE_BUDGET 1500  ///< Maximum number of nodes added by all the clones.
+#define SPEC_MAX_ROUNDS 2      ///< Clones can be specialized again this many times.
+
+SymTabsFct** specialize_functions(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report); ///< Function to clone functions for their constant arguments and redirect the calls.
+
+#endif
@@ -0,0 +1,252 @@
+#include "sroa.h"
+
+/**
+ * @brief A local array whose elements may be replaced by scalars.
+ */
+typedef struct{
+    Node *decl;        ///< Array node of the declaration.
+    Node *type;        ///< Type node holding the declaration.
+    char *name;        ///< Name of the array.
+    int size;          ///< Number of elements.
+    int is_int;        ///< Flag telling if the elements are int.
+    int replaceable;   ///< Flag cleared by the first access that isn't a constant index in bounds.
+    char **elements;   ///< Scalar of each element, NULL until the element is accessed.
+}Candidate;
+
+/**
+ * @brief State of the scalar replacement in a function.
+ */
+typedef struct{
+    SymTabs *global_vars;
+    SymTabsFct *function;    ///< Table of the current function.
+    Node *corps;             ///< Body of the current function.
+    Candidate *candidates;   ///< Local arrays of the current function.
+    int nb_candidates;       ///< Number of local arrays.
+    char **temps;            ///< Scalars created so far, not in the tables yet.
+    int nb_temps;            ///< Number of scalars.
+}SroaCtx;
+
+static Node *unwrap(Node *root){
+    while(root->label == Expression)
+        root = FIRSTCHILD(root);
+    return root;
+}
+
+static int is_local(SroaCtx *ctx, char *var_name){
+    for(int i = 0; i < ctx->nb_temps; ++i)
+        if(!strcmp(ctx->temps[i], var_name))
+            return 1;
+    return check_in_table_fct(ctx->function->parameters, var_name) || check_in_table_fct(ctx->function->variables, var_name);
+}
+
+static Candidate *find_candidate(SroaCtx *ctx, char *var_name){
+    for(int i = 0; i < ctx->nb_candidates; ++i)
+        if(!strcmp(ctx->candidates[i].name, var_name))
+            return &ctx->candidates[i];
+    return NULL;
+}
+
+/**
+ * @brief Collects the local arrays small enough to be replaced.
+ *
+ * An array named like a global or a parameter is never accessed by its name, since the
+ * globals and the parameters are looked up first, so it's left alone.
+ */
+static void collect_candidates(SroaCtx *ctx){
+    for(Node *decl = FIRSTCHILD(ctx->corps); decl && decl->label == Type; decl = decl->nextSibling)
+        for(Node *current = FIRSTCHILD(decl); current; current = current->nextSibling){
+            Candidate *candidate;
+            char *var_name;
+            if(current->label != Array)
+                continue;
+            var_name = FIRSTCHILD(current)->ident;
+            if(FIRSTCHILD(FIRSTCHILD(current))->num > SROA_MAX_SIZE || check_in_table(*ctx->global_vars, var_name)
+                || check_in_table_fct(ctx->function->parameters, var_name))
+                continue;
+            ctx->candidates = (Candidate*) try(realloc(ctx->candidates, sizeof(Candidate) * (ctx->nb_candidates + 1)), NULL);
+            candidate = &ctx->candidates[ctx->nb_candidates++];
+            candidate->decl = current;
+            candidate->type = decl;
+            candidate->name = var_name;
+            candidate->size = FIRSTCHILD(FIRSTCHILD(current))->num;
+            candidate->is_int = !strcmp(decl->ident, "int");
+            candidate->replaceable = 1;
+            candidate->elements = (char**) try(calloc(candidate->size + 1, sizeof(char*)), NULL);
+        }
+}
+
+static Element *find_element(Table *table, char *var_name){
+    for(Table *current = table; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return &current->var;
+    return NULL;
+}
+
+/**
+ * @brief Tells if an expression always holds in an element of an array, int or char.
+ *
+ * The elements are stored on 4 bytes or 1 and read sign extended, while a scalar keeps the 64
+ * bits of its value. Both reads agree when the stored value is a constant in the range of the
+ * element, or a variable read at most as wide: an array element or a global scalar.
+ */
+static int fits_element(SroaCtx *ctx, Node *root, int is_int){
+    Element *var;
+    char *var_name;
+    root = unwrap(root);
+    if(root->label == Num)
+        return is_int || (root->num >= -128 && root->num <= 127);
+    if(root->label == Character)
+        return 1;
+    if(root->label != Variable)
+        return 0;
+    root = FIRSTCHILD(root);
+    var_name = root->label == Array ? FIRSTCHILD(root)->ident : root->ident;
+    if(!(var = find_element(ctx->global_vars->first, var_name)) && root->label != Array)
+        return 0;
+    if(!var && !(var = find_element(ctx->function->parameters, var_name)))
+        var = find_element(ctx->function->variables, var_name);
+    if(!var || var->is_array != (root->label == Array))
+        return 0;
+    return is_int || !var->is_int;
+}
+
+/**
+ * @brief Clears the flag of the arrays used other than by a constant index in bounds.
+ */
+static void check_accesses(SroaCtx *ctx, Node *root){
+    for(; root; root = root->nextSibling){
+        Candidate *candidate;
+        if(root->label == Variable && FIRSTCHILD(root)->label == Ident && (candidate = find_candidate(ctx, FIRSTCHILD(root)->ident)))
+            candidate->replaceable = 0;
+        if(root->label == Variable && FIRSTCHILD(root)->label == Array
+            && (candidate = find_candidate(ctx, FIRSTCHILD(FIRSTCHILD(root))->ident))){
+            Node *index = unwrap(FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))));
+            if(index->label != Num || index->num < 0 || index->num >= candidate->size)
+                candidate->replaceable = 0;
+        }
+        if(root->label == Equals && FIRSTCHILD(FIRSTCHILD(root))->label == Array
+            && (candidate = find_candidate(ctx, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root)))->ident))
+            && !fits_element(ctx, SECONDCHILD(root), candidate->is_int))
+            candidate->replaceable = 0;
+        check_accesses(ctx, FIRSTCHILD(root));
+    }
+}
+
+static char *temp_name(SroaCtx *ctx){
+    static int counter = 0;
+    char *name = (char*) try(malloc(sizeof(char) * (strlen(SROA_TEMP_PREFIX) + 12)), NULL);
+    do
+        sprintf(name, SROA_TEMP_PREFIX "%d", ++counter);
+    while(is_local(ctx, name) || check_in_table(*ctx->global_vars, name) || find_function_decl(name));
+    ctx->temps = (char**) try(realloc(ctx->temps, sizeof(char*) * (ctx->nb_temps + 1)), NULL);
+    ctx->temps[ctx->nb_temps++] = name;
+    return name;
+}
+
+static void declare_temp(SroaCtx *ctx, char *name, int is_int){
+    Node *decl = makeNode(Type), *ident = makeNode(Ident);
+    decl->ident = strdup(is_int ? "int" : "char");
+    ident->ident = strdup(name);
+    addChild(decl, ident);
+    decl->nextSibling = ctx->corps->firstChild;
+    ctx->corps->firstChild = decl;
+}
+
+/**
+ * @brief Replaces the accesses to the elements of the replaceable arrays by their scalars.
+ */
+static void replace_accesses(SroaCtx *ctx, Node *root){
+    for(; root; root = root->nextSibling){
+        Candidate *candidate;
+        if(root->label == Variable && FIRSTCHILD(root)->label == Array
+            && (candidate = find_candidate(ctx, FIRSTCHILD(FIRSTCHILD(root))->ident)) && candidate->replaceable){
+            Node *array = FIRSTCHILD(root), *ident = makeNode(Ident);
+            int index = unwrap(FIRSTCHILD(FIRSTCHILD(array)))->num;
+            if(!candidate->elements[index]){
+                candidate->elements[index] = temp_name(ctx);
+                declare_temp(ctx, candidate->elements[index], candidate->is_int);
+            }
+            ident->ident = strdup(candidate->elements[index]);
+            ident->lineno = array->lineno;
+            root->firstChild = ident;
+            deleteTree(array);
+            continue;
+        }
+        replace_accesses(ctx, FIRSTCHILD(root));
+    }
+}
+
+/**
+ * @brief Removes the declaration of an array, and its Type node if it was the last one.
+ */
+static void remove_declaration(SroaCtx *ctx, Candidate *candidate){
+    for(Node **link = &candidate->type->firstChild; *link; link = &(*link)->nextSibling)
+        if(*link == candidate->decl){
+            *link = candidate->decl->nextSibling;
+            candidate->decl->nextSibling = NULL;
+            deleteTree(candidate->decl);
+            break;
+        }
+    if(candidate->type->firstChild)
+        return;
+    for(Node **link = &ctx->corps->firstChild; *link; link = &(*link)->nextSibling)
+        if(*link == candidate->type){
+            *link = candidate->type->nextSibling;
+            candidate->type->nextSibling = NULL;
+            deleteTree(candidate->type);
+            break;
+        }
+}
+
+static void free_candidates(SroaCtx *ctx){
+    for(int i = 0; i < ctx->nb_candidates; ++i)
+        free(ctx->candidates[i].elements);
+    free(ctx->candidates);
+    ctx->candidates = NULL;
+    ctx->nb_candidates = 0;
+}
+
+/**
+ * @brief Replaces the elements of the small local arrays by scalars.
+ *
+ * A local array of at most SROA_MAX_SIZE elements is replaced when each access indexes it
+ * by a constant in bounds, so that it's never passed to a function. Each accessed element
+ * becomes a local scalar of the type of the array, that the constant propagation and the
+ * dead code elimination then handle like the other scalars. The array also needs all its
+ * assigned values to be read the same from a scalar, see fits_element().
+ * @return The tables of the functions, rebuilt with the new scalars.
+ */
+SymTabsFct** replace_small_arrays(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report){
+    SroaCtx ctx = {global_vars, NULL, NULL, NULL, 0, NULL, 0};
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        int index = -1;
+        if(current->label != Function)
+            continue;
+        for(int i = 0; i < *nb_functions && index < 0; ++i)
+            if(!strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                index = i;
+        if(index < 0)
+            continue;
+        ctx.function = functions[index];
+        ctx.corps = FOURTHCHILD(current);
+        collect_candidates(&ctx);
+        check_accesses(&ctx, FIRSTCHILD(ctx.corps));
+        replace_accesses(&ctx, FIRSTCHILD(ctx.corps));
+        for(int i = 0; i < ctx.nb_candidates; ++i){
+            Candidate *candidate = &ctx.candidates[i];
+            int nb_elements = 0;
+            if(!candidate->replaceable)
+                continue;
+            for(int j = 0; j < candidate->size; ++j)
+                nb_elements += candidate->elements[j] != NULL;
+            if(report && nb_elements)
+                fprintf(stderr, "%s: array %s replaced by %d scalar%s\n", ctx.function->ident, candidate->name, nb_elements, nb_elements > 1 ? "s" : "");
+            else if(report)
+                fprintf(stderr, "%s: array %s never accessed, removed\n", ctx.function->ident, candidate->name);
+            remove_declaration(&ctx, candidate);
+        }
+        free_candidates(&ctx);
+    }
+    free(ctx.temps);
+    return update_decl_functions(functions, nb_functions, global_vars);
+}
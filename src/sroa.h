@@ -0,0 +1,16 @@
+/**
+ * @file sroa.h
+ * @brief Scalar replacement of the small local arrays only indexed by constants.
+ */
+
+#ifndef __SROA__H
+#define __SROA__H
+
+#include "compile.h"
+
+#define SROA_TEMP_PREFIX "sroa" ///< Prefix of the variables replacing the array elements.
+#define SROA_MAX_SIZE 16        ///< Arrays with more elements than this are never replaced.
+
+SymTabsFct** replace_small_arrays(SymTabs *global_vars, SymTabsFct **functions, int *nb_functions, int report); ///< Function to replace the elements of the small local arrays by scalars, reporting each array on stderr if asked.
+
+#endif
@@ -36,6 +36,7 @@ Node *makeNode(label_t label) {
   node-> firstChild = node->nextSibling = NULL;
   node->lineno=lineno;
   node->ident = NULL;
+  node->num = 0;
   return node;
 }
 
@@ -56,6 +57,25 @@ void addChild(Node *parent, Node *child) {
   }
 }
 
+Node *copyTree(Node *node) {
+  Node *copy = makeNode(node->label);
+  copy->lineno = node->lineno;
+  copy->num = node->num;
+  copy->ident = node->ident ? strdup(node->ident) : NULL;
+  for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+    addChild(copy, copyTree(child));
+  }
+  return copy;
+}
+
+int countNodes(Node *node) {
+  int nb = 1;
+  for (Node *child = node->firstChild; child != NULL; child = child->nextSibling) {
+    nb += countNodes(child);
+  }
+  return nb;
+}
+
 void deleteTree(Node *node) {
     /*if(node->ident)
         free(node->ident);*/
@@ -35,6 +35,8 @@ typedef struct Node {
 Node *makeNode(label_t label);
 void addSibling(Node *node, Node *sibling);
 void addChild(Node *parent, Node *child);
+Node *copyTree(Node *node);
+int countNodes(Node *node);
 void deleteTree(Node*node);
 void printTree(Node *node);
 
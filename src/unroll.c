@@ -0,0 +1,388 @@
+#include "unroll.h"
+#include "eval.h"
+#include "vectorize.h"
+
+/**
+ * @brief State of the unrolling of a function.
+ */
+typedef struct{
+    SymTabs *global_vars;
+    SymTabsFct *function;  ///< Table of the current function.
+    int budget;            ///< Number of nodes the unrolling can still add to the function.
+    int report;            ///< Flag telling if the decisions are written on stderr.
+    int changed;           ///< Flag telling if a loop has been unrolled.
+}UnrollCtx;
+
+/**
+ * @brief A loop like while(counter OP bound){ ...; counter = counter + step; }.
+ */
+typedef struct{
+    char *counter;    ///< Name of the counter.
+    int step;         ///< Increment of the counter.
+    char *op;         ///< Comparison of the exit test.
+    Node *bound;      ///< Bound of the exit test.
+    Node *increment;  ///< Last statement of the body, increasing the counter.
+}CountedLoop;
+
+static Node *unwrap(Node *root){
+    return root->label == Expression ? FIRSTCHILD(root) : root;
+}
+
+static char *scalar_name(Node *root){
+    root = unwrap(root);
+    return root->label == Variable && FIRSTCHILD(root)->label == Ident ? FIRSTCHILD(root)->ident : NULL;
+}
+
+static int is_local_scalar(UnrollCtx *ctx, char *var_name){
+    if(check_in_table(*ctx->global_vars, var_name))
+        return 0;
+    for(Table *current = ctx->function->variables; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return !current->var.is_array;
+    for(Table *current = ctx->function->parameters; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return !current->var.is_array;
+    return 0;
+}
+
+static int count_assignments(Node *root, char *var_name){
+    int nb = 0;
+    for(; root; root = root->nextSibling){
+        if(root->label == Equals && FIRSTCHILD(FIRSTCHILD(root))->label == Ident
+            && !strcmp(FIRSTCHILD(FIRSTCHILD(root))->ident, var_name))
+            nb++;
+        nb += count_assignments(FIRSTCHILD(root), var_name);
+    }
+    return nb;
+}
+
+static int constant_value(Node *root, long *value){
+    root = unwrap(root);
+    if(root->label == Num)
+        *value = root->num;
+    else if(root->label == Character)
+        *value = character_value(root);
+    else
+        return 0;
+    return 1;
+}
+
+static void report_loop(UnrollCtx *ctx, Node *loop, char *message){
+    if(ctx->report)
+        fprintf(stderr, "%s, loop line %d: %s\n", ctx->function->ident, FIRSTCHILD(loop)->lineno, message);
+}
+
+/**
+ * @brief Recognizes a counted loop.
+ *
+ * The counter is a local scalar only assigned by the last statement of the body, and it's
+ * compared to a constant or to a local scalar that the loop doesn't assign.
+ */
+static int recognize_loop(UnrollCtx *ctx, Node *loop, CountedLoop *counted){
+    Node *cond = unwrap(FIRSTCHILD(loop)), *body = SECONDCHILD(loop), *last;
+    char *bound_name;
+    long value;
+    if((cond->label != Order && (cond->label != Eq || strcmp(cond->ident, "!="))) || !SECONDCHILD(cond))
+        return 0;
+    counted->counter = scalar_name(FIRSTCHILD(cond));
+    if(!counted->counter || !is_local_scalar(ctx, counted->counter) || body->label != Instructions)
+        return 0;
+    for(last = FIRSTCHILD(body); last->nextSibling; last = last->nextSibling)
+        ;
+    counted->step = increment_step(last, counted->counter);
+    if(!counted->step || count_assignments(FIRSTCHILD(loop), counted->counter) != 1)
+        return 0;
+    counted->op = cond->ident;
+    if((counted->op[0] == '<' && counted->step < 0) || (counted->op[0] == '>' && counted->step > 0))
+        return 0;
+    counted->bound = SECONDCHILD(cond);
+    bound_name = scalar_name(counted->bound);
+    if(!constant_value(counted->bound, &value) && (!bound_name || !is_local_scalar(ctx, bound_name)
+        || count_assignments(FIRSTCHILD(loop), bound_name)))
+        return 0;
+    counted->increment = last;
+    return 1;
+}
+
+/**
+ * @brief Computes the number of iterations of a counted loop.
+ * @return The number of iterations, or -1 if the loop doesn't end.
+ */
+static long trip_count(CountedLoop *counted, long init, long bound){
+    long step = counted->step, distance;
+    if(!strcmp(counted->op, "!="))
+        return (bound - init) % step == 0 && (bound - init) / step >= 0 ? (bound - init) / step : -1;
+    if(counted->op[0] == '<')
+        distance = bound - init + (counted->op[1] == '=');
+    else
+        distance = init - bound + (counted->op[1] == '=');
+    step = labs(step);
+    return distance <= 0 ? 0 : (distance + step - 1) / step;
+}
+
+static Node *make_variable(char *var_name){
+    Node *var = makeNode(Variable), *ident = makeNode(Ident);
+    ident->ident = strdup(var_name);
+    addChild(var, ident);
+    return var;
+}
+
+static Node *make_num(long value){
+    Node *num = makeNode(Num);
+    num->num = (int)value;
+    return num;
+}
+
+/**
+ * @brief Makes the expression var_name + offset.
+ */
+static Node *make_offset(char *var_name, long offset){
+    Node *addsub;
+    if(!offset)
+        return make_variable(var_name);
+    addsub = makeNode(Addsub);
+    addsub->ident = offset > 0 ? "+" : "-";
+    addChild(addsub, make_variable(var_name));
+    addChild(addsub, make_num(labs(offset)));
+    return addsub;
+}
+
+static Node *make_assignment(char *var_name, Node *value){
+    Node *affect = makeNode(Equals), *expr = makeNode(Expression);
+    affect->ident = "=";
+    addChild(expr, value);
+    addChild(affect, make_variable(var_name));
+    addChild(affect, expr);
+    return affect;
+}
+
+/**
+ * @brief Replaces the reads of the counter in a tree.
+ * @param constant Flag telling if the counter is replaced by the value instead of counter + value.
+ */
+static void substitute_counter(Node *root, char *counter, long value, int constant){
+    for(Node *child = FIRSTCHILD(root); child; child = child->nextSibling){
+        if(child->label == Variable && FIRSTCHILD(child)->label == Ident && !strcmp(FIRSTCHILD(child)->ident, counter)){
+            Node *replacement = constant ? make_num(value) : make_offset(counter, value);
+            deleteTree(FIRSTCHILD(child));
+            child->label = replacement->label;
+            child->ident = replacement->ident;
+            child->num = replacement->num;
+            child->firstChild = replacement->firstChild;
+            free(replacement);
+        }
+        else
+            substitute_counter(child, counter, value, constant);
+    }
+}
+
+static void append(Node **first, Node **last, Node *stmt){
+    if(*last)
+        (*last)->nextSibling = stmt;
+    else
+        *first = stmt;
+    for(*last = stmt; (*last)->nextSibling; *last = (*last)->nextSibling)
+        ;
+}
+
+/**
+ * @brief Copies the statements of the body of a counted loop, its increment excluded.
+ * @param value Value of the counter in the copy, or offset from the counter if constant is 0.
+ */
+static void copy_body(CountedLoop *counted, Node *loop, long value, int constant, Node **first, Node **last){
+    for(Node *stmt = FIRSTCHILD(SECONDCHILD(loop)); stmt != counted->increment; stmt = stmt->nextSibling){
+        Node *copy = copyTree(stmt), *holder = makeNode(Instructions);
+        addChild(holder, copy);
+        substitute_counter(holder, counted->counter, value, constant);
+        append(first, last, FIRSTCHILD(holder));
+        free(holder);
+    }
+}
+
+/**
+ * @brief Makes the statements of nb iterations of a loop whose counter starts at init.
+ */
+static Node *unrolled_iterations(CountedLoop *counted, Node *loop, long init, long nb){
+    Node *first = NULL, *last = NULL;
+    for(long i = 0; i < nb; ++i)
+        copy_body(counted, loop, init + i * counted->step, 1, &first, &last);
+    append(&first, &last, make_assignment(counted->counter, make_num(init + nb * counted->step)));
+    return first;
+}
+
+/**
+ * @brief Replaces a statement by a list of statements.
+ * @param in_list Flag telling if the statement is in a list of instructions, otherwise the new
+ * statements are wrapped in a new list.
+ */
+static void replace_stmt(Node **link, Node *first, int in_list){
+    Node *old = *link, *last;
+    if(!in_list){
+        Node *block = makeNode(Instructions);
+        block->firstChild = first;
+        first = block;
+    }
+    for(last = first; last->nextSibling; last = last->nextSibling)
+        ;
+    last->nextSibling = old->nextSibling;
+    *link = first;
+}
+
+/**
+ * @brief Unrolls a loop by UNROLL_FACTOR, the loop itself being kept for the remaining iterations.
+ *
+ * The new loop runs while the last copy of the body would run, each copy reading counter + i * step.
+ */
+static Node *unroll_partially(CountedLoop *counted, Node *loop){
+    Node *main_loop = makeNode(While), *cond = makeNode(Expression), *test = makeNode(unwrap(FIRSTCHILD(loop))->label);
+    Node *body = makeNode(Instructions), *first = NULL, *last = NULL;
+    main_loop->ident = strdup(loop->ident);
+    test->ident = strdup(counted->op);
+    test->lineno = cond->lineno = FIRSTCHILD(loop)->lineno;
+    addChild(test, make_offset(counted->counter, (long)(UNROLL_FACTOR - 1) * counted->step));
+    addChild(test, copyTree(counted->bound));
+    addChild(cond, test);
+    for(int i = 0; i < UNROLL_FACTOR; ++i)
+        copy_body(counted, loop, (long)i * counted->step, 0, &first, &last);
+    append(&first, &last, make_assignment(counted->counter, make_offset(counted->counter, (long)UNROLL_FACTOR * counted->step)));
+    body->firstChild = first;
+    addChild(main_loop, cond);
+    addChild(main_loop, body);
+    return main_loop;
+}
+
+/**
+ * @brief Unrolls a counted loop, fully when its number of iterations is known and small.
+ * @param previous The statement before the loop, which may give the initial value of the counter.
+ */
+static void unroll_loop(UnrollCtx *ctx, Node **link, int in_list, Node *previous){
+    Node *loop = *link, *replacement;
+    CountedLoop counted;
+    long init = 0, bound, trips = -1, remainder = -1;
+    int body_size;
+    char message[128];
+    if(!recognize_loop(ctx, loop, &counted)){
+        report_loop(ctx, loop, "not unrolled, not a counted loop");
+        return;
+    }
+    if(previous && previous->label == Equals && scalar_name(FIRSTCHILD(previous))
+        && !strcmp(scalar_name(FIRSTCHILD(previous)), counted.counter)
+        && constant_value(SECONDCHILD(previous), &init) && constant_value(counted.bound, &bound))
+        trips = trip_count(&counted, init, bound);
+    body_size = countNodes(FIRSTCHILD(SECONDCHILD(loop))) - countNodes(counted.increment);
+    if(trips >= 0 && trips <= UNROLL_MAX_TRIPS && trips * body_size <= ctx->budget){
+        replacement = unrolled_iterations(&counted, loop, init, trips);
+        ctx->budget -= trips * body_size;
+        sprintf(message, "fully unrolled, %ld iteration%s", trips, trips != 1 ? "s" : "");
+    }
+    else if(is_vectorizable(loop, ctx->global_vars, ctx->function)){
+        report_loop(ctx, loop, "not unrolled, left to the vectorizer");
+        return;
+    }
+    else if(body_size > UNROLL_MAX_BODY || UNROLL_FACTOR * body_size > ctx->budget){
+        report_loop(ctx, loop, "not unrolled, body too large");
+        return;
+    }
+    else if(!strcmp(counted.op, "!=")){
+        report_loop(ctx, loop, "not unrolled, too many iterations for a != test");
+        return;
+    }
+    else{
+        replacement = unroll_partially(&counted, loop);
+        remainder = trips >= 0 ? trips % UNROLL_FACTOR : -1;
+        if(remainder >= 0){
+            replacement->nextSibling = unrolled_iterations(&counted, loop, init + (trips - remainder) * counted.step, remainder);
+            sprintf(message, "unrolled by %d, %ld iteration%s left after the loop", UNROLL_FACTOR, remainder, remainder != 1 ? "s" : "");
+        }
+        else
+            sprintf(message, "unrolled by %d with a remainder loop", UNROLL_FACTOR);
+        ctx->budget -= (UNROLL_FACTOR + (remainder > 0 ? remainder : 0)) * body_size;
+    }
+    report_loop(ctx, loop, message);
+    ctx->changed = 1;
+    if(trips < 0){
+        Node *next = loop->nextSibling;
+        replacement->nextSibling = loop;
+        loop->nextSibling = NULL;
+        if(!in_list){
+            *link = makeNode(Instructions);
+            (*link)->firstChild = replacement;
+            (*link)->nextSibling = next;
+        }
+        else{
+            loop->nextSibling = next;
+            *link = replacement;
+        }
+        return;
+    }
+    replace_stmt(link, replacement, in_list);
+    loop->nextSibling = NULL;
+    deleteTree(loop);
+}
+
+static void unroll_stmt(UnrollCtx *ctx, Node **link, int in_list, Node *previous);
+
+/**
+ * @brief Unrolls the loops of a list of statements, without looking again at the statements it creates.
+ */
+static void unroll_list(UnrollCtx *ctx, Node **link){
+    Node *previous = NULL;
+    while(*link){
+        Node *next = (*link)->nextSibling;
+        unroll_stmt(ctx, link, 1, previous);
+        for(; *link != next; link = &(*link)->nextSibling)
+            previous = *link;
+    }
+}
+
+/**
+ * @brief Unrolls the loops of a statement, inner loops first.
+ * @param link Pointer to the statement in its parent.
+ * @param in_list Flag telling if the statement is in a list of instructions.
+ */
+static void unroll_stmt(UnrollCtx *ctx, Node **link, int in_list, Node *previous){
+    Node *root = *link;
+    switch(root->label){
+        case Instructions:
+            unroll_list(ctx, &root->firstChild);
+            break;
+        case If:
+            unroll_stmt(ctx, &FIRSTCHILD(root)->nextSibling, 0, NULL);
+            if(THIRDCHILD(root))
+                unroll_stmt(ctx, &SECONDCHILD(root)->nextSibling, 0, NULL);
+            break;
+        case While:
+            unroll_stmt(ctx, &FIRSTCHILD(root)->nextSibling, 0, NULL);
+            unroll_loop(ctx, link, in_list, previous);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Unrolls the counted while loops.
+ *
+ * A loop whose number of iterations is known and at most UNROLL_MAX_TRIPS is replaced by copies
+ * of its body reading the value of the counter. Otherwise, the body is copied UNROLL_FACTOR times
+ * in a loop running while the last copy would run, and the original loop does the remaining
+ * iterations. The copies added to a function are limited to UNROLL_BUDGET nodes.
+ * @param report Flag telling if the decision taken for each loop is written on stderr.
+ */
+void unroll_loops(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report){
+    UnrollCtx ctx = {global_vars, NULL, 0, report, 0};
+    for(Node *current = FIRSTCHILD(SECONDCHILD(node)); current; current = current->nextSibling){
+        if(current->label != Function)
+            continue;
+        ctx.function = NULL;
+        for(int i = 0; i < nb_functions; ++i)
+            if(!strcmp(functions[i]->ident, SECONDCHILD(current)->ident))
+                ctx.function = functions[i];
+        if(!ctx.function)
+            continue;
+        ctx.budget = UNROLL_BUDGET;
+        unroll_list(&ctx, &FOURTHCHILD(current)->firstChild);
+    }
+    if(ctx.changed)
+        fold_constant_calls(global_vars, functions, nb_functions, 0);
+}
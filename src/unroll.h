@@ -0,0 +1,18 @@
+/**
+ * @file unroll.h
+ * @brief Unrolling of the counted while loops.
+ */
+
+#ifndef __UNROLL__H
+#define __UNROLL__H
+
+#include "compile.h"
+
+#define UNROLL_FACTOR 4       ///< Number of copies of the body in a partially unrolled loop.
+#define UNROLL_MAX_TRIPS 16   ///< Loops running at most this many times are fully unrolled.
+#define UNROLL_MAX_BODY 60    ///< Loops whose body has more nodes than this are never unrolled.
+#define UNROLL_BUDGET 2000    ///< Maximum number of nodes added by the unrolling of a function.
+
+void unroll_loops(SymTabs *global_vars, SymTabsFct **functions, int nb_functions, int report); ///< Function to unroll the counted loops, reporting each loop on stderr if asked.
+
+#endif
@@ -0,0 +1,687 @@
+#include "vectorize.h"
+#include "frame.h"
+
+static const char *base_registers[VEC_MAX_ARRAYS] = {"rsi", "rdi", "r10", "r11", "r13", "rbx"};
+
+/**
+ * @brief Array accessed by a vectorized loop.
+ */
+typedef struct{
+    char *name;       ///< Name of the array.
+    int kind;         ///< IV_LOCAL, IV_PARAM or IV_GLOBAL.
+    int is_int;       ///< Flag indicating if the elements are integers.
+    int written;      ///< Flag telling if the loop stores into the array.
+    int displaced;    ///< Flag telling if the array is read at another index than the counter.
+    int displacement; ///< Largest displacement of the reads, in absolute value.
+}VecArray;
+
+/**
+ * @brief Scalar accumulating the elements of a vectorized loop.
+ */
+typedef struct{
+    int op;       ///< VEC_SUM, VEC_SUB, VEC_MIN or VEC_MAX.
+    char *var;    ///< Name of the scalar.
+    Node *expr;   ///< Expression accumulated at each iteration.
+}VecReduction;
+
+/**
+ * @brief Analysis of a while loop for its vectorization.
+ */
+typedef struct{
+    Node *loop;
+    SymTabs *global_vars;
+    SymTabsFct *function;
+    char *counter;                              ///< Counter of the loop, increased by 1.
+    Node *bound;                                ///< Invariant bound of the exit test.
+    int inclusive;                              ///< Flag telling if the exit test is <=.
+    int width;                                  ///< Size of the elements in memory, 0 until an array is met.
+    int has_mul;                                ///< Flag telling if the loop multiplies elements.
+    VecArray arrays[VEC_MAX_ARRAYS];            ///< Arrays of the loop, with base_registers as addresses.
+    int nb_arrays;
+    Node *invariants[VEC_MAX_INVARIANTS];       ///< Operands broadcast on the stack before the loop.
+    int nb_invariants;
+    VecReduction reductions[VEC_MAX_REDUCTIONS];
+    int nb_reductions;
+}VecLoop;
+
+static Node *unwrap(Node *root){
+    return root->label == Expression ? FIRSTCHILD(root) : root;
+}
+
+static char *scalar_name(Node *root){
+    root = unwrap(root);
+    return root->label == Variable && FIRSTCHILD(root)->label == Ident ? FIRSTCHILD(root)->ident : NULL;
+}
+
+static Element *find_element(Table *table, char *var_name){
+    for(Table *current = table; current; current = current->next)
+        if(!strcmp(current->var.ident, var_name))
+            return &current->var;
+    return NULL;
+}
+
+/**
+ * @brief Finds a variable as the code generation does, globals first.
+ * @param kind Set to IV_GLOBAL, IV_PARAM or IV_LOCAL.
+ */
+static Element *find_var(VecLoop *vec, char *var_name, int *kind){
+    Element *var;
+    *kind = IV_GLOBAL;
+    if((var = find_element(vec->global_vars->first, var_name)))
+        return var;
+    *kind = IV_PARAM;
+    if((var = find_element(vec->function->parameters, var_name)))
+        return var;
+    *kind = IV_LOCAL;
+    return find_element(vec->function->variables, var_name);
+}
+
+static int is_local_scalar(VecLoop *vec, char *var_name){
+    int kind;
+    Element *var = find_var(vec, var_name, &kind);
+    return var && kind != IV_GLOBAL && !var->is_array;
+}
+
+static int count_assignments(Node *root, char *var_name){
+    int nb = 0;
+    for(; root; root = root->nextSibling){
+        if(root->label == Equals && FIRSTCHILD(FIRSTCHILD(root))->label == Ident
+            && !strcmp(FIRSTCHILD(FIRSTCHILD(root))->ident, var_name))
+            nb++;
+        nb += count_assignments(FIRSTCHILD(root), var_name);
+    }
+    return nb;
+}
+
+static int count_uses(Node *root, char *var_name){
+    int nb = 0;
+    for(; root; root = root->nextSibling){
+        if(root->label == Variable && FIRSTCHILD(root)->label == Ident && !strcmp(FIRSTCHILD(root)->ident, var_name))
+            nb++;
+        nb += count_uses(FIRSTCHILD(root), var_name);
+    }
+    return nb;
+}
+
+static int same_tree(Node *a, Node *b){
+    if(!a || !b)
+        return a == b;
+    if(a->label != b->label || a->num != b->num || (!a->ident) != (!b->ident) || (a->ident && strcmp(a->ident, b->ident)))
+        return 0;
+    return same_tree(FIRSTCHILD(a), FIRSTCHILD(b)) && same_tree(a->nextSibling, b->nextSibling);
+}
+
+static int invariant_index(VecLoop *vec, Node *leaf){
+    for(int i = 0; i < vec->nb_invariants; ++i){
+        Node *invariant = vec->invariants[i];
+        if(invariant->label == leaf->label && invariant->num == leaf->num
+            && (leaf->label == Num || (leaf->label == Character ? character_value(invariant) == character_value(leaf)
+            : !strcmp(FIRSTCHILD(invariant)->ident, FIRSTCHILD(leaf)->ident))))
+            return i;
+    }
+    return -1;
+}
+
+static int add_invariant(VecLoop *vec, Node *leaf){
+    if(invariant_index(vec, leaf) >= 0)
+        return 1;
+    if(vec->nb_invariants == VEC_MAX_INVARIANTS)
+        return 0;
+    vec->invariants[vec->nb_invariants++] = leaf;
+    return 1;
+}
+
+static int array_index(VecLoop *vec, char *name){
+    for(int i = 0; i < vec->nb_arrays; ++i)
+        if(!strcmp(vec->arrays[i].name, name))
+            return i;
+    return -1;
+}
+
+/**
+ * @brief Adds an array to the loop. All the arrays must have elements of the same size in memory,
+ * 4 bytes for an int and 1 for a char.
+ */
+static VecArray *add_array(VecLoop *vec, char *name){
+    int index = array_index(vec, name), kind, width;
+    Element *var;
+    if(index >= 0)
+        return &vec->arrays[index];
+    var = find_var(vec, name, &kind);
+    if(!var || !var->is_array || vec->nb_arrays == VEC_MAX_ARRAYS)
+        return NULL;
+    width = element_size(var->is_int);
+    if(vec->width && vec->width != width)
+        return NULL;
+    vec->width = width;
+    vec->arrays[vec->nb_arrays] = (VecArray){name, kind, var->is_int, 0, 0, 0};
+    return &vec->arrays[vec->nb_arrays++];
+}
+
+static int check_load(VecLoop *vec, Node *array){
+    int displacement;
+    char *index = indexed_variable(FIRSTCHILD(FIRSTCHILD(array)), &displacement);
+    VecArray *vec_array;
+    if(!index || strcmp(index, vec->counter) || !(vec_array = add_array(vec, FIRSTCHILD(array)->ident)))
+        return 0;
+    if(displacement){
+        vec_array->displaced = 1;
+        if(abs(displacement) > vec_array->displacement)
+            vec_array->displacement = abs(displacement);
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks an expression computed element by element.
+ *
+ * The leaves are elements of arrays indexed by the counter plus a constant, and invariant operands.
+ * @return The number of registers needed to compute it, or 0 if it can't be vectorized.
+ */
+static int check_expression(VecLoop *vec, Node *root){
+    int left, right;
+    root = unwrap(root);
+    switch(root->label){
+        case Num:
+        case Character:
+            return add_invariant(vec, root);
+        case Variable:
+            if(FIRSTCHILD(root)->label == Array)
+                return check_load(vec, FIRSTCHILD(root));
+            {
+                int kind;
+                Element *var = find_var(vec, FIRSTCHILD(root)->ident, &kind);
+                if(!var || var->is_array || !strcmp(FIRSTCHILD(root)->ident, vec->counter)
+                    || count_assignments(FIRSTCHILD(vec->loop), FIRSTCHILD(root)->ident))
+                    return 0;
+            }
+            return add_invariant(vec, root);
+        case Addsub:
+            if(!SECONDCHILD(root)){
+                left = check_expression(vec, FIRSTCHILD(root));
+                return left && root->ident[0] == '-' ? max(2, left + 1) : left;
+            }
+            left = check_expression(vec, FIRSTCHILD(root));
+            right = check_expression(vec, SECONDCHILD(root));
+            return left && right ? max(2, max(left, right + 1)) : 0;
+        case Divstar:
+            if(strcmp(root->ident, "*"))
+                return 0;
+            left = check_expression(vec, FIRSTCHILD(root));
+            right = check_expression(vec, SECONDCHILD(root));
+            if(!left || !right)
+                return 0;
+            vec->has_mul = 1;
+            return max(4, max(left, right + 1));
+        default:
+            return 0;
+    }
+}
+
+static int check_store(VecLoop *vec, Node *stmt){
+    Node *target = FIRSTCHILD(FIRSTCHILD(stmt));
+    int displacement, needed;
+    char *index = indexed_variable(FIRSTCHILD(FIRSTCHILD(target)), &displacement);
+    VecArray *array;
+    if(!index || strcmp(index, vec->counter) || displacement || !(array = add_array(vec, FIRSTCHILD(target)->ident)))
+        return 0;
+    array->written = 1;
+    needed = check_expression(vec, SECONDCHILD(stmt));
+    return needed && needed <= VEC_REGISTERS;
+}
+
+static int check_reduction_var(VecLoop *vec, char *var_name){
+    return is_local_scalar(vec, var_name) && strcmp(var_name, vec->counter) && vec->nb_reductions < VEC_MAX_REDUCTIONS
+        && count_uses(FIRSTCHILD(vec->loop), var_name) == 2 && count_assignments(FIRSTCHILD(vec->loop), var_name) == 1;
+}
+
+/**
+ * @brief Checks a sum like s = s + e, s = e + s or s = s - e, s being only used there.
+ */
+static int check_sum(VecLoop *vec, Node *stmt){
+    char *var_name = FIRSTCHILD(FIRSTCHILD(stmt))->ident;
+    Node *expr = unwrap(SECONDCHILD(stmt)), *operand;
+    int op, needed;
+    if(!check_reduction_var(vec, var_name) || expr->label != Addsub || !SECONDCHILD(expr))
+        return 0;
+    if(scalar_name(FIRSTCHILD(expr)) && !strcmp(scalar_name(FIRSTCHILD(expr)), var_name)){
+        operand = SECONDCHILD(expr);
+        op = expr->ident[0] == '-' ? VEC_SUB : VEC_SUM;
+    }
+    else if(expr->ident[0] == '+' && scalar_name(SECONDCHILD(expr)) && !strcmp(scalar_name(SECONDCHILD(expr)), var_name)){
+        operand = FIRSTCHILD(expr);
+        op = VEC_SUM;
+    }
+    else
+        return 0;
+    needed = check_expression(vec, operand);
+    if(!needed || needed > VEC_REGISTERS - 2)
+        return 0;
+    vec->reductions[vec->nb_reductions++] = (VecReduction){op, var_name, unwrap(operand)};
+    return 1;
+}
+
+/**
+ * @brief Checks a minimum or a maximum like if(a[i] > m) m = a[i], m being only used there.
+ */
+static int check_min_max(VecLoop *vec, Node *stmt){
+    Node *cond = unwrap(FIRSTCHILD(stmt)), *then = SECONDCHILD(stmt), *value;
+    char *var_name, *other;
+    int greater, op;
+    if(THIRDCHILD(stmt) || cond->label != Order)
+        return 0;
+    if(then->label == Instructions && !FIRSTCHILD(then)->nextSibling)
+        then = FIRSTCHILD(then);
+    if(then->label != Equals || FIRSTCHILD(FIRSTCHILD(then))->label != Ident)
+        return 0;
+    var_name = FIRSTCHILD(FIRSTCHILD(then))->ident;
+    value = unwrap(SECONDCHILD(then));
+    if(value->label != Variable || FIRSTCHILD(value)->label != Array || !check_reduction_var(vec, var_name))
+        return 0;
+    greater = cond->ident[0] == '>';
+    if(same_tree(unwrap(FIRSTCHILD(cond))->firstChild, value->firstChild) && (other = scalar_name(SECONDCHILD(cond))))
+        op = greater ? VEC_MAX : VEC_MIN;
+    else if(same_tree(unwrap(SECONDCHILD(cond))->firstChild, value->firstChild) && (other = scalar_name(FIRSTCHILD(cond))))
+        op = greater ? VEC_MIN : VEC_MAX;
+    else
+        return 0;
+    if(strcmp(other, var_name) || !check_load(vec, FIRSTCHILD(value)))
+        return 0;
+    vec->reductions[vec->nb_reductions++] = (VecReduction){op, var_name, value};
+    return 1;
+}
+
+static int check_stmt(VecLoop *vec, Node *stmt){
+    if(stmt->label == Equals)
+        return FIRSTCHILD(FIRSTCHILD(stmt))->label == Array ? check_store(vec, stmt) : check_sum(vec, stmt);
+    if(stmt->label == If)
+        return check_min_max(vec, stmt);
+    return 0;
+}
+
+/**
+ * @brief Analyzes a loop like while(i < n){ ...; i = i + 1; }.
+ *
+ * The body may only store into elements indexed by the counter and accumulate reductions. The
+ * dependence test refuses a loop reading an array it writes at another index than the counter,
+ * since a vector would read elements before the iterations writing them. Parameter arrays may
+ * alias each other, which is checked when the loop runs.
+ */
+static int analyze_loop(VecLoop *vec){
+    Node *cond = unwrap(FIRSTCHILD(vec->loop)), *body = SECONDCHILD(vec->loop), *stmt;
+    if(cond->label != Order || cond->ident[0] != '<' || !(vec->counter = scalar_name(FIRSTCHILD(cond)))
+        || !is_local_scalar(vec, vec->counter) || body->label != Instructions)
+        return 0;
+    vec->inclusive = cond->ident[1] == '=';
+    vec->bound = unwrap(SECONDCHILD(cond));
+    if(vec->bound->label != Num && vec->bound->label != Character){
+        int kind;
+        Element *var = scalar_name(vec->bound) ? find_var(vec, scalar_name(vec->bound), &kind) : NULL;
+        if(!var || var->is_array || count_assignments(FIRSTCHILD(vec->loop), scalar_name(vec->bound)))
+            return 0;
+    }
+    for(stmt = FIRSTCHILD(body); stmt->nextSibling; stmt = stmt->nextSibling)
+        if(!check_stmt(vec, stmt))
+            return 0;
+    if(increment_step(stmt, vec->counter) != 1 || count_assignments(FIRSTCHILD(vec->loop), vec->counter) != 1 || !vec->width)
+        return 0;
+    if(vec->has_mul && vec->width == 1)
+        return 0;
+    for(int i = 0; i < vec->nb_reductions; ++i){
+        VecReduction *reduction = &vec->reductions[i];
+        if(vec->width == 1 || reduction->expr->label != Variable || FIRSTCHILD(reduction->expr)->label != Array)
+            return 0;
+    }
+    for(int i = 0; i < vec->nb_arrays; ++i)
+        if(vec->arrays[i].written && vec->arrays[i].displaced)
+            return 0;
+    return 1;
+}
+
+/**
+ * @brief Tells if a while loop can be vectorized.
+ * @param loop The While node.
+ * @param global_vars The table of the global variables.
+ * @param function The table of the function of the loop.
+ */
+int is_vectorizable(Node *loop, SymTabs *global_vars, SymTabsFct *function){
+    VecLoop vec = {.loop = loop, .global_vars = global_vars, .function = function};
+    return analyze_loop(&vec);
+}
+
+static char packed_suffix(int width){
+    return width == 1 ? 'b' : 'd';
+}
+
+/**
+ * @brief Writes the address of a scalar of the function.
+ */
+static void scalar_address(VecLoop *vec, char *var_name, char *address){
+    int kind;
+    Element *var = find_var(vec, var_name, &kind);
+    sprintf(address, kind == IV_PARAM ? "rbp + %d" : "rbp - %d", var->deplct);
+}
+
+/**
+ * @brief Writes the copy of rax in each element of xmm0.
+ */
+static void broadcast(VecLoop *vec, FILE *file){
+    fprintf(file, "movd xmm0, eax\n");
+    if(vec->width == 1){
+        fprintf(file, "punpcklbw xmm0, xmm0\n");
+        fprintf(file, "punpcklwd xmm0, xmm0\n");
+    }
+    fprintf(file, "pshufd xmm0, xmm0, 0\n");
+}
+
+/**
+ * @brief Writes the computation of an expression for VEC_BYTES / width iterations into xmm<reg>.
+ */
+static void write_expression(VecLoop *vec, Node *root, int reg, FILE *file){
+    char suffix = packed_suffix(vec->width);
+    root = unwrap(root);
+    if(root->label == Variable && FIRSTCHILD(root)->label == Array){
+        int displacement, index = array_index(vec, FIRSTCHILD(FIRSTCHILD(root))->ident);
+        indexed_variable(FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(root))), &displacement);
+        fprintf(file, "movdqu xmm%d, [%s + r8 * %d %+d]\n", reg, base_registers[index], vec->width,
+            displacement * vec->width);
+        return;
+    }
+    if(root->label == Num || root->label == Character || root->label == Variable){
+        fprintf(file, "movdqu xmm%d, [rsp + %d]\n", reg, VEC_BYTES * invariant_index(vec, root));
+        return;
+    }
+    if(root->label == Addsub && !SECONDCHILD(root)){
+        if(root->ident[0] == '+'){
+            write_expression(vec, FIRSTCHILD(root), reg, file);
+            return;
+        }
+        write_expression(vec, FIRSTCHILD(root), reg + 1, file);
+        fprintf(file, "pxor xmm%d, xmm%d\n", reg, reg);
+        fprintf(file, "psub%c xmm%d, xmm%d\n", suffix, reg, reg + 1);
+        return;
+    }
+    write_expression(vec, FIRSTCHILD(root), reg, file);
+    write_expression(vec, SECONDCHILD(root), reg + 1, file);
+    if(root->label == Addsub)
+        fprintf(file, "p%s%c xmm%d, xmm%d\n", root->ident[0] == '+' ? "add" : "sub", suffix, reg, reg + 1);
+    else{
+        fprintf(file, "movdqa xmm%d, xmm%d\n", reg + 2, reg);
+        fprintf(file, "movdqa xmm%d, xmm%d\n", reg + 3, reg + 1);
+        fprintf(file, "pmuludq xmm%d, xmm%d\n", reg, reg + 1);
+        fprintf(file, "psrlq xmm%d, 32\n", reg + 2);
+        fprintf(file, "psrlq xmm%d, 32\n", reg + 3);
+        fprintf(file, "pmuludq xmm%d, xmm%d\n", reg + 2, reg + 3);
+        fprintf(file, "pshufd xmm%d, xmm%d, 8\n", reg, reg);
+        fprintf(file, "pshufd xmm%d, xmm%d, 8\n", reg + 2, reg + 2);
+        fprintf(file, "punpckldq xmm%d, xmm%d\n", reg, reg + 2);
+    }
+}
+
+/**
+ * @brief Writes the selection of the minimum or maximum of xmm0 and xmm<acc> into xmm<acc>.
+ */
+static void write_min_max(int op, int acc, FILE *file){
+    if(op == VEC_MAX){
+        fprintf(file, "movdqa xmm1, xmm0\n");
+        fprintf(file, "pcmpgtd xmm1, xmm%d\n", acc);
+    }
+    else{
+        fprintf(file, "movdqa xmm1, xmm%d\n", acc);
+        fprintf(file, "pcmpgtd xmm1, xmm0\n");
+    }
+    fprintf(file, "pand xmm0, xmm1\n");
+    fprintf(file, "pandn xmm1, xmm%d\n", acc);
+    fprintf(file, "por xmm0, xmm1\n");
+    fprintf(file, "movdqa xmm%d, xmm0\n", acc);
+}
+
+/**
+ * @brief Writes the statements of the body for VEC_BYTES / width iterations.
+ *
+ * The accumulated expressions are summed on 64 bits, as the scalar code does, so the integers
+ * are sign extended first. The sum is subtracted from the scalar of a VEC_SUB.
+ */
+static void write_body(VecLoop *vec, FILE *file){
+    int reduction = 0;
+    for(Node *stmt = FIRSTCHILD(SECONDCHILD(vec->loop)); stmt->nextSibling; stmt = stmt->nextSibling){
+        if(stmt->label == Equals && FIRSTCHILD(FIRSTCHILD(stmt))->label == Array){
+            int index = array_index(vec, FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(stmt)))->ident);
+            write_expression(vec, SECONDCHILD(stmt), 0, file);
+            fprintf(file, "movdqu [%s + r8 * %d], xmm0\n", base_registers[index], vec->width);
+            continue;
+        }
+        VecReduction *current = &vec->reductions[reduction];
+        int acc = VEC_REGISTERS + reduction++;
+        write_expression(vec, current->expr, 0, file);
+        if(current->op >= VEC_MIN)
+            write_min_max(current->op, acc, file);
+        else{
+            fprintf(file, "pxor xmm1, xmm1\n");
+            fprintf(file, "pcmpgtd xmm1, xmm0\n");
+            fprintf(file, "movdqa xmm2, xmm0\n");
+            fprintf(file, "punpckldq xmm0, xmm1\n");
+            fprintf(file, "punpckhdq xmm2, xmm1\n");
+            fprintf(file, "paddq xmm0, xmm2\n");
+            fprintf(file, "paddq xmm%d, xmm0\n", acc);
+        }
+    }
+}
+
+/**
+ * @brief Writes the initialization of the accumulators of the reductions.
+ */
+static void write_accumulators(VecLoop *vec, FILE *file){
+    for(int i = 0; i < vec->nb_reductions; ++i){
+        int acc = VEC_REGISTERS + i;
+        if(vec->reductions[i].op < VEC_MIN){
+            fprintf(file, "pxor xmm%d, xmm%d\n", acc, acc);
+            continue;
+        }
+        fprintf(file, "mov eax, %s\n", vec->reductions[i].op == VEC_MIN ? "0x7fffffff" : "0x80000000");
+        fprintf(file, "movd xmm%d, eax\n", acc);
+        fprintf(file, "pshufd xmm%d, xmm%d, 0\n", acc, acc);
+    }
+}
+
+/**
+ * @brief Writes the merge of the lanes of the accumulators into their scalars.
+ */
+static void write_merge(VecLoop *vec, FILE *file){
+    char address[32];
+    for(int i = 0; i < vec->nb_reductions; ++i){
+        VecReduction *reduction = &vec->reductions[i];
+        int acc = VEC_REGISTERS + i;
+        scalar_address(vec, reduction->var, address);
+        if(reduction->op < VEC_MIN){
+            fprintf(file, "pshufd xmm0, xmm%d, 0x4e\n", acc);
+            fprintf(file, "paddq xmm0, xmm%d\n", acc);
+            fprintf(file, "movq rax, xmm0\n");
+            fprintf(file, "%s [%s], rax\n", reduction->op == VEC_SUB ? "sub" : "add", address);
+            continue;
+        }
+        char *keep = create_label();
+        fprintf(file, "pshufd xmm0, xmm%d, 0x4e\n", acc);
+        write_min_max(reduction->op, acc, file);
+        fprintf(file, "pshufd xmm0, xmm%d, 0xb1\n", acc);
+        write_min_max(reduction->op, acc, file);
+        fprintf(file, "movd eax, xmm%d\n", acc);
+        fprintf(file, "movsxd rax, eax\n");
+        fprintf(file, "cmp rax, [%s]\n", address);
+        fprintf(file, "j%s %s\n", reduction->op == VEC_MIN ? "ge" : "le", keep);
+        fprintf(file, "mov [%s], rax\n", address);
+        fprintf(file, "%s:\n", keep);
+        free(keep);
+    }
+}
+
+/**
+ * @brief Writes the checks that the parameter arrays written by the loop don't overlap the other
+ * parameter arrays within the elements a vector reads ahead.
+ */
+static void write_alias_checks(VecLoop *vec, char *fail_label, FILE *file){
+    int lanes = VEC_BYTES / vec->width;
+    for(int i = 0; i < vec->nb_arrays; ++i)
+        for(int j = 0; j < vec->nb_arrays; ++j){
+            if(i == j || !vec->arrays[i].written || vec->arrays[i].kind != IV_PARAM || vec->arrays[j].kind != IV_PARAM
+                || (vec->arrays[j].written && j < i))
+                continue;
+            fprintf(file, "mov rax, %s\n", base_registers[i]);
+            fprintf(file, "sub rax, %s\n", base_registers[j]);
+            fprintf(file, "mov rdx, rax\n");
+            fprintf(file, "sar rdx, 63\n");
+            fprintf(file, "xor rax, rdx\n");
+            fprintf(file, "sub rax, rdx\n");
+            fprintf(file, "cmp rax, %d\n", (lanes + vec->arrays[j].displacement) * vec->width);
+            fprintf(file, "jb %s\n", fail_label);
+        }
+}
+
+/**
+ * @brief Writes the address of an array into a register.
+ */
+static void write_base(VecLoop *vec, int index, const char *reg, FILE *file){
+    int kind;
+    Element *var = find_var(vec, vec->arrays[index].name, &kind);
+    if(kind == IV_GLOBAL){
+        fprintf(file, "mov %s, global_vars\n", reg);
+        fprintf(file, "add %s, %d\n", reg, var->deplct);
+    }
+    else if(kind == IV_PARAM)
+        fprintf(file, "mov %s, [rbp + %d]\n", reg, var->deplct);
+    else
+        fprintf(file, "lea %s, [rbp - %d]\n", reg, var->deplct);
+}
+
+/**
+ * @brief Recognizes a loop filling an array with an invariant or copying an array into another.
+ * @return The index of the copied array, VEC_FILL for a fill, or VEC_NO_IDIOM.
+ */
+static int string_idiom(VecLoop *vec){
+    Node *stmt = FIRSTCHILD(SECONDCHILD(vec->loop)), *value;
+    int displacement, index;
+    if(vec->nb_reductions || stmt->nextSibling->nextSibling || stmt->label != Equals)
+        return VEC_NO_IDIOM;
+    value = unwrap(SECONDCHILD(stmt));
+    if(value->label != Variable || FIRSTCHILD(value)->label != Array)
+        return value->label == Num || value->label == Character || value->label == Variable ? VEC_FILL : VEC_NO_IDIOM;
+    index = array_index(vec, FIRSTCHILD(FIRSTCHILD(value))->ident);
+    indexed_variable(FIRSTCHILD(FIRSTCHILD(FIRSTCHILD(value))), &displacement);
+    if(displacement || vec->arrays[index].written || vec->arrays[index].is_int != vec->arrays[!index].is_int)
+        return VEC_NO_IDIOM;
+    return index;
+}
+
+/**
+ * @brief Writes a fill or a copy loop as a rep stos or rep movs running every iteration.
+ *
+ * Loops of fewer than VEC_STRING_MIN iterations go on to the vector iterations, which start faster,
+ * and so does a copy between parameter arrays whose destination starts inside the copied elements.
+ * @param skip_label Label after the vector iterations, reached when the loop is done.
+ */
+static void write_string_loop(VecLoop *vec, char *skip_label, FILE *file, SymTabsFct **functions, int nb_functions,
+    char *function_name){
+    int idiom = string_idiom(vec), target = vec->arrays[0].written ? 0 : 1;
+    char suffix = packed_suffix(vec->width), address[32], *vector_label;
+    if(idiom == VEC_NO_IDIOM)
+        return;
+    vector_label = create_label();
+    fprintf(file, "mov rcx, r9\n");
+    fprintf(file, "sub rcx, r8\n");
+    fprintf(file, "cmp rcx, %d\n", VEC_STRING_MIN);
+    fprintf(file, "jl %s\n", vector_label);
+    if(idiom == VEC_FILL){
+        get_value(SECONDCHILD(FIRSTCHILD(SECONDCHILD(vec->loop))), file, vec->global_vars, NULL, NULL, functions,
+            nb_functions, function_name);
+        fprintf(file, "pop rax\n");
+    }
+    else{
+        write_base(vec, idiom, "rsi", file);
+        fprintf(file, "lea rsi, [rsi + r8 * %d]\n", vec->width);
+    }
+    write_base(vec, target, "rdi", file);
+    fprintf(file, "lea rdi, [rdi + r8 * %d]\n", vec->width);
+    fprintf(file, "mov rcx, r9\n");
+    fprintf(file, "sub rcx, r8\n");
+    if(idiom != VEC_FILL && vec->arrays[idiom].kind == IV_PARAM && vec->arrays[target].kind == IV_PARAM){
+        fprintf(file, "mov rax, rdi\n");
+        fprintf(file, "sub rax, rsi\n");
+        fprintf(file, "lea rdx, [rcx * %d]\n", vec->width);
+        fprintf(file, "cmp rax, rdx\n");
+        fprintf(file, "jb %s\n", vector_label);
+    }
+    fprintf(file, "rep %s%c\n", idiom == VEC_FILL ? "stos" : "movs", suffix);
+    scalar_address(vec, vec->counter, address);
+    fprintf(file, "mov [%s], r9\n", address);
+    fprintf(file, "jmp %s\n", skip_label);
+    fprintf(file, "%s:\n", vector_label);
+    free(vector_label);
+}
+
+/**
+ * @brief Writes the iterations of a while loop that run VEC_BYTES / width at a time with SSE2.
+ *
+ * The counter and the bound are kept in r8 and r9, the addresses of the arrays in base_registers
+ * and the broadcast invariants on the stack. Unaligned accesses are used, so no iteration is run
+ * before the vectors. Long fills and copies use rep stos and rep movs instead. The counter is stored back after them, and the scalar loop written next by
+ * the caller runs the remaining iterations.
+ * @return 1 if the loop has been vectorized, 0 otherwise.
+ */
+int vectorize_loop(Node *loop, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name){
+    VecLoop vec = {.loop = loop, .global_vars = global_vars};
+    Node counter = {.label = Ident};
+    char *vector_label, *clean_label, *skip_label, address[32];
+    int lanes;
+    for(int i = 0; i < nb_functions; ++i)
+        if(!strcmp(functions[i]->ident, function_name))
+            vec.function = functions[i];
+    if(!vec.function || !analyze_loop(&vec))
+        return 0;
+    lanes = VEC_BYTES / vec.width;
+    vector_label = create_label();
+    clean_label = create_label();
+    skip_label = create_label();
+    counter.ident = vec.counter;
+    fprintf(file, ";Vectorized while\n");
+    get_value(&(Node){.label = Variable, .firstChild = &counter}, file, global_vars, NULL, NULL, functions,
+        nb_functions, function_name);
+    get_value(vec.bound, file, global_vars, NULL, NULL, functions, nb_functions, function_name);
+    fprintf(file, "pop r9\n");
+    fprintf(file, "pop r8\n");
+    if(vec.inclusive)
+        fprintf(file, "add r9, 1\n");
+    write_string_loop(&vec, skip_label, file, functions, nb_functions, function_name);
+    fprintf(file, "mov rax, r9\n");
+    fprintf(file, "sub rax, r8\n");
+    fprintf(file, "cmp rax, %d\n", lanes);
+    fprintf(file, "jl %s\n", skip_label);
+    if(vec.nb_invariants)
+        fprintf(file, "sub rsp, %d\n", VEC_BYTES * vec.nb_invariants);
+    for(int i = 0; i < vec.nb_invariants; ++i){
+        get_value(vec.invariants[i], file, global_vars, NULL, NULL, functions, nb_functions, function_name);
+        fprintf(file, "pop rax\n");
+        broadcast(&vec, file);
+        fprintf(file, "movdqu [rsp + %d], xmm0\n", VEC_BYTES * i);
+    }
+    for(int i = 0; i < vec.nb_arrays; ++i)
+        write_base(&vec, i, base_registers[i], file);
+    write_alias_checks(&vec, clean_label, file);
+    write_accumulators(&vec, file);
+    fprintf(file, "%s:\n", vector_label);
+    write_body(&vec, file);
+    fprintf(file, "add r8, %d\n", lanes);
+    fprintf(file, "lea rax, [r8 + %d]\n", lanes);
+    fprintf(file, "cmp rax, r9\n");
+    fprintf(file, "jle %s\n", vector_label);
+    write_merge(&vec, file);
+    scalar_address(&vec, vec.counter, address);
+    fprintf(file, "mov [%s], r8\n", address);
+    fprintf(file, "%s:\n", clean_label);
+    if(vec.nb_invariants)
+        fprintf(file, "add rsp, %d\n", VEC_BYTES * vec.nb_invariants);
+    fprintf(file, "%s:\n", skip_label);
+    free(vector_label);
+    free(clean_label);
+    free(skip_label);
+    return 1;
+}
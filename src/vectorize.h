@@ -0,0 +1,32 @@
+/**
+ * @file vectorize.h
+ * @brief Vectorization of the array loops with SSE2.
+ */
+
+#ifndef __VECTORIZE__H
+#define __VECTORIZE__H
+
+#include "compile.h"
+#include "ivsr.h"
+
+#define VEC_BYTES 16            ///< Size of an SSE2 register.
+#define VEC_MAX_ARRAYS 6        ///< Maximum number of arrays of a vectorized loop, one general register each.
+#define VEC_MAX_INVARIANTS 8    ///< Maximum number of invariant operands broadcast before a vectorized loop.
+#define VEC_MAX_REDUCTIONS 3    ///< Maximum number of reductions of a vectorized loop, xmm12 to xmm14.
+#define VEC_REGISTERS 12        ///< Registers xmm0 to xmm11 evaluate the expressions.
+
+#define VEC_STRING_MIN 64       ///< Fills and copies of fewer elements use the vector iterations rather than rep stos or rep movs.
+
+#define VEC_FILL -1     ///< Loop storing an invariant into each element of an array.
+#define VEC_NO_IDIOM -2 ///< Loop that is neither a fill nor a copy.
+
+#define VEC_SUM 0 ///< Reduction s = s + e.
+#define VEC_SUB 1 ///< Reduction s = s - e.
+#define VEC_MIN 2 ///< Reduction if(e < m) m = e.
+#define VEC_MAX 3 ///< Reduction if(e > m) m = e.
+
+int is_vectorizable(Node *loop, SymTabs *global_vars, SymTabsFct *function); ///< Function to check if a while loop can be vectorized.
+
+int vectorize_loop(Node *loop, FILE *file, SymTabs *global_vars, SymTabsFct **functions, int nb_functions, char *function_name); ///< Function to write the vectorized iterations of a while loop, before its scalar code.
+
+#endif
@@ -0,0 +1,286 @@
+#include <limits.h>
+#include <signal.h>
+#include "vm.h"
+
+/**
+ * @brief Return of a call: the state of the caller.
+ */
+typedef struct{
+    long *pc;         ///< Instruction following the call.
+    long *registers;  ///< Frame of the caller.
+    char *frame;      ///< Memory of the local arrays of the caller.
+    char *frame_end;  ///< End of the memory of the caller, where the frame of the call started.
+    long dest;        ///< Register of the caller receiving the value.
+}VmCall;
+
+static unsigned char in_buffer[IN_BUFFER_SIZE];
+static long in_start = 0, in_end = 0;
+static char out_buffer[OUT_BUFFER_SIZE];
+static long out_length = 0;
+
+/**
+ * @brief Writes the output buffer, like _flush: a write taking only a part of the bytes is
+ * followed by another, and the rest is given up after an error.
+ */
+static void vm_flush(){
+    long done = 0, res;
+    while(done < out_length && (res = write(1, out_buffer + done, out_length - done)) > 0)
+        done += res;
+    out_length = 0;
+}
+
+static long vm_fill(){
+    long res;
+    vm_flush();
+    res = read(0, in_buffer, IN_BUFFER_SIZE);
+    in_start = 0;
+    in_end = res > 0 ? res : 0;
+    return res;
+}
+
+static long vm_getchar(){
+    if(in_start >= in_end && vm_fill() <= 0)
+        return 0;
+    return in_buffer[in_start++];
+}
+
+/**
+ * @brief Reads an integer like _getint: an optional '-' then digits, the character following
+ * the number being consumed. The program exits with code 5 without any digit or '-' first.
+ */
+static long vm_getint(){
+    unsigned long value = 0, digit;
+    long sign = 1, first = vm_getchar();
+    if(first == '-')
+        sign = -1;
+    else if((unsigned long) (first - '0') > 9){
+        vm_flush();
+        exit(5);
+    }
+    else
+        value = first - '0';
+    while(in_start < in_end || vm_fill() > 0){
+        digit = in_buffer[in_start++] - (unsigned long) '0';
+        if(digit > 9)
+            break;
+        value = value * 10 + digit;
+    }
+    return (long) (value * sign);
+}
+
+static void vm_putchar(long character){
+    if(out_length >= OUT_BUFFER_SIZE)
+        vm_flush();
+    out_buffer[out_length++] = character;
+    if((char) character == '\n' && line_buffered)
+        vm_flush();
+}
+
+static void vm_putint(long value){
+    char scratch[PUTINT_SCRATCH], *first = scratch + PUTINT_SCRATCH;
+    unsigned long magnitude = value < 0 ? 0UL - (unsigned long) value : (unsigned long) value;
+    if(out_length > OUT_BUFFER_SIZE - PUTINT_SCRATCH)
+        vm_flush();
+    do{
+        *--first = '0' + magnitude % 10;
+        magnitude /= 10;
+    }while(magnitude);
+    if(value < 0)
+        *--first = '-';
+    memcpy(out_buffer + out_length, first, scratch + PUTINT_SCRATCH - first);
+    out_length += scratch + PUTINT_SCRATCH - first;
+}
+
+/**
+ * @brief Writes the characters of a merged putchar at once, like the native code.
+ */
+static void vm_puts(char *characters, long length){
+    if(out_length > OUT_BUFFER_SIZE - (length + 7) / 8 * 8)
+        vm_flush();
+    memcpy(out_buffer + out_length, characters, length);
+    out_length += length;
+    if(line_buffered && memchr(characters, '\n', length))
+        vm_flush();
+}
+
+/**
+ * @brief Stops the program like the native code for a division by 0 or of the smallest integer
+ * by -1, the pending output being lost.
+ */
+static void vm_divide_error(){
+    raise(SIGFPE);
+    exit(EXIT_ERROR);
+}
+
+static void vm_stack_overflow(){
+    fprintf(stderr, "Virtual machine error: stack overflow\n");
+    raise(SIGSEGV);
+    exit(EXIT_ERROR);
+}
+
+/**
+ * @brief Runs the bytecode of a program from main.
+ *
+ * The dispatch is threaded: each opcode of the code is first replaced by the address of the
+ * code handling it, so that every handler jumps straight to the next one with a computed goto.
+ * The parameters of main get the first words of the initial stack of a process, like the
+ * native code: argc, argv[0], NULL, then the environment. A call zeroes the local scalars of
+ * its frame, a fresh frame of the native code being zeroed too the first time.
+ * @param asm_filename Name of the assembly file the program would have, argv[0] being its name
+ * without .asm.
+ * @return The value returned by main.
+ */
+int run_bytecode(Bytecode *program, char *asm_filename){
+    static void *const handlers[BC_OPCODES] = {
+        [BC_MOVE] = &&op_move, [BC_CONST] = &&op_const, [BC_ADD] = &&op_add, [BC_SUB] = &&op_sub,
+        [BC_MUL] = &&op_mul, [BC_DIV] = &&op_div, [BC_MOD] = &&op_mod, [BC_ADDK] = &&op_addk,
+        [BC_MULK] = &&op_mulk, [BC_NEG] = &&op_neg, [BC_NOT] = &&op_not,
+        [BC_EQ] = &&op_eq, [BC_NE] = &&op_ne, [BC_LT] = &&op_lt, [BC_LE] = &&op_le, [BC_GT] = &&op_gt, [BC_GE] = &&op_ge,
+        [BC_JMP] = &&op_jmp, [BC_JZ] = &&op_jz, [BC_JNZ] = &&op_jnz,
+        [BC_JEQ] = &&op_jeq, [BC_JNE] = &&op_jne, [BC_JLT] = &&op_jlt, [BC_JLE] = &&op_jle, [BC_JGT] = &&op_jgt, [BC_JGE] = &&op_jge,
+        [BC_JEQK] = &&op_jeqk, [BC_JNEK] = &&op_jnek, [BC_JLTK] = &&op_jltk, [BC_JLEK] = &&op_jlek,
+        [BC_JGTK] = &&op_jgtk, [BC_JGEK] = &&op_jgek,
+        [BC_LDGI] = &&op_ldgi, [BC_LDGC] = &&op_ldgc, [BC_STGI] = &&op_stgi, [BC_STGC] = &&op_stgc,
+        [BC_LDI] = &&op_ldi, [BC_LDC] = &&op_ldc, [BC_STI] = &&op_sti, [BC_STC] = &&op_stc,
+        [BC_LDIK] = &&op_ldik, [BC_LDCK] = &&op_ldck, [BC_STIK] = &&op_stik, [BC_STCK] = &&op_stck,
+        [BC_FRAME] = &&op_frame, [BC_CALL] = &&op_call, [BC_RET] = &&op_ret, [BC_RET0] = &&op_ret0,
+        [BC_GETCHAR] = &&op_getchar, [BC_GETINT] = &&op_getint, [BC_PUTCHAR] = &&op_putchar,
+        [BC_PUTINT] = &&op_putint, [BC_PUTS] = &&op_puts
+    };
+    extern char **environ;
+    long *code = program->code, *pc, *r, *registers, value, nb_env = 0;
+    char *memory, *frame, *frame_end, *name = strdup(asm_filename);
+    VmCall *calls, *call;
+    BcFunction *function;
+    if(program->main_function < 0)
+        return 0;
+    for(long i = 0; i < program->size; i += 1 + value){
+        value = bytecode_operands(code + i);
+        code[i] = (long) handlers[code[i]];
+    }
+    if(strstr(name, ".asm"))
+        strstr(name, ".asm")[0] = '\0';
+    while(environ[nb_env])
+        nb_env++;
+    function = &program->functions[program->main_function];
+    registers = r = (long*) try(calloc(VM_REGISTERS, sizeof(long)), NULL);
+    memory = frame = (char*) try(calloc(VM_MEMORY, sizeof(char)), NULL);
+    calls = call = (VmCall*) try(malloc(sizeof(VmCall) * VM_MAX_CALLS), NULL);
+    if(function->nb_registers > VM_REGISTERS || function->frame_bytes > VM_MEMORY)
+        vm_stack_overflow();
+    for(int i = 0; i < function->nb_params; ++i)
+        r[i] = i == 0 ? 1 : i == 1 ? (long) name : i >= 3 && i - 3 < nb_env ? (long) environ[i - 3] : 0;
+    frame_end = frame + function->frame_bytes;
+    pc = code + function->entry;
+
+#define NEXT(n) pc += (n) + 1; goto *(void*) *pc
+#define R(i) r[pc[i]]
+#define JUMP_IF(cond) if(cond){ pc = code + pc[3]; goto *(void*) *pc; } NEXT(3)
+
+    goto *(void*) *pc;
+op_move: R(1) = R(2); NEXT(2);
+op_const: R(1) = pc[2]; NEXT(2);
+op_add: R(1) = (long) ((unsigned long) R(2) + (unsigned long) R(3)); NEXT(3);
+op_sub: R(1) = (long) ((unsigned long) R(2) - (unsigned long) R(3)); NEXT(3);
+op_mul: R(1) = (long) ((unsigned long) R(2) * (unsigned long) R(3)); NEXT(3);
+op_div:
+    if(R(3) == 0 || (R(2) == LONG_MIN && R(3) == -1))
+        vm_divide_error();
+    R(1) = R(2) / R(3); NEXT(3);
+op_mod:
+    if(R(3) == 0 || (R(2) == LONG_MIN && R(3) == -1))
+        vm_divide_error();
+    R(1) = R(2) % R(3); NEXT(3);
+op_addk: R(1) = (long) ((unsigned long) R(2) + (unsigned long) pc[3]); NEXT(3);
+op_mulk: R(1) = (long) ((unsigned long) R(2) * (unsigned long) pc[3]); NEXT(3);
+op_neg: R(1) = (long) (0UL - (unsigned long) R(2)); NEXT(2);
+op_not: R(1) = !R(2); NEXT(2);
+op_eq: R(1) = R(2) == R(3); NEXT(3);
+op_ne: R(1) = R(2) != R(3); NEXT(3);
+op_lt: R(1) = R(2) < R(3); NEXT(3);
+op_le: R(1) = R(2) <= R(3); NEXT(3);
+op_gt: R(1) = R(2) > R(3); NEXT(3);
+op_ge: R(1) = R(2) >= R(3); NEXT(3);
+op_jmp: pc = code + pc[1]; goto *(void*) *pc;
+op_jz:
+    if(!R(1)){ pc = code + pc[2]; goto *(void*) *pc; }
+    NEXT(2);
+op_jnz:
+    if(R(1)){ pc = code + pc[2]; goto *(void*) *pc; }
+    NEXT(2);
+op_jeq: JUMP_IF(R(1) == R(2));
+op_jne: JUMP_IF(R(1) != R(2));
+op_jlt: JUMP_IF(R(1) < R(2));
+op_jle: JUMP_IF(R(1) <= R(2));
+op_jgt: JUMP_IF(R(1) > R(2));
+op_jge: JUMP_IF(R(1) >= R(2));
+op_jeqk: JUMP_IF(R(1) == pc[2]);
+op_jnek: JUMP_IF(R(1) != pc[2]);
+op_jltk: JUMP_IF(R(1) < pc[2]);
+op_jlek: JUMP_IF(R(1) <= pc[2]);
+op_jgtk: JUMP_IF(R(1) > pc[2]);
+op_jgek: JUMP_IF(R(1) >= pc[2]);
+op_ldgi: R(1) = *(int*) pc[2]; NEXT(2);
+op_ldgc: R(1) = *(signed char*) pc[2]; NEXT(2);
+op_stgi: *(int*) pc[1] = R(2); NEXT(2);
+op_stgc: *(signed char*) pc[1] = R(2); NEXT(2);
+op_ldi: R(1) = ((int*) R(2))[R(3)]; NEXT(3);
+op_ldc: R(1) = ((signed char*) R(2))[R(3)]; NEXT(3);
+op_sti: ((int*) R(1))[R(2)] = R(3); NEXT(3);
+op_stc: ((signed char*) R(1))[R(2)] = R(3); NEXT(3);
+op_ldik: R(1) = ((int*) R(2))[pc[3]]; NEXT(3);
+op_ldck: R(1) = ((signed char*) R(2))[pc[3]]; NEXT(3);
+op_stik: ((int*) R(1))[pc[2]] = R(3); NEXT(3);
+op_stck: ((signed char*) R(1))[pc[2]] = R(3); NEXT(3);
+op_frame: R(1) = (long) (frame + pc[2]); NEXT(2);
+op_call:
+    function = &program->functions[pc[1]];
+    if(call == calls + VM_MAX_CALLS || r + pc[2] + function->nb_registers > registers + VM_REGISTERS
+        || frame_end + function->frame_bytes > memory + VM_MEMORY)
+        vm_stack_overflow();
+    *call++ = (VmCall){pc + 4, r, frame, frame_end, pc[3]};
+    r += pc[2];
+    memset(r + function->nb_params, 0, sizeof(long) * function->nb_locals);
+    frame = frame_end;
+    frame_end += function->frame_bytes;
+    pc = code + function->entry;
+    goto *(void*) *pc;
+op_ret:
+    value = R(1);
+    goto ret;
+op_ret0:
+    value = 0;
+ret:
+    if(call == calls)
+        goto end;
+    --call;
+    pc = call->pc;
+    r = call->registers;
+    frame = call->frame;
+    frame_end = call->frame_end;
+    r[call->dest] = value;
+    goto *(void*) *pc;
+op_getchar:
+    R(1) = in_start < in_end ? in_buffer[in_start++] : vm_getchar(); NEXT(1);
+op_getint: R(1) = vm_getint(); NEXT(1);
+op_putchar:
+    if(out_length < OUT_BUFFER_SIZE && !line_buffered)
+        out_buffer[out_length++] = R(1);
+    else
+        vm_putchar(R(1));
+    NEXT(1);
+op_putint: vm_putint(R(1)); NEXT(1);
+op_puts: vm_puts((char*) (pc + 2), pc[1]); NEXT(1 + (pc[1] + 7) / 8);
+
+#undef NEXT
+#undef R
+#undef JUMP_IF
+
+end:
+    vm_flush();
+    free(registers);
+    free(memory);
+    free(calls);
+    free(name);
+    return value;
+}
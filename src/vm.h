@@ -0,0 +1,17 @@
+/**
+ * @file vm.h
+ * @brief Virtual machine running the bytecode of a program, without any external tool.
+ */
+
+#ifndef __VM__H
+#define __VM__H
+
+#include "bytecode.h"
+
+#define VM_REGISTERS (1 << 20)  ///< Registers of all the frames, 8 MB like the stack of a process.
+#define VM_MEMORY (8 << 20)     ///< Bytes of the local arrays of all the frames.
+#define VM_MAX_CALLS (1 << 18)  ///< Maximum depth of the calls.
+
+int run_bytecode(Bytecode *program, char *asm_filename); ///< Function to run the bytecode of a program, returning the value of main.
+
+#endif
@@ -0,0 +1,3 @@
+#!/bin/bash
+# Entrée de getchar.tpc : dix millions de lignes, 79 Mo.
+seq 10000000
@@ -0,0 +1,3 @@
+#!/bin/bash
+# Entrée de getint.tpc : dix millions d'entiers, de -5000000 à 4999999.
+seq -5000000 4999999
@@ -0,0 +1,3 @@
+#!/bin/bash
+# Entrée de buffered_io.tpc : six mille lignes, 300 ko.
+seq 6000 | sed 's/.*/Ligne & : le Renard BRUN saute par-dessus le Chien paresseux/'
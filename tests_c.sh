@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# Compare la sortie en C (--emit=c, compilée par gcc -O2) au code natif (nasm puis gcc avec libtpc)
+# sur les programmes de test/good et de test/bench. Les options sont passées au compilateur, par
+# exemple : ./tests_c.sh -O1
+# Un programme de test/bench lit la sortie du script de même nom en .sh s'il existe.
+# Les sorties et les codes de retour des deux chemins doivent être identiques. Les appels terminaux
+# ne sont pas optimisés par gcc, pour qu'une récursion sans fin déborde la pile comme le code natif.
+
+if [ ! -f "./bin/tpcc" ]; then
+  echo "Le compilateur 'tpcc' n'est pas présent dans le répertoire courant."
+  exit 1
+fi
+
+if [ ! -f "./bin/libtpc.a" ]; then
+  echo "Le runtime 'libtpc.a' n'est pas construit, utilisez : make runtime"
+  exit 1
+fi
+
+mkdir -p obj bin
+
+score=0
+total=0
+
+printf "%-24s %12s %12s %10s\n" "programme" "natif" "C" "identique"
+for file in test/good/*.tpc test/bench/*.tpc; do
+  name=$(basename "$file" .tpc)
+  directory=$(dirname "$file")
+  input=/dev/null
+  if [ -f "$directory/$name.sh" ]; then
+    input="obj/$name.in"
+    bash "$directory/$name.sh" > "$input"
+  fi
+
+  ./bin/tpcc "$@" < "$file" > /dev/null 2>&1 || { echo "$name : erreur de compilation, ignoré"; continue; }
+  ((total++))
+  nasm -f elf64 -o obj/tests_c.o _anonymous.asm && gcc -o bin/tests_native obj/tests_c.o -nostartfiles -no-pie -Lbin -ltpc || continue
+  ./bin/tpcc --emit=c "$@" < "$file" > /dev/null 2>&1 || { echo "$name : erreur de compilation en C"; continue; }
+  gcc -O2 -fno-optimize-sibling-calls -o bin/tests_c _anonymous.c 2> /dev/null || { echo "$name : erreur de gcc"; continue; }
+
+  start=$EPOCHREALTIME
+  { ./bin/tests_native < "$input" > obj/tests_native.out; } 2> /dev/null
+  native_status=$?
+  ran=$EPOCHREALTIME
+  { ./bin/tests_c < "$input" > obj/tests_c.out; } 2> /dev/null
+  c_status=$?
+  end=$EPOCHREALTIME
+
+  same=NON
+  if [ $native_status == $c_status ] && cmp -s obj/tests_native.out obj/tests_c.out; then
+    same=oui
+    ((score++))
+  fi
+  awk -v name="$name" -v start="${start/,/.}" -v ran="${ran/,/.}" -v end="${end/,/.}" -v same=$same 'BEGIN {
+    printf "%-24s %11.3fs %11.3fs %10s\n", name, ran - start, end - ran, same
+  }'
+done
+rm -f _anonymous.asm _anonymous.c obj/tests_c.o obj/tests_native.out obj/tests_c.out bin/tests_native bin/tests_c
+
+echo ""
+echo "Score : $score / $total"
+[ $score == $total ]
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+# Compare les exécutables écrits par tpcc -e (assembleur et éditeur de liens intégrés) à la machine
+# virtuelle (--vm) sur les programmes de test/good. Les options sont passées au compilateur, par
+# exemple : ./tests_e.sh -O1 -b
+# Un programme lit la sortie du script de même nom en .sh s'il existe. Les sorties et les codes de
+# retour des deux chemins doivent être identiques, puis --run est comparé de la même façon.
+
+if [ ! -f "./bin/tpcc" ]; then
+  echo "Le compilateur 'tpcc' n'est pas présent dans le répertoire courant."
+  exit 1
+fi
+
+mkdir -p obj
+
+score=0
+total=0
+
+printf "%-24s %10s %10s\n" "programme" "-e" "--run"
+for file in test/good/*.tpc; do
+  name=$(basename "$file" .tpc)
+  input=/dev/null
+  if [ -f "test/good/$name.sh" ]; then
+    input="obj/$name.in"
+    bash "test/good/$name.sh" > "$input"
+  fi
+
+  rm -f _anonymous
+  ./bin/tpcc -e "$@" < "$file" > /dev/null 2>&1 || { echo "$name : erreur de compilation, ignoré"; continue; }
+  ((total++))
+  if [ ! -x _anonymous ]; then
+    echo "$name : pas d'exécutable"
+    continue
+  fi
+
+  { ./_anonymous < "$input" > obj/tests_e.out; } 2> /dev/null
+  e_status=$?
+  { ./bin/tpcc --vm --input "$input" "$@" < "$file" > obj/tests_vm.out; } 2> /dev/null
+  vm_status=$?
+  { ./bin/tpcc --run --input "$input" "$@" < "$file" > obj/tests_run.out; } 2> /dev/null
+  run_status=$?
+
+  same_e=NON
+  if [ $e_status == $vm_status ] && cmp -s obj/tests_e.out obj/tests_vm.out; then
+    same_e=oui
+  fi
+  same_run=NON
+  if [ $run_status == $vm_status ] && cmp -s obj/tests_run.out obj/tests_vm.out; then
+    same_run=oui
+  fi
+  if [ $same_e == oui ] && [ $same_run == oui ]; then
+    ((score++))
+  fi
+  printf "%-24s %10s %10s\n" "$name" $same_e $same_run
+done
+rm -f _anonymous.asm _anonymous obj/tests_e.out obj/tests_vm.out obj/tests_run.out
+
+echo ""
+echo "Score : $score / $total"
+[ $score == $total ]